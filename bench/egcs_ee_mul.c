@@ -18,8 +18,9 @@ int main(void)
     mpz_t a, b, c;
     mpz_inits(a, b, c, NULL);
 
-    mpz_set_ui(a, 4124124523);
-    mpz_set_ui(b, 23423523);
+    /* Messages must lie in the subgroup generated by g */
+    mpz_powm_ui(a, pk->g, 4124124523, pk->q);
+    mpz_powm_ui(b, pk->g, 23423523, pk->q);
 
     egcs_encrypt(pk, hr, ca, a);
     egcs_encrypt(pk, hr, cb, b);
@@ -43,36 +43,58 @@ public:
         return pk;
     }
 
-    hcs_random* get_rand() {
+    const djcs_public_key* as_ptr() const {
+        return pk;
+    }
+
+    hcs_random* get_rand() const {
         return hr->as_ptr();
     }
 
     /* Encryption functions acting on a key */
-    void encrypt(mpz_class &rop, mpz_class &op) {
+    void encrypt(mpz_class &rop, mpz_class &op) const {
         djcs_encrypt(pk, hr->as_ptr(), rop.get_mpz_t(), op.get_mpz_t());
     }
 
-    void reencrypt(mpz_class &rop, mpz_class &op) {
+    /* Encrypt using the caller's random state. A key shared between threads
+     * should be used this way, with one hcs::random per thread. */
+    void encrypt(mpz_class &rop, mpz_class &op, hcs::random &hr_) const {
+        djcs_encrypt(pk, hr_.as_ptr(), rop.get_mpz_t(), op.get_mpz_t());
+    }
+
+    void reencrypt(mpz_class &rop, mpz_class &op) const {
         djcs_reencrypt(pk, hr->as_ptr(), rop.get_mpz_t(), op.get_mpz_t());
     }
 
-    void ep_add(mpz_class &rop, mpz_class &c1, mpz_class &c2) {
+    void ep_add(mpz_class &rop, mpz_class &c1, mpz_class &c2) const {
         djcs_ep_add(pk, rop.get_mpz_t(), c1.get_mpz_t(), c2.get_mpz_t());
     }
 
-    void ee_add(mpz_class &rop, mpz_class &c1, mpz_class &c2) {
+    void ee_add(mpz_class &rop, mpz_class &c1, mpz_class &c2) const {
         djcs_ee_add(pk, rop.get_mpz_t(), c1.get_mpz_t(), c2.get_mpz_t());
     }
 
-    void ep_mul(mpz_class &rop, mpz_class &c1, mpz_class &p1) {
-        djcs_ep_mul(pk, rop.get_mpz_t(), c1.get_mpz_t(), p1.get_mpz_t());
+    int ep_mul(mpz_class &rop, mpz_class &c1, mpz_class &p1) const {
+        return djcs_ep_mul(pk, rop.get_mpz_t(), c1.get_mpz_t(), p1.get_mpz_t());
+    }
+
+    int ee_sub(mpz_class &rop, mpz_class &c1, mpz_class &c2) const {
+        return djcs_ee_sub(pk, rop.get_mpz_t(), c1.get_mpz_t(), c2.get_mpz_t());
+    }
+
+    void ep_sub(mpz_class &rop, mpz_class &c1, mpz_class &p1) const {
+        djcs_ep_sub(pk, rop.get_mpz_t(), c1.get_mpz_t(), p1.get_mpz_t());
+    }
+
+    int e_neg(mpz_class &rop, mpz_class &c1) const {
+        return djcs_e_neg(pk, rop.get_mpz_t(), c1.get_mpz_t());
     }
 
     void clear() {
         djcs_clear_public_key(pk);
     }
 
-    std::string export_json() {
+    std::string export_json() const {
         return std::string(djcs_export_public_key(pk));
     }
 
@@ -103,11 +125,15 @@ public:
         return vk;
     }
 
-    hcs_random* get_rand() {
+    const djcs_private_key* as_ptr() const {
+        return vk;
+    }
+
+    hcs_random* get_rand() const {
         return hr->as_ptr();
     }
 
-    void decrypt(mpz_class &rop, mpz_class &c1) {
+    void decrypt(mpz_class &rop, mpz_class &c1) const {
         djcs_decrypt(vk, rop.get_mpz_t(), c1.get_mpz_t());
     }
 
@@ -115,7 +141,7 @@ public:
         djcs_clear_private_key(vk);
     }
 
-    std::string export_json() {
+    std::string export_json() const {
         return std::string(djcs_export_private_key(vk));
     }
 
@@ -124,13 +150,16 @@ public:
     }
 };
 
-inline void generate_key_pair(public_key &pk, private_key &vk,
-        const unsigned long bits)
+// djcs_generate_key_pair returns zero on success, unlike the other schemes,
+// so the result is flipped to match them
+inline int generate_key_pair(public_key &pk, private_key &vk,
+        const unsigned long s, const unsigned long bits)
 {
-    djcs_generate_key_pair(pk.as_ptr(), vk.as_ptr(), vk.get_rand(), bits);
+    return djcs_generate_key_pair(pk.as_ptr(), vk.as_ptr(), vk.get_rand(), s,
+                                  bits) == 0;
 }
 
-inline int verify_key_pair(public_key &pk, private_key &vk) {
+inline int verify_key_pair(const public_key &pk, const private_key &vk) {
     return djcs_verify_key_pair(pk.as_ptr(), vk.as_ptr());
 }
 
@@ -1,5 +1,5 @@
 /**
- * @file djcs_t.h
+ * @file djcs_t.hpp
  *
  * The threshold Paillier scheme offers the same properties as the Paillier
  * scheme, with the extra security that decryption is split performed between a
@@ -18,9 +18,9 @@
 #ifndef HCS_DJCS_T_HPP
 #define HCS_DJCS_T_HPP
 
-#include <string>
 #include <gmpxx.h>
 #include "../libhcs/djcs_t.h"
+#include "../libhcs/hcs_shares.h"
 #include "random.hpp"
 
 namespace hcs {
@@ -40,49 +40,51 @@ public:
     }
 
     ~public_key() {
-        djcs_free_public_key(pk);
+        djcs_t_free_public_key(pk);
         hr->dec_refcount();
     }
 
-    djcs_public_key* as_ptr() {
+    djcs_t_public_key* as_ptr() {
         return pk;
     }
 
-    hcs_random* get_rand() {
+    const djcs_t_public_key* as_ptr() const {
+        return pk;
+    }
+
+    hcs_random* get_rand() const {
         return hr->as_ptr();
     }
 
     /* Encryption functions acting on a key */
-    void encrypt(mpz_class &rop, mpz_class &op) {
+    void encrypt(mpz_class &rop, mpz_class &op) const {
         djcs_t_encrypt(pk, hr->as_ptr(), rop.get_mpz_t(), op.get_mpz_t());
     }
 
-    void reencrypt(mpz_class &rop, mpz_class &op) {
+    void reencrypt(mpz_class &rop, mpz_class &op) const {
         djcs_t_reencrypt(pk, hr->as_ptr(), rop.get_mpz_t(), op.get_mpz_t());
     }
 
-    void ep_add(mpz_class &rop, mpz_class &c1, mpz_class &c2) {
+    void ep_add(mpz_class &rop, mpz_class &c1, mpz_class &c2) const {
         djcs_t_ep_add(pk, rop.get_mpz_t(), c1.get_mpz_t(), c2.get_mpz_t());
     }
 
-    void ee_add(mpz_class &rop, mpz_class &c1, mpz_class &c2) {
+    void ee_add(mpz_class &rop, mpz_class &c1, mpz_class &c2) const {
         djcs_t_ee_add(pk, rop.get_mpz_t(), c1.get_mpz_t(), c2.get_mpz_t());
     }
 
-    void ep_mul(mpz_class &rop, mpz_class &c1, mpz_class &p1) {
+    void ep_mul(mpz_class &rop, mpz_class &c1, mpz_class &p1) const {
         djcs_t_ep_mul(pk, rop.get_mpz_t(), c1.get_mpz_t(), p1.get_mpz_t());
     }
 
-    void clear() {
-        djcs_t_clear_public_key(pk);
-    }
-
-    std::string export_json() {
-        return std::string(djcs_t_export_public_key(pk));
+    // Shares are combined with only the public key, so this may run on a
+    // node holding no secret values
+    int share_combine(mpz_class &rop, hcs_shares *hs) const {
+        return djcs_t_share_combine(pk, rop.get_mpz_t(), hs);
     }
 
-    int import_json(std::string &json) {
-        return djcs_t_import_public_key(pk, json.c_str());
+    void clear() {
+        djcs_t_clear_public_key(pk);
     }
 };
 
@@ -94,7 +96,7 @@ private:
 
 public:
     private_key(hcs::random &hr_) {
-        vk = djcs_init_private_key();
+        vk = djcs_t_init_private_key();
         hr = &hr_;
         hr->inc_refcount();
     }
@@ -108,73 +110,52 @@ public:
         return vk;
     }
 
-    hcs_random* get_rand() {
-        return hr->as_ptr();
-    }
-
-    void decrypt(mpz_class &rop, mpz_class &c1) {
-        djcs_t_decrypt(vk, rop.get_mpz_t(), c1.get_mpz_t());
+    const djcs_t_private_key* as_ptr() const {
+        return vk;
     }
 
-    // May want to make a new object which holds shares, given there are a
-    // number of specific operations that are useful to do on them, plus
-    // they require a set size and we can enforce that through some function
-    void share_combine(mpz_class &rop, vector<mpz_t> &shares) {
-        djcs_t_share_combine(vk, rop.get_mpz_t(), shares.data());
+    hcs_random* get_rand() const {
+        return hr->as_ptr();
     }
 
     void clear() {
         djcs_t_clear_private_key(vk);
     }
-
-    std::string export_json() {
-        return std::string(djcs_t_export_private_key(vk));
-    }
-
-    int import_json(std::string &json) {
-        return djcs_t_import_private_key(vk, json.c_str());
-    }
 };
 
 inline void generate_key_pair(public_key &pk, private_key &vk,
-        const unsigned long bits, const unsigned long l, const unsigned long w)
+        const unsigned long s, const unsigned long bits, const unsigned long l,
+        const unsigned long w)
 {
-    djcs_t_generate_key_pair(pk.as_ptr(), vk.as_ptr(), vk.get_rand(), bits,
-            w, l);
-}
-
-inline int verify_key_pair(public_key &pk, private_key &vk) {
-    return djcs_t_verify_key_pair(pk.as_ptr(), vk.as_ptr());
+    djcs_t_generate_key_pair(pk.as_ptr(), vk.as_ptr(), vk.get_rand(), s,
+            bits, w, l);
 }
 
+// The coefficients are drawn from, and freed with, the private key, so it
+// must outlive the polynomial
 class polynomial {
 
 private:
-    djcs_t_polynomial *px;
-    hcs::random *hr;
+    mpz_t *coeff;
+    djcs_t_private_key *vk;
 
 public:
-    polynomial(hcs::random &hr_) {
-        pk = djcs_t_init_polynomial();
-        hr = &hr_;
-        hr->inc_refcount();
-    }
-
-    ~public_key() {
-        djcs_t_free_polynomial(pk);
-        hr->dec_refcount();
+    polynomial(private_key &vk_) {
+        vk = vk_.as_ptr();
+        coeff = djcs_t_init_polynomial(vk, vk_.get_rand());
     }
 
-    djcs_t_poly* as_ptr() {
-        return pk;
+    ~polynomial() {
+        if (coeff)
+            djcs_t_free_polynomial(vk, coeff);
     }
 
-    hcs_random* get_rand() {
-        return hr->as_ptr();
+    mpz_t* as_ptr() {
+        return coeff;
     }
 
-    void compute(djcs_t::private_key &vk, mpz_class &rop, const unsigned long x) {
-        djcs_t_compute_polynomial(vk.as_ptr(), p, rop.get_mpz_t(), x);
+    void compute(mpz_class &rop, const unsigned long x) const {
+        djcs_t_compute_polynomial(vk, coeff, rop.get_mpz_t(), x);
     }
 };
 
@@ -197,22 +178,13 @@ public:
         return au;
     }
 
-    share_decrypt(public_key &pk, mpz_class &rop, mpz_class &cipher1) {
+    void share_decrypt(const public_key &pk, mpz_class &rop,
+            mpz_class &cipher1) {
         djcs_t_share_decrypt(pk.as_ptr(), au, rop.get_mpz_t(),
                 cipher1.get_mpz_t());
     }
-
-    std::string export_json() {
-        return std::string(djcs_t_export_auth_server(au));
-    }
-
-    void import_json(std::string &json) {
-        djcs_t_import_auth_server(au, json.c_str());
-    }
 };
 
-#ifdef __cplusplus
-}
-#endif
-
+} // djcs_t namespace
+} // hcs namespace
 #endif
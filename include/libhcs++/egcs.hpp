@@ -33,6 +33,11 @@ public:
         c = egcs_init_cipher();
     }
 
+    cipher(const cipher &o) {
+        c = egcs_init_cipher();
+        egcs_set(c, o.as_ptr());
+    }
+
     ~cipher() {
         egcs_free_cipher(c);
     }
@@ -73,18 +78,37 @@ public:
         return pk;
     }
 
-    hcs_random* get_rand() {
+    const egcs_public_key* as_ptr() const {
+        return pk;
+    }
+
+    hcs_random* get_rand() const {
         return hr->as_ptr();
     }
 
-    /* Encryption functions acting on a key */
-    cipher encrypt(mpz_class &op) {
+    /* Encryption functions acting on a key. A message outside the subgroup
+     * of order r is refused, leaving the returned cipher zero. */
+    cipher encrypt(mpz_class &op) const {
         cipher rop;
         egcs_encrypt(pk, hr->as_ptr(), rop.as_ptr(), op.get_mpz_t());
         return rop;
     }
 
-    cipher ee_mul(cipher &c1, cipher &c2) {
+    /* Encrypt using the caller's random state. A key shared between threads
+     * should be used this way, with one hcs::random per thread. */
+    cipher encrypt(mpz_class &op, hcs::random &hr_) const {
+        cipher rop;
+        egcs_encrypt(pk, hr_.as_ptr(), rop.as_ptr(), op.get_mpz_t());
+        return rop;
+    }
+
+    cipher reencrypt(cipher &op) const {
+        cipher rop;
+        egcs_reencrypt(pk, hr->as_ptr(), rop.as_ptr(), op.as_ptr());
+        return rop;
+    }
+
+    cipher ee_mul(cipher &c1, cipher &c2) const {
         cipher rop;
         egcs_ee_mul(pk, rop.as_ptr(), c1.as_ptr(), c2.as_ptr());
         return rop;
@@ -118,12 +142,16 @@ public:
         return vk;
     }
 
-    hcs_random* get_rand() {
+    const egcs_private_key* as_ptr() const {
+        return vk;
+    }
+
+    hcs_random* get_rand() const {
         return hr->as_ptr();
     }
 
     /* Encryption functions acting on a key */
-    mpz_class decrypt(cipher &op) {
+    mpz_class decrypt(cipher &op) const {
         mpz_class rop;
         egcs_decrypt(vk, rop.get_mpz_t(), op.as_ptr());
         return rop;
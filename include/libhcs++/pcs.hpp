@@ -43,46 +43,81 @@ public:
         return pk;
     }
 
-    hcs_random* get_rand() {
+    const pcs_public_key* as_ptr() const {
+        return pk;
+    }
+
+    hcs_random* get_rand() const {
         return hr->as_ptr();
     }
 
     /* Encryption functions acting on a key */
-    mpz_class encrypt(mpz_class &op) {
+    mpz_class encrypt(mpz_class &op) const {
         mpz_class rop;
         pcs_encrypt(pk, hr->as_ptr(), rop.get_mpz_t(), op.get_mpz_t());
         return rop;
     }
 
-    mpz_class reencrypt(mpz_class &op) {
+    /* Encrypt using the caller's random state. A key shared between threads
+     * should be used this way, with one hcs::random per thread. */
+    mpz_class encrypt(mpz_class &op, hcs::random &hr_) const {
+        mpz_class rop;
+        pcs_encrypt(pk, hr_.as_ptr(), rop.get_mpz_t(), op.get_mpz_t());
+        return rop;
+    }
+
+    mpz_class reencrypt(mpz_class &op) const {
         mpz_class rop;
         pcs_reencrypt(pk, hr->as_ptr(), rop.get_mpz_t(), op.get_mpz_t());
         return rop;
     }
 
-    mpz_class ep_add(mpz_class &c1, mpz_class &c2) {
+    mpz_class ep_add(mpz_class &c1, mpz_class &c2) const {
         mpz_class rop;
         pcs_ep_add(pk, rop.get_mpz_t(), c1.get_mpz_t(), c2.get_mpz_t());
         return rop;
     }
 
-    mpz_class ee_add(mpz_class &c1, mpz_class &c2) {
+    mpz_class ee_add(mpz_class &c1, mpz_class &c2) const {
         mpz_class rop;
         pcs_ee_add(pk, rop.get_mpz_t(), c1.get_mpz_t(), c2.get_mpz_t());
         return rop;
     }
 
-    mpz_class ep_mul(mpz_class &c1, mpz_class &p1) {
+    // As for ee_sub, a scalar needing the inverse of an invalid ciphertext
+    // leaves the result zero
+    mpz_class ep_mul(mpz_class &c1, mpz_class &p1) const {
         mpz_class rop;
         pcs_ep_mul(pk, rop.get_mpz_t(), c1.get_mpz_t(), p1.get_mpz_t());
         return rop;
     }
 
+    // An invalid ciphertext leaves the result zero, which is never a valid
+    // ciphertext itself
+    mpz_class ee_sub(mpz_class &c1, mpz_class &c2) const {
+        mpz_class rop;
+        pcs_ee_sub(pk, rop.get_mpz_t(), c1.get_mpz_t(), c2.get_mpz_t());
+        return rop;
+    }
+
+    mpz_class ep_sub(mpz_class &c1, mpz_class &p1) const {
+        mpz_class rop;
+        pcs_ep_sub(pk, rop.get_mpz_t(), c1.get_mpz_t(), p1.get_mpz_t());
+        return rop;
+    }
+
+    // As for ee_sub, an invalid ciphertext leaves the result zero
+    mpz_class e_neg(mpz_class &c1) const {
+        mpz_class rop;
+        pcs_e_neg(pk, rop.get_mpz_t(), c1.get_mpz_t());
+        return rop;
+    }
+
     void clear() {
         pcs_clear_public_key(pk);
     }
 
-    std::string export_json() {
+    std::string export_json() const {
         return std::string(pcs_export_public_key(pk));
     }
 
@@ -113,11 +148,15 @@ public:
         return vk;
     }
 
-    hcs_random* get_rand() {
+    const pcs_private_key* as_ptr() const {
+        return vk;
+    }
+
+    hcs_random* get_rand() const {
         return hr->as_ptr();
     }
 
-    mpz_class decrypt(mpz_class &c1) {
+    mpz_class decrypt(mpz_class &c1) const {
         mpz_class rop;
         pcs_decrypt(vk, rop.get_mpz_t(), c1.get_mpz_t());
         return rop;
@@ -127,7 +166,7 @@ public:
         pcs_clear_private_key(vk);
     }
 
-    std::string export_json() {
+    std::string export_json() const {
         return std::string(pcs_export_private_key(vk));
     }
 
@@ -142,7 +181,7 @@ inline void generate_key_pair(public_key &pk, private_key &vk,
     pcs_generate_key_pair(pk.as_ptr(), vk.as_ptr(), vk.get_rand(), bits);
 }
 
-inline int verify_key_pair(public_key &pk, private_key &vk) {
+inline int verify_key_pair(const public_key &pk, const private_key &vk) {
     return pcs_verify_key_pair(pk.as_ptr(), vk.as_ptr());
 }
 
@@ -19,9 +19,9 @@
 #define HCS_PCS_T_HPP
 
 #include <string>
-#include <vector>
 #include <gmpxx.h>
 #include "../libhcs/pcs_t.h"
+#include "../libhcs/hcs_shares.h"
 #include "random.hpp"
 
 namespace hcs {
@@ -49,47 +49,80 @@ public:
         return pk;
     }
 
-    hcs::random* get_rand() {
+    const pcs_t_public_key* as_ptr() const {
+        return pk;
+    }
+
+    hcs::random* get_rand() const {
         return hr;
     }
 
     /* Encryption functions acting on a key */
-    mpz_class encrypt(mpz_class &op) {
+    mpz_class encrypt(mpz_class &op) const {
         mpz_class rop;
         pcs_t_encrypt(pk, hr->as_ptr(), rop.get_mpz_t(), op.get_mpz_t());
         return rop;
     }
 
-    mpz_class reencrypt(mpz_class &op) {
+    /* Encrypt using the caller's random state. A key shared between threads
+     * should be used this way, with one hcs::random per thread. */
+    mpz_class encrypt(mpz_class &op, hcs::random &hr_) const {
+        mpz_class rop;
+        pcs_t_encrypt(pk, hr_.as_ptr(), rop.get_mpz_t(), op.get_mpz_t());
+        return rop;
+    }
+
+    mpz_class reencrypt(mpz_class &op) const {
         mpz_class rop;
         pcs_t_reencrypt(pk, hr->as_ptr(), rop.get_mpz_t(), op.get_mpz_t());
         return rop;
     }
 
-    mpz_class ep_add(mpz_class &c1, mpz_class &c2) {
+    mpz_class ep_add(mpz_class &c1, mpz_class &c2) const {
         mpz_class rop;
         pcs_t_ep_add(pk, rop.get_mpz_t(), c1.get_mpz_t(), c2.get_mpz_t());
         return rop;
     }
 
-    mpz_class ee_add(mpz_class &c1, mpz_class &c2) {
+    mpz_class ee_add(mpz_class &c1, mpz_class &c2) const {
         mpz_class rop;
         pcs_t_ee_add(pk, rop.get_mpz_t(), c1.get_mpz_t(), c2.get_mpz_t());
         return rop;
     }
 
-    mpz_class ep_mul(mpz_class &c1, mpz_class &p1) {
+    // As for ee_sub, a scalar needing the inverse of an invalid ciphertext
+    // leaves the result zero
+    mpz_class ep_mul(mpz_class &c1, mpz_class &p1) const {
         mpz_class rop;
         pcs_t_ep_mul(pk, rop.get_mpz_t(), c1.get_mpz_t(), p1.get_mpz_t());
         return rop;
     }
 
-    // May want to make a new object which holds shares, given there are a
-    // number of specific operations that are useful to do on them, plus
-    // they require a set size and we can enforce that through some function
-    mpz_class share_combine(std::vector<mpz_t> &shares) {
+    // An invalid ciphertext leaves the result zero, which is never a valid
+    // ciphertext itself
+    mpz_class ee_sub(mpz_class &c1, mpz_class &c2) const {
+        mpz_class rop;
+        pcs_t_ee_sub(pk, rop.get_mpz_t(), c1.get_mpz_t(), c2.get_mpz_t());
+        return rop;
+    }
+
+    mpz_class ep_sub(mpz_class &c1, mpz_class &p1) const {
+        mpz_class rop;
+        pcs_t_ep_sub(pk, rop.get_mpz_t(), c1.get_mpz_t(), p1.get_mpz_t());
+        return rop;
+    }
+
+    // As for ee_sub, an invalid ciphertext leaves the result zero
+    mpz_class e_neg(mpz_class &c1) const {
         mpz_class rop;
-        pcs_t_share_combine(pk, rop.get_mpz_t(), shares.data());
+        pcs_t_e_neg(pk, rop.get_mpz_t(), c1.get_mpz_t());
+        return rop;
+    }
+
+    // Too few flagged shares, or an invalid one, leaves the result zero
+    mpz_class share_combine(hcs_shares *hs) const {
+        mpz_class rop;
+        pcs_t_share_combine(pk, rop.get_mpz_t(), hs);
         return rop;
     }
 
@@ -97,12 +130,14 @@ public:
         pcs_t_clear_public_key(pk);
     }
 
-    std::string export_json() {
+    std::string export_json() const {
         return std::string(pcs_t_export_public_key(pk));
     }
 
+    // pcs_t_import_public_key returns zero on success, so the result is
+    // flipped to match the other wrappers
     int import_json(std::string &json) {
-        return pcs_t_import_public_key(pk, json.c_str());
+        return pcs_t_import_public_key(pk, json.c_str()) == 0;
     }
 };
 
@@ -128,25 +163,17 @@ public:
         return vk;
     }
 
-    hcs::random* get_rand() {
-        return hr;
+    const pcs_t_private_key* as_ptr() const {
+        return vk;
     }
 
-    void decrypt(mpz_class &rop, mpz_class &c1) {
-        //pcs_t_decrypt(vk, rop.get_mpz_t(), c1.get_mpz_t());
+    hcs::random* get_rand() const {
+        return hr;
     }
 
     void clear() {
         pcs_t_clear_private_key(vk);
     }
-
-    std::string export_json() {
-        //return std::string(pcs_t_export_private_key(vk));
-    }
-
-    int import_json(std::string &json) {
-        //return pcs_t_import_private_key(vk, json.c_str());
-    }
 };
 
 class polynomial {
@@ -217,14 +244,14 @@ public:
     }
 };
 
-inline void generate_key_pair(public_key &pk, private_key &vk,
+inline int generate_key_pair(public_key &pk, private_key &vk,
         const unsigned long bits, const unsigned long l, const unsigned long w)
 {
-    pcs_t_generate_key_pair(pk.as_ptr(), vk.as_ptr(), vk.get_rand()->as_ptr(),
-                            bits, w, l);
+    return pcs_t_generate_key_pair(pk.as_ptr(), vk.as_ptr(),
+                                   vk.get_rand()->as_ptr(), bits, w, l);
 }
 
-inline int verify_key_pair(public_key &pk, private_key &vk) {
+inline int verify_key_pair(const public_key &pk, const private_key &vk) {
     return pcs_t_verify_key_pair(pk.as_ptr(), vk.as_ptr());
 }
 
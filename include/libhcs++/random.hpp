@@ -7,6 +7,7 @@
 #ifndef HCS_RANDOM_HPP
 #define HCS_RANDOM_HPP
 
+#include <atomic>
 #include "../libhcs/hcs_random.h"
 
 namespace hcs {
@@ -15,7 +16,7 @@ class random {
 
 private:
     hcs_random *hr;
-    int refcount;   // Counts the number of times this particular instance is counted
+    std::atomic<int> refcount;  // Number of keys referencing this instance
 
 public:
     random() : refcount(0) {
@@ -35,7 +36,10 @@ public:
     }
 
     bool dec_refcount() {
-        return refcount > 0 ? --refcount != 0 : false;
+        int c = refcount.load();
+        while (c > 0 && !refcount.compare_exchange_weak(c, c - 1))
+            ;
+        return c > 1;
     }
 
     bool is_referenced() {
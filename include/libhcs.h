@@ -1,12 +1,28 @@
 #ifndef HCS_LIBHCS_H
 #define HCS_LIBHCS_H
 
+#include "libhcs/hcs_crt.h"
+#include "libhcs/hcs_encoding.h"
+#include "libhcs/hcs_groupby.h"
+#include "libhcs/hcs_key_cache.h"
+#include "libhcs/hcs_prime_pool.h"
 #include "libhcs/hcs_shares.h"
+#include "libhcs/hcs_transport.h"
 #include "libhcs/hcs_random.h"
+#include "libhcs/hcs_scrub.h"
 #include "libhcs/pcs.h"
+#include "libhcs/pcs_ope.h"
+#include "libhcs/pcs_stream.h"
 #include "libhcs/pcs_t.h"
+#include "libhcs/pcs_t_coord.h"
+#include "libhcs/pcs_t_tally.h"
 #include "libhcs/djcs.h"
+#include "libhcs/djcs_pir.h"
 #include "libhcs/djcs_t.h"
+#include "libhcs/dgkcs.h"
 #include "libhcs/egcs.h"
+#include "libhcs/egcs_t.h"
+#include "libhcs/jlcs.h"
+#include "libhcs/oucs.h"
 
 #endif
@@ -0,0 +1,372 @@
+/**
+ * @file dgkcs.h
+ *
+ * The Damgard-Geisler-Kroigaard scheme encrypts values modulo a small prime
+ * u, and is additively homomorphic modulo u:
+ *
+ * @code
+ * E(a + b mod u) = dgkcs_ee_add(E(a), E(b));
+ * E(a + b mod u) = dgkcs_ep_add(E(a), b);
+ * E(a * b mod u) = dgkcs_ep_mul(E(a), b);
+ * E(-a mod u)    = dgkcs_e_neg(E(a));
+ * @endcode
+ *
+ * It is built for bitwise secure comparison, where each bit of a value is
+ * encrypted on its own and the party holding the private key only needs to
+ * learn whether a combination of bits is zero. Ciphertexts are reduced
+ * modulo n, and the random exponent is short, so with the fixed-base tables
+ * held in the public key an encryption is a few hundred multiplications.
+ * dgkcs_is_zero then needs a single t-bit exponentiation modulo p.
+ *
+ * All mpz_t values can be aliases unless otherwise stated.
+ */
+
+#ifndef HCS_DGKCS_H
+#define HCS_DGKCS_H
+
+#include <gmp.h>
+#include "hcs_random.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Bits of the hidden prime orders v_p and v_q used by
+ * dgkcs_generate_key_pair.
+ */
+#define DGKCS_T_BITS 256
+
+/**
+ * Largest plaintext modulus accepted by dgkcs_generate_key_pair. The private
+ * key holds a decryption table with one entry per plaintext.
+ */
+#define DGKCS_MAX_U (1UL << 20)
+
+/**
+ * Public key for use in the DGK system.
+ */
+typedef struct {
+    unsigned long u;     /**< Plaintext modulus, a small prime */
+    unsigned long t;     /**< Bits of the hidden orders v_p and v_q */
+    unsigned long rbits; /**< Precomputation: bits of a random exponent,
+                              5t / 2 */
+    mpz_t n;             /**< Modulus of the key: n = p * q */
+    mpz_t g;             /**< Generator of order u * v_p * v_q */
+    mpz_t h;             /**< Generator of order v_p * v_q */
+    mpz_t *gtab;         /**< Precomputation: fixed-base table of g */
+    mpz_t *htab;         /**< Precomputation: fixed-base table of h */
+} dgkcs_public_key;
+
+/**
+ * An entry of the decryption table of a dgkcs_private_key.
+ */
+typedef struct {
+    mp_limb_t key;       /**< Low limb of gp^m mod p */
+    unsigned long m;     /**< The plaintext m */
+} dgkcs_dlog_entry;
+
+/**
+ * Private key for use in the DGK system.
+ */
+typedef struct {
+    unsigned long u;     /**< Plaintext modulus, a small prime */
+    unsigned long t;     /**< Bits of the hidden orders v_p and v_q */
+    mpz_t p;             /**< A random prime with u * v_p dividing p - 1 */
+    mpz_t q;             /**< A random prime with u * v_q dividing q - 1 */
+    mpz_t vp;            /**< A random prime of t bits */
+    mpz_t vq;            /**< A random prime of t bits */
+    mpz_t g;             /**< The generator g of the public key */
+    mpz_t gp;            /**< Precomputation: g^vp mod p, of order u */
+    mpz_t n;             /**< Precomputation: p * q */
+    dgkcs_dlog_entry *dlog; /**< Precomputation: the u powers of gp, sorted
+                                 by key */
+} dgkcs_private_key;
+
+/**
+ * Initialise a dgkcs_public_key and return a pointer to the newly created
+ * structure.
+ *
+ * @return A pointer to an initialised dgkcs_public_key, NULL on allocation
+ *         failure
+ */
+dgkcs_public_key*  dgkcs_init_public_key(void);
+
+/**
+ * Initialise a dgkcs_private_key and return a pointer to the newly created
+ * structure.
+ *
+ * @return A pointer to an initialised dgkcs_private_key, NULL on allocation
+ *         failure
+ */
+dgkcs_private_key* dgkcs_init_private_key(void);
+
+/**
+ * Initialise a key pair with modulus size @p bits. The plaintext modulus u
+ * is the smallest prime not less than @p umin. It is required that @p pk and
+ * @p vk are initialised before calling this function, and any key they hold
+ * is released.
+ *
+ * The hidden orders v_p and v_q have DGKCS_T_BITS bits, or a quarter of
+ * @p bits if that is smaller. For a comparison of l-bit values, @p umin is
+ * usually a little over l, so u stays tiny. In practice the @p bits value
+ * should usually be greater than 2048 to ensure sufficient security.
+ *
+ * The public key holds fixed-base tables of about 10t entries of @p bits
+ * bits each.
+ *
+ * @param pk A pointer to an initialised dgkcs_public_key
+ * @param vk A pointer to an initialised dgkcs_private_key
+ * @param hr A pointer to an initialised hcs_random type
+ * @param bits The number of bits for the modulus of the key
+ * @param umin The smallest plaintext modulus wanted
+ * @return non-zero on success, zero if u would be larger than DGKCS_MAX_U,
+ *         @p bits is too small to hold u and v_p, or memory could not be
+ *         allocated
+ */
+int dgkcs_generate_key_pair(dgkcs_public_key *pk, dgkcs_private_key *vk,
+        hcs_random *hr, const unsigned long bits, const unsigned long umin);
+
+/**
+ * Encrypt a value @p plain1, and set @p rop to the encrypted result.
+ * @p plain1 is taken modulo u.
+ *
+ * @param pk A pointer to an initialised dgkcs_public_key
+ * @param hr A pointer to an initialised hcs_random type
+ * @param rop mpz_t where the encrypted result is stored
+ * @param plain1 mpz_t to be encrypted
+ */
+void dgkcs_encrypt(const dgkcs_public_key *pk, hcs_random *hr, mpz_t rop,
+        mpz_t plain1);
+
+/**
+ * Encrypt each of the @p count values in @p plain, storing the results in
+ * @p rop. The random exponents are drawn from @p hr in turn, and the
+ * exponentiations are then spread across threads. @p rop and @p plain may
+ * be the same array.
+ *
+ * @param pk A pointer to an initialised dgkcs_public_key
+ * @param hr A pointer to an initialised hcs_random type
+ * @param rop Array of @p count mpz_t where the results are stored
+ * @param plain Array of @p count values to encrypt
+ * @param count Number of values in each array
+ * @return non-zero on success, zero on allocation failure
+ */
+int dgkcs_encrypt_batch(const dgkcs_public_key *pk, hcs_random *hr,
+        mpz_t *rop, mpz_t *plain, unsigned long count);
+
+/**
+ * Encrypt the low @p count bits of @p plain1 one at a time, storing the
+ * encryption of bit i in rop[i]. @p plain1 must be non-negative and must not
+ * alias any value in @p rop.
+ *
+ * @param pk A pointer to an initialised dgkcs_public_key
+ * @param hr A pointer to an initialised hcs_random type
+ * @param rop Array of @p count mpz_t where the results are stored
+ * @param plain1 mpz_t whose bits are encrypted
+ * @param count Number of bits to encrypt
+ * @return non-zero on success, zero on allocation failure
+ */
+int dgkcs_encrypt_bits(const dgkcs_public_key *pk, hcs_random *hr,
+        mpz_t *rop, mpz_t plain1, unsigned long count);
+
+/**
+ * Reencrypt an encrypted value @p op. Upon decryption, this newly
+ * encrypted value, @p rop, will retain the same value as @p op.
+ *
+ * @param pk A pointer to an initialised dgkcs_public_key
+ * @param hr A pointer to an initialised hcs_random type
+ * @param rop mpz_t where the newly encrypted value is stored
+ * @param op mpz_t to be reencrypted
+ */
+void dgkcs_reencrypt(const dgkcs_public_key *pk, hcs_random *hr, mpz_t rop,
+        mpz_t op);
+
+/**
+ * Add a plaintext value @p plain1 to an encrypted value @p cipher1 modulo
+ * u, storing the result in @p rop.
+ *
+ * @param pk A pointer to an initialised dgkcs_public_key
+ * @param rop mpz_t where the newly encrypted value is stored
+ * @param cipher1 mpz_t to be added together
+ * @param plain1 mpz_t to be added together
+ */
+void dgkcs_ep_add(const dgkcs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t plain1);
+
+/**
+ * Add an encrypted value @p cipher2 to an encrypted value @p cipher1 modulo
+ * u, storing the result in @p rop.
+ *
+ * @param pk A pointer to an initialised dgkcs_public_key.
+ * @param rop mpz_t where the newly encrypted value is stored
+ * @param cipher1 mpz_t to be added together
+ * @param cipher2 mpz_t to be added together
+ */
+void dgkcs_ee_add(const dgkcs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t cipher2);
+
+/**
+ * Subtract an encrypted value @p cipher2 from an encrypted value @p cipher1
+ * modulo u, storing the result in @p rop.
+ *
+ * @param pk A pointer to an initialised dgkcs_public_key.
+ * @param rop mpz_t where the newly encrypted value is stored
+ * @param cipher1 The encrypted value which is to be subtracted from
+ * @param cipher2 The encrypted value which is to be subtracted
+ * @return non-zero on success, zero if @p cipher2 is not a valid
+ *         ciphertext, in which case @p rop is unmodified
+ */
+int dgkcs_ee_sub(const dgkcs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t cipher2);
+
+/**
+ * Multiply a plaintext value @p plain1 with an encrypted value @p cipher1
+ * modulo u, storing the result in @p rop. @p plain1 is reduced modulo u
+ * first, so the cost is that of a short exponentiation.
+ *
+ * @param pk A pointer to an initialised dgkcs_public_key.
+ * @param rop mpz_t where the newly encrypted value is stored
+ * @param cipher1 mpz_t to be multiplied together
+ * @param plain1 mpz_t to be multiplied together
+ */
+void dgkcs_ep_mul(const dgkcs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t plain1);
+
+/**
+ * Negate an encrypted value @p cipher1 modulo u, storing the result in
+ * @p rop.
+ *
+ * @param pk A pointer to an initialised dgkcs_public_key.
+ * @param rop mpz_t where the newly encrypted value is stored
+ * @param cipher1 The encrypted value which is to be negated
+ * @return non-zero on success, zero if @p cipher1 is not a valid
+ *         ciphertext, in which case @p rop is unmodified
+ */
+int dgkcs_e_neg(const dgkcs_public_key *pk, mpz_t rop, mpz_t cipher1);
+
+/**
+ * Test whether @p cipher1 is an encryption of zero. This raises
+ * @p cipher1 to v_p modulo p, which removes the random mask, so it costs a
+ * single t-bit exponentiation modulo p.
+ *
+ * @param vk A pointer to an initialised dgkcs_private_key
+ * @param cipher1 mpz_t to be tested
+ * @return non-zero if @p cipher1 decrypts to zero, else zero
+ */
+int dgkcs_is_zero(const dgkcs_private_key *vk, mpz_t cipher1);
+
+/**
+ * Test each of the @p count values in @p cipher with dgkcs_is_zero,
+ * storing the results in @p rop. The tests are spread across threads.
+ *
+ * @param vk A pointer to an initialised dgkcs_private_key
+ * @param rop Array of @p count flags where the results are stored
+ * @param cipher Array of @p count encrypted values to test
+ * @param count Number of values in each array
+ */
+void dgkcs_is_zero_batch(const dgkcs_private_key *vk, int *rop,
+        mpz_t *cipher, unsigned long count);
+
+/**
+ * Decrypt a value @p cipher1, and set @p rop to the decrypted result. After
+ * the same exponentiation as dgkcs_is_zero, the plaintext is looked up in
+ * the table held in the private key.
+ *
+ * @param vk A pointer to an initialised dgkcs_private_key
+ * @param rop mpz_t where the decrypted result is stored
+ * @param cipher1 mpz_t to be decrypted
+ * @return non-zero on success, zero if @p cipher1 is not a valid ciphertext,
+ *         in which case @p rop is unmodified
+ */
+int dgkcs_decrypt(const dgkcs_private_key *vk, mpz_t rop, mpz_t cipher1);
+
+/**
+ * This function zeros all data in @p pk and releases its tables. It is
+ * useful to use if we wish to generate or import a new value for the given
+ * dgkcs_public_key and want to safely ensure the old values are removed.
+ *
+ * @param pk A pointer to an initialised dgkcs_public_key
+ */
+void dgkcs_clear_public_key(dgkcs_public_key *pk);
+
+/**
+ * This function zeros all data in @p vk and releases its decryption table,
+ * so a new key may be generated or imported into it.
+ *
+ * @param vk A pointer to an initialised dgkcs_private_key
+ */
+void dgkcs_clear_private_key(dgkcs_private_key *vk);
+
+/**
+ * Frees a dgkcs_public_key and all associated memory.
+ *
+ * @param pk A pointer to an initialised dgkcs_public_key
+ */
+void dgkcs_free_public_key(dgkcs_public_key *pk);
+
+/**
+ * Frees a dgkcs_private_key and all associated memory.
+ *
+ * @param vk A pointer to an initialised dgkcs_private_key
+ */
+void dgkcs_free_private_key(dgkcs_private_key *vk);
+
+/**
+ * Check that the n, g and u values of @p pk and @p vk match.
+ *
+ * @param pk A pointer to an initialised dgkcs_public_key
+ * @param vk A pointer to an initialised dgkcs_private_key
+ * @return non-zero if keys are valid, else zero
+ */
+int dgkcs_verify_key_pair(const dgkcs_public_key *pk,
+        const dgkcs_private_key *vk);
+
+/**
+ * Export a public key as a JSON string, in the format of
+ * pcs_export_public_key. Only n, g, h, u and t are stored, and the tables
+ * are rebuilt on import.
+ *
+ * @param pk A pointer to an initialised dgkcs_public_key
+ * @return A string representing the given key, else NULL on error
+ */
+char* dgkcs_export_public_key(const dgkcs_public_key *pk);
+
+/**
+ * Export a private key as a JSON string. Only p, q, vp, vq, g, u and t are
+ * stored.
+ *
+ * @param vk A pointer to an initialised dgkcs_private_key
+ * @return A string representing the given key, else NULL on error
+ */
+char* dgkcs_export_private_key(const dgkcs_private_key *vk);
+
+/**
+ * Import a public key from a string. The input string is expected to
+ * match the format given by the export functions. Any key previously held
+ * by @p pk is cleared first.
+ *
+ * @param pk A pointer to an initialised dgkcs_public_key
+ * @param json A string storing the contents of a public key
+ * @return non-zero if success, else zero on format error, if t is zero,
+ *         above DGKCS_T_BITS or too large for n, or on allocation failure
+ */
+int dgkcs_import_public_key(dgkcs_public_key *pk, const char *json);
+
+/**
+ * Import a private key from a string. The input string is expected to
+ * match the format given by the export functions. Any key previously held
+ * by @p vk is cleared first.
+ *
+ * @param vk A pointer to an initialised dgkcs_private_key
+ * @param json A string storing the contents of a private key
+ * @return non-zero if success, else zero on format error, if u is larger
+ *         than DGKCS_MAX_U, or on allocation failure
+ */
+int dgkcs_import_private_key(dgkcs_private_key *vk, const char *json);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -91,7 +91,29 @@ int djcs_generate_key_pair(djcs_public_key *pk, djcs_private_key *vk,
  * @param rop mpz_t where the encrypted result is stored
  * @param plain1 mpz_t to be encrypted
  */
-void djcs_encrypt(djcs_public_key *pk, hcs_random *hr, mpz_t rop, mpz_t plain1);
+void djcs_encrypt(const djcs_public_key *pk, hcs_random *hr, mpz_t rop,
+        mpz_t plain1);
+
+/**
+ * Encrypt a value @p plain1 at level @p s, where 1 <= @p s <= pk->s, and set
+ * @p rop to the encrypted result. The plaintext space is then n^s and the
+ * ciphertext space n^(s+1), independent of the level the key was generated
+ * with. Since a ciphertext at level @p s is itself a valid plaintext at level
+ * @p s + 1, this allows ciphertexts to be encrypted again, as done by
+ * recursive private information retrieval.
+ *
+ * The homomorphic operations of this header all work at level pk->s, so
+ * ciphertexts produced at a lower level must only be combined with each
+ * other modulo n^(s+1).
+ *
+ * @param pk A pointer to an initialised djcs_public_key
+ * @param hr A pointer to an initialised hcs_random type
+ * @param rop mpz_t where the encrypted result is stored
+ * @param plain1 mpz_t to be encrypted
+ * @param s The level to encrypt at
+ */
+void djcs_encrypt_s(const djcs_public_key *pk, hcs_random *hr, mpz_t rop,
+        mpz_t plain1, unsigned long s);
 
 /**
  * Reencrypt an encrypted value @p op. Upon decryption, this newly
@@ -102,7 +124,8 @@ void djcs_encrypt(djcs_public_key *pk, hcs_random *hr, mpz_t rop, mpz_t plain1);
  * @param rop mpz_t where the newly encrypted value is stored
  * @param op mpz_t to be reencrypted
  */
-void djcs_reencrypt(djcs_public_key *pk, hcs_random *hr, mpz_t rop, mpz_t op);
+void djcs_reencrypt(const djcs_public_key *pk, hcs_random *hr, mpz_t rop,
+        mpz_t op);
 
 /**
  * Add a plaintext value @p plain1 to an encrypted value @p cipher1, storing
@@ -113,7 +136,8 @@ void djcs_reencrypt(djcs_public_key *pk, hcs_random *hr, mpz_t rop, mpz_t op);
  * @param cipher1 mpz_t to be added together
  * @param plain1 mpz_t to be added together
  */
-void djcs_ep_add(djcs_public_key *pk, mpz_t rop, mpz_t cipher1, mpz_t plain1);
+void djcs_ep_add(const djcs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t plain1);
 
 /**
  * Add an encrypted value @p cipher2 to an encrypted value @p cipher1, storing
@@ -124,18 +148,99 @@ void djcs_ep_add(djcs_public_key *pk, mpz_t rop, mpz_t cipher1, mpz_t plain1);
  * @param cipher1 mpz_t to be added together
  * @param cipher2 mpz_t to be added together
  */
-void djcs_ee_add(djcs_public_key *pk, mpz_t rop, mpz_t cipher1, mpz_t cipher2);
+void djcs_ee_add(const djcs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t cipher2);
 
 /**
  * Multiply a plaintext value @p plain1 with an encrypted value @p cipher1,
  * storing the result in @p rop.
  *
+ * @p plain1 is reduced modulo n^s, and may be negative. A scalar which is
+ * negative, or larger than half of n^s, is applied to the inverse of
+ * @p cipher1 instead, so its cost depends on its size after reduction.
+ *
  * @param pk A pointer to an initialised djcs_public_key
  * @param rop Where the new encrypted result is stored
  * @param cipher1 The encrypted value which is to be multipled to
  * @param plain1 The plaintext value which is to be multipled
+ * @return non-zero on success, zero if the scalar needs the inverse of
+ *         @p cipher1 and it is not a valid ciphertext, in which case
+ *         @p rop is unmodified
+ */
+int djcs_ep_mul(const djcs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t plain1);
+
+/**
+ * Negate an encrypted value @p cipher1, storing the result in @p rop.
+ *
+ * @param pk A pointer to an initialised djcs_public_key
+ * @param rop Where the new encrypted result is stored
+ * @param cipher1 The encrypted value which is to be negated
+ * @return non-zero on success, zero if @p cipher1 is not a valid
+ *         ciphertext, in which case @p rop is unmodified
  */
-void djcs_ep_mul(djcs_public_key *pk, mpz_t rop, mpz_t cipher1, mpz_t plain1);
+int djcs_e_neg(const djcs_public_key *pk, mpz_t rop, mpz_t cipher1);
+
+/**
+ * Subtract an encrypted value @p cipher2 from an encrypted value @p cipher1,
+ * storing the result in @p rop.
+ *
+ * @param pk A pointer to an initialised djcs_public_key
+ * @param rop Where the new encrypted result is stored
+ * @param cipher1 The encrypted value which is to be subtracted from
+ * @param cipher2 The encrypted value which is to be subtracted
+ * @return non-zero on success, zero if @p cipher2 is not a valid
+ *         ciphertext, in which case @p rop is unmodified
+ */
+int djcs_ee_sub(const djcs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t cipher2);
+
+/**
+ * Subtract a plaintext value @p plain1 from an encrypted value @p cipher1,
+ * storing the result in @p rop. As g = n + 1, g^-plain1 is formed from s
+ * binomial coefficients without exponentiation or inversion, so this costs
+ * little more than djcs_ee_add.
+ *
+ * @param pk A pointer to an initialised djcs_public_key
+ * @param rop Where the new encrypted result is stored
+ * @param cipher1 The encrypted value which is to be subtracted from
+ * @param plain1 The plaintext value which is to be subtracted
+ */
+void djcs_ep_sub(const djcs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t plain1);
+
+/**
+ * Negate each of the @p count encrypted values in @p cipher, storing the
+ * results in @p rop. Every inverse is derived from a single modular
+ * inversion. @p rop and @p cipher may be the same array.
+ *
+ * @param pk A pointer to an initialised djcs_public_key
+ * @param rop Array of @p count mpz_t where the results are stored
+ * @param cipher Array of @p count encrypted values to negate
+ * @param count Number of values in each array
+ * @return non-zero on success, zero if some value in @p cipher is not a valid
+ *         ciphertext, in which case @p rop is unmodified
+ */
+int djcs_e_neg_batch(const djcs_public_key *pk, mpz_t *rop, mpz_t *cipher,
+        unsigned long count);
+
+/**
+ * Subtract each encrypted value in @p cipher2 from the corresponding
+ * encrypted value in @p cipher1, storing the results in @p rop. Every inverse
+ * is derived from a single modular inversion. Any of the arrays may be the
+ * same.
+ *
+ * @param pk A pointer to an initialised djcs_public_key
+ * @param rop Array of @p count mpz_t where the results are stored
+ * @param cipher1 Array of @p count encrypted values to subtract from
+ * @param cipher2 Array of @p count encrypted values to subtract
+ * @param count Number of values in each array
+ * @return non-zero on success, zero on allocation failure or if some value
+ *         in @p cipher2 is not a valid ciphertext, in which case @p rop is
+ *         unmodified
+ */
+int djcs_ee_sub_batch(const djcs_public_key *pk, mpz_t *rop, mpz_t *cipher1,
+        mpz_t *cipher2, unsigned long count);
 
 /**
  * Decrypt a value @p cipher1, and set @p rop to the decrypted result. @p rop
@@ -145,7 +250,19 @@ void djcs_ep_mul(djcs_public_key *pk, mpz_t rop, mpz_t cipher1, mpz_t plain1);
  * @param rop mpz_t where the decrypted result is stored
  * @param cipher1 mpz_t to be decrypted
  */
-void djcs_decrypt(djcs_private_key *vk, mpz_t rop, mpz_t cipher1);
+void djcs_decrypt(const djcs_private_key *vk, mpz_t rop, mpz_t cipher1);
+
+/**
+ * Decrypt a value @p cipher1 encrypted at level @p s, where
+ * 1 <= @p s <= vk->s, and set @p rop to the decrypted result.
+ *
+ * @param vk A pointer to an initialised djcs_private_key
+ * @param rop mpz_t where the decrypted result is stored
+ * @param cipher1 mpz_t to be decrypted
+ * @param s The level @p cipher1 was encrypted at
+ */
+void djcs_decrypt_s(const djcs_private_key *vk, mpz_t rop, mpz_t cipher1,
+        unsigned long s);
 
 /**
  * Clears all data in a djcs_public_key. This does not free memory in the
@@ -194,18 +311,36 @@ void djcs_free_private_key(djcs_private_key *vk);
  * @param vk A pointer to an initialised djcs_private_key
  * @return non-zero if keys are valid, else zero
  */
-int djcs_verify_key_pair(djcs_public_key *pk, djcs_private_key *vk);
+int djcs_verify_key_pair(const djcs_public_key *pk, const djcs_private_key *vk);
+
+/**
+ * Check that each of the @p count ciphertexts in @p cipher is a valid
+ * Damgard-Jurik ciphertext under @p pk. A ciphertext is valid if it lies in
+ * the range 0 < c < n^(s+1) and is prime to n. The coprimality of the whole batch
+ * is decided with a single gcd against the product of the ciphertexts, so
+ * this is much cheaper than checking each individually.
+ *
+ * @param pk A pointer to an initialised djcs_public_key
+ * @param cipher An array of @p count ciphertexts
+ * @param count The number of ciphertexts in @p cipher
+ * @param valid If not NULL, an array of @p count flags, each set to non-zero
+ *              if the corresponding ciphertext is valid, else zero
+ * @return non-zero if every ciphertext is valid, else zero
+ */
+int djcs_validate_batch(const djcs_public_key *pk, mpz_t *cipher,
+        unsigned long count, int *valid);
 
 /**
  * Export a public key as a string. We only store the minimum required values
  * to restore the key. In this case, these are the s and n values.
  *
- * The format these strings export as is as a JSON object.
+ * The format these strings export as is as a JSON object, with integers
+ * encoded as described for pcs_export_public_key.
  *
  * @param pk A pointer to an initialised djcs_public_key
  * @return A string representing the given key, else NULL on error
  */
-char* djcs_export_public_key(djcs_public_key *pk);
+char* djcs_export_public_key(const djcs_public_key *pk);
 
 /**
  * Export a private key as a string. We only store the minimum required values
@@ -215,7 +350,7 @@ char* djcs_export_public_key(djcs_public_key *pk);
  * @param vk A pointer to an initialised djcs_private_key
  * @return A string representing the given key, else NULL on error
  */
-char* djcs_export_private_key(djcs_private_key *vk);
+char* djcs_export_private_key(const djcs_private_key *vk);
 
 /**
  * Import a public key from a string. The input string is expected to
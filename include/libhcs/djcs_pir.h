@@ -0,0 +1,173 @@
+/**
+ * @file djcs_pir.h
+ *
+ * Single-server private information retrieval over the Damgard-Jurik scheme.
+ *
+ * A database of fixed-size records is viewed as a d-dimensional array, and a
+ * query holds one encrypted selection vector per dimension. The server folds
+ * the database along the first dimension, producing one ciphertext per
+ * remaining position. Those ciphertexts are then treated as plaintexts for
+ * the next dimension, which is encrypted one level higher, and so on until a
+ * single ciphertext per record chunk remains. This uses the length-flexible
+ * property of the scheme: a ciphertext at level s is a plaintext at level
+ * s + 1, so a key with s >= d answers a d-dimensional query. The query then
+ * contains roughly d * records^(1/d) ciphertexts rather than one per record.
+ *
+ * Records are split into chunks which each fit in the plaintext space of the
+ * first level. Each chunk of the answer is a product of selection vector
+ * entries raised to record chunks, so it is computed as a single
+ * multi-exponentiation. The powers of the selection vector are tabulated
+ * once per query and shared by every column and chunk, and columns are
+ * processed in parallel.
+ *
+ * @code
+ * djcs_pir_params *pp = djcs_pir_init_params(pk, records, record_size, 2);
+ * mpz_t query[pp->query_size], answer[pp->chunks];
+ *
+ * // Client
+ * djcs_pir_query(pp, hr, query, index);
+ *
+ * // Server
+ * djcs_pir_db *db = djcs_pir_open_db("records.bin");
+ * djcs_pir_respond(pp, db, answer, query);
+ *
+ * // Client
+ * djcs_pir_decode(pp, vk, record, answer);
+ * @endcode
+ */
+
+#ifndef HCS_DJCS_PIR_H
+#define HCS_DJCS_PIR_H
+
+#include <stddef.h>
+#include <gmp.h>
+#include "djcs.h"
+#include "hcs_random.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Layout of a database and its queries for a single public key. The client
+ * and server must construct these with the same arguments. The key must
+ * outlive the parameters.
+ */
+typedef struct {
+    const djcs_public_key *pk;  /**< Key queries are encrypted under */
+    unsigned long d;            /**< Number of dimensions */
+    unsigned long *dim;         /**< Length of each dimension */
+    unsigned long records;      /**< Number of records in the database */
+    size_t record_size;         /**< Size of each record in bytes */
+    unsigned long s;            /**< Level of the first dimension */
+    size_t chunk_size;          /**< Bytes of a record per plaintext */
+    unsigned long chunks;       /**< Number of chunks in a record */
+    unsigned long query_size;   /**< Number of ciphertexts in a query */
+} djcs_pir_params;
+
+/**
+ * A read-only database of consecutive records, either mapped from a file or
+ * borrowed from memory.
+ */
+typedef struct {
+    const unsigned char *data;  /**< Start of the records */
+    size_t size;                /**< Size of the database in bytes */
+    int mapped;                 /**< Non-zero if @p data is a file mapping */
+} djcs_pir_db;
+
+/**
+ * Initialise the parameters for retrieving records of @p record_size bytes
+ * from a database of @p records records, using a query of @p d dimensions.
+ * The dimensions are chosen as close to equal as possible. The key must have
+ * been generated with s >= @p d. Any levels beyond @p d are used to enlarge
+ * the plaintext space of the first dimension, reducing the number of chunks
+ * per record.
+ *
+ * @param pk A pointer to an initialised djcs_public_key
+ * @param records Number of records in the database
+ * @param record_size Size of each record in bytes
+ * @param d Number of dimensions
+ * @return A pointer to the initialised parameters, NULL on allocation
+ *         failure or if the arguments are not usable with @p pk
+ */
+djcs_pir_params* djcs_pir_init_params(const djcs_public_key *pk,
+        unsigned long records, size_t record_size, unsigned long d);
+
+/**
+ * Frees a djcs_pir_params and all associated memory.
+ *
+ * @param pp A pointer to djcs_pir_params
+ */
+void djcs_pir_free_params(djcs_pir_params *pp);
+
+/**
+ * Map the file at @p path read-only as a database. Pages are read on demand
+ * as the server scans them, so the database does not need to fit in memory.
+ *
+ * @param path Path of the database file
+ * @return A pointer to the database, NULL if the file could not be mapped
+ */
+djcs_pir_db* djcs_pir_open_db(const char *path);
+
+/**
+ * Use @p size bytes at @p data as a database. The memory is not copied, and
+ * must outlive the database.
+ *
+ * @param data Start of the records
+ * @param size Size of the database in bytes
+ * @return A pointer to the database, NULL on allocation failure
+ */
+djcs_pir_db* djcs_pir_init_db(const void *data, size_t size);
+
+/**
+ * Unmap a database if it was opened from a file, and free it.
+ *
+ * @param db A pointer to a djcs_pir_db
+ */
+void djcs_pir_free_db(djcs_pir_db *db);
+
+/**
+ * Generate a query for the record at @p index, storing it in @p query.
+ *
+ * @param pp A pointer to initialised djcs_pir_params
+ * @param hr A pointer to an initialised hcs_random type
+ * @param query Array of pp->query_size initialised mpz_t
+ * @param index The record to retrieve
+ * @return non-zero on success, zero if @p index is out of range
+ */
+int djcs_pir_query(const djcs_pir_params *pp, hcs_random *hr, mpz_t *query,
+        unsigned long index);
+
+/**
+ * Answer @p query against @p db, storing the result in @p answer. Records
+ * beyond the end of the database are treated as zero, so the last dimension
+ * need not be full.
+ *
+ * @param pp A pointer to initialised djcs_pir_params
+ * @param db A pointer to a djcs_pir_db of at least pp->records records
+ * @param answer Array of pp->chunks initialised mpz_t
+ * @param query Array of pp->query_size ciphertexts from djcs_pir_query
+ * @return non-zero on success, zero on allocation failure or if @p db is
+ *         too small
+ */
+int djcs_pir_respond(const djcs_pir_params *pp, const djcs_pir_db *db,
+        mpz_t *answer, mpz_t *query);
+
+/**
+ * Decrypt @p answer, writing the retrieved record to @p record.
+ *
+ * @param pp A pointer to initialised djcs_pir_params
+ * @param vk A pointer to an initialised djcs_private_key
+ * @param record Buffer of pp->record_size bytes
+ * @param answer Array of pp->chunks ciphertexts from djcs_pir_respond
+ * @return non-zero on success, zero if @p answer does not decrypt to a
+ *         record
+ */
+int djcs_pir_decode(const djcs_pir_params *pp, const djcs_private_key *vk,
+        unsigned char *record, mpz_t *answer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -17,6 +17,7 @@
 
 #include <gmp.h>
 #include "hcs_random.h"
+#include "hcs_shares.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -31,12 +32,23 @@ typedef struct {
 } djcs_t_auth_server;
 
 /**
- * Public key for use in the Threshold Damgard-Jurik system.
+ * Combines decryption shares incrementally as they arrive.
+ */
+typedef struct hcs_combiner djcs_t_combiner;
+
+/**
+ * Public key for use in the Threshold Damgard-Jurik system. This holds
+ * everything needed to combine decryption shares, so shares may be combined
+ * by parties which never see the private key.
  */
 typedef struct {
     unsigned long s; /**< Ciphertext space exponent */
-    mpz_t *n;        /**< Modulus of the key. n = p * q */
+    unsigned long w; /**< The number of servers req to successfully decrypt */
+    unsigned long l; /**< The number of decryption servers */
+    mpz_t *n;        /**< Modulus of the key. n = p * q. Higher powers are
+                          precomputed, with n[i] = n^(i+1) for i <= s */
     mpz_t g;         /**< Precomputation: n + 1 usually, may be 2 */
+    mpz_t delta;     /**< Precomputation: l! */
 } djcs_t_public_key;
 
 /**
@@ -47,9 +59,9 @@ typedef struct {
     unsigned long w;    /**< The number of servers req to decrypt */
     unsigned long l;    /**< The number of decryption servers */
     mpz_t *vi;          /**< Verification values for the decrypt servers */
-    mpz_t *n;           /**< Modulus; Higher powers are precomputed. Len(n) = s*/
+    mpz_t *n;           /**< Modulus; Higher powers are precomputed as in the
+                             public key */
     mpz_t v;            /**< Cyclic generator of squares in Z*n^2 */
-    mpz_t delta;        /**< Precomputation: l! */
     mpz_t d;            /**< d = 0 mod m and d = 1 mod n^2 */
     mpz_t p;            /**< A random prime determined during key generation */
     mpz_t ph;           /**< A random prime such that p = 2*ph + 1 */
@@ -96,10 +108,18 @@ djcs_t_private_key* djcs_t_init_private_key(void);
  * to this allocated memory, resulting in a memory leak. If you wish to call
  * this function in this manner, ensure djcs_t_clear_public_key and/or
  * djcs_t_clear_private_key are called prior.
+ *
+ * @param pk A pointer to an initialised djcs_t_public_key
+ * @param vk A pointer to an initialised djcs_t_private_key
+ * @param hr A pointer to an initialised hcs_random type
+ * @param s The ciphertext space exponent
+ * @param bits The number of bits for the modulus of the key
+ * @param w The number of servers required to decrypt
+ * @param l The number of decryption servers
  */
 void djcs_t_generate_key_pair(djcs_t_public_key *pk, djcs_t_private_key *vk,
         hcs_random *hr, const unsigned long s, const unsigned long bits,
-        const unsigned long l, const unsigned long w);
+        const unsigned long w, const unsigned long l);
 
 /**
  * Encrypt a value @p plain1, and set @p rop to the encrypted result.
@@ -109,7 +129,7 @@ void djcs_t_generate_key_pair(djcs_t_public_key *pk, djcs_t_private_key *vk,
  * @param rop mpz_t where the encrypted result is stored
  * @param plain1 mpz_t to be encrypted
  */
-void djcs_t_encrypt(djcs_t_public_key *pk, hcs_random *hr, mpz_t rop,
+void djcs_t_encrypt(const djcs_t_public_key *pk, hcs_random *hr, mpz_t rop,
                     mpz_t plain1);
 
 /**
@@ -121,7 +141,8 @@ void djcs_t_encrypt(djcs_t_public_key *pk, hcs_random *hr, mpz_t rop,
  * @param rop mpz_t where the newly encrypted value is stored
  * @param op mpz_t to be reencrypted
  */
-void djcs_t_reencrypt(djcs_t_public_key *pk, hcs_random *hr, mpz_t rop, mpz_t op);
+void djcs_t_reencrypt(const djcs_t_public_key *pk, hcs_random *hr, mpz_t rop,
+        mpz_t op);
 
 /**
  * Add a plaintext value @p plain1 to an encrypted value @p cipher1, storing
@@ -132,7 +153,8 @@ void djcs_t_reencrypt(djcs_t_public_key *pk, hcs_random *hr, mpz_t rop, mpz_t op
  * @param cipher1 mpz_t to be added together
  * @param plain1 mpz_t to be added together
  */
-void djcs_t_ep_add(djcs_t_public_key *pk, mpz_t rop, mpz_t cipher1, mpz_t plain1);
+void djcs_t_ep_add(const djcs_t_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t plain1);
 
 /**
  * Add an encrypted value @p cipher2 to an encrypted value @p cipher1, storing
@@ -143,7 +165,8 @@ void djcs_t_ep_add(djcs_t_public_key *pk, mpz_t rop, mpz_t cipher1, mpz_t plain1
  * @param cipher1 mpz_t to be added together
  * @param cipher2 mpz_t to be added together
  */
-void djcs_t_ee_add(djcs_t_public_key *pk, mpz_t rop, mpz_t cipher1, mpz_t cipher2);
+void djcs_t_ee_add(const djcs_t_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t cipher2);
 
 /**
  * Multiply a plaintext value @p plain1 with an encrypted value @p cipher1,
@@ -154,7 +177,8 @@ void djcs_t_ee_add(djcs_t_public_key *pk, mpz_t rop, mpz_t cipher1, mpz_t cipher
  * @param cipher1 The encrypted value which is to be multipled to
  * @param plain1 The plaintext value which is to be multipled
  */
-void djcs_t_ep_mul(djcs_t_public_key *pk, mpz_t rop, mpz_t cipher1, mpz_t plain1);
+void djcs_t_ep_mul(const djcs_t_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t plain1);
 
 /**
  * Allocate and initialise the values in a random polynomial. The length of
@@ -179,8 +203,8 @@ mpz_t* djcs_t_init_polynomial(djcs_t_private_key *vk, hcs_random *hr);
  * @param rop mpz_t where the result is stored
  * @param x The value to calculate the polynomial at
  */
-void djcs_t_compute_polynomial(djcs_t_private_key *vk, mpz_t *coeff, mpz_t rop,
-                               const unsigned long x);
+void djcs_t_compute_polynomial(const djcs_t_private_key *vk, mpz_t *coeff,
+        mpz_t rop, const unsigned long x);
 
 /**
  * Frees a given polynomial (array of mpz_t values) and all associated data.
@@ -219,33 +243,109 @@ void djcs_t_set_auth_server(djcs_t_auth_server *au, mpz_t si, unsigned long i);
  * combined when sufficient shares have been accumulated using the
  * djcs_t_share_combine function.
  *
- * @param vk A pointer to an initialised djcs_t_private_key
+ * @param pk A pointer to an initialised djcs_t_public_key
  * @param au A pointer to an initialised djcs_t_auth_server
  * @param rop mpz_t where the calculated share is stored
  * @param cipher1 mpz_t which stores the ciphertext to decrypt
  */
-void djcs_t_share_decrypt(djcs_t_private_key *vk, djcs_t_auth_server *au,
+void djcs_t_share_decrypt(const djcs_t_public_key *pk, djcs_t_auth_server *au,
                           mpz_t rop, mpz_t cipher1);
 
 /**
- * Combine an array of shares @p c, storing the result in @p rop.
+ * Combine the shares in @p hs, storing the result in @p rop. Only the public
+ * key is needed, so this may run on nodes which hold no secret values.
  *
- * The array @p c must be managed by the caller, and is expected to be at least
- * of length vk->l. If it is greater, only the first vk->l values are scanned.
- * If a share is not present, then the value is expected to be 0. If reusing the
- * same array for a number of decryptions, ensure that the array is zeroed
- * between each combination.
+ * Only the shares of the first pk->l servers whose flag is set in @p hs are
+ * used, and at least pk->w of them must be set. The Lagrange coefficients are
+ * computed over exactly the flagged servers, so any subset of sufficient size
+ * may be chosen by setting and clearing flags.
  *
- * \todo Potentially construct a proper type for storing a list of shares to
- *       ensure these functions are called in the correct way.
+ * @param pk A pointer to an initialised djcs_t_public_key
+ * @param rop mpz_t where the combined decrypted result is stored
+ * @param hs A pointer to an initialised hcs_shares of at least pk->l shares
+ * @return non-zero on success, zero on allocation failure, if fewer than
+ *         pk->w shares are flagged, or if a share is invalid
+ */
+int djcs_t_share_combine(const djcs_t_public_key *pk, mpz_t rop,
+        hcs_shares *hs);
+
+/**
+ * Combine the shares of every ciphertext in @p hs, storing the result for
+ * ciphertext r in rop[r]. The same flagged servers are used for every
+ * ciphertext, so the Lagrange coefficients are computed once, and
+ * ciphertexts are combined in parallel.
  *
- * \pre vk->l <= length(c)
+ * @param pk A pointer to an initialised djcs_t_public_key
+ * @param rop Array of hs->count mpz_t where the results are stored
+ * @param hs A pointer to an hcs_shares of at least pk->l servers, from
+ *        hcs_init_shares_batch
+ * @return non-zero on success, zero on allocation failure, if fewer than
+ *         pk->w shares are flagged, or if a share is invalid
+ */
+int djcs_t_share_combine_batch(const djcs_t_public_key *pk, mpz_t *rop,
+        hcs_shares *hs);
+
+/**
+ * Initialise a combiner which folds decryption shares into the result as
+ * they arrive, rather than waiting for all of them as djcs_t_share_combine
+ * does. Each share of a fixed quorum is raised to its Lagrange-weighted
+ * power as soon as it is added, so only the final discrete logarithm
+ * remains once the last share arrives.
  *
- * @param vk A pointer to an initialised djcs_t_private_key
- * @param rop mpz_t where the combined decrypted result is stored
- * @param c array of share values
+ * If @p quorum is NULL, the first pk->w distinct shares to arrive form the
+ * quorum. Their weights are only known once the last of them arrives, at
+ * which point they are all raised to their powers in parallel.
+ *
+ * A combiner may be shared between threads receiving shares concurrently.
+ *
+ * @param pk A pointer to an initialised djcs_t_public_key
+ * @param quorum Array of pk->w distinct zero-indexed servers whose shares
+ *        will be used, or NULL to use the first to arrive
+ * @return A pointer to an initialised djcs_t_combiner, NULL on allocation
+ *         failure or if @p quorum is invalid
+ */
+djcs_t_combiner* djcs_t_init_combiner(const djcs_t_public_key *pk,
+        const unsigned long *quorum);
+
+/**
+ * Add the decryption share @p share of the zero-indexed server @p i. Shares
+ * from servers outside a fixed quorum, or which repeat a server, are
+ * ignored.
+ *
+ * @param cb A pointer to an initialised djcs_t_combiner
+ * @param i The index of the server which computed @p share
+ * @param share The share computed with djcs_t_share_decrypt
+ * @return non-zero if the quorum is complete
+ */
+int djcs_t_combiner_add(djcs_t_combiner *cb, unsigned long i, mpz_t share);
+
+/**
+ * Compute the decrypted value from a complete quorum, storing it in @p rop.
+ *
+ * @param pk A pointer to the djcs_t_public_key @p cb was initialised with
+ * @param cb A pointer to an initialised djcs_t_combiner
+ * @param rop mpz_t where the decrypted result is stored
+ * @return non-zero on success, zero if the quorum is incomplete or a share
+ *         is invalid
+ */
+int djcs_t_combiner_result(const djcs_t_public_key *pk, djcs_t_combiner *cb,
+        mpz_t rop);
+
+/**
+ * Discard all shares held by @p cb so it can be reused for another
+ * ciphertext. A fixed quorum is kept. Shares for the previous ciphertext
+ * still being added by other threads are discarded.
+ *
+ * @param cb A pointer to an initialised djcs_t_combiner
+ */
+void djcs_t_combiner_reset(djcs_t_combiner *cb);
+
+/**
+ * Frees a djcs_t_combiner and all associated memory.
+ *
+ * @param cb A pointer to an initialised djcs_t_combiner
  */
-void djcs_t_share_combine(djcs_t_private_key *vk, mpz_t rop, mpz_t *c);
+void djcs_t_free_combiner(djcs_t_combiner *cb);
 
 /**
  * Frees a djcs_t_auth_server and all associated memory.
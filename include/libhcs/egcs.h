@@ -10,6 +10,11 @@
  * These can be used with the provided initialisation functions, and should
  * be freed on program termination.
  *
+ * Keys use a subgroup of prime order r of Z_q*. Messages must lie in that
+ * subgroup, for example as powers of g. Raising c2 = m * h^t to r cancels
+ * the mask and leaves m^r, which would let anyone test guesses of any
+ * other message, so egcs_encrypt refuses them.
+ *
  * All mpz_t values can be alises unless otherwise stated.
  */
 
@@ -23,6 +28,11 @@
 extern "C" {
 #endif
 
+/**
+ * Bits of the prime order subgroup used by egcs_generate_key_pair.
+ */
+#define EGCS_ORDER_BITS 256
+
 /**
  * Ciphertext type for use in the ElGamal scheme.
  */
@@ -35,8 +45,9 @@ typedef struct {
  * Public key for use in the ElGamal scheme.
  */
 typedef struct {
-    mpz_t g;    /**< Generator for the cyclic group */
-    mpz_t q;    /**< Order of the cyclic group */
+    mpz_t g;    /**< Generator of the subgroup of order r */
+    mpz_t q;    /**< Prime modulus of the group, q = 2kr + 1 */
+    mpz_t r;    /**< Prime order of the subgroup generated by g */
     mpz_t h;    /**< g^x in G */
 } egcs_public_key;
 
@@ -44,8 +55,9 @@ typedef struct {
  * Private key for use in the ElGamal scheme.
  */
 typedef struct {
-    mpz_t x;    /**< Random value in {1, ..., q-1} */
-    mpz_t q;    /**< Order of the cyclic group */
+    mpz_t x;    /**< Random value in {1, ..., r-1} */
+    mpz_t q;    /**< Prime modulus of the group */
+    mpz_t r;    /**< Prime order of the subgroup */
 } egcs_private_key;
 
 /**
@@ -71,6 +83,11 @@ egcs_private_key* egcs_init_private_key(void);
  * and @p vk are initialised before calling this function. @p pk and @p vk are
  * expected to not be NULL.
  *
+ * The generator g spans a subgroup of prime order r of EGCS_ORDER_BITS bits,
+ * or half of @p bits if that is smaller. Every exponent used to encrypt,
+ * reencrypt and decrypt is taken modulo r, so each exponentiation costs a
+ * fraction of a full-width one, about 12 times less for a 3072-bit modulus.
+ *
  * In practice the @p bits value should usually be greater than 2048 to ensure
  * sufficient security.
  *
@@ -100,14 +117,30 @@ void egcs_set(egcs_cipher *rop, egcs_cipher *op);
 
 /**
  * Encrypt a value @p plain1, and set @p rop to the encrypted result.
+ * @p plain1 must lie in the subgroup of order pk->r, such as a power of
+ * pk->g.
  *
  * @param pk A pointer to an initialised egcs_public_key
  * @param hr A pointer to an initialised hcs_random type
  * @param rop egcs_cipher where the result is to be stored
  * @param plain1 mpz_t to be encrypted
+ * @return non-zero on success, zero if @p plain1 is not in the subgroup, in
+ *         which case @p rop is unmodified
+ */
+int egcs_encrypt(const egcs_public_key *pk, hcs_random *hr, egcs_cipher *rop,
+                 mpz_t plain1);
+
+/**
+ * Reencrypt an encrypted value @p op. Upon decryption, this newly
+ * encrypted value, @p rop, will retain the same value as @p op.
+ *
+ * @param pk A pointer to an initialised egcs_public_key
+ * @param hr A pointer to an initialised hcs_random type
+ * @param rop egcs_cipher where the newly encrypted value is stored
+ * @param op egcs_cipher to be reencrypted
  */
-void egcs_encrypt(egcs_public_key *pk, hcs_random *hr, egcs_cipher *rop,
-                  mpz_t plain1);
+void egcs_reencrypt(const egcs_public_key *pk, hcs_random *hr,
+        egcs_cipher *rop, egcs_cipher *op);
 
 /**
  * Multiply an encrypted value @p ct1 with an encrypted value @p ct2, storing
@@ -118,7 +151,7 @@ void egcs_encrypt(egcs_public_key *pk, hcs_random *hr, egcs_cipher *rop,
  * @param ct1 egcs_cipher to be multiplied together
  * @param ct2 egcs_cipher to be multiplied together
  */
-void egcs_ee_mul(egcs_public_key *pk, egcs_cipher *rop, egcs_cipher *ct1,
+void egcs_ee_mul(const egcs_public_key *pk, egcs_cipher *rop, egcs_cipher *ct1,
         egcs_cipher *ct2);
 
 /**
@@ -128,7 +161,7 @@ void egcs_ee_mul(egcs_public_key *pk, egcs_cipher *rop, egcs_cipher *ct1,
  * @param rop mpz_t where the decrypted result is stored
  * @param cipher1 egcs_cipher to be decrypted
  */
-void egcs_decrypt(egcs_private_key *vk, mpz_t rop, egcs_cipher *cipher1);
+void egcs_decrypt(const egcs_private_key *vk, mpz_t rop, egcs_cipher *cipher1);
 
 /**
  * Zero all data related to the given egcs_cipher.
@@ -0,0 +1,351 @@
+/**
+ * @file egcs_t.h
+ *
+ * The threshold ElGamal scheme splits the private key of the ElGamal scheme
+ * amongst a number of decryption servers, any w of which can decrypt a
+ * ciphertext together. Like egcs, it is homomorphic under multiplication.
+ *
+ * The scheme works in a subgroup of prime order r of Z_q*, where r is much
+ * smaller than q. The secret x is shared with a random polynomial over Z_r,
+ * and each server computes its decryption share as c1^(x_i) mod q, a single
+ * exponentiation with an exponent the size of r. Shares are combined with
+ * Lagrange interpolation in the exponent. Key generation needs only two
+ * primes, r and q = 2kr + 1, and no safe primes.
+ *
+ * Messages must themselves lie in the subgroup of order r, as the mask
+ * h^t does not hide which coset of it a message lies in. egcs_t_encrypt
+ * refuses any other message.
+ *
+ * Ciphertexts are of the egcs_cipher type, and are managed with the egcs
+ * functions.
+ *
+ * All mpz_t values can be aliases unless otherwise stated.
+ *
+ * \warning All indexing for the servers and polynomial functions should be
+ * zero-indexed, as is usual when working with c arrays. The functions
+ * themselves correct for this internally, and 1-indexing servers may result
+ * in incorrect results.
+ */
+
+#ifndef HCS_EGCS_T_H
+#define HCS_EGCS_T_H
+
+#include <gmp.h>
+#include "egcs.h"
+#include "hcs_random.h"
+#include "hcs_shares.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Bits of the prime order subgroup used by egcs_t_generate_key_pair.
+ */
+#define EGCS_T_ORDER_BITS EGCS_ORDER_BITS
+
+/**
+ * Details of the polynomial used to compute values for decryption servers.
+ */
+typedef struct {
+    unsigned long n;    /**< The number of terms in the polynomial */
+    mpz_t *coeff;       /**< Coefficients of the polynomial */
+} egcs_t_polynomial;
+
+/**
+ * Details that a decryption server is required to keep track of.
+ */
+typedef struct {
+    unsigned long i;    /**< The server index of this particular instance */
+    mpz_t si;           /**< The polynomial evaluation at @p i */
+} egcs_t_auth_server;
+
+/**
+ * Public key for use in the threshold ElGamal scheme. This holds everything
+ * needed to combine decryption shares, so shares may be combined by parties
+ * which never see the private key.
+ */
+typedef struct {
+    unsigned long w; /**< The number of servers req to successfully decrypt */
+    unsigned long l; /**< The number of decryption servers */
+    mpz_t g;         /**< Generator of the subgroup of order r */
+    mpz_t q;         /**< Prime modulus of the group, q = 2kr + 1 */
+    mpz_t r;         /**< Prime order of the subgroup generated by g */
+    mpz_t h;         /**< g^x mod q */
+    mpz_t delta;     /**< Precomputation: l! */
+    mpz_t dinv;      /**< Precomputation: -(2 * delta)^-1 mod r */
+} egcs_t_public_key;
+
+/**
+ * Private key for use in the threshold ElGamal scheme. Once it has been
+ * split amongst the decryption servers with egcs_t_compute_polynomial, it
+ * is no longer required and should be destroyed.
+ */
+typedef struct {
+    unsigned long w; /**< The number of servers req to decrypt */
+    unsigned long l; /**< The number of decryption servers */
+    mpz_t x;         /**< Random value in {1, ..., r-1} */
+    mpz_t r;         /**< Prime order of the subgroup */
+} egcs_t_private_key;
+
+/**
+ * Initialise a egcs_t_public_key and return a pointer to the newly created
+ * structure.
+ *
+ * @return A pointer to an initialised egcs_t_public_key, NULL on allocation
+ *         failure
+ */
+egcs_t_public_key* egcs_t_init_public_key(void);
+
+/**
+ * Initialise a egcs_t_private_key and return a pointer to the newly created
+ * structure.
+ *
+ * @return A pointer to an initialised egcs_t_private_key, NULL on allocation
+ *         failure
+ */
+egcs_t_private_key* egcs_t_init_private_key(void);
+
+/**
+ * Initialise a key pair with modulus size @p bits, to be shared amongst
+ * @p l decryption servers of which @p w are required to decrypt. It is
+ * required that @p pk and @p vk are initialised before calling this
+ * function.
+ *
+ * The subgroup order r has EGCS_T_ORDER_BITS bits, or half of @p bits if
+ * that is smaller. In practice the @p bits value should usually be greater
+ * than 2048 to ensure sufficient security.
+ *
+ * @param pk A pointer to an initialised egcs_t_public_key
+ * @param vk A pointer to an initialised egcs_t_private_key
+ * @param hr A pointer to an initialised hcs_random type
+ * @param bits The number of bits for the modulus of the key
+ * @param w The number of servers required to decrypt
+ * @param l The number of decryption servers
+ * @return non-zero on success, zero if @p w is zero or greater than @p l
+ */
+int egcs_t_generate_key_pair(egcs_t_public_key *pk, egcs_t_private_key *vk,
+        hcs_random *hr, const unsigned long bits, const unsigned long w,
+        const unsigned long l);
+
+/**
+ * Encrypt a value @p plain1, and set @p rop to the encrypted result.
+ * @p plain1 must lie in the subgroup of order pk->r, such as a power of
+ * pk->g. Raising c2 to r cancels the mask, so any other message would leak
+ * which coset of the subgroup it lies in.
+ *
+ * @param pk A pointer to an initialised egcs_t_public_key
+ * @param hr A pointer to an initialised hcs_random
+ * @param rop egcs_cipher where the encrypted result is stored
+ * @param plain1 mpz_t to be encrypted
+ * @return non-zero on success, zero if @p plain1 is not in the subgroup, in
+ *         which case @p rop is unmodified
+ */
+int egcs_t_encrypt(const egcs_t_public_key *pk, hcs_random *hr,
+        egcs_cipher *rop, mpz_t plain1);
+
+/**
+ * Reencrypt an encrypted value @p op. Upon decryption, this newly
+ * encrypted value, @p rop, will retain the same value as @p op.
+ *
+ * @param pk A pointer to an initialised egcs_t_public_key
+ * @param hr A pointer to an initialised hcs_random
+ * @param rop egcs_cipher where the newly encrypted value is stored
+ * @param op egcs_cipher to be reencrypted
+ */
+void egcs_t_reencrypt(const egcs_t_public_key *pk, hcs_random *hr,
+        egcs_cipher *rop, egcs_cipher *op);
+
+/**
+ * Multiply two encrypted values @p ct1 and @p ct2, storing the result in
+ * @p rop.
+ *
+ * @param pk A pointer to an initialised egcs_t_public_key
+ * @param rop egcs_cipher where the result is stored
+ * @param ct1 egcs_cipher to be multiplied together
+ * @param ct2 egcs_cipher to be multiplied together
+ */
+void egcs_t_ee_mul(const egcs_t_public_key *pk, egcs_cipher *rop,
+        egcs_cipher *ct1, egcs_cipher *ct2);
+
+/**
+ * Allocate and initialise the values in a random polynomial over Z_r, with
+ * the secret x as its constant term. The length of this polynomial is taken
+ * from values in @p vk, specifically it will be of length vk->w. The
+ * polynomial functions are to be used by a single trusted party, for which
+ * once the required computation is completed, the polynomial can be
+ * discarded.
+ *
+ * @code
+ * egcs_t_polynomial *px = egcs_t_init_polynomial(vk, hr);
+ * for (int i = 0; i < decrypt_server_count; ++i) {
+ *     egcs_t_compute_polynomial(vk, px, result, i);
+ *     network_send(result); // Send the computed value to a decryption server
+ * }
+ * egcs_t_free_polynomial(px);
+ * @endcode
+ *
+ * @param vk A pointer to an initialised egcs_t_private_key
+ * @param hr A pointer to an initialised hcs_random type
+ * @return A polynomial on success, else NULL
+ */
+egcs_t_polynomial* egcs_t_init_polynomial(egcs_t_private_key *vk,
+        hcs_random *hr);
+
+/**
+ * Compute a polynomial P(x) for a given x value in Z_r.
+ *
+ * @param vk A pointer to an initialised egcs_t_private_key
+ * @param px A pointer to a polynomial from egcs_t_init_polynomial
+ * @param rop mpz_t where the result is stored
+ * @param x The value to calculate the polynomial at
+ */
+void egcs_t_compute_polynomial(const egcs_t_private_key *vk,
+        egcs_t_polynomial *px, mpz_t rop, const unsigned long x);
+
+/**
+ * Frees a given polynomial and all associated data.
+ *
+ * @param px A pointer to an egcs_t_polynomial
+ */
+void egcs_t_free_polynomial(egcs_t_polynomial *px);
+
+/**
+ * Initialise a egcs_t_auth_server and return a pointer to the newly created
+ * structure.
+ *
+ * @return A pointer to an initialised egcs_t_auth_server, NULL on allocation
+ *         failure
+ */
+egcs_t_auth_server* egcs_t_init_auth_server(void);
+
+/**
+ * Set the internal values for the server @p au. @p si is the secret polynomial
+ * share for the given value, @p i. These values should be shared in a secret
+ * and secure way and not given out publicly. The index given to each server
+ * should be unique.
+ *
+ * @param au A pointer to an initialised egcs_t_auth_server
+ * @param si The value of a secret polynomial evaluated at @p i
+ * @param i The servers given index
+ */
+void egcs_t_set_auth_server(egcs_t_auth_server *au, mpz_t si,
+        unsigned long i);
+
+/**
+ * For a given ciphertext @p ct, compute the server @p au's share and store
+ * the result in the variable @p rop. These shares can be managed, and then
+ * combined when sufficient shares have been accumulated using the
+ * egcs_t_share_combine function.
+ *
+ * The first component of @p ct must lie in the subgroup of order r, as
+ * every honestly formed ciphertext does. Any other value would leak part
+ * of the server's share, so it is refused and @p rop is left unmodified.
+ *
+ * @param pk A pointer to an initialised egcs_t_public_key
+ * @param au A pointer to an initialised egcs_t_auth_server
+ * @param rop mpz_t where the calculated share is stored
+ * @param ct egcs_cipher which stores the ciphertext to decrypt
+ * @return non-zero on success, zero if @p ct is refused
+ */
+int egcs_t_share_decrypt(const egcs_t_public_key *pk, egcs_t_auth_server *au,
+        mpz_t rop, egcs_cipher *ct);
+
+/**
+ * Compute the shares of the server @p au for each of the @p count
+ * ciphertexts in @p ct in parallel, storing the share of ct[i] in rop[i].
+ *
+ * @param pk A pointer to an initialised egcs_t_public_key
+ * @param au A pointer to an initialised egcs_t_auth_server
+ * @param rop Array of @p count mpz_t where the shares are stored
+ * @param ct Array of @p count ciphertexts to decrypt
+ * @param count Number of ciphertexts
+ * @return non-zero on success, zero if any ciphertext is refused by
+ *         egcs_t_share_decrypt, in which case its entry of @p rop is
+ *         left unmodified
+ */
+int egcs_t_share_decrypt_batch(const egcs_t_public_key *pk,
+        egcs_t_auth_server *au, mpz_t *rop, egcs_cipher **ct,
+        unsigned long count);
+
+/**
+ * Combine the shares in @p hs of the ciphertext @p ct, storing the
+ * decrypted result in @p rop. Only the public key is needed, so this may
+ * run on nodes which hold no secret values.
+ *
+ * Only the shares of the first pk->l servers whose flag is set in @p hs are
+ * used, and at least pk->w of them must be set. The Lagrange coefficients are
+ * computed over exactly the flagged servers, so any subset of sufficient size
+ * may be chosen by setting and clearing flags.
+ *
+ * @param pk A pointer to an initialised egcs_t_public_key
+ * @param rop mpz_t where the combined decrypted result is stored
+ * @param ct The ciphertext the shares were computed from
+ * @param hs A pointer to an initialised hcs_shares of at least pk->l shares
+ * @return non-zero on success, zero on allocation failure, if fewer than
+ *         pk->w shares are flagged, or if a share is invalid
+ */
+int egcs_t_share_combine(const egcs_t_public_key *pk, mpz_t rop,
+        egcs_cipher *ct, hcs_shares *hs);
+
+/**
+ * Combine the shares of every ciphertext in @p hs, storing the result for
+ * ciphertext r in rop[r]. The same flagged servers are used for every
+ * ciphertext, so the Lagrange coefficients are computed once, and
+ * ciphertexts are combined in parallel.
+ *
+ * @param pk A pointer to an initialised egcs_t_public_key
+ * @param rop Array of hs->count mpz_t where the results are stored
+ * @param ct Array of hs->count ciphertexts, ct[r] matching row r of @p hs
+ * @param hs A pointer to an hcs_shares of at least pk->l servers, from
+ *        hcs_init_shares_batch
+ * @return non-zero on success, zero on allocation failure, if fewer than
+ *         pk->w shares are flagged, or if a share is invalid
+ */
+int egcs_t_share_combine_batch(const egcs_t_public_key *pk, mpz_t *rop,
+        egcs_cipher **ct, hcs_shares *hs);
+
+/**
+ * Frees a egcs_t_auth_server and all associated memory.
+ *
+ * @param au A pointer to an initialised egcs_t_auth_server
+ */
+void egcs_t_free_auth_server(egcs_t_auth_server *au);
+
+/**
+ * Clears all data in a egcs_t_public_key. This does not free memory in the
+ * keys, only putting it into a state whereby they can be safely used to
+ * generate new key values.
+ *
+ * @param pk A pointer to an initialised egcs_t_public_key
+ */
+void egcs_t_clear_public_key(egcs_t_public_key *pk);
+
+/**
+ * Clears all data in a egcs_t_private_key. This does not free memory in the
+ * keys, only putting it into a state whereby they can be safely used to
+ * generate new key values.
+ *
+ * @param vk A pointer to an initialised egcs_t_private_key
+ */
+void egcs_t_clear_private_key(egcs_t_private_key *vk);
+
+/**
+ * Frees a egcs_t_public_key and all associated memory.
+ *
+ * @param pk A pointer to an initialised egcs_t_public_key
+ */
+void egcs_t_free_public_key(egcs_t_public_key *pk);
+
+/**
+ * Frees a egcs_t_private_key and all associated memory.
+ *
+ * @param vk A pointer to an initialised egcs_t_private_key
+ */
+void egcs_t_free_private_key(egcs_t_private_key *vk);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
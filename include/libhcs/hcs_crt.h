@@ -0,0 +1,95 @@
+/**
+ * @file hcs_crt.h
+ *
+ * A precomputed context for recombining residues with the chinese remainder
+ * theorem. The moduli are fixed once, and all inverses and partial products
+ * that recombination requires are computed up front. Recombination is then
+ * performed in Garner's mixed-radix form, which for two moduli is a single
+ * modular multiplication followed by a multiply-add.
+ *
+ * Any number of pairwise coprime moduli are supported, so the same context
+ * can be used for prime powers such as p^(s+1) and q^(s+1).
+ */
+
+#ifndef HCS_CRT_H
+#define HCS_CRT_H
+
+#include <gmp.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Stores a set of moduli and the values required to recombine residues
+ * taken with respect to them.
+ */
+typedef struct {
+    unsigned long k;    /**< The number of moduli */
+    mpz_t *m;           /**< The pairwise coprime moduli */
+    mpz_t *mp;          /**< Precomputation: mp[i] = m[0] * ... * m[i-1] */
+    mpz_t *mi;          /**< Precomputation: mi[i] = mp[i]^{-1} mod m[i] */
+} hcs_crt;
+
+/**
+ * Initialise a hcs_crt and return a pointer to the newly created structure.
+ *
+ * @param k The number of moduli this hcs_crt should store
+ * @return A pointer to an initialised hcs_crt, NULL on allocation failure or
+ *         if @p k is zero
+ */
+hcs_crt* hcs_init_crt(unsigned long k);
+
+/**
+ * Set the modulus at @p index to @p m. @p index should be less than
+ * @p crt->k. hcs_crt_precompute must be called after all moduli are set and
+ * before any recombination is performed.
+ *
+ * @param crt A pointer to an initialised hcs_crt
+ * @param m The modulus to store
+ * @param index The index to store this modulus at
+ */
+void hcs_crt_set_modulus(hcs_crt *crt, mpz_t m, unsigned long index);
+
+/**
+ * Compute the partial products and inverses for the moduli stored in
+ * @p crt.
+ *
+ * @param crt A pointer to an initialised hcs_crt
+ * @return non-zero on success, zero if @p crt holds no moduli or the moduli
+ *         are not pairwise coprime
+ */
+int hcs_crt_precompute(hcs_crt *crt);
+
+/**
+ * Recombine the residues @p a, storing the unique value in
+ * [0, m[0] * ... * m[k-1]) congruent to each a[i] mod m[i] in @p rop. @p a
+ * is expected to be of length @p crt->k. @p rop must not alias any of
+ * a[1], ..., a[k-1].
+ *
+ * @param crt A pointer to an initialised and precomputed hcs_crt
+ * @param rop mpz_t where the recombined value is stored
+ * @param a Array of residues
+ */
+void hcs_crt_combine(const hcs_crt *crt, mpz_t rop, mpz_t *a);
+
+/**
+ * Zero all data in @p crt. The moduli must be set and precomputed again
+ * before the context is reused.
+ *
+ * @param crt A pointer to an initialised hcs_crt
+ */
+void hcs_clear_crt(hcs_crt *crt);
+
+/**
+ * Frees a hcs_crt and all associated memory.
+ *
+ * @param crt A pointer to an initialised hcs_crt
+ */
+void hcs_free_crt(hcs_crt *crt);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,409 @@
+/**
+ * @file hcs_encoding.h
+ *
+ * Encoding of real numbers for the additive schemes pcs, pcs_t and djcs.
+ *
+ * A value is stored as a signed integer mantissa and a base-2 exponent, so
+ * that value = mantissa * 2^exponent. Signed fixed-point values use the same
+ * exponent for every number, while values encoded from a double keep the
+ * exponent of the double, giving floating-point behaviour with a separate
+ * exponent per ciphertext. Negative mantissas are mapped to the top of the
+ * plaintext space, as n - |mantissa|.
+ *
+ * Adding two encrypted numbers requires them to share an exponent. Rather
+ * than normalising every ciphertext up front, exponents are tracked with each
+ * value and a ciphertext is only rescaled when it meets a value with a
+ * smaller exponent. Rescaling a ciphertext costs one squaring per bit of
+ * difference, while rescaling a plaintext is a single shift, so the
+ * plaintext operand is always the one moved when possible. Sums of many
+ * values with differing exponents share a single squaring chain.
+ *
+ * Mantissas are not reduced, so repeated multiplication and rescaling grow
+ * them. A mantissa which exceeds the largest encodable magnitude of the key,
+ * roughly a third of the plaintext space, wraps around and decodes to an
+ * incorrect value. This is not detectable on encrypted values, and the
+ * caller must choose exponents with enough headroom.
+ *
+ * @code
+ * hcs_encoding *enc = hcs_init_encoding_pcs(pk);
+ * hcs_encoded_number x, y;
+ * hcs_encrypted_number cx;
+ *
+ * hcs_encoded_init(&x);
+ * hcs_encoded_init(&y);
+ * hcs_encrypted_init(&cx);
+ *
+ * hcs_encode_double(enc, &x, 1.5);
+ * hcs_encode_fixed(enc, &y, -0.25, -16);
+ * hcs_encrypt_encoded(enc, hr, &cx, &x);
+ * hcs_encrypted_add_encoded(enc, &cx, &cx, &y);
+ * hcs_decrypt_encoded_pcs(enc, vk, &x, &cx);
+ * // hcs_decode_double(&x) == 1.25
+ * @endcode
+ */
+
+#ifndef HCS_ENCODING_H
+#define HCS_ENCODING_H
+
+#include <gmp.h>
+#include "djcs.h"
+#include "hcs_random.h"
+#include "pcs.h"
+#include "pcs_t.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Schemes an encoding may be created for.
+ */
+typedef enum {
+    HCS_ENCODING_PCS,   /**< A pcs_public_key */
+    HCS_ENCODING_PCS_T, /**< A pcs_t_public_key */
+    HCS_ENCODING_DJCS   /**< A djcs_public_key */
+} hcs_encoding_scheme;
+
+/**
+ * Encoding parameters for a single public key. The key must outlive the
+ * encoding.
+ */
+typedef struct {
+    hcs_encoding_scheme scheme; /**< Which member of the key union is valid */
+    union {
+        const pcs_public_key *pcs;      /**< Key for HCS_ENCODING_PCS */
+        const pcs_t_public_key *pcs_t;  /**< Key for HCS_ENCODING_PCS_T */
+        const djcs_public_key *djcs;    /**< Key for HCS_ENCODING_DJCS */
+    } pk;
+    mpz_srcptr n;       /**< Plaintext modulus of the key */
+    mpz_srcptr n2;      /**< Ciphertext modulus of the key */
+    mpz_srcptr g;       /**< Generator of the key */
+    mpz_t max;          /**< Largest mantissa magnitude which can be encoded */
+} hcs_encoding;
+
+/**
+ * An unencrypted value mantissa * 2^exponent.
+ */
+typedef struct {
+    mpz_t mantissa;     /**< Signed integer mantissa */
+    long exponent;      /**< Base-2 exponent */
+} hcs_encoded_number;
+
+/**
+ * An encrypted value, whose plaintext is an encoded mantissa, along with its
+ * base-2 exponent. The exponent is not encrypted.
+ */
+typedef struct {
+    mpz_t cipher;       /**< Encryption of the mantissa */
+    long exponent;      /**< Base-2 exponent */
+} hcs_encrypted_number;
+
+/**
+ * Initialise an encoding for the pcs public key @p pk and return a pointer
+ * to the newly created structure.
+ *
+ * @param pk A pointer to an initialised pcs_public_key
+ * @return A pointer to an initialised hcs_encoding, NULL on allocation
+ *         failure
+ */
+hcs_encoding* hcs_init_encoding_pcs(const pcs_public_key *pk);
+
+/**
+ * Initialise an encoding for the pcs_t public key @p pk and return a pointer
+ * to the newly created structure.
+ *
+ * @param pk A pointer to an initialised pcs_t_public_key
+ * @return A pointer to an initialised hcs_encoding, NULL on allocation
+ *         failure
+ */
+hcs_encoding* hcs_init_encoding_pcs_t(const pcs_t_public_key *pk);
+
+/**
+ * Initialise an encoding for the djcs public key @p pk and return a pointer
+ * to the newly created structure. The plaintext space is n^s.
+ *
+ * @param pk A pointer to an initialised djcs_public_key
+ * @return A pointer to an initialised hcs_encoding, NULL on allocation
+ *         failure
+ */
+hcs_encoding* hcs_init_encoding_djcs(const djcs_public_key *pk);
+
+/**
+ * Free an encoding. The key it was created for is not affected.
+ *
+ * @param enc A pointer to an initialised hcs_encoding
+ */
+void hcs_free_encoding(hcs_encoding *enc);
+
+/**
+ * Initialise an hcs_encoded_number to zero.
+ *
+ * @param op The number to initialise
+ */
+void hcs_encoded_init(hcs_encoded_number *op);
+
+/**
+ * Free the memory held by an hcs_encoded_number.
+ *
+ * @param op The number to clear
+ */
+void hcs_encoded_clear(hcs_encoded_number *op);
+
+/**
+ * Initialise an hcs_encrypted_number. Its value is undefined until set.
+ *
+ * @param op The number to initialise
+ */
+void hcs_encrypted_init(hcs_encrypted_number *op);
+
+/**
+ * Free the memory held by an hcs_encrypted_number.
+ *
+ * @param op The number to clear
+ */
+void hcs_encrypted_clear(hcs_encrypted_number *op);
+
+/**
+ * Encode the integer @p mantissa with exponent @p exponent.
+ *
+ * @param enc A pointer to an initialised hcs_encoding
+ * @param rop Where the encoded value is stored
+ * @param mantissa The signed mantissa
+ * @param exponent The base-2 exponent
+ * @return non-zero on success, zero if @p mantissa is too large to encode
+ */
+int hcs_encode_mpz(const hcs_encoding *enc, hcs_encoded_number *rop,
+        const mpz_t mantissa, long exponent);
+
+/**
+ * Encode @p value as a fixed-point number with exponent @p exponent, rounding
+ * to the nearest multiple of 2^exponent. An exponent of -k gives k bits after
+ * the binary point.
+ *
+ * @param enc A pointer to an initialised hcs_encoding
+ * @param rop Where the encoded value is stored
+ * @param value The value to encode
+ * @param exponent The base-2 exponent
+ * @return non-zero on success, zero if @p value is not finite or is too large
+ *         to encode
+ */
+int hcs_encode_fixed(const hcs_encoding *enc, hcs_encoded_number *rop,
+        double value, long exponent);
+
+/**
+ * Encode @p value exactly, using the largest exponent which represents it
+ * without loss. Larger exponents keep mantissas small and make rescaling on
+ * addition less likely.
+ *
+ * @param enc A pointer to an initialised hcs_encoding
+ * @param rop Where the encoded value is stored
+ * @param value The value to encode
+ * @return non-zero on success, zero if @p value is not finite
+ */
+int hcs_encode_double(const hcs_encoding *enc, hcs_encoded_number *rop,
+        double value);
+
+/**
+ * Return the value of @p op as a double, truncating any bits of the mantissa
+ * beyond double precision. Values outside the range of a double are returned
+ * as infinity.
+ *
+ * @param op An encoded number
+ * @return The value of @p op
+ */
+double hcs_decode_double(const hcs_encoded_number *op);
+
+/**
+ * Set @p rop from a decrypted plaintext and the exponent of the ciphertext
+ * it was decrypted from. This is used for schemes such as pcs_t, where
+ * decryption is done outside of the encoding.
+ *
+ * @param enc A pointer to an initialised hcs_encoding
+ * @param rop Where the encoded value is stored
+ * @param plain The decrypted plaintext
+ * @param exponent The exponent of the ciphertext
+ * @return non-zero on success, zero if @p plain lies outside the encodable
+ *         range, which indicates an overflow occurred
+ */
+int hcs_decode_plaintext(const hcs_encoding *enc, hcs_encoded_number *rop,
+        const mpz_t plain, long exponent);
+
+/**
+ * Encrypt the encoded number @p op.
+ *
+ * @param enc A pointer to an initialised hcs_encoding
+ * @param hr A pointer to an initialised hcs_random type
+ * @param rop Where the encrypted value is stored
+ * @param op The encoded number to encrypt
+ */
+void hcs_encrypt_encoded(const hcs_encoding *enc, hcs_random *hr,
+        hcs_encrypted_number *rop, const hcs_encoded_number *op);
+
+/**
+ * Decrypt @p op with the pcs private key @p vk. @p enc must have been
+ * created for the matching public key.
+ *
+ * @param enc A pointer to an initialised hcs_encoding
+ * @param vk A pointer to an initialised pcs_private_key
+ * @param rop Where the decrypted value is stored
+ * @param op The encrypted number to decrypt
+ * @return non-zero on success, zero if the plaintext overflowed
+ */
+int hcs_decrypt_encoded_pcs(const hcs_encoding *enc,
+        const pcs_private_key *vk, hcs_encoded_number *rop,
+        const hcs_encrypted_number *op);
+
+/**
+ * Decrypt @p op with the djcs private key @p vk. @p enc must have been
+ * created for the matching public key.
+ *
+ * @param enc A pointer to an initialised hcs_encoding
+ * @param vk A pointer to an initialised djcs_private_key
+ * @param rop Where the decrypted value is stored
+ * @param op The encrypted number to decrypt
+ * @return non-zero on success, zero if the plaintext overflowed
+ */
+int hcs_decrypt_encoded_djcs(const hcs_encoding *enc,
+        const djcs_private_key *vk, hcs_encoded_number *rop,
+        const hcs_encrypted_number *op);
+
+/**
+ * Lower the exponent of @p op to @p exponent, storing the result in @p rop.
+ * This costs one modular squaring per bit the exponent is lowered by. If
+ * @p exponent is not below the exponent of @p op, @p op is copied.
+ *
+ * @param enc A pointer to an initialised hcs_encoding
+ * @param rop Where the rescaled value is stored
+ * @param op The encrypted number to rescale
+ * @param exponent The new exponent
+ */
+void hcs_encrypted_rescale(const hcs_encoding *enc, hcs_encrypted_number *rop,
+        const hcs_encrypted_number *op, long exponent);
+
+/**
+ * Add two encrypted numbers. Only the operand with the larger exponent is
+ * rescaled, and only if the exponents differ.
+ *
+ * @param enc A pointer to an initialised hcs_encoding
+ * @param rop Where the sum is stored
+ * @param op1 An encrypted number
+ * @param op2 An encrypted number
+ */
+void hcs_encrypted_add(const hcs_encoding *enc, hcs_encrypted_number *rop,
+        const hcs_encrypted_number *op1, const hcs_encrypted_number *op2);
+
+/**
+ * Add an encoded number to an encrypted number. If the exponent of @p op2 is
+ * at least that of @p op1, only @p op2 is rescaled, which requires no
+ * modular exponentiation.
+ *
+ * @param enc A pointer to an initialised hcs_encoding
+ * @param rop Where the sum is stored
+ * @param op1 An encrypted number
+ * @param op2 An encoded number
+ */
+void hcs_encrypted_add_encoded(const hcs_encoding *enc,
+        hcs_encrypted_number *rop, const hcs_encrypted_number *op1,
+        const hcs_encoded_number *op2);
+
+/**
+ * Subtract the encrypted number @p op2 from @p op1, aligning exponents as in
+ * hcs_encrypted_add.
+ *
+ * @param enc A pointer to an initialised hcs_encoding
+ * @param rop Where the difference is stored
+ * @param op1 The encrypted number to subtract from
+ * @param op2 The encrypted number to subtract
+ * @return non-zero on success, zero if @p op2 is not invertible, in which
+ *         case @p rop is left unmodified
+ */
+int hcs_encrypted_sub(const hcs_encoding *enc, hcs_encrypted_number *rop,
+        const hcs_encrypted_number *op1, const hcs_encrypted_number *op2);
+
+/**
+ * Subtract the encoded number @p op2 from the encrypted number @p op1,
+ * aligning exponents as in hcs_encrypted_add_encoded.
+ *
+ * @param enc A pointer to an initialised hcs_encoding
+ * @param rop Where the difference is stored
+ * @param op1 The encrypted number to subtract from
+ * @param op2 The encoded number to subtract
+ */
+void hcs_encrypted_sub_encoded(const hcs_encoding *enc,
+        hcs_encrypted_number *rop, const hcs_encrypted_number *op1,
+        const hcs_encoded_number *op2);
+
+/**
+ * Negate an encrypted number.
+ *
+ * @param enc A pointer to an initialised hcs_encoding
+ * @param rop Where the result is stored
+ * @param op The encrypted number to negate
+ * @return non-zero on success, zero if @p op is not invertible, in which
+ *         case @p rop is left unmodified
+ */
+int hcs_encrypted_neg(const hcs_encoding *enc, hcs_encrypted_number *rop,
+        const hcs_encrypted_number *op);
+
+/**
+ * Multiply an encrypted number by an encoded number. The exponents are
+ * added, so no rescaling is needed.
+ *
+ * @param enc A pointer to an initialised hcs_encoding
+ * @param rop Where the product is stored
+ * @param op1 An encrypted number
+ * @param op2 An encoded number
+ * @return non-zero on success, zero if the mantissa of @p op2 is negative
+ *         and @p op1 is not invertible, in which case @p rop is left
+ *         unmodified
+ */
+int hcs_encrypted_mul_encoded(const hcs_encoding *enc,
+        hcs_encrypted_number *rop, const hcs_encrypted_number *op1,
+        const hcs_encoded_number *op2);
+
+/**
+ * Sum the @p count encrypted numbers in @p op. The sum is evaluated as a
+ * single multi-exponentiation in which every term shares the squarings
+ * needed to bring it to the smallest exponent, so the cost of rescaling is
+ * the difference between the largest and smallest exponents, rather than a
+ * separate rescale per term.
+ *
+ * @param enc A pointer to an initialised hcs_encoding
+ * @param rop Where the sum is stored
+ * @param op Array of @p count encrypted numbers
+ * @param count Number of values in @p op
+ * @return non-zero on success, zero on allocation failure
+ */
+int hcs_encrypted_sum(const hcs_encoding *enc, hcs_encrypted_number *rop,
+        const hcs_encrypted_number *op, unsigned long count);
+
+/**
+ * Rescale each of the @p count encrypted numbers in @p op in place to the
+ * smallest exponent among them. Rescales are run in parallel.
+ *
+ * @param enc A pointer to an initialised hcs_encoding
+ * @param op Array of @p count encrypted numbers
+ * @param count Number of values in @p op
+ */
+void hcs_encrypted_align_batch(const hcs_encoding *enc,
+        hcs_encrypted_number *op, unsigned long count);
+
+/**
+ * Add the arrays @p op1 and @p op2 elementwise, as in hcs_encrypted_add.
+ * Elements are processed in parallel. Any of the arrays may be the same.
+ *
+ * @param enc A pointer to an initialised hcs_encoding
+ * @param rop Array of @p count encrypted numbers to store the sums
+ * @param op1 Array of @p count encrypted numbers
+ * @param op2 Array of @p count encrypted numbers
+ * @param count Number of values in each array
+ */
+void hcs_encrypted_add_batch(const hcs_encoding *enc,
+        hcs_encrypted_number *rop, const hcs_encrypted_number *op1,
+        const hcs_encrypted_number *op2, unsigned long count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
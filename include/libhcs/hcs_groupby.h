@@ -0,0 +1,239 @@
+/**
+ * @file hcs_groupby.h
+ *
+ * Encrypted group-by aggregation for the additive schemes pcs, pcs_t and
+ * djcs. Each row is a plaintext key and a ciphertext, and the result is the
+ * encrypted sum of the ciphertexts of every key.
+ *
+ * Rows are added to one of a number of shards, each owned by a single
+ * thread, so no locking is needed while adding. Every shard maps keys to
+ * accumulators through a compact open-addressing table. Accumulators are
+ * reduced lazily, only once they grow to several times the size of the
+ * ciphertext modulus, so most rows cost a single multiplication with no
+ * division. Once every row has been added, shards are merged pairwise in a
+ * parallel tree, so merging takes a logarithmic number of rounds in the
+ * number of shards.
+ *
+ * When the sum of every group is known to be small, the results can be
+ * packed before decryption, with many groups sharing a single ciphertext.
+ * This divides the number of decryptions, which dominate when there are
+ * many groups, by the number of groups per ciphertext.
+ *
+ * @code
+ * hcs_groupby *gb = hcs_init_groupby_pcs(pk, 0);
+ * hcs_groupby_add_batch(gb, key, cipher, rows);
+ * hcs_groupby_finish(gb);
+ *
+ * unsigned long packed = hcs_groupby_packed_count(gb, 40);
+ * hcs_groupby_pack(gb, packed_cipher, 40);
+ * for (unsigned long i = 0; i < packed; ++i)
+ *     pcs_decrypt(vk, plain[i], packed_cipher[i]);
+ * hcs_groupby_unpack(gb, sum, plain, 40);
+ * // sum[i] is the sum of group hcs_groupby_key(gb, i)
+ * hcs_free_groupby(gb);
+ * @endcode
+ */
+
+#ifndef HCS_GROUPBY_H
+#define HCS_GROUPBY_H
+
+#include <gmp.h>
+#include "djcs.h"
+#include "pcs.h"
+#include "pcs_t.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Opaque group-by aggregator.
+ */
+typedef struct hcs_groupby hcs_groupby;
+
+/**
+ * Initialise an aggregator for ciphertexts under the pcs public key @p pk.
+ *
+ * @param pk A pointer to an initialised pcs_public_key, which must outlive
+ *        the aggregator
+ * @param shards Number of shards, or zero for one per OpenMP thread
+ * @return A pointer to an initialised hcs_groupby, NULL on allocation
+ *         failure
+ */
+hcs_groupby* hcs_init_groupby_pcs(const pcs_public_key *pk,
+        unsigned long shards);
+
+/**
+ * Initialise an aggregator for ciphertexts under the pcs_t public key
+ * @p pk.
+ *
+ * @param pk A pointer to an initialised pcs_t_public_key, which must outlive
+ *        the aggregator
+ * @param shards Number of shards, or zero for one per OpenMP thread
+ * @return A pointer to an initialised hcs_groupby, NULL on allocation
+ *         failure
+ */
+hcs_groupby* hcs_init_groupby_pcs_t(const pcs_t_public_key *pk,
+        unsigned long shards);
+
+/**
+ * Initialise an aggregator for ciphertexts under the djcs public key @p pk.
+ * The plaintext space is n^s.
+ *
+ * @param pk A pointer to an initialised djcs_public_key, which must outlive
+ *        the aggregator
+ * @param shards Number of shards, or zero for one per OpenMP thread
+ * @return A pointer to an initialised hcs_groupby, NULL on allocation
+ *         failure
+ */
+hcs_groupby* hcs_init_groupby_djcs(const djcs_public_key *pk,
+        unsigned long shards);
+
+/**
+ * Return the number of shards of @p gb.
+ *
+ * @param gb A pointer to an initialised hcs_groupby
+ * @return Number of shards
+ */
+unsigned long hcs_groupby_shards(const hcs_groupby *gb);
+
+/**
+ * Add @p cipher to the sum of group @p key in shard @p shard. Rows may be
+ * added to distinct shards from several threads at once, but each shard
+ * must only be used by one thread at a time.
+ *
+ * @param gb A pointer to an initialised hcs_groupby
+ * @param shard Shard to add to, less than hcs_groupby_shards(gb)
+ * @param key The group of this row
+ * @param cipher A ciphertext under the key of @p gb
+ * @return non-zero on success, zero on allocation failure
+ */
+int hcs_groupby_add(hcs_groupby *gb, unsigned long shard, unsigned long key,
+        mpz_t cipher);
+
+/**
+ * Add the @p count rows in @p key and @p cipher, spreading them across every
+ * shard in parallel.
+ *
+ * @param gb A pointer to an initialised hcs_groupby
+ * @param key Array of @p count group keys
+ * @param cipher Array of @p count ciphertexts
+ * @param count Number of rows
+ * @return non-zero on success, zero on allocation failure
+ */
+int hcs_groupby_add_batch(hcs_groupby *gb, const unsigned long *key,
+        mpz_t *cipher, unsigned long count);
+
+/**
+ * Merge every shard and fully reduce the sum of each group. This must be
+ * called after adding rows and before any results are read. More rows may
+ * be added afterwards, after which this must be called again.
+ *
+ * @param gb A pointer to an initialised hcs_groupby
+ * @return non-zero on success, zero on allocation failure
+ */
+int hcs_groupby_finish(hcs_groupby *gb);
+
+/**
+ * Return the number of distinct groups seen. Groups are indexed from zero
+ * in an unspecified order.
+ *
+ * @param gb A pointer to a finished hcs_groupby
+ * @return Number of groups
+ */
+unsigned long hcs_groupby_count(const hcs_groupby *gb);
+
+/**
+ * Return the key of the group at @p index.
+ *
+ * @param gb A pointer to a finished hcs_groupby
+ * @param index Index of the group, less than hcs_groupby_count(gb)
+ * @return The key of the group
+ */
+unsigned long hcs_groupby_key(const hcs_groupby *gb, unsigned long index);
+
+/**
+ * Return the encrypted sum of the group at @p index. The value remains
+ * valid until rows are next added or @p gb is reset.
+ *
+ * @param gb A pointer to a finished hcs_groupby
+ * @param index Index of the group, less than hcs_groupby_count(gb)
+ * @return The encrypted sum of the group
+ */
+mpz_srcptr hcs_groupby_cipher(const hcs_groupby *gb, unsigned long index);
+
+/**
+ * Find the index of the group with key @p key.
+ *
+ * @param gb A pointer to a finished hcs_groupby
+ * @param key The key to look up
+ * @param index Where the index of the group is stored if found
+ * @return non-zero if the group exists, zero otherwise
+ */
+int hcs_groupby_find(const hcs_groupby *gb, unsigned long key,
+        unsigned long *index);
+
+/**
+ * Return the number of ciphertexts hcs_groupby_pack produces when every
+ * group sum is given @p bits bits.
+ *
+ * @param gb A pointer to a finished hcs_groupby
+ * @param bits Bits reserved for the sum of each group
+ * @return Number of packed ciphertexts, or zero if @p bits is zero or leaves
+ *         no room for a single group in the plaintext space
+ */
+unsigned long hcs_groupby_packed_count(const hcs_groupby *gb,
+        mp_bitcnt_t bits);
+
+/**
+ * Pack the sums of every group into as few ciphertexts as possible, with
+ * group i of a ciphertext occupying bits i * @p bits upwards of the
+ * plaintext. Every sum must be non-negative and below 2^@p bits, otherwise
+ * it spills into its neighbour. Packing costs @p bits squarings per group,
+ * and ciphertexts are packed in parallel.
+ *
+ * @param gb A pointer to a finished hcs_groupby
+ * @param rop Array of hcs_groupby_packed_count(gb, bits) mpz_t where the
+ *        packed ciphertexts are stored
+ * @param bits Bits reserved for the sum of each group
+ * @return non-zero on success, zero if @p bits is invalid as for
+ *         hcs_groupby_packed_count
+ */
+int hcs_groupby_pack(const hcs_groupby *gb, mpz_t *rop, mp_bitcnt_t bits);
+
+/**
+ * Split the decryptions of the ciphertexts produced by hcs_groupby_pack into
+ * the sum of each group.
+ *
+ * @param gb A pointer to the finished hcs_groupby which was packed
+ * @param rop Array of hcs_groupby_count(gb) mpz_t where the sum of group i
+ *        is stored in rop[i]
+ * @param plain Array of the decrypted packed ciphertexts, in order
+ * @param bits Bits reserved for the sum of each group, as given to
+ *        hcs_groupby_pack
+ * @return non-zero on success, zero if @p bits is invalid as for
+ *         hcs_groupby_packed_count, in which case @p rop is unmodified
+ */
+int hcs_groupby_unpack(const hcs_groupby *gb, mpz_t *rop, mpz_t *plain,
+        mp_bitcnt_t bits);
+
+/**
+ * Discard every group so @p gb can aggregate another set of rows. Memory is
+ * kept for reuse.
+ *
+ * @param gb A pointer to an initialised hcs_groupby
+ */
+void hcs_groupby_reset(hcs_groupby *gb);
+
+/**
+ * Frees a hcs_groupby and all associated memory.
+ *
+ * @param gb A pointer to an initialised hcs_groupby
+ */
+void hcs_free_groupby(hcs_groupby *gb);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
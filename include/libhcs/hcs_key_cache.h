@@ -0,0 +1,146 @@
+/**
+ * @file hcs_key_cache.h
+ *
+ * A thread-safe cache of imported public keys. A server handling many
+ * tenants would otherwise import the same key from its JSON representation
+ * on every request, paying for the parse, the base conversion and the
+ * precomputation of powers of n each time.
+ *
+ * Keys are looked up by a SHA-256 fingerprint of their JSON string, so a
+ * cache hit costs one hash of the string and a table lookup. A hit returns
+ * a reference to a fully imported key which must be released once the
+ * caller is finished with it. Cached keys are shared between threads and
+ * must not be modified.
+ *
+ * The cache is split into a number of shards, each with its own
+ * reader-writer lock, so that lookups only contend with imports landing in
+ * the same shard. Lookups take the shard lock in shared mode and mark the
+ * entry as recently used with an atomic store. When a shard exceeds its
+ * share of the memory budget, entries are evicted using the CLOCK
+ * approximation of LRU. An evicted key stays valid until every reference to
+ * it has been released.
+ */
+
+#ifndef HCS_KEY_CACHE_H
+#define HCS_KEY_CACHE_H
+
+#include <stddef.h>
+#include "djcs.h"
+#include "pcs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Size in bytes of a key fingerprint.
+ */
+#define HCS_KEY_FINGERPRINT_SIZE 32
+
+/**
+ * Types of key which may be stored in a cache.
+ */
+typedef enum {
+    HCS_KEY_PCS,    /**< A pcs_public_key */
+    HCS_KEY_DJCS    /**< A djcs_public_key */
+} hcs_key_type;
+
+/**
+ * A key held by a cache. The reference count and recently used bit are only
+ * ever accessed atomically.
+ */
+typedef struct hcs_cached_key {
+    hcs_key_type type;      /**< Which member of the key union is valid */
+    union {
+        const pcs_public_key *pcs;    /**< Key for HCS_KEY_PCS */
+        const djcs_public_key *djcs;  /**< Key for HCS_KEY_DJCS */
+    } key;
+    unsigned char fingerprint[HCS_KEY_FINGERPRINT_SIZE]; /**< Lookup hash */
+    size_t size;            /**< Approximate memory used by this entry */
+    unsigned long refcount; /**< References held by the cache and callers */
+    int referenced;         /**< CLOCK bit, set on every lookup */
+    struct hcs_cached_key *next; /**< Next entry in the same bucket */
+} hcs_cached_key;
+
+/**
+ * A sharded key cache. The layout is private, as the shard locks require
+ * POSIX definitions a strict C99 caller may not have enabled.
+ */
+typedef struct hcs_key_cache hcs_key_cache;
+
+/**
+ * Initialise an empty hcs_key_cache and return a pointer to the newly
+ * created structure. The memory budget is divided evenly between the
+ * shards. A shard always keeps at least the most recently imported key,
+ * even if that alone exceeds its budget.
+ *
+ * @param budget Approximate number of bytes the cached keys may use
+ * @return A pointer to an initialised hcs_key_cache, NULL on allocation
+ *         failure
+ */
+hcs_key_cache* hcs_init_key_cache(size_t budget);
+
+/**
+ * Compute the fingerprint used to look up the key of type @p type with
+ * JSON representation @p json.
+ *
+ * @param type The type of key
+ * @param json A string storing the contents of a public key
+ * @param out Buffer of HCS_KEY_FINGERPRINT_SIZE bytes to store the result
+ */
+void hcs_key_fingerprint(hcs_key_type type, const char *json,
+        unsigned char *out);
+
+/**
+ * Return a reference to the key of type @p type given by @p json, importing
+ * it into the cache if it is not already present. The reference must be
+ * returned with hcs_key_cache_release.
+ *
+ * Keys are matched on their exact JSON string. The same key exported with
+ * different formatting is cached as two separate entries.
+ *
+ * @param cache A pointer to an initialised hcs_key_cache
+ * @param type The type of key @p json holds
+ * @param json A string storing the contents of a public key
+ * @return A pointer to the cached key, NULL on format or allocation failure
+ */
+hcs_cached_key* hcs_key_cache_get(hcs_key_cache *cache, hcs_key_type type,
+        const char *json);
+
+/**
+ * Release a reference returned by hcs_key_cache_get. If the key has been
+ * evicted and this was the last reference, the key is freed.
+ *
+ * @param key A pointer returned by hcs_key_cache_get
+ */
+void hcs_key_cache_release(hcs_cached_key *key);
+
+/**
+ * Return the number of keys currently held by the cache.
+ *
+ * @param cache A pointer to an initialised hcs_key_cache
+ * @return The number of keys held
+ */
+unsigned long hcs_key_cache_count(hcs_key_cache *cache);
+
+/**
+ * Return the approximate memory in bytes used by the keys in the cache.
+ *
+ * @param cache A pointer to an initialised hcs_key_cache
+ * @return The number of bytes used
+ */
+size_t hcs_key_cache_size(hcs_key_cache *cache);
+
+/**
+ * Remove every key from the cache and free the cache. Keys still referenced
+ * by a caller are freed when released.
+ *
+ * @param cache A pointer to an initialised hcs_key_cache
+ */
+void hcs_free_key_cache(hcs_key_cache *cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
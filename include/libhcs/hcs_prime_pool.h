@@ -0,0 +1,162 @@
+/**
+ * @file hcs_prime_pool.h
+ *
+ * A pool of pre-generated primes. Prime generation dominates the cost of key
+ * generation, and for safe primes can take seconds. A pool can be filled
+ * ahead of time, either directly or by a background thread running at the
+ * lowest scheduling priority available, so that a later key generation only
+ * has to take two primes from the pool.
+ *
+ * Every prime in a pool is generated for the same bit count and is either a
+ * regular prime, or a safe prime p = 2q + 1 stored alongside q. The key
+ * generation functions which accept a pool fall back to generating primes
+ * inline if the pool is empty or was filled for a different key size.
+ *
+ * The primes in a pool are secret key material. Any file a pool is saved to
+ * is created readable only by its owner, and primes are zeroed once taken.
+ */
+
+#ifndef HCS_PRIME_POOL_H
+#define HCS_PRIME_POOL_H
+
+#include <gmp.h>
+#include "hcs_random.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A bounded pool of primes which may be filled by a background thread. The
+ * structure is opaque, and every function taking a pool is thread-safe.
+ */
+typedef struct hcs_prime_pool hcs_prime_pool;
+
+/**
+ * Initialise an empty hcs_prime_pool and return a pointer to the newly
+ * created structure.
+ *
+ * @p bits is the value passed to the prime generator, and is half of the key
+ * size in bits as used by key generation. The helper
+ * hcs_prime_pool_bits_for_key gives the value to use for a particular key.
+ *
+ * @param bits The bit count to generate each prime with
+ * @param safe Non-zero if the pool should hold safe primes
+ * @param capacity The maximum number of primes to hold at once
+ * @return A pointer to an initialised hcs_prime_pool, NULL on allocation
+ *         failure
+ */
+hcs_prime_pool* hcs_init_prime_pool(mp_bitcnt_t bits, int safe,
+        unsigned long capacity);
+
+/**
+ * Return the bit count a pool must be created with to serve key generation
+ * for a modulus of @p key_bits bits.
+ *
+ * @param key_bits The number of bits of the key modulus
+ * @return The per-prime bit count
+ */
+mp_bitcnt_t hcs_prime_pool_bits_for_key(unsigned long key_bits);
+
+/**
+ * Return the bit count @p pool was created with.
+ *
+ * @param pool A pointer to an initialised hcs_prime_pool
+ * @return The per-prime bit count
+ */
+mp_bitcnt_t hcs_prime_pool_bits(const hcs_prime_pool *pool);
+
+/**
+ * Return whether @p pool holds safe primes.
+ *
+ * @param pool A pointer to an initialised hcs_prime_pool
+ * @return non-zero if the pool holds safe primes, else zero
+ */
+int hcs_prime_pool_safe(const hcs_prime_pool *pool);
+
+/**
+ * Start a background thread which keeps the pool filled. The thread runs at
+ * idle priority where the platform supports it, sleeps while the pool is
+ * full, and uses its own random state. Calling this on a pool which is
+ * already running has no effect.
+ *
+ * @param pool A pointer to an initialised hcs_prime_pool
+ * @return non-zero on success, zero if the thread could not be created
+ */
+int hcs_prime_pool_start(hcs_prime_pool *pool);
+
+/**
+ * Stop the background thread, waiting for any prime it is currently
+ * generating to be finished. Primes already in the pool are kept.
+ *
+ * @param pool A pointer to an initialised hcs_prime_pool
+ */
+void hcs_prime_pool_stop(hcs_prime_pool *pool);
+
+/**
+ * Generate primes in the calling thread until the pool holds at least
+ * @p count primes or is full. This may be used with or instead of the
+ * background thread.
+ *
+ * @param pool A pointer to an initialised hcs_prime_pool
+ * @param hr A pointer to an initialised hcs_random type
+ * @param count The number of primes the pool should hold on return
+ */
+void hcs_prime_pool_fill(hcs_prime_pool *pool, hcs_random *hr,
+        unsigned long count);
+
+/**
+ * Take a prime from the pool without waiting. For a pool of safe primes,
+ * @p q is set to (p - 1) / 2, otherwise @p q may be NULL.
+ *
+ * @param pool A pointer to an initialised hcs_prime_pool
+ * @param p mpz_t where the prime is stored
+ * @param q mpz_t where the Sophie Germain prime is stored, if any
+ * @return non-zero if a prime was taken, zero if the pool was empty
+ */
+int hcs_prime_pool_take(hcs_prime_pool *pool, mpz_t p, mpz_t q);
+
+/**
+ * Return the number of primes currently held by the pool.
+ *
+ * @param pool A pointer to an initialised hcs_prime_pool
+ * @return The number of primes held
+ */
+unsigned long hcs_prime_pool_count(hcs_prime_pool *pool);
+
+/**
+ * Write the primes currently held by @p pool to the file @p path. The file
+ * is created, or an existing file reset, with permissions allowing access by
+ * its owner only.
+ *
+ * @param pool A pointer to an initialised hcs_prime_pool
+ * @param path Path of the file to write
+ * @return non-zero on success, zero on failure
+ */
+int hcs_prime_pool_save(hcs_prime_pool *pool, const char *path);
+
+/**
+ * Add primes stored in the file @p path by hcs_prime_pool_save to @p pool.
+ * The file must have been saved from a pool with the same bit count and
+ * prime type. Primes beyond the capacity of the pool are ignored, and each
+ * prime is checked for primality and for the size the pool generates as it
+ * is read. A prime of any other size fails the load.
+ *
+ * @param pool A pointer to an initialised hcs_prime_pool
+ * @param path Path of the file to read
+ * @return non-zero on success, zero on failure
+ */
+int hcs_prime_pool_load(hcs_prime_pool *pool, const char *path);
+
+/**
+ * Stop any background thread, zero all held primes and free the pool.
+ *
+ * @param pool A pointer to an initialised hcs_prime_pool
+ */
+void hcs_free_prime_pool(hcs_prime_pool *pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
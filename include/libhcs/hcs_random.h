@@ -9,6 +9,10 @@
  * Seed is gathered from the operating systems provided entropy. For example,
  * /dev/urandom is used under Linux. This may be slightly altered, but for now
  * it satisfies the required randomness.
+ *
+ * An hcs_random is modified by every function which draws from it, so each
+ * thread should use its own. Keys are never modified by encryption or
+ * decryption, and may be shared freely between threads.
  */
 
 #ifndef HCS_RAND_H
@@ -0,0 +1,63 @@
+/**
+ * @file hcs_scrub.h
+ *
+ * Controls which values are overwritten with zeros before their memory is
+ * released. GMP does not clear limbs when freeing or reallocating them, so
+ * without scrubbing, secret values may remain in freed memory.
+ *
+ * Values are divided into two classes. Secret values are private keys,
+ * primes, polynomial coefficients, secret shares, and temporaries computed
+ * from these or from a decrypted plaintext. Public values are public keys,
+ * ciphertexts, and temporaries computed only from these. The policy decides
+ * which classes are scrubbed.
+ *
+ * The default policy is chosen at build time by defining HCS_SCRUB_DEFAULT
+ * to one of the hcs_scrub_policy values. With CMake, this is set with
+ * -DHCS_SCRUB_POLICY=NONE, SECRET or ALL. The policy may be changed at any
+ * time with hcs_set_scrub_policy, and applies process-wide.
+ */
+
+#ifndef HCS_SCRUB_H
+#define HCS_SCRUB_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Which classes of value are scrubbed before being released.
+ */
+typedef enum {
+    HCS_SCRUB_NONE,     /**< Never scrub */
+    HCS_SCRUB_SECRET,   /**< Scrub secret values only */
+    HCS_SCRUB_ALL       /**< Scrub secret and public values */
+} hcs_scrub_policy;
+
+#ifndef HCS_SCRUB_DEFAULT
+/**
+ * The policy in effect before hcs_set_scrub_policy is first called.
+ */
+#define HCS_SCRUB_DEFAULT HCS_SCRUB_SECRET
+#endif
+
+/**
+ * Set the scrubbing policy for the whole process. This is safe to call while
+ * other threads are using the library, though a value being released at the
+ * same moment may follow either policy.
+ *
+ * @param policy The new policy
+ */
+void hcs_set_scrub_policy(hcs_scrub_policy policy);
+
+/**
+ * Return the current scrubbing policy.
+ *
+ * @return The current policy
+ */
+hcs_scrub_policy hcs_get_scrub_policy(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
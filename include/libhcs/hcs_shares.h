@@ -2,12 +2,29 @@
  * @file hcs_shares.h
  *
  * This is a structure which is designed to hold a number of shares. It can be
- * thought of as an array of mpz_t values, each with a corresponding bit which
- * signals if the particular value of the share should be counted when
- * combining shares. This is used by all threshold encryption schemes.
+ * thought of as a matrix of values with one row per ciphertext and one column
+ * per server, along with a bit per server which signals if the shares of that
+ * server should be counted when combining shares. This is used by all
+ * threshold encryption schemes.
  *
  * The rationale for this is that one may want to test a number of different
  * combinations of shares, and setting a flag simplifies this process.
+ *
+ * Every share is stored in a single arena of limbs, with a fixed number of
+ * limbs reserved for each, so setting a share never allocates once the
+ * arena is large enough. Shares are read back through read-only mpz_t views
+ * of the arena. A structure may be reset and refilled for each batch of
+ * ciphertexts without being reinitialised.
+ *
+ * @code
+ * hcs_shares *hs = hcs_init_shares_batch(pk->l, count,
+ *                                        mpz_sizeinbase(pk->n2, 2));
+ * for (unsigned long i = 0; i < pk->l; ++i)
+ *     for (unsigned long r = 0; r < count; ++r)
+ *         hcs_set_batch_share(hs, share[r][i], r, i);
+ * pcs_t_share_combine_batch(pk, plain, hs);
+ * hcs_reset_shares(hs);
+ * @endcode
  */
 
 #ifndef HCS_SHARES
@@ -20,18 +37,24 @@ extern "C" {
 #endif
 
 /**
- * Stores a number of shares, with flags indicating if they are currently to
- * be counted.
+ * Stores a matrix of shares, with flags indicating which servers are
+ * currently to be counted. The fields should only be accessed through the
+ * functions below.
  */
 typedef struct {
-    mpz_t *shares;      /**< An array of share values */
-    int *flag;          /**< Flags corresponding to each value in @p shares */
-    void **server_id;   /**< Optional id of each shares server */
-    unsigned long size; /**< Number of shares in this array */
+    unsigned long size;     /**< Number of servers */
+    unsigned long count;    /**< Number of ciphertexts */
+    mp_size_t limbs;        /**< Limbs reserved for each share */
+    mp_limb_t *arena;       /**< Limbs of share i of ciphertext r, starting at
+                                 (r * size + i) * limbs */
+    mp_size_t *used;        /**< Limbs used by each share, in arena order */
+    unsigned long *mask;    /**< Bitmap of the servers to count */
+    void **server_id;       /**< Optional id of each shares server */
 } hcs_shares;
 
 /**
- * Initialise a hcs_shares and return a pointer to the newly created structure.
+ * Initialise a hcs_shares holding a single share for each of @p size servers
+ * and return a pointer to the newly created structure.
  *
  * @param size The number of shares this hcs_shares should store
  * @return A pointer to an initialised hcs_shares, NULL on allocation failure
@@ -39,16 +62,61 @@ typedef struct {
 hcs_shares* hcs_init_shares(unsigned long size);
 
 /**
- * Set a share value for the server given by id @p index. @p index should
- * be less than @p hs->size. It is up to the caller to enforce this. The
- * owner of this @p hs should have a mapping of server id's to indices, as it
- * is required by a number of other functions involved in threshold system.
+ * Initialise a hcs_shares holding the shares of @p size servers for each of
+ * @p count ciphertexts, and return a pointer to the newly created structure.
+ * Space for shares of up to @p bits bits is reserved up front. Larger shares
+ * may still be stored, but move the whole arena.
+ *
+ * @param size The number of servers
+ * @param count The number of ciphertexts
+ * @param bits The largest expected share size in bits, usually that of the
+ *        ciphertext modulus, or zero to grow on demand
+ * @return A pointer to an initialised hcs_shares, NULL on allocation failure
+ */
+hcs_shares* hcs_init_shares_batch(unsigned long size, unsigned long count,
+        mp_bitcnt_t bits);
+
+/**
+ * Set a share value for the server given by id @p index, and set its flag.
+ * @p index should be less than @p hs->size. It is up to the caller to enforce
+ * this. The owner of this @p hs should have a mapping of server id's to
+ * indices, as it is required by a number of other functions involved in
+ * threshold system. This sets the share of the first ciphertext.
  *
  * @param hs A pointer to an initialised hcs_shares
- * @param value Share stored in an mpz_t variable
+ * @param value Non-negative share stored in an mpz_t variable
  * @param index Index of the server to store this share in
+ * @return non-zero on success, zero if the arena could not be grown
+ */
+int hcs_set_share(hcs_shares *hs, mpz_t value, unsigned long index);
+
+/**
+ * Set the share of server @p index for ciphertext @p row, and set the flag
+ * of the server. Shares of distinct positions may be set from several
+ * threads at once, provided none exceeds the reserved size.
+ *
+ * @param hs A pointer to an initialised hcs_shares
+ * @param value Non-negative share stored in an mpz_t variable
+ * @param row Index of the ciphertext, less than @p hs->count
+ * @param index Index of the server, less than @p hs->size
+ * @return non-zero on success, zero if the arena could not be grown
+ */
+int hcs_set_batch_share(hcs_shares *hs, mpz_t value, unsigned long row,
+        unsigned long index);
+
+/**
+ * Return a read-only view of the share of server @p index for ciphertext
+ * @p row. The view is stored in @p view, which must not be initialised,
+ * cleared or modified, and remains valid until the share is next set.
+ *
+ * @param hs A pointer to an initialised hcs_shares
+ * @param view Storage for the view
+ * @param row Index of the ciphertext
+ * @param index Index of the server
+ * @return The view, usable wherever a const mpz_t is
  */
-void hcs_set_share(hcs_shares *hs, mpz_t value, unsigned long index);
+mpz_srcptr hcs_get_share(const hcs_shares *hs, mpz_ptr view,
+        unsigned long row, unsigned long index);
 
 /**
  * Set the flag on @p hs at @p index. This share will then be counted by
@@ -85,6 +153,39 @@ void hcs_toggle_flag(hcs_shares *hs, unsigned long index);
  */
 int hcs_tst_flag(hcs_shares *hs, unsigned long index);
 
+/**
+ * Return the number of servers whose flag is set.
+ *
+ * @param hs A pointer to an initialised hcs_shares
+ * @return The number of flagged servers
+ */
+unsigned long hcs_count_flags(const hcs_shares *hs);
+
+/**
+ * Return the first server at or after @p index whose flag is set. Only
+ * flagged servers are visited when iterating with this, a word of flags at
+ * a time.
+ *
+ * @code
+ * for (unsigned long i = hcs_next_flag(hs, 0); i < hs->size;
+ *         i = hcs_next_flag(hs, i + 1))
+ * @endcode
+ *
+ * @param hs A pointer to an initialised hcs_shares
+ * @param index Index to start searching from
+ * @return The index of the next flagged server, or @p hs->size if there is
+ *         none
+ */
+unsigned long hcs_next_flag(const hcs_shares *hs, unsigned long index);
+
+/**
+ * Clear every flag and share of @p hs so it can hold the shares of another
+ * batch. No memory is released.
+ *
+ * @param hs A pointer to an initialised hcs_shares
+ */
+void hcs_reset_shares(hcs_shares *hs);
+
 /**
  * Frees a hcs_shares and all associated memory.
  *
@@ -97,4 +198,3 @@ void hcs_free_shares(hcs_shares *hs);
 #endif
 
 #endif
-
@@ -0,0 +1,129 @@
+/**
+ * @file hcs_transport.h
+ *
+ * Reliable byte streams for exchanging values between parties.
+ *
+ * A transport wraps a file descriptor, such as a connected UNIX-domain
+ * socket or a pipe, or one end of an in-process pair which passes bytes
+ * through memory. Every read and write transfers exactly the requested
+ * number of bytes or fails, so message framing is left to the protocol
+ * built on top. Reads from a descriptor are buffered, so a protocol may read
+ * small fields without a system call for each one.
+ *
+ * A transport may be read by one thread while another writes to it.
+ * hcs_transport_shutdown may be called from any thread to wake a reader
+ * blocked on the other end.
+ *
+ * @code
+ * int lfd = hcs_listen_unix("/tmp/server.sock", 8);
+ * hcs_transport *t = hcs_accept_unix(lfd);
+ * hcs_transport_write(t, "hello", 5);
+ * hcs_free_transport(t);
+ * @endcode
+ */
+
+#ifndef HCS_TRANSPORT_H
+#define HCS_TRANSPORT_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Opaque byte stream.
+ */
+typedef struct hcs_transport hcs_transport;
+
+/**
+ * Initialise a transport over the open file descriptor @p fd. The transport
+ * takes ownership of @p fd, which is closed when the transport is freed.
+ *
+ * @param fd A descriptor open for both reading and writing
+ * @return A pointer to an initialised hcs_transport, NULL on allocation
+ *         failure
+ */
+hcs_transport* hcs_init_transport_fd(int fd);
+
+/**
+ * Initialise two connected in-process transports. Bytes written to either
+ * end are read from the other. Writes never block, as buffered bytes are
+ * only limited by memory.
+ *
+ * @param a Set to a pointer to the first end
+ * @param b Set to a pointer to the second end
+ * @return non-zero on success, zero on allocation failure
+ */
+int hcs_init_transport_pair(hcs_transport **a, hcs_transport **b);
+
+/**
+ * Create a UNIX-domain socket listening at @p path. Any existing socket file
+ * at @p path is replaced.
+ *
+ * @param path Filesystem path of the socket
+ * @param backlog Maximum number of pending connections
+ * @return The listening descriptor, or -1 on failure
+ */
+int hcs_listen_unix(const char *path, int backlog);
+
+/**
+ * Wait for a connection on the listening descriptor @p fd, as returned by
+ * hcs_listen_unix.
+ *
+ * @param fd A listening descriptor
+ * @return A transport for the accepted connection, NULL on failure
+ */
+hcs_transport* hcs_accept_unix(int fd);
+
+/**
+ * Connect to the UNIX-domain socket listening at @p path.
+ *
+ * @param path Filesystem path of the socket
+ * @return A transport for the connection, NULL on failure
+ */
+hcs_transport* hcs_connect_unix(const char *path);
+
+/**
+ * Read exactly @p len bytes from @p t into @p buf, waiting as needed.
+ *
+ * @param t A pointer to an initialised hcs_transport
+ * @param buf Buffer of at least @p len bytes
+ * @param len Number of bytes to read
+ * @return non-zero on success, zero if the stream ended or failed first
+ */
+int hcs_transport_read(hcs_transport *t, void *buf, size_t len);
+
+/**
+ * Write all @p len bytes of @p buf to @p t.
+ *
+ * @param t A pointer to an initialised hcs_transport
+ * @param buf Bytes to write
+ * @param len Number of bytes to write
+ * @return non-zero on success, zero if the stream was closed or failed
+ */
+int hcs_transport_write(hcs_transport *t, const void *buf, size_t len);
+
+/**
+ * Shut down both directions of @p t. Pending and later reads on either end
+ * see the end of the stream once buffered bytes are consumed, and later
+ * writes fail. A descriptor which is not a socket is unaffected until it is
+ * freed. The transport must still be freed.
+ *
+ * @param t A pointer to an initialised hcs_transport
+ */
+void hcs_transport_shutdown(hcs_transport *t);
+
+/**
+ * Frees a hcs_transport and all associated memory, closing its descriptor.
+ * The other end of an in-process pair sees the end of the stream.
+ *
+ * @param t A pointer to an initialised hcs_transport
+ */
+void hcs_free_transport(hcs_transport *t);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,262 @@
+/**
+ * @file jlcs.h
+ *
+ * The Joye-Libert scheme is a generalization of the Goldwasser-Micali scheme
+ * which encrypts k bits at a time. It is additively homomorphic modulo 2^k:
+ *
+ * @code
+ * E(a + b mod 2^k) = jlcs_ee_add(E(a), E(b));
+ * E(a + b mod 2^k) = jlcs_ep_add(E(a), b);
+ * E(a * b mod 2^k) = jlcs_ep_mul(E(a), b);
+ * E(-a mod 2^k)    = jlcs_e_neg(E(a));
+ * @endcode
+ *
+ * Ciphertexts are reduced modulo n rather than n^2, and encryption costs a
+ * single k-bit exponentiation plus k squarings, rather than the full-width
+ * exponentiation of the Paillier scheme. This suits large volumes of small
+ * values, which would waste most of a Paillier plaintext.
+ *
+ * All mpz_t values can be aliases unless otherwise stated.
+ */
+
+#ifndef HCS_JLCS_H
+#define HCS_JLCS_H
+
+#include <gmp.h>
+#include "hcs_random.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Public key for use in the Joye-Libert system.
+ */
+typedef struct {
+    unsigned long k;    /**< Number of bits in a plaintext */
+    mpz_t n;            /**< Modulus of the key: n = p * q */
+    mpz_t y;            /**< A quadratic non-residue mod p and q */
+    mpz_t k2;           /**< Precomputation: 2^k */
+} jlcs_public_key;
+
+/**
+ * Private key for use in the Joye-Libert system.
+ */
+typedef struct {
+    unsigned long k;    /**< Number of bits in a plaintext */
+    mpz_t p;            /**< A random prime with p = 1 mod 2^k */
+    mpz_t q;            /**< A random prime with q = 3 mod 4 */
+    mpz_t y;            /**< The non-residue of the public key */
+    mpz_t e;            /**< Precomputation: (p - 1) / 2^k */
+    mpz_t *d;           /**< Precomputation: d[j] = y^(-e * 2^j) mod p for
+                             j < k */
+    mpz_t n;            /**< Precomputation: p * q */
+} jlcs_private_key;
+
+/**
+ * Initialise a jlcs_public_key and return a pointer to the newly created
+ * structure.
+ *
+ * @return A pointer to an initialised jlcs_public_key, NULL on allocation
+ *         failure
+ */
+jlcs_public_key*  jlcs_init_public_key(void);
+
+/**
+ * Initialise a jlcs_private_key and return a pointer to the newly created
+ * structure.
+ *
+ * @return A pointer to an initialised jlcs_private_key, NULL on allocation
+ *         failure
+ */
+jlcs_private_key* jlcs_init_private_key(void);
+
+/**
+ * Initialise a key pair with modulus size @p bits, encrypting @p k bits at a
+ * time. It is required that @p pk and @p vk are initialised before calling
+ * this function.
+ *
+ * The prime p is chosen with p = 1 mod 2^k, so @p k is limited to a quarter
+ * of @p bits to leave p with enough random bits. In practice the @p bits
+ * value should usually be greater than 2048 to ensure sufficient security.
+ *
+ * @param pk A pointer to an initialised jlcs_public_key
+ * @param vk A pointer to an initialised jlcs_private_key
+ * @param hr A pointer to an initialised hcs_random type
+ * @param bits The number of bits for the modulus of the key
+ * @param k The number of bits in a plaintext
+ * @return non-zero on success, zero if @p k is zero, larger than a quarter
+ *         of @p bits, or memory could not be allocated
+ */
+int jlcs_generate_key_pair(jlcs_public_key *pk, jlcs_private_key *vk,
+        hcs_random *hr, const unsigned long bits, const unsigned long k);
+
+/**
+ * Encrypt a value @p plain1, and set @p rop to the encrypted result.
+ * @p plain1 is taken modulo 2^k.
+ *
+ * @param pk A pointer to an initialised jlcs_public_key
+ * @param hr A pointer to an initialised hcs_random type
+ * @param rop mpz_t where the encrypted result is stored
+ * @param plain1 mpz_t to be encrypted
+ */
+void jlcs_encrypt(const jlcs_public_key *pk, hcs_random *hr, mpz_t rop,
+        mpz_t plain1);
+
+/**
+ * Reencrypt an encrypted value @p op. Upon decryption, this newly
+ * encrypted value, @p rop, will retain the same value as @p op.
+ *
+ * @param pk A pointer to an initialised jlcs_public_key
+ * @param hr A pointer to an initialised hcs_random type
+ * @param rop mpz_t where the newly encrypted value is stored
+ * @param op mpz_t to be reencrypted
+ */
+void jlcs_reencrypt(const jlcs_public_key *pk, hcs_random *hr, mpz_t rop,
+        mpz_t op);
+
+/**
+ * Add a plaintext value @p plain1 to an encrypted value @p cipher1 modulo
+ * 2^k, storing the result in @p rop.
+ *
+ * @param pk A pointer to an initialised jlcs_public_key
+ * @param rop mpz_t where the newly encrypted value is stored
+ * @param cipher1 mpz_t to be added together
+ * @param plain1 mpz_t to be added together
+ */
+void jlcs_ep_add(const jlcs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t plain1);
+
+/**
+ * Add an encrypted value @p cipher2 to an encrypted value @p cipher1 modulo
+ * 2^k, storing the result in @p rop.
+ *
+ * @param pk A pointer to an initialised jlcs_public_key.
+ * @param rop mpz_t where the newly encrypted value is stored
+ * @param cipher1 mpz_t to be added together
+ * @param cipher2 mpz_t to be added together
+ */
+void jlcs_ee_add(const jlcs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t cipher2);
+
+/**
+ * Multiply a plaintext value @p plain1 with an encrypted value @p cipher1
+ * modulo 2^k, storing the result in @p rop. @p plain1 is reduced modulo 2^k
+ * first, so the cost is at most a k-bit exponentiation.
+ *
+ * @param pk A pointer to an initialised jlcs_public_key.
+ * @param rop mpz_t where the newly encrypted value is stored
+ * @param cipher1 mpz_t to be multiplied together
+ * @param plain1 mpz_t to be multiplied together
+ */
+void jlcs_ep_mul(const jlcs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t plain1);
+
+/**
+ * Negate an encrypted value @p cipher1 modulo 2^k, storing the result in
+ * @p rop.
+ *
+ * @param pk A pointer to an initialised jlcs_public_key.
+ * @param rop mpz_t where the newly encrypted value is stored
+ * @param cipher1 The encrypted value which is to be negated
+ */
+void jlcs_e_neg(const jlcs_public_key *pk, mpz_t rop, mpz_t cipher1);
+
+/**
+ * Decrypt a value @p cipher1, and set @p rop to the decrypted result. The
+ * plaintext is recovered a bit at a time from c^((p-1)/2^k) mod p, using the
+ * powers of y held in the private key, so after the first exponentiation
+ * only squarings and multiplications mod p remain.
+ *
+ * @param vk A pointer to an initialised jlcs_private_key
+ * @param rop mpz_t where the decrypted result is stored
+ * @param cipher1 mpz_t to be decrypted
+ */
+void jlcs_decrypt(const jlcs_private_key *vk, mpz_t rop, mpz_t cipher1);
+
+/**
+ * This function zeros all data in @p pk. It is useful to use if we wish
+ * to generate or import a new value for the given jlcs_public_key and want
+ * to safely ensure the old values are removed.
+ *
+ * @param pk A pointer to an initialised jlcs_public_key
+ */
+void jlcs_clear_public_key(jlcs_public_key *pk);
+
+/**
+ * This function zeros all data in @p vk and releases its precomputed
+ * table, so a new key may be generated or imported into it.
+ *
+ * @param vk A pointer to an initialised jlcs_private_key
+ */
+void jlcs_clear_private_key(jlcs_private_key *vk);
+
+/**
+ * Frees a jlcs_public_key and all associated memory.
+ *
+ * @param pk A pointer to an initialised jlcs_public_key
+ */
+void jlcs_free_public_key(jlcs_public_key *pk);
+
+/**
+ * Frees a jlcs_private_key and all associated memory.
+ *
+ * @param vk A pointer to an initialised jlcs_private_key
+ */
+void jlcs_free_private_key(jlcs_private_key *vk);
+
+/**
+ * Check that the n and k values of @p pk and @p vk match.
+ *
+ * @param pk A pointer to an initialised jlcs_public_key
+ * @param vk A pointer to an initialised jlcs_private_key
+ * @return non-zero if keys are valid, else zero
+ */
+int jlcs_verify_key_pair(const jlcs_public_key *pk, const jlcs_private_key *vk);
+
+/**
+ * Export a public key as a JSON string, in the format of
+ * pcs_export_public_key. Only n, y and k are stored.
+ *
+ * @param pk A pointer to an initialised jlcs_public_key
+ * @return A string representing the given key, else NULL on error
+ */
+char* jlcs_export_public_key(const jlcs_public_key *pk);
+
+/**
+ * Export a private key as a JSON string. Only p, q, y and k are stored.
+ *
+ * @param vk A pointer to an initialised jlcs_private_key
+ * @return A string representing the given key, else NULL on error
+ */
+char* jlcs_export_private_key(const jlcs_private_key *vk);
+
+/**
+ * Import a public key from a string. The input string is expected to
+ * match the format given by the export functions.
+ *
+ * @param pk A pointer to an initialised jlcs_public_key
+ * @param json A string storing the contents of a public key
+ * @return non-zero if success, else zero on format error or if k is zero
+ *         or not smaller than the bit length of n
+ */
+int jlcs_import_public_key(jlcs_public_key *pk, const char *json);
+
+/**
+ * Import a private key from a string. The input string is expected to
+ * match the format given by the export functions. Any key previously held
+ * by @p vk is cleared first.
+ *
+ * @param vk A pointer to an initialised jlcs_private_key
+ * @param json A string storing the contents of a private key
+ * @return non-zero if success, else zero on format error, if p is not
+ *         1 mod 2^k, if y is a quadratic residue mod p, or on allocation
+ *         failure
+ */
+int jlcs_import_private_key(jlcs_private_key *vk, const char *json);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,275 @@
+/**
+ * @file oucs.h
+ *
+ * The Okamoto-Uchiyama scheme is an additively homomorphic scheme with the
+ * same operations as the Paillier scheme:
+ *
+ * @code
+ * E(a + b) = oucs_ee_add(E(a), E(b));
+ * E(a + b) = oucs_ep_add(E(a), b);
+ * E(a * b) = oucs_ep_mul(E(a), b);
+ * E(a - b) = oucs_ee_sub(E(a), E(b));
+ * E(-a)    = oucs_e_neg(E(a));
+ * @endcode
+ *
+ * The modulus is n = p^2 * q and ciphertexts are reduced modulo n rather than
+ * n^2, so they are half the size of Paillier ciphertexts for the same
+ * modulus. Decryption is a single exponentiation modulo p^2, where p is a
+ * third of the size of n. The price is a smaller plaintext space: results
+ * are only correct modulo the secret prime p, so every plaintext, and every
+ * result of homomorphic operations, must be below 2^pk->mbits.
+ *
+ * Like Paillier, the scheme is malleable and must not be used where an
+ * attacker can obtain decryptions of chosen ciphertexts, which reveal p.
+ *
+ * All mpz_t values can be aliases unless otherwise stated.
+ */
+
+#ifndef HCS_OUCS_H
+#define HCS_OUCS_H
+
+#include <gmp.h>
+#include "hcs_random.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Public key for use in the Okamoto-Uchiyama system.
+ */
+typedef struct {
+    unsigned long mbits; /**< Plaintexts must be below 2^mbits */
+    mpz_t n;             /**< Modulus of the key: n = p^2 * q */
+    mpz_t g;             /**< Random value whose order mod p^2 is a multiple
+                              of p */
+    mpz_t h;             /**< Precomputation: g^n mod n */
+} oucs_public_key;
+
+/**
+ * Private key for use in the Okamoto-Uchiyama system.
+ */
+typedef struct {
+    mpz_t p;        /**< A random prime determined during key generation */
+    mpz_t q;        /**< A random prime determined during key generation */
+    mpz_t g;        /**< The generator of the public key */
+    mpz_t p2;       /**< Precomputation: p^2 */
+    mpz_t hp;       /**< Precomputation: L_p(g^{p-1} mod p^2)^{-1} mod p */
+    mpz_t n;        /**< Precomputation: p^2 * q */
+} oucs_private_key;
+
+/**
+ * Initialise a oucs_public_key and return a pointer to the newly created
+ * structure.
+ *
+ * @return A pointer to an initialised oucs_public_key, NULL on allocation
+ *         failure
+ */
+oucs_public_key*  oucs_init_public_key(void);
+
+/**
+ * Initialise a oucs_private_key and return a pointer to the newly created
+ * structure.
+ *
+ * @return A pointer to an initialised oucs_private_key, NULL on allocation
+ *         failure
+ */
+oucs_private_key* oucs_init_private_key(void);
+
+/**
+ * Initialise a key pair with modulus size @p bits. It is required that @p pk
+ * and @p vk are initialised before calling this function. @p pk and @p vk are
+ * expected to not be NULL. The primes p and q are each a third of @p bits.
+ *
+ * In practice the @p bits value should usually be greater than 3072 to ensure
+ * sufficient security.
+ *
+ * @param pk A pointer to an initialised oucs_public_key
+ * @param vk A pointer to an initialised oucs_private_key
+ * @param hr A pointer to an initialised hcs_random type
+ * @param bits The number of bits for the modulus of the key
+ */
+void oucs_generate_key_pair(oucs_public_key *pk, oucs_private_key *vk,
+                            hcs_random *hr, const unsigned long bits);
+
+/**
+ * Encrypt a value @p plain1, and set @p rop to the encrypted result.
+ * @p plain1 must be non-negative and below 2^pk->mbits.
+ *
+ * @param pk A pointer to an initialised oucs_public_key
+ * @param hr A pointer to an initialised hcs_random type
+ * @param rop mpz_t where the encrypted result is stored
+ * @param plain1 mpz_t to be encrypted
+ */
+void oucs_encrypt(const oucs_public_key *pk, hcs_random *hr, mpz_t rop,
+        mpz_t plain1);
+
+/**
+ * Reencrypt an encrypted value @p op. Upon decryption, this newly
+ * encrypted value, @p rop, will retain the same value as @p op.
+ *
+ * @param pk A pointer to an initialised oucs_public_key
+ * @param hr A pointer to an initialised hcs_random type
+ * @param rop mpz_t where the newly encrypted value is stored
+ * @param op mpz_t to be reencrypted
+ */
+void oucs_reencrypt(const oucs_public_key *pk, hcs_random *hr, mpz_t rop,
+        mpz_t op);
+
+/**
+ * Add a plaintext value @p plain1 to an encrypted value @p cipher1, storing
+ * the result in @p rop.
+ *
+ * @param pk A pointer to an initialised oucs_public_key
+ * @param rop mpz_t where the newly encrypted value is stored
+ * @param cipher1 mpz_t to be added together
+ * @param plain1 mpz_t to be added together
+ */
+void oucs_ep_add(const oucs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t plain1);
+
+/**
+ * Add an encrypted value @p cipher2 to an encrypted value @p cipher1, storing
+ * the result in @p rop.
+ *
+ * @param pk A pointer to an initialised oucs_public_key.
+ * @param rop mpz_t where the newly encrypted value is stored
+ * @param cipher1 mpz_t to be added together
+ * @param cipher2 mpz_t to be added together
+ */
+void oucs_ee_add(const oucs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t cipher2);
+
+/**
+ * Multiply a plaintext value @p plain1 with an encrypted value @p cipher1,
+ * storing the result in @p rop.
+ *
+ * @param pk A pointer to an initialised oucs_public_key.
+ * @param rop mpz_t where the newly encrypted value is stored
+ * @param cipher1 mpz_t to be multiplied together
+ * @param plain1 mpz_t to be multiplied together
+ */
+void oucs_ep_mul(const oucs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t plain1);
+
+/**
+ * Negate an encrypted value @p cipher1, storing the result in @p rop. The
+ * result decrypts to p - a, so it is only useful as part of a sum which is
+ * non-negative.
+ *
+ * @param pk A pointer to an initialised oucs_public_key.
+ * @param rop mpz_t where the newly encrypted value is stored
+ * @param cipher1 The encrypted value which is to be negated
+ * @return non-zero on success, zero if @p cipher1 is not a valid
+ *         ciphertext, in which case @p rop is unmodified
+ */
+int oucs_e_neg(const oucs_public_key *pk, mpz_t rop, mpz_t cipher1);
+
+/**
+ * Subtract an encrypted value @p cipher2 from an encrypted value @p cipher1,
+ * storing the result in @p rop.
+ *
+ * @param pk A pointer to an initialised oucs_public_key.
+ * @param rop mpz_t where the newly encrypted value is stored
+ * @param cipher1 The encrypted value which is to be subtracted from
+ * @param cipher2 The encrypted value which is to be subtracted
+ * @return non-zero on success, zero if @p cipher2 is not a valid
+ *         ciphertext, in which case @p rop is unmodified
+ */
+int oucs_ee_sub(const oucs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t cipher2);
+
+/**
+ * Decrypt a value @p cipher1, and set @p rop to the decrypted result. @p rop
+ * and @p cipher1 can aliases for the same mpz_t.
+ *
+ * @param vk A pointer to an initialised oucs_private_key
+ * @param rop mpz_t where the decrypted result is stored
+ * @param cipher1 mpz_t to be decrypted
+ */
+void oucs_decrypt(const oucs_private_key *vk, mpz_t rop, mpz_t cipher1);
+
+/**
+ * This function zeros all data in @p pk. It is useful to use if we wish
+ * to generate or import a new value for the given oucs_public_key and want
+ * to safely ensure the old values are removed.
+ *
+ * @param pk A pointer to an initialised oucs_public_key
+ */
+void oucs_clear_public_key(oucs_public_key *pk);
+
+/**
+ * This function zeros all data in @p vk. It is useful to use if we wish
+ * to generate or import a new value for the given oucs_private_key and want
+ * to safely ensure the old values are removed.
+ *
+ * @param vk A pointer to an initialised oucs_private_key
+ */
+void oucs_clear_private_key(oucs_private_key *vk);
+
+/**
+ * Frees a oucs_public_key and all associated memory.
+ *
+ * @param pk A pointer to an initialised oucs_public_key
+ */
+void oucs_free_public_key(oucs_public_key *pk);
+
+/**
+ * Frees a oucs_private_key and all associated memory.
+ *
+ * @param vk A pointer to an initialised oucs_private_key
+ */
+void oucs_free_private_key(oucs_private_key *vk);
+
+/**
+ * Check that the n values of @p pk and @p vk match.
+ *
+ * @param pk A pointer to an initialised oucs_public_key
+ * @param vk A pointer to an initialised oucs_private_key
+ * @return non-zero if keys are valid, else zero
+ */
+int oucs_verify_key_pair(const oucs_public_key *pk, const oucs_private_key *vk);
+
+/**
+ * Export a public key as a JSON string, in the format of
+ * pcs_export_public_key. Only n and g are stored.
+ *
+ * @param pk A pointer to an initialised oucs_public_key
+ * @return A string representing the given key, else NULL on error
+ */
+char* oucs_export_public_key(const oucs_public_key *pk);
+
+/**
+ * Export a private key as a JSON string. Only p, q and g are stored.
+ *
+ * @param vk A pointer to an initialised oucs_private_key
+ * @return A string representing the given key, else NULL on error
+ */
+char* oucs_export_private_key(const oucs_private_key *vk);
+
+/**
+ * Import a public key from a string. The input string is expected to
+ * match the format given by the export functions.
+ *
+ * @param pk A pointer to an initialised oucs_public_key
+ * @param json A string storing the contents of a public key
+ * @return non-zero if success, else zero on format error
+ */
+int oucs_import_public_key(oucs_public_key *pk, const char *json);
+
+/**
+ * Import a private key from a string. The input string is expected to
+ * match the format given by the export functions.
+ *
+ * @param vk A pointer to an initialised oucs_private_key
+ * @param json A string storing the contents of a private key
+ * @return non-zero if success, else zero on format error or if g is not a
+ *         valid generator for p
+ */
+int oucs_import_private_key(oucs_private_key *vk, const char *json);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
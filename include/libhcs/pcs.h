@@ -8,6 +8,9 @@
  * E(a + b) = pcs_ee_add(E(a), E(b));
  * E(a + b) = pcs_ep_add(E(a), b);
  * E(a * b) = pcs_ep_mul(E(a), b);
+ * E(a - b) = pcs_ee_sub(E(a), E(b));
+ * E(a - b) = pcs_ep_sub(E(a), b);
+ * E(-a)    = pcs_e_neg(E(a));
  * @endcode
  *
  * All mpz_t values can be aliases unless otherwise stated.
@@ -17,6 +20,8 @@
 #define HCS_PCS_H
 
 #include <gmp.h>
+#include "hcs_crt.h"
+#include "hcs_prime_pool.h"
 #include "hcs_random.h"
 
 #ifdef __cplusplus
@@ -46,6 +51,7 @@ typedef struct {
     mpz_t mu;       /**< Precomputation: lambda^{-1} mod n */
     mpz_t n;        /**< Precomputation: p * q */
     mpz_t n2;       /**< Precomputation: n^2 */
+    hcs_crt *crt;   /**< Precomputation: CRT context for moduli p and q */
 } pcs_private_key;
 
 /**
@@ -89,6 +95,21 @@ pcs_private_key* pcs_init_private_key(void);
 void pcs_generate_key_pair(pcs_public_key *pk, pcs_private_key *vk,
                            hcs_random *hr, const unsigned long bits);
 
+/**
+ * Initialise a key pair with modulus size @p bits, as pcs_generate_key_pair,
+ * but taking the primes p and q from @p pool. If @p pool is empty, or holds
+ * primes of the wrong size, the missing primes are generated inline using
+ * @p hr instead.
+ *
+ * @param pk A pointer to an initialised pcs_public_key
+ * @param vk A pointer to an initialised pcs_private_key
+ * @param hr A pointer to an initialised hcs_random type
+ * @param pool A pointer to an initialised hcs_prime_pool
+ * @param bits The number of bits for the modulus of the key
+ */
+void pcs_generate_key_pair_pool(pcs_public_key *pk, pcs_private_key *vk,
+        hcs_random *hr, hcs_prime_pool *pool, const unsigned long bits);
+
 /**
  * Encrypt a value @p plain1, and set @p rop to the encrypted result.
  *
@@ -97,7 +118,8 @@ void pcs_generate_key_pair(pcs_public_key *pk, pcs_private_key *vk,
  * @param rop mpz_t where the encrypted result is stored
  * @param plain1 mpz_t to be encrypted
  */
-void pcs_encrypt(pcs_public_key *pk, hcs_random *hr, mpz_t rop, mpz_t plain1);
+void pcs_encrypt(const pcs_public_key *pk, hcs_random *hr, mpz_t rop,
+        mpz_t plain1);
 
 /**
  * Encrypt a value @p plain1, and set @p rop to the encrypted result. Do not
@@ -109,7 +131,7 @@ void pcs_encrypt(pcs_public_key *pk, hcs_random *hr, mpz_t rop, mpz_t plain1);
  * @param plain1 mpz_t to be encrypted
  * @param r random mpz_t value to be used during encryption
  */
-void pcs_encrypt_r(pcs_public_key *pk, mpz_t rop, mpz_t plain1, mpz_t r);
+void pcs_encrypt_r(const pcs_public_key *pk, mpz_t rop, mpz_t plain1, mpz_t r);
 
 /**
  * Reencrypt an encrypted value @p op. Upon decryption, this newly
@@ -120,7 +142,8 @@ void pcs_encrypt_r(pcs_public_key *pk, mpz_t rop, mpz_t plain1, mpz_t r);
  * @param rop mpz_t where the newly encrypted value is stored
  * @param op mpz_t to be reencrypted
  */
-void pcs_reencrypt(pcs_public_key *pk, hcs_random *hr, mpz_t rop, mpz_t op);
+void pcs_reencrypt(const pcs_public_key *pk, hcs_random *hr, mpz_t rop,
+        mpz_t op);
 
 /**
  * Add a plaintext value @p plain1 to an encrypted value @p cipher1, storing
@@ -131,7 +154,8 @@ void pcs_reencrypt(pcs_public_key *pk, hcs_random *hr, mpz_t rop, mpz_t op);
  * @param cipher1 mpz_t to be added together
  * @param plain1 mpz_t to be added together
  */
-void pcs_ep_add(pcs_public_key *pk, mpz_t rop, mpz_t cipher1, mpz_t plain1);
+void pcs_ep_add(const pcs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t plain1);
 
 /**
  * Add an encrypted value @p cipher2 to an encrypted value @p cipher1, storing
@@ -142,19 +166,100 @@ void pcs_ep_add(pcs_public_key *pk, mpz_t rop, mpz_t cipher1, mpz_t plain1);
  * @param cipher1 mpz_t to be added together
  * @param cipher2 mpz_t to be added together
  */
-void pcs_ee_add(pcs_public_key *pk, mpz_t rop, mpz_t cipher1, mpz_t cipher2);
+void pcs_ee_add(const pcs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t cipher2);
 
 /**
  * Multiply a plaintext value @p plain1 with an encrypted value @p cipher1,
  * storing the result in @p rop. All the parameters can be aliased, however,
  * usually only @p rop and @p cipher1 will be.
  *
+ * @p plain1 is reduced modulo n, and may be negative. A scalar which is
+ * negative, or larger than half of n, is applied to the inverse of
+ * @p cipher1 instead, so its cost depends on its size after reduction.
+ *
  * @param pk A pointer to an initialised pcs_public_key.
  * @param rop mpz_t where the newly encrypted value is stored
  * @param cipher1 mpz_t to be multiplied together
  * @param plain1 mpz_t to be multiplied together
+ * @return non-zero on success, zero if the scalar needs the inverse of
+ *         @p cipher1 and it is not a valid ciphertext, in which case
+ *         @p rop is unmodified
+ */
+int pcs_ep_mul(const pcs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t plain1);
+
+/**
+ * Negate an encrypted value @p cipher1, storing the result in @p rop.
+ *
+ * @param pk A pointer to an initialised pcs_public_key.
+ * @param rop mpz_t where the newly encrypted value is stored
+ * @param cipher1 The encrypted value which is to be negated
+ * @return non-zero on success, zero if @p cipher1 is not a valid
+ *         ciphertext, in which case @p rop is unmodified
+ */
+int pcs_e_neg(const pcs_public_key *pk, mpz_t rop, mpz_t cipher1);
+
+/**
+ * Subtract an encrypted value @p cipher2 from an encrypted value @p cipher1,
+ * storing the result in @p rop.
+ *
+ * @param pk A pointer to an initialised pcs_public_key.
+ * @param rop mpz_t where the newly encrypted value is stored
+ * @param cipher1 The encrypted value which is to be subtracted from
+ * @param cipher2 The encrypted value which is to be subtracted
+ * @return non-zero on success, zero if @p cipher2 is not a valid
+ *         ciphertext, in which case @p rop is unmodified
  */
-void pcs_ep_mul(pcs_public_key *pk, mpz_t rop, mpz_t cipher1, mpz_t plain1);
+int pcs_ee_sub(const pcs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t cipher2);
+
+/**
+ * Subtract a plaintext value @p plain1 from an encrypted value @p cipher1,
+ * storing the result in @p rop. As g = n + 1, g^-plain1 is formed directly
+ * without exponentiation or inversion, so this costs about as much as
+ * pcs_ee_add.
+ *
+ * @param pk A pointer to an initialised pcs_public_key.
+ * @param rop mpz_t where the newly encrypted value is stored
+ * @param cipher1 The encrypted value which is to be subtracted from
+ * @param plain1 The plaintext value which is to be subtracted
+ */
+void pcs_ep_sub(const pcs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t plain1);
+
+/**
+ * Negate each of the @p count encrypted values in @p cipher, storing the
+ * results in @p rop. Every inverse is derived from a single modular
+ * inversion. @p rop and @p cipher may be the same array.
+ *
+ * @param pk A pointer to an initialised pcs_public_key.
+ * @param rop Array of @p count mpz_t where the results are stored
+ * @param cipher Array of @p count encrypted values to negate
+ * @param count Number of values in each array
+ * @return non-zero on success, zero if some value in @p cipher is not a valid
+ *         ciphertext, in which case @p rop is unmodified
+ */
+int pcs_e_neg_batch(const pcs_public_key *pk, mpz_t *rop, mpz_t *cipher,
+        unsigned long count);
+
+/**
+ * Subtract each encrypted value in @p cipher2 from the corresponding
+ * encrypted value in @p cipher1, storing the results in @p rop. Every inverse
+ * is derived from a single modular inversion. Any of the arrays may be the
+ * same.
+ *
+ * @param pk A pointer to an initialised pcs_public_key.
+ * @param rop Array of @p count mpz_t where the results are stored
+ * @param cipher1 Array of @p count encrypted values to subtract from
+ * @param cipher2 Array of @p count encrypted values to subtract
+ * @param count Number of values in each array
+ * @return non-zero on success, zero on allocation failure or if some value
+ *         in @p cipher2 is not a valid ciphertext, in which case @p rop is
+ *         unmodified
+ */
+int pcs_ee_sub_batch(const pcs_public_key *pk, mpz_t *rop, mpz_t *cipher1,
+        mpz_t *cipher2, unsigned long count);
 
 /**
  * Decrypt a value @p cipher1, and set @p rop to the decrypted result. @p rop
@@ -164,7 +269,7 @@ void pcs_ep_mul(pcs_public_key *pk, mpz_t rop, mpz_t cipher1, mpz_t plain1);
  * @param rop mpz_t where the decrypted result is stored
  * @param cipher1 mpz_t to be decrypted
  */
-void pcs_decrypt(pcs_private_key *vk, mpz_t rop, mpz_t cipher1);
+void pcs_decrypt(const pcs_private_key *vk, mpz_t rop, mpz_t cipher1);
 
 /**
  * This function zeros all data in @p pk. It is useful to use if we wish
@@ -220,18 +325,39 @@ void pcs_free_private_key(pcs_private_key *vk);
  * @param vk A pointer to an initialised pcs_private_key
  * @return non-zero if keys are valid, else zero
  */
-int pcs_verify_key_pair(pcs_public_key *pk, pcs_private_key *vk);
+int pcs_verify_key_pair(const pcs_public_key *pk, const pcs_private_key *vk);
+
+/**
+ * Check that each of the @p count ciphertexts in @p cipher is a valid
+ * Paillier ciphertext under @p pk. A ciphertext is valid if it lies in
+ * the range 0 < c < n^2 and is prime to n. The coprimality of the whole batch
+ * is decided with a single gcd against the product of the ciphertexts, so
+ * this is much cheaper than checking each individually.
+ *
+ * @param pk A pointer to an initialised pcs_public_key
+ * @param cipher An array of @p count ciphertexts
+ * @param count The number of ciphertexts in @p cipher
+ * @param valid If not NULL, an array of @p count flags, each set to non-zero
+ *              if the corresponding ciphertext is valid, else zero
+ * @return non-zero if every ciphertext is valid, else zero
+ */
+int pcs_validate_batch(const pcs_public_key *pk, mpz_t *cipher,
+        unsigned long count, int *valid);
 
 /**
  * Export a public key as a string. We only store the minimum required values
  * to restore the key. In this case, this is only the n value.
  *
- * The format these strings export as is as a JSON object.
+ * The format these strings export as is as a JSON object. Every integer is
+ * stored as a hexadecimal string, which converts in linear time, and the
+ * object carries the version "v": 2. Objects written by earlier versions
+ * store integers in base 62 with no version, and are still accepted by every
+ * import function.
  *
  * @param pk A pointer to an initialised pcs_public_key
  * @return A string representing the given key, else NULL on error
  */
-char* pcs_export_public_key(pcs_public_key *pk);
+char* pcs_export_public_key(const pcs_public_key *pk);
 
 /**
  * Export a private key as a string. We only store the minimum required values
@@ -241,7 +367,7 @@ char* pcs_export_public_key(pcs_public_key *pk);
  * @param vk A pointer to an initialised pcs_private_key
  * @return A string representing the given key, else NULL on error
  */
-char* pcs_export_private_key(pcs_private_key *vk);
+char* pcs_export_private_key(const pcs_private_key *vk);
 
 /**
  * Import a public key from a string. The input string is expected to
@@ -0,0 +1,171 @@
+/**
+ * @file pcs_ope.h
+ *
+ * Oblivious polynomial evaluation over the Paillier scheme, and private set
+ * intersection built on it.
+ *
+ * A receiver encodes its set as the roots of polynomials whose coefficients
+ * it encrypts. Elements are hashed into buckets, with one polynomial per
+ * bucket, so the degree stays near the largest bucket load rather than the
+ * size of the set. Every polynomial is padded to the same degree so the
+ * loads are not revealed.
+ *
+ * A sender evaluates the encrypted polynomial of the matching bucket at each
+ * of its points. Enc(P(y)) is the product of c_i^(y^i) over the encrypted
+ * coefficients c_i, which is computed as a single multi-exponentiation. The
+ * powers of the coefficients of a bucket are tabulated once and shared by
+ * every point falling in that bucket, and buckets are evaluated in
+ * parallel. Each result is rerandomised by a fresh random n-th residue, so
+ * it does not carry the randomness the receiver chose for the coefficients.
+ *
+ * For set intersection the sender returns Enc(r * P(y) + y) for a random r,
+ * in a random order. This decrypts to y when y is a root, that is when y is
+ * in the receiver's set, and to a random value otherwise.
+ *
+ * @code
+ * // Receiver
+ * pcs_ope_poly *poly = pcs_ope_init_poly();
+ * pcs_ope_encrypt_set(pk, hr, poly, set, set_count, 0);
+ *
+ * // Sender
+ * pcs_psi_respond(pk, hr, poly, response, points, point_count);
+ *
+ * // Receiver
+ * pcs_psi_intersect(vk, found, &found_count, response, point_count, set,
+ *                   set_count);
+ * @endcode
+ */
+
+#ifndef HCS_PCS_OPE_H
+#define HCS_PCS_OPE_H
+
+#include <gmp.h>
+#include "hcs_random.h"
+#include "pcs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A set of encrypted polynomials of equal degree, one per bucket.
+ */
+typedef struct {
+    unsigned long buckets;  /**< Number of buckets */
+    unsigned long degree;   /**< Degree of every polynomial */
+    mpz_t *coeff;           /**< Coefficient i of bucket b is at
+                                 b * (degree + 1) + i, lowest degree first */
+} pcs_ope_poly;
+
+/**
+ * Initialise an empty pcs_ope_poly and return a pointer to it.
+ *
+ * @return A pointer to an initialised pcs_ope_poly, NULL on allocation
+ *         failure
+ */
+pcs_ope_poly* pcs_ope_init_poly(void);
+
+/**
+ * Return the bucket of @p x among @p buckets buckets. This is derived from
+ * the SHA-256 hash of the big-endian bytes of @p x, so it is the same for
+ * the sender and the receiver.
+ *
+ * @param x A non-negative value
+ * @param buckets Number of buckets
+ * @return The bucket of @p x, in [0, @p buckets)
+ */
+unsigned long pcs_ope_bucket(const mpz_t x, unsigned long buckets);
+
+/**
+ * Store in @p poly the encryption of the polynomials whose roots are the
+ * @p count values of @p set, hashed into @p buckets buckets. Any previous
+ * contents of @p poly are released.
+ *
+ * Fewer buckets give fewer coefficients to encrypt and send, but a higher
+ * degree and so more work per evaluated point. If @p buckets is zero, one
+ * bucket per four elements is used.
+ *
+ * @param pk A pointer to an initialised pcs_public_key
+ * @param hr A pointer to an initialised hcs_random type
+ * @param poly A pointer to an initialised pcs_ope_poly
+ * @param set Array of @p count distinct values in [0, n)
+ * @param count Number of values in @p set
+ * @param buckets Number of buckets, or zero for the default
+ * @return non-zero on success, zero on allocation failure
+ */
+int pcs_ope_encrypt_set(const pcs_public_key *pk, hcs_random *hr,
+        pcs_ope_poly *poly, mpz_t *set, unsigned long count,
+        unsigned long buckets);
+
+/**
+ * Evaluate the encrypted polynomial of the bucket of each of the @p count
+ * values in @p points at that value, storing Enc(P(points[j])) in rop[j].
+ * @p rop and @p points must not be the same array.
+ *
+ * @param pk A pointer to an initialised pcs_public_key
+ * @param hr A pointer to an initialised hcs_random type
+ * @param poly A pointer to an encrypted pcs_ope_poly
+ * @param rop Array of @p count mpz_t where the results are stored
+ * @param points Array of @p count values in [0, n)
+ * @param count Number of points
+ * @return non-zero on success, zero on allocation failure
+ */
+int pcs_ope_evaluate(const pcs_public_key *pk, hcs_random *hr,
+        const pcs_ope_poly *poly, mpz_t *rop, mpz_t *points,
+        unsigned long count);
+
+/**
+ * Compute the sender's response to an encrypted set. For each value y in
+ * @p points, Enc(r * P(y) + y) is stored in @p rop for a fresh random r. The
+ * order of the results is shuffled, so it reveals nothing about which point
+ * produced each. @p rop and @p points must not be the same array.
+ *
+ * @param pk A pointer to an initialised pcs_public_key
+ * @param hr A pointer to an initialised hcs_random type
+ * @param poly A pointer to the receiver's encrypted pcs_ope_poly
+ * @param rop Array of @p count mpz_t where the response is stored
+ * @param points Array of @p count values in [0, n)
+ * @param count Number of points
+ * @return non-zero on success, zero on allocation failure
+ */
+int pcs_psi_respond(const pcs_public_key *pk, hcs_random *hr,
+        const pcs_ope_poly *poly, mpz_t *rop, mpz_t *points,
+        unsigned long count);
+
+/**
+ * Decrypt a response from pcs_psi_respond, and store each decrypted value
+ * which is in @p set in @p rop.
+ *
+ * @param vk A pointer to an initialised pcs_private_key
+ * @param rop Array of at least @p count mpz_t where the intersection is
+ *        stored
+ * @param found Set to the number of values stored in @p rop
+ * @param response Array of @p count ciphertexts
+ * @param count Number of ciphertexts in @p response
+ * @param set The receiver's set
+ * @param set_count Number of values in @p set
+ * @return non-zero on success, zero on allocation failure
+ */
+int pcs_psi_intersect(const pcs_private_key *vk, mpz_t *rop,
+        unsigned long *found, mpz_t *response, unsigned long count,
+        mpz_t *set, unsigned long set_count);
+
+/**
+ * Release the coefficients held by @p poly, leaving it empty.
+ *
+ * @param poly A pointer to an initialised pcs_ope_poly
+ */
+void pcs_ope_clear_poly(pcs_ope_poly *poly);
+
+/**
+ * Frees a pcs_ope_poly and all associated memory.
+ *
+ * @param poly A pointer to an initialised pcs_ope_poly
+ */
+void pcs_ope_free_poly(pcs_ope_poly *poly);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,77 @@
+/**
+ * @file pcs_stream.h
+ *
+ * Bulk encryption and decryption of files under the Paillier scheme.
+ *
+ * Records pass through three stages running concurrently. The calling
+ * thread parses records, a pool of worker threads encrypts or decrypts
+ * them, and a writer thread outputs them in their original order. Records
+ * are processed in chunks, which are recycled once written, so memory use
+ * is fixed by the number of chunks in flight rather than the size of the
+ * input. With enough workers, throughput approaches the number of cores
+ * times the rate of a single encryption or decryption.
+ *
+ * Plaintext files hold non-negative decimal integers separated by
+ * whitespace, and are written one per line. Ciphertext files are binary:
+ * the magic number 0x48435343, followed by each ciphertext as its 32-bit
+ * big-endian byte length and its big-endian magnitude.
+ *
+ * @code
+ * pcs_encrypt_stream(pk, hr, plain_in, cipher_out, 0, 0);
+ * pcs_decrypt_stream(vk, cipher_in, plain_out, 0, 0);
+ * @endcode
+ */
+
+#ifndef HCS_PCS_STREAM_H
+#define HCS_PCS_STREAM_H
+
+#include <stdio.h>
+#include "hcs_random.h"
+#include "pcs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Encrypt every plaintext in @p in, writing the ciphertexts to @p out.
+ * Each worker draws from its own random state, seeded from @p hr.
+ *
+ * @param pk A pointer to an initialised pcs_public_key
+ * @param hr A pointer to an initialised hcs_random type
+ * @param in Stream of plaintexts
+ * @param out Stream the ciphertexts are written to
+ * @param workers Number of encryption threads, or zero for one per online
+ *        processor
+ * @param depth Number of chunks of records in flight at once, or zero for
+ *        four per worker
+ * @return non-zero on success, zero if @p in is malformed, holds a value
+ *         which is not below n, a read or write error occurred, or the
+ *         threads could not be started. Output written before a failure is
+ *         left in @p out.
+ */
+int pcs_encrypt_stream(const pcs_public_key *pk, hcs_random *hr, FILE *in,
+        FILE *out, unsigned long workers, unsigned long depth);
+
+/**
+ * Decrypt every ciphertext in @p in, writing the plaintexts to @p out.
+ *
+ * @param vk A pointer to an initialised pcs_private_key
+ * @param in Stream of ciphertexts, as written by pcs_encrypt_stream
+ * @param out Stream the plaintexts are written to
+ * @param workers Number of decryption threads, or zero for one per online
+ *        processor
+ * @param depth Number of chunks of records in flight at once, or zero for
+ *        four per worker
+ * @return non-zero on success, zero if @p in is malformed or truncated, a
+ *         read or write error occurred, or the threads could not be
+ *         started. Output written before a failure is left in @p out.
+ */
+int pcs_decrypt_stream(const pcs_private_key *vk, FILE *in, FILE *out,
+        unsigned long workers, unsigned long depth);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -19,6 +19,7 @@
 #define HCS_PCS_T_H
 
 #include <gmp.h>
+#include "hcs_prime_pool.h"
 #include "hcs_random.h"
 #include "hcs_shares.h"
 
@@ -56,6 +57,11 @@ typedef struct {
     mpz_t si;           /**< The polynomial evaluation at @p i */
 } pcs_t_auth_server;
 
+/**
+ * Combines decryption shares incrementally as they arrive.
+ */
+typedef struct hcs_combiner pcs_t_combiner;
+
 /**
  * Public key for use in the Threshold Paillier system. This key is the main
  * key used, even during decryption we use this key AS WELL as using the
@@ -122,7 +128,7 @@ pcs_t_private_key* pcs_t_init_private_key(void);
  * function in this manner, ensure pcs_t_clear_public_key and/or
  * pcs_t_clear_private_key are called prior.
  *
- * \pre 0 < @p l <= @p w
+ * \pre 0 < @p w <= @p l
  *
  * @code
  * pcs_t_public_key *pk = pcs_t_init_public_key();
@@ -135,13 +141,32 @@ pcs_t_private_key* pcs_t_init_private_key(void);
  * @param vk A pointer to an initialised pcs_t_private_key
  * @param hr A pointer to an initialised hcs_random type
  * @param bits The number of bits for the modulus of the key
- * @param l The number of servers required to succesfully decrypt
- * @param w The number of servers in total
+ * @param w The number of servers required to succesfully decrypt
+ * @param l The number of servers in total
  * @return non-zero on success, zero on allocation failure
  */
 int pcs_t_generate_key_pair(pcs_t_public_key *pk, pcs_t_private_key *vk,
-        hcs_random *hr, const unsigned long bits, const unsigned long l,
-        const unsigned long w);
+        hcs_random *hr, const unsigned long bits, const unsigned long w,
+        const unsigned long l);
+
+/**
+ * Initialise a key pair with modulus size @p bits, as pcs_t_generate_key_pair,
+ * but taking the safe primes from @p pool. If @p pool is empty, does not hold
+ * safe primes, or holds primes of the wrong size, the missing primes are
+ * generated inline using @p hr instead.
+ *
+ * @param pk A pointer to an initialised pcs_t_public_key
+ * @param vk A pointer to an initialised pcs_t_private_key
+ * @param hr A pointer to an initialised hcs_random type
+ * @param pool A pointer to an initialised hcs_prime_pool
+ * @param bits The number of bits for the modulus of the key
+ * @param w The number of servers required to succesfully decrypt
+ * @param l The number of servers in total
+ * @return non-zero on success, zero on allocation failure
+ */
+int pcs_t_generate_key_pair_pool(pcs_t_public_key *pk, pcs_t_private_key *vk,
+        hcs_random *hr, hcs_prime_pool *pool, const unsigned long bits,
+        const unsigned long w, const unsigned long l);
 
 /**
  * Encrypt a value @p plain1, and set @p rop to the encryted result. This
@@ -155,7 +180,8 @@ int pcs_t_generate_key_pair(pcs_t_public_key *pk, pcs_t_private_key *vk,
  * @param rop mpz_t where the encrypted result is stored
  * @param plain1 mpz_t to be encrypted
  */
-void pcs_t_encrypt_r(pcs_t_public_key *pk, mpz_t rop, mpz_t r, mpz_t plain1);
+void pcs_t_encrypt_r(const pcs_t_public_key *pk, mpz_t rop, mpz_t r,
+        mpz_t plain1);
 
 /**
  * Encrypt a value @p plain1, and set @p rop to the encrypted result. This only
@@ -168,7 +194,7 @@ void pcs_t_encrypt_r(pcs_t_public_key *pk, mpz_t rop, mpz_t r, mpz_t plain1);
  * @param rop mpz_t where the encrypted result is stored
  * @param plain1 mpz_t to be encrypted
  */
-void pcs_t_r_encrypt(pcs_t_public_key *pk, hcs_random *hr,
+void pcs_t_r_encrypt(const pcs_t_public_key *pk, hcs_random *hr,
         mpz_t r, mpz_t rop, mpz_t plain1);
 
 /**
@@ -179,7 +205,8 @@ void pcs_t_r_encrypt(pcs_t_public_key *pk, hcs_random *hr,
  * @param rop mpz_t where the encrypted result is stored
  * @param plain1 mpz_t to be encrypted
  */
-void pcs_t_encrypt(pcs_t_public_key *pk, hcs_random *hr, mpz_t rop, mpz_t plain1);
+void pcs_t_encrypt(const pcs_t_public_key *pk, hcs_random *hr, mpz_t rop,
+        mpz_t plain1);
 
 /**
  * Reencrypt an encrypted value @p cipher1. Upon decryption, this newly
@@ -190,7 +217,8 @@ void pcs_t_encrypt(pcs_t_public_key *pk, hcs_random *hr, mpz_t rop, mpz_t plain1
  * @param rop mpz_t where the newly encrypted value is stored
  * @param op mpz_t to be reencrypted
  */
-void pcs_t_reencrypt(pcs_t_public_key *pk, hcs_random *hr, mpz_t rop, mpz_t op);
+void pcs_t_reencrypt(const pcs_t_public_key *pk, hcs_random *hr, mpz_t rop,
+        mpz_t op);
 
 /**
  * Add a plaintext value @p plain1 to an encrypted value @p cipher1, storing
@@ -201,7 +229,8 @@ void pcs_t_reencrypt(pcs_t_public_key *pk, hcs_random *hr, mpz_t rop, mpz_t op);
  * @param cipher1 mpz_t to be added together
  * @param plain1 mpz_t to be added together
  */
-void pcs_t_ep_add(pcs_t_public_key *pk, mpz_t rop, mpz_t cipher1, mpz_t plain1);
+void pcs_t_ep_add(const pcs_t_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t plain1);
 
 /**
  * Add an encrypted value @p cipher2 to an encrypted value @p cipher1, storing
@@ -212,18 +241,99 @@ void pcs_t_ep_add(pcs_t_public_key *pk, mpz_t rop, mpz_t cipher1, mpz_t plain1);
  * @param cipher1 mpz_t to be added together
  * @param cipher2 mpz_t to be added together
  */
-void pcs_t_ee_add(pcs_t_public_key *pk, mpz_t rop, mpz_t cipher1, mpz_t cipher2);
+void pcs_t_ee_add(const pcs_t_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t cipher2);
 
 /**
  * Multiply a plaintext value @p plain1 with an encrypted value @p cipher1,
  * storing the result in @p rop.
  *
+ * @p plain1 is reduced modulo n, and may be negative. A scalar which is
+ * negative, or larger than half of n, is applied to the inverse of
+ * @p cipher1 instead, so its cost depends on its size after reduction.
+ *
  * @param pk A pointer to an initialised pcs_t_public_key
  * @param rop Where the new encrypted result is stored
  * @param cipher1 The encrypted value which is to be multipled to
  * @param plain1 The plaintext value which is to be multipled
+ * @return non-zero on success, zero if the scalar needs the inverse of
+ *         @p cipher1 and it is not a valid ciphertext, in which case
+ *         @p rop is unmodified
+ */
+int pcs_t_ep_mul(const pcs_t_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t plain1);
+
+/**
+ * Negate an encrypted value @p cipher1, storing the result in @p rop.
+ *
+ * @param pk A pointer to an initialised pcs_t_public_key
+ * @param rop Where the new encrypted result is stored
+ * @param cipher1 The encrypted value which is to be negated
+ * @return non-zero on success, zero if @p cipher1 is not a valid
+ *         ciphertext, in which case @p rop is unmodified
+ */
+int pcs_t_e_neg(const pcs_t_public_key *pk, mpz_t rop, mpz_t cipher1);
+
+/**
+ * Subtract an encrypted value @p cipher2 from an encrypted value @p cipher1,
+ * storing the result in @p rop.
+ *
+ * @param pk A pointer to an initialised pcs_t_public_key
+ * @param rop Where the new encrypted result is stored
+ * @param cipher1 The encrypted value which is to be subtracted from
+ * @param cipher2 The encrypted value which is to be subtracted
+ * @return non-zero on success, zero if @p cipher2 is not a valid
+ *         ciphertext, in which case @p rop is unmodified
+ */
+int pcs_t_ee_sub(const pcs_t_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t cipher2);
+
+/**
+ * Subtract a plaintext value @p plain1 from an encrypted value @p cipher1,
+ * storing the result in @p rop. As g = n + 1, g^-plain1 is formed directly
+ * without exponentiation or inversion, so this costs about as much as
+ * pcs_t_ee_add.
+ *
+ * @param pk A pointer to an initialised pcs_t_public_key
+ * @param rop Where the new encrypted result is stored
+ * @param cipher1 The encrypted value which is to be subtracted from
+ * @param plain1 The plaintext value which is to be subtracted
+ */
+void pcs_t_ep_sub(const pcs_t_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t plain1);
+
+/**
+ * Negate each of the @p count encrypted values in @p cipher, storing the
+ * results in @p rop. Every inverse is derived from a single modular
+ * inversion. @p rop and @p cipher may be the same array.
+ *
+ * @param pk A pointer to an initialised pcs_t_public_key
+ * @param rop Array of @p count mpz_t where the results are stored
+ * @param cipher Array of @p count encrypted values to negate
+ * @param count Number of values in each array
+ * @return non-zero on success, zero if some value in @p cipher is not a valid
+ *         ciphertext, in which case @p rop is unmodified
+ */
+int pcs_t_e_neg_batch(const pcs_t_public_key *pk, mpz_t *rop, mpz_t *cipher,
+        unsigned long count);
+
+/**
+ * Subtract each encrypted value in @p cipher2 from the corresponding
+ * encrypted value in @p cipher1, storing the results in @p rop. Every inverse
+ * is derived from a single modular inversion. Any of the arrays may be the
+ * same.
+ *
+ * @param pk A pointer to an initialised pcs_t_public_key
+ * @param rop Array of @p count mpz_t where the results are stored
+ * @param cipher1 Array of @p count encrypted values to subtract from
+ * @param cipher2 Array of @p count encrypted values to subtract
+ * @param count Number of values in each array
+ * @return non-zero on success, zero on allocation failure or if some value
+ *         in @p cipher2 is not a valid ciphertext, in which case @p rop is
+ *         unmodified
  */
-void pcs_t_ep_mul(pcs_t_public_key *pk, mpz_t rop, mpz_t cipher1, mpz_t plain1);
+int pcs_t_ee_sub_batch(const pcs_t_public_key *pk, mpz_t *rop, mpz_t *cipher1,
+        mpz_t *cipher2, unsigned long count);
 
 /**
  * Allocate and initialise the values in a pcs_t_proof object. This is used
@@ -261,10 +371,26 @@ void pcs_t_set_proof(pcs_t_proof *pf, mpz_t generator, unsigned long m1,
  * @param nth_power The power that this encrypted value represents
  * @param id User id in the system. This can be discarded by using the value 0
  */
-void pcs_t_compute_1of2_ns_protocol(pcs_t_public_key *pk, hcs_random *hr,
+void pcs_t_compute_1of2_ns_protocol(const pcs_t_public_key *pk, hcs_random *hr,
         pcs_t_proof *pf, mpz_t cipher_m, mpz_t cipher_r, unsigned long nth_power,
         unsigned long id);
 
+/**
+ * Compute a proof that @p cipher is an encryption of zero, that is, an n'th
+ * power. @p cipher_r is the random value used to encrypt @p cipher. The
+ * challenge is derived from a hash of the modulus, @p cipher, the first
+ * message and @p id.
+ *
+ * @param pk A pointer to an initialised pcs_t_public_key
+ * @param hr A pointer to an initialised hcs_random object
+ * @param pf A pointer to an initialised pcs_t_proof object
+ * @param cipher The encrypted value
+ * @param cipher_r The random r value used for this cipher text
+ * @param id User id in the system. This can be discarded by using the value 0
+ */
+void pcs_t_compute_ns_protocol(const pcs_t_public_key *pk, hcs_random *hr,
+        pcs_t_proof *pf, mpz_t cipher, mpz_t cipher_r, unsigned long id);
+
 /**
  * Verify a proof and return whether it is an n'th power.
  *
@@ -273,7 +399,7 @@ void pcs_t_compute_1of2_ns_protocol(pcs_t_public_key *pk, hcs_random *hr,
  * @param id User id in the system.
  * @return 0 if not an n'th power, non-zero if it is an n'th power
  */
-int pcs_t_verify_ns_protocol(pcs_t_public_key *pk, pcs_t_proof *pf,
+int pcs_t_verify_ns_protocol(const pcs_t_public_key *pk, pcs_t_proof *pf,
         unsigned long id);
 
 /**
@@ -284,7 +410,7 @@ int pcs_t_verify_ns_protocol(pcs_t_public_key *pk, pcs_t_proof *pf,
  * @param cipher Encrypted value that this proof is meant to verify
  * @param id of the owner of this cipher text
  */
-int pcs_t_verify_1of2_ns_protocol(pcs_t_public_key *pk, pcs_t_proof *pf,
+int pcs_t_verify_1of2_ns_protocol(const pcs_t_public_key *pk, pcs_t_proof *pf,
         mpz_t cipher, unsigned long id);
 
 /**
@@ -326,7 +452,7 @@ pcs_t_polynomial* pcs_t_init_polynomial(pcs_t_private_key *vk, hcs_random *hr);
  * @param rop mpz_t where the result is stored
  * @param x The value to calculate the polynomial at
  */
-void pcs_t_compute_polynomial(pcs_t_private_key *vk, pcs_t_polynomial *px,
+void pcs_t_compute_polynomial(const pcs_t_private_key *vk, pcs_t_polynomial *px,
                               mpz_t rop, const unsigned long x);
 
 /**
@@ -370,28 +496,102 @@ void pcs_t_set_auth_server(pcs_t_auth_server *au, mpz_t si, unsigned long i);
  * @param rop mpz_t where the calculated share is stored
  * @param cipher1 mpz_t which stores the ciphertext to decrypt
  */
-void pcs_t_share_decrypt(pcs_t_public_key *vk, pcs_t_auth_server *au,
+void pcs_t_share_decrypt(const pcs_t_public_key *vk, pcs_t_auth_server *au,
                          mpz_t rop, mpz_t cipher1);
 
 /**
- * Combine an array of shares @p c, storing the result in @p rop.
- *
- * The array @p c must be managed by the caller, and is expected to be at least
- * of length vk->l. If it is greater, only the first vk->l values are scanned.
- * If a share is not present, then the value is expected to be 0. If reusing the
- * same array for a number of decryptions, ensure that the array is zeroed
- * between each combination.
+ * Combine the shares in @p hs, storing the result in @p rop.
  *
- * \todo Potentially construct a proper type for storing a list of shares to
- *       ensure these functions are called in the correct way.
+ * Only the shares of the first vk->l servers whose flag is set in @p hs are
+ * used, and at least vk->w of them must be set. The Lagrange coefficients are
+ * computed over exactly the flagged servers, so any subset of sufficient size
+ * may be chosen by setting and clearing flags.
  *
- * \pre vk->l <= length(c)
- *
- * @param vk A pointer to an initialised pcs_t_private_key
+ * @param vk A pointer to an initialised pcs_t_public_key
  * @param rop mpz_t where the combined decrypted result is stored
  * @param hs A pointer to an initialised hcs_shares
+ * @return non-zero on success, zero on allocation failure, if fewer than
+ *         vk->w shares are flagged, or if a share is invalid
+ */
+int pcs_t_share_combine(const pcs_t_public_key *vk, mpz_t rop, hcs_shares *hs);
+
+/**
+ * Combine the shares of every ciphertext in @p hs, storing the result for
+ * ciphertext r in rop[r]. The same flagged servers are used for every
+ * ciphertext, so the Lagrange coefficients are computed once, and
+ * ciphertexts are combined in parallel.
+ *
+ * @param pk A pointer to an initialised pcs_t_public_key
+ * @param rop Array of hs->count mpz_t where the results are stored
+ * @param hs A pointer to an hcs_shares of at least pk->l servers, from
+ *        hcs_init_shares_batch
+ * @return non-zero on success, zero on allocation failure, if fewer than
+ *         pk->w shares are flagged, or if a share is invalid
+ */
+int pcs_t_share_combine_batch(const pcs_t_public_key *pk, mpz_t *rop,
+        hcs_shares *hs);
+
+/**
+ * Initialise a combiner which folds decryption shares into the result as
+ * they arrive, rather than waiting for all of them as pcs_t_share_combine
+ * does. Each share of a fixed quorum is raised to its Lagrange-weighted
+ * power as soon as it is added, so only the final discrete logarithm
+ * remains once the last share arrives.
+ *
+ * If @p quorum is NULL, the first pk->w distinct shares to arrive form the
+ * quorum. Their weights are only known once the last of them arrives, at
+ * which point they are all raised to their powers in parallel.
+ *
+ * A combiner may be shared between threads receiving shares concurrently.
+ *
+ * @param pk A pointer to an initialised pcs_t_public_key
+ * @param quorum Array of pk->w distinct zero-indexed servers whose shares
+ *        will be used, or NULL to use the first to arrive
+ * @return A pointer to an initialised pcs_t_combiner, NULL on allocation
+ *         failure or if @p quorum is invalid
+ */
+pcs_t_combiner* pcs_t_init_combiner(const pcs_t_public_key *pk,
+        const unsigned long *quorum);
+
+/**
+ * Add the decryption share @p share of the zero-indexed server @p i. Shares
+ * from servers outside a fixed quorum, or which repeat a server, are
+ * ignored.
+ *
+ * @param cb A pointer to an initialised pcs_t_combiner
+ * @param i The index of the server which computed @p share
+ * @param share The share computed with pcs_t_share_decrypt
+ * @return non-zero if the quorum is complete
+ */
+int pcs_t_combiner_add(pcs_t_combiner *cb, unsigned long i, mpz_t share);
+
+/**
+ * Compute the decrypted value from a complete quorum, storing it in @p rop.
+ *
+ * @param pk A pointer to the pcs_t_public_key @p cb was initialised with
+ * @param cb A pointer to an initialised pcs_t_combiner
+ * @param rop mpz_t where the decrypted result is stored
+ * @return non-zero on success, zero if the quorum is incomplete or a share
+ *         is invalid
+ */
+int pcs_t_combiner_result(const pcs_t_public_key *pk, pcs_t_combiner *cb,
+        mpz_t rop);
+
+/**
+ * Discard all shares held by @p cb so it can be reused for another
+ * ciphertext. A fixed quorum is kept. Shares for the previous ciphertext
+ * still being added by other threads are discarded.
+ *
+ * @param cb A pointer to an initialised pcs_t_combiner
+ */
+void pcs_t_combiner_reset(pcs_t_combiner *cb);
+
+/**
+ * Frees a pcs_t_combiner and all associated memory.
+ *
+ * @param cb A pointer to an initialised pcs_t_combiner
  */
-int pcs_t_share_combine(pcs_t_public_key *vk, mpz_t rop, hcs_shares *hs);
+void pcs_t_free_combiner(pcs_t_combiner *cb);
 
 /**
  * Frees a pcs_t_auth_server and all associated memory.
@@ -444,12 +644,13 @@ void pcs_t_free_private_key(pcs_t_private_key *vk);
  * @param vk A pointer to an initialised pcs_t_private_key
  * @return non-zero if keys match, zero if they do not
  */
-int pcs_t_verify_key_pair(pcs_t_public_key *pk, pcs_t_private_key *vk);
+int pcs_t_verify_key_pair(const pcs_t_public_key *pk,
+        const pcs_t_private_key *vk);
 
 /**
  * Import a public key from a json string. The format of the json string must
- * match those of the export functions, and is described more in-depth at
- * @(refer to description of serialization).
+ * match those of the export functions. Integers are encoded as described for
+ * pcs_export_public_key, so both the current and the older format are read.
  *
  * @param pk A pointer to an initialised pcs_t_public_key
  * @param json A null-terminated json string containing public key data
@@ -464,7 +665,7 @@ int pcs_t_import_public_key(pcs_t_public_key *pk, const char *json);
  * @param pk A pointer to an initialised pcs_t_public_key
  * @return A null-terminated json string
  */
-char *pcs_t_export_public_key(pcs_t_public_key *pk);
+char *pcs_t_export_public_key(const pcs_t_public_key *pk);
 
 /**
  * Export an auth server as a json string. This function allocates memory and
@@ -518,7 +719,7 @@ int pcs_t_import_proof(pcs_t_proof *pf, const char *json);
  * @return json A null-terminated json string containing all server
  *              verification data. NULL is returned on case of parse error.
  */
-char *pcs_t_export_verify_values(pcs_t_private_key *vk);
+char *pcs_t_export_verify_values(const pcs_t_private_key *vk);
 
 /**
  * Import an array of verification values stored in a json string. The format
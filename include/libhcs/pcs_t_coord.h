@@ -0,0 +1,133 @@
+/**
+ * @file pcs_t_coord.h
+ *
+ * Threshold decryption for the Threshold Paillier scheme, split between a
+ * coordinator and a number of authority servers connected by hcs_transport
+ * streams.
+ *
+ * Each authority server holds one pcs_t_auth_server and answers requests
+ * with pcs_t_serve. The coordinator splits the ciphertexts it is asked to
+ * decrypt into batches and sends every batch to every server in a single
+ * message. Several batches are kept in flight at once, so servers always
+ * have queued work and the cost of a round trip is paid once per window of
+ * batches rather than once per ciphertext. A thread per server receives its
+ * replies, and shares are folded into a combiner for each ciphertext as they
+ * arrive. A batch completes as soon as any w servers have answered it, so a
+ * slow server does not delay the results of a batch while w others remain.
+ * Its slot is reused only once every live server has answered, though, and
+ * requests are written to each server in turn, so a server which stays
+ * connected but stops answering stalls decryption after window batches. A
+ * server whose stream fails is dropped; one which hangs must be dropped by
+ * the caller, with hcs_transport_shutdown on its transport.
+ *
+ * All messages are sequences of 32-bit big-endian integers and values. A
+ * value is its length in bytes followed by its big-endian magnitude.
+ * - On connecting, a server sends the magic number 0x48435431 and its
+ *   zero-based index.
+ * - A request is a batch id, a count and that many ciphertexts.
+ * - A response is the batch id, the count and the share of each ciphertext,
+ *   in the same order.
+ *
+ * @code
+ * // Each authority server
+ * hcs_transport *t = hcs_accept_unix(listen_fd);
+ * pcs_t_serve(pk, au, t);
+ *
+ * // Coordinator
+ * pcs_t_coordinator *co = pcs_t_init_coordinator(pk, servers, l, 0, 0);
+ * pcs_t_coordinator_decrypt(co, plain, cipher, count);
+ * pcs_t_free_coordinator(co);
+ * @endcode
+ */
+
+#ifndef HCS_PCS_T_COORD_H
+#define HCS_PCS_T_COORD_H
+
+#include <gmp.h>
+#include "hcs_transport.h"
+#include "pcs_t.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Opaque threshold decryption coordinator.
+ */
+typedef struct pcs_t_coordinator pcs_t_coordinator;
+
+/**
+ * Answer decryption requests arriving on @p t with the shares of @p au,
+ * until the coordinator closes the stream. Each batch is decrypted in
+ * parallel.
+ *
+ * @param pk A pointer to an initialised pcs_t_public_key
+ * @param au A pointer to an initialised pcs_t_auth_server
+ * @param t A transport connected to a coordinator
+ * @return non-zero if the stream ended between requests, zero on a stream
+ *         error, a malformed request or allocation failure
+ */
+int pcs_t_serve(const pcs_t_public_key *pk, pcs_t_auth_server *au,
+        hcs_transport *t);
+
+/**
+ * Initialise a coordinator for the @p count servers connected through
+ * @p servers. The greeting of every server is read before this returns, so
+ * the servers must already be running.
+ *
+ * @param pk A pointer to an initialised pcs_t_public_key, which must outlive
+ *        the coordinator
+ * @param servers Array of @p count transports, one per server, which must
+ *        outlive the coordinator
+ * @param count Number of servers, at least pk->w
+ * @param batch Maximum number of ciphertexts per message, at most 65536, or
+ *        zero for 256
+ * @param window Maximum number of batches in flight, or zero for 4
+ * @return A pointer to an initialised pcs_t_coordinator, NULL on allocation
+ *         failure, if too few servers were given, if @p batch is larger
+ *         than servers accept, or if a server sent a malformed greeting or
+ *         a duplicate index
+ */
+pcs_t_coordinator* pcs_t_init_coordinator(const pcs_t_public_key *pk,
+        hcs_transport **servers, unsigned long count, unsigned long batch,
+        unsigned long window);
+
+/**
+ * Decrypt the @p count ciphertexts in @p cipher, storing the plaintexts in
+ * @p rop. This must not be called from several threads at once.
+ *
+ * Servers whose stream fails are dropped. Decryption fails only if fewer
+ * than pk->w servers remain, or a server sends an invalid share, after which
+ * the coordinator must be freed.
+ *
+ * @param co A pointer to an initialised pcs_t_coordinator
+ * @param rop Array of @p count mpz_t where the plaintexts are stored
+ * @param cipher Array of @p count ciphertexts
+ * @param count Number of ciphertexts
+ * @return non-zero on success, zero on failure
+ */
+int pcs_t_coordinator_decrypt(pcs_t_coordinator *co, mpz_t *rop,
+        mpz_t *cipher, unsigned long count);
+
+/**
+ * Return the number of servers still answering requests.
+ *
+ * @param co A pointer to an initialised pcs_t_coordinator
+ * @return Number of live servers
+ */
+unsigned long pcs_t_coordinator_live(pcs_t_coordinator *co);
+
+/**
+ * Shut down the streams to every server and free a pcs_t_coordinator and
+ * all associated memory. The transports themselves are not freed. Each
+ * server's pcs_t_serve returns once it has seen the end of its stream.
+ *
+ * @param co A pointer to an initialised pcs_t_coordinator
+ */
+void pcs_t_free_coordinator(pcs_t_coordinator *co);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
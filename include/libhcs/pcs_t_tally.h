@@ -0,0 +1,135 @@
+/**
+ * @file pcs_t_tally.h
+ *
+ * A pipelined election tally for the Threshold Paillier scheme.
+ *
+ * Ballots are read from a stream and pass through three stages connected by
+ * bounded queues. The calling thread parses ballots, a pool of worker
+ * threads verifies the proof attached to each one, and a single accumulator
+ * thread adds every valid ballot into the total of its race. The stages run
+ * concurrently, so the wall-clock time approaches that of the slowest stage,
+ * which is usually verification. Ballots are held in a fixed set of slots
+ * which are recycled once accumulated, so memory use does not grow with the
+ * number of ballots.
+ *
+ * Once the stream is exhausted, a share-decryption request is issued for
+ * each race through a callback, carrying the encrypted total. The caller
+ * forwards these to the decryption servers and combines the shares with
+ * pcs_t_share_combine as usual.
+ *
+ * Each ballot is a ciphertext of either generator^0 or generator^1, with a
+ * proof from pcs_t_compute_1of2_ns_protocol bound to the voter id. In the
+ * stream, a ballot is one line of whitespace-separated fields: the race, the
+ * voter id, the ciphertext and the six proof values e[0], e[1], a[0], a[1],
+ * z[0] and z[1]. Numbers are written in base 62. pcs_t_tally_write_ballot
+ * produces this format. A socket can be read by wrapping it with fdopen.
+ *
+ * @code
+ * pcs_t_tally *tally = pcs_t_init_tally(pk, generator, races, 0, 0);
+ * pcs_t_tally_run(tally, stdin, send_to_servers, servers);
+ * pcs_t_free_tally(tally);
+ * @endcode
+ */
+
+#ifndef HCS_PCS_T_TALLY_H
+#define HCS_PCS_T_TALLY_H
+
+#include <stdio.h>
+#include <gmp.h>
+#include "pcs_t.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Opaque tally engine.
+ */
+typedef struct pcs_t_tally pcs_t_tally;
+
+/**
+ * Called once per race when a tally completes. @p cipher is the encrypted
+ * sum of the @p count valid ballots cast in @p race, and remains valid only
+ * for the duration of the call.
+ */
+typedef void (*pcs_t_tally_request)(void *arg, unsigned long race,
+        mpz_t cipher, unsigned long count);
+
+/**
+ * Initialise a tally engine for @p races races under the key @p pk.
+ *
+ * @param pk A pointer to an initialised pcs_t_public_key, which must outlive
+ *        the tally
+ * @param generator The generator ballots are proven against, as set with
+ *        pcs_t_set_proof
+ * @param races Number of races. Races are numbered from zero.
+ * @param workers Number of verification threads, or zero for one per
+ *        online processor
+ * @param depth Number of ballots in flight at once, or zero for four per
+ *        worker
+ * @return A pointer to an initialised pcs_t_tally, NULL on allocation
+ *         failure
+ */
+pcs_t_tally* pcs_t_init_tally(const pcs_t_public_key *pk, mpz_t generator,
+        unsigned long races, unsigned long workers, unsigned long depth);
+
+/**
+ * Tally every ballot in @p in, then call @p request for each race in order.
+ * Ballots with an invalid proof, an unknown race or a voter id already
+ * counted in that race are counted as rejected and otherwise ignored. Totals
+ * from a previous run are discarded.
+ *
+ * @param tally A pointer to an initialised pcs_t_tally
+ * @param in Stream of ballots
+ * @param request Callback receiving the total of each race
+ * @param arg Passed unchanged to @p request
+ * @return non-zero on success, zero if @p in is malformed, a read error
+ *         occurred, the threads could not be started or memory could not
+ *         be allocated, in which case @p request is not called
+ */
+int pcs_t_tally_run(pcs_t_tally *tally, FILE *in, pcs_t_tally_request request,
+        void *arg);
+
+/**
+ * Return the number of valid ballots counted in @p race by the last run.
+ *
+ * @param tally A pointer to an initialised pcs_t_tally
+ * @param race The race to query
+ * @return Number of valid ballots in @p race
+ */
+unsigned long pcs_t_tally_accepted(const pcs_t_tally *tally,
+        unsigned long race);
+
+/**
+ * Return the number of ballots rejected by the last run.
+ *
+ * @param tally A pointer to an initialised pcs_t_tally
+ * @return Number of rejected ballots
+ */
+unsigned long pcs_t_tally_rejected(const pcs_t_tally *tally);
+
+/**
+ * Write a ballot to @p out in the format read by pcs_t_tally_run.
+ *
+ * @param out Stream to write to
+ * @param race The race the ballot is cast in
+ * @param id The voter id the proof was computed with
+ * @param cipher The encrypted vote
+ * @param pf The proof computed for @p cipher
+ * @return non-zero on success, zero on a write error
+ */
+int pcs_t_tally_write_ballot(FILE *out, unsigned long race, unsigned long id,
+        mpz_t cipher, pcs_t_proof *pf);
+
+/**
+ * Frees a pcs_t_tally and all associated memory.
+ *
+ * @param tally A pointer to an initialised pcs_t_tally
+ */
+void pcs_t_free_tally(pcs_t_tally *tally);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,338 @@
+/*
+ * @file combiner.c
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <gmp.h>
+#include "../../include/libhcs/hcs_shares.h"
+#include "combiner.h"
+#include "util.h"
+
+static void set_coefficients(hcs_combiner *cb)
+{
+    /* Servers are zero-indexed, but evaluated at their index plus one */
+    for (unsigned long k = 0; k < cb->w; ++k)
+        cb->x[k] = cb->quorum[k] + 1;
+
+    for (unsigned long k = 0; k < cb->w; ++k) {
+        mpz_lagrange_coeff(cb->coeff[k], cb->delta, cb->x, cb->w, k);
+        mpz_mul_2exp(cb->coeff[k], cb->coeff[k], 1);
+    }
+}
+
+/* Fold share^|coeff| into the product matching the sign of coeff. Must be
+ * called with the lock held. */
+static void fold(hcs_combiner *cb, const mpz_t power, const mpz_t coeff)
+{
+    mpz_ptr product = mpz_sgn(coeff) < 0 ? cb->neg : cb->pos;
+    mpz_mul(product, product, power);
+    mpz_mod(product, product, cb->mod);
+}
+
+hcs_combiner* hcs_init_combiner(const mpz_t mod, const mpz_t delta,
+        unsigned long l, unsigned long w, const unsigned long *quorum)
+{
+    if (w == 0 || w > l)
+        return NULL;
+
+    hcs_combiner *cb = malloc(sizeof(hcs_combiner));
+    if (cb == NULL)
+        return NULL;
+
+    cb->quorum = malloc(sizeof(unsigned long) * w);
+    cb->x = malloc(sizeof(unsigned long) * w);
+    cb->slot = malloc(sizeof(long) * l);
+    cb->coeff = malloc(sizeof(mpz_t) * w);
+    cb->held = malloc(sizeof(mpz_t) * l);
+    cb->arrived = calloc(l, sizeof(int));
+    if (!cb->quorum || !cb->x || !cb->slot || !cb->coeff || !cb->held ||
+            !cb->arrived)
+        goto failure;
+
+    for (unsigned long i = 0; i < l; ++i)
+        cb->slot[i] = -1;
+
+    if (quorum) {
+        for (unsigned long k = 0; k < w; ++k) {
+            if (quorum[k] >= l || cb->slot[quorum[k]] != -1)
+                goto failure;
+            cb->slot[quorum[k]] = k;
+            cb->quorum[k] = quorum[k];
+        }
+    }
+
+    if (pthread_mutex_init(&cb->lock, NULL))
+        goto failure;
+    if (pthread_cond_init(&cb->idle, NULL)) {
+        pthread_mutex_destroy(&cb->lock);
+    pthread_cond_destroy(&cb->idle);
+        goto failure;
+    }
+
+    mpz_init_set(cb->mod, mod);
+    mpz_init_set(cb->delta, delta);
+    mpz_init_set_ui(cb->pos, 1);
+    mpz_init_set_ui(cb->neg, 1);
+    for (unsigned long k = 0; k < w; ++k)
+        mpz_init(cb->coeff[k]);
+    for (unsigned long i = 0; i < l; ++i)
+        mpz_init(cb->held[i]);
+
+    cb->l = l;
+    cb->w = w;
+    cb->adaptive = quorum == NULL;
+    cb->members = quorum ? w : 0;
+    cb->folded = 0;
+    cb->generation = 0;
+    cb->busy = 0;
+
+    if (!cb->adaptive)
+        set_coefficients(cb);
+
+    return cb;
+
+failure:
+    free(cb->quorum);
+    free(cb->x);
+    free(cb->slot);
+    free(cb->coeff);
+    free(cb->held);
+    free(cb->arrived);
+    free(cb);
+    return NULL;
+}
+
+static int add_fixed(hcs_combiner *cb, unsigned long i, const mpz_t share)
+{
+    int complete;
+    const long k = cb->slot[i];
+    const unsigned long generation = cb->generation;
+    mpz_t t;
+
+    cb->arrived[i] = 1;
+    pthread_mutex_unlock(&cb->lock);
+
+    mpz_init(t);
+    mpz_abs(t, cb->coeff[k]);
+    mpz_powm(t, share, t, cb->mod);
+
+    /* A reset while the share was raised means it belongs to the previous
+     * ciphertext, so it must not be folded into the new product */
+    pthread_mutex_lock(&cb->lock);
+    if (cb->generation == generation) {
+        fold(cb, t, cb->coeff[k]);
+        ++cb->folded;
+    }
+    complete = cb->folded == cb->w;
+    pthread_mutex_unlock(&cb->lock);
+
+    mpz_clear(t);
+    return complete;
+}
+
+static int add_adaptive(hcs_combiner *cb, unsigned long i, const mpz_t share)
+{
+    cb->arrived[i] = 1;
+    cb->quorum[cb->members++] = i;
+    mpz_set(cb->held[i], share);
+
+    if (cb->members < cb->w) {
+        pthread_mutex_unlock(&cb->lock);
+        return 0;
+    }
+
+    /* The quorum is now fixed and later shares are ignored, so the held
+     * shares can be used without the lock. A reset waits until busy is
+     * cleared. */
+    cb->busy = 1;
+    pthread_mutex_unlock(&cb->lock);
+    set_coefficients(cb);
+
+    #pragma omp parallel for
+    for (unsigned long k = 0; k < cb->w; ++k) {
+        mpz_t t;
+        mpz_init(t);
+        mpz_abs(t, cb->coeff[k]);
+        mpz_powm(cb->held[cb->quorum[k]], cb->held[cb->quorum[k]], t,
+                 cb->mod);
+        mpz_clear(t);
+    }
+
+    pthread_mutex_lock(&cb->lock);
+    for (unsigned long k = 0; k < cb->w; ++k)
+        fold(cb, cb->held[cb->quorum[k]], cb->coeff[k]);
+    cb->folded = cb->w;
+    cb->busy = 0;
+    pthread_cond_broadcast(&cb->idle);
+    pthread_mutex_unlock(&cb->lock);
+
+    return 1;
+}
+
+int hcs_combiner_add(hcs_combiner *cb, unsigned long i, const mpz_t share)
+{
+    pthread_mutex_lock(&cb->lock);
+
+    /* Unknown servers, repeats and shares beyond the quorum are ignored.
+     * Both helpers release the lock. */
+    if (i < cb->l && !cb->arrived[i]) {
+        if (!cb->adaptive && cb->slot[i] >= 0)
+            return add_fixed(cb, i, share);
+        if (cb->adaptive && cb->members < cb->w)
+            return add_adaptive(cb, i, share);
+    }
+
+    const int complete = cb->folded == cb->w;
+    pthread_mutex_unlock(&cb->lock);
+    return complete;
+}
+
+int hcs_combiner_complete(hcs_combiner *cb)
+{
+    pthread_mutex_lock(&cb->lock);
+    const int complete = cb->folded == cb->w;
+    pthread_mutex_unlock(&cb->lock);
+    return complete;
+}
+
+int hcs_combiner_product(hcs_combiner *cb, mpz_t rop)
+{
+    int retval = 0;
+    mpz_t t;
+    mpz_init(t);
+
+    pthread_mutex_lock(&cb->lock);
+    if (cb->folded == cb->w && mpz_invert(t, cb->neg, cb->mod)) {
+        mpz_mul(rop, cb->pos, t);
+        mpz_mod(rop, rop, cb->mod);
+        retval = 1;
+    }
+    pthread_mutex_unlock(&cb->lock);
+
+    mpz_clear(t);
+    return retval;
+}
+
+void hcs_combiner_reset(hcs_combiner *cb)
+{
+    pthread_mutex_lock(&cb->lock);
+    while (cb->busy)
+        pthread_cond_wait(&cb->idle, &cb->lock);
+
+    for (unsigned long i = 0; i < cb->l; ++i)
+        cb->arrived[i] = 0;
+    if (cb->adaptive)
+        cb->members = 0;
+    cb->folded = 0;
+    mpz_set_ui(cb->pos, 1);
+    mpz_set_ui(cb->neg, 1);
+    cb->generation++;
+    pthread_mutex_unlock(&cb->lock);
+}
+
+void hcs_free_combiner(hcs_combiner *cb)
+{
+    pthread_mutex_destroy(&cb->lock);
+    pthread_cond_destroy(&cb->idle);
+
+    for (unsigned long k = 0; k < cb->w; ++k)
+        mpz_clear(cb->coeff[k]);
+    for (unsigned long i = 0; i < cb->l; ++i)
+        mpz_clear(cb->held[i]);
+    mpz_clears(cb->mod, cb->delta, cb->pos, cb->neg, NULL);
+
+    free(cb->quorum);
+    free(cb->x);
+    free(cb->slot);
+    free(cb->coeff);
+    free(cb->held);
+    free(cb->arrived);
+    free(cb);
+}
+
+/* Combine rows [0, rows) of hs into rop, failing unless at least w servers
+ * are flagged. The Lagrange coefficients are
+ * computed once for every row, rows are combined in parallel, and the
+ * products of negatively weighted shares are inverted together. */
+static int combine_rows(mpz_t *rop, unsigned long rows, const mpz_t mod,
+        const mpz_t delta, unsigned long l, unsigned long w, hcs_shares *hs)
+{
+    int retval = 0, negative = 0;
+    unsigned long count = 0;
+    const unsigned long servers = l < hs->size ? l : hs->size;
+
+    unsigned long *x = malloc(sizeof(unsigned long) * (servers ? servers : 1));
+    mpz_t *coeff = malloc(sizeof(mpz_t) * (servers ? servers : 1));
+    mpz_t *neg = malloc(sizeof(mpz_t) * (rows ? rows : 1));
+    if (!x || !coeff || !neg)
+        goto end;
+
+    for (unsigned long i = hcs_next_flag(hs, 0); i < servers;
+            i = hcs_next_flag(hs, i + 1))
+        x[count++] = i + 1;
+
+    /* Fewer shares would interpolate the wrong polynomial */
+    if (count < w)
+        goto end;
+
+    for (unsigned long k = 0; k < count; ++k) {
+        mpz_init(coeff[k]);
+        mpz_lagrange_coeff(coeff[k], delta, x, count, k);
+        mpz_mul_2exp(coeff[k], coeff[k], 1);
+        negative |= mpz_sgn(coeff[k]) < 0;
+    }
+
+    #pragma omp parallel for
+    for (unsigned long r = 0; r < rows; ++r) {
+        mpz_t view, t, e;
+        mpz_init(t);
+        mpz_init(e);
+        mpz_init_set_ui(neg[r], 1);
+        mpz_set_ui(rop[r], 1);
+
+        for (unsigned long k = 0; k < count; ++k) {
+            mpz_abs(e, coeff[k]);
+            mpz_powm(t, hcs_get_share(hs, view, r, x[k] - 1), e, mod);
+
+            mpz_ptr product = mpz_sgn(coeff[k]) < 0 ? neg[r] : rop[r];
+            mpz_mul(product, product, t);
+            mpz_mod(product, product, mod);
+        }
+
+        mpz_clear(t);
+        mpz_clear(e);
+    }
+
+    if (!negative || mpz_invert_batch(neg, neg, rows, mod)) {
+        #pragma omp parallel for
+        for (unsigned long r = 0; r < rows; ++r) {
+            mpz_mul(rop[r], rop[r], neg[r]);
+            mpz_mod(rop[r], rop[r], mod);
+        }
+        retval = 1;
+    }
+
+    for (unsigned long r = 0; r < rows; ++r)
+        mpz_clear(neg[r]);
+    for (unsigned long k = 0; k < count; ++k)
+        mpz_clear(coeff[k]);
+
+end:
+    free(neg);
+    free(coeff);
+    free(x);
+    return retval;
+}
+
+int hcs_combine_shares(mpz_t rop, const mpz_t mod, const mpz_t delta,
+        unsigned long l, unsigned long w, hcs_shares *hs)
+{
+    return combine_rows((mpz_t*)rop, 1, mod, delta, l, w, hs);
+}
+
+int hcs_combine_shares_batch(mpz_t *rop, const mpz_t mod, const mpz_t delta,
+        unsigned long l, unsigned long w, hcs_shares *hs)
+{
+    return combine_rows(rop, hs->count, mod, delta, l, w, hs);
+}
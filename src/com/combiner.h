@@ -0,0 +1,113 @@
+/**
+ * @file combiner.h
+ *
+ * Incremental combination of threshold decryption shares, common to the
+ * threshold Paillier and Damgard-Jurik schemes. Both combine shares c_i
+ * into c' = prod c_i^(2 * lambda_i) modulo the ciphertext modulus, where
+ * lambda_i is the Lagrange coefficient of server i scaled by delta = l!,
+ * before applying their own discrete logarithm.
+ *
+ * With a fixed quorum every coefficient is known up front, so each share is
+ * raised to its power as soon as it arrives and folded into a running
+ * product. Shares with a negative coefficient are collected in a separate
+ * product, so only a single inversion is needed when the quorum completes.
+ *
+ * Without a fixed quorum, the first w distinct shares to arrive form the
+ * quorum. The coefficients are only known once the last of these arrives,
+ * so the shares are held until then and raised to their powers in
+ * parallel.
+ *
+ * Shares may be added from several threads at once. Exponentiation happens
+ * outside of the lock, which only guards the bookkeeping and the final
+ * multiplication into the running product. A reset may also race with adds
+ * for the previous ciphertext. Each fixed quorum share is tagged with the
+ * generation it was added in, and is dropped if a reset happened while it
+ * was raised. Completing an adaptive quorum uses the held shares and
+ * coefficients outside of the lock, so a reset waits for it to finish.
+ */
+
+#ifndef HCS_COMBINER_H
+#define HCS_COMBINER_H
+
+#include <pthread.h>
+#include <gmp.h>
+#include "../../include/libhcs/hcs_shares.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct hcs_combiner {
+    mpz_t mod;                  /* Modulus shares are combined under */
+    mpz_t delta;                /* l! */
+    unsigned long l;            /* Number of servers */
+    unsigned long w;            /* Number of shares required */
+    int adaptive;               /* Non-zero if the quorum is not fixed */
+    unsigned long *quorum;      /* Server indices of the quorum */
+    unsigned long *x;           /* Evaluation points of the quorum */
+    long *slot;                 /* Position of each server in the quorum,
+                                   or -1 if it is not a member */
+    mpz_t *coeff;               /* 2 * lambda of each quorum member */
+    mpz_t *held;                /* Shares awaiting an adaptive quorum */
+    int *arrived;               /* Whether each server's share arrived */
+    unsigned long members;      /* Quorum members known so far */
+    unsigned long folded;       /* Shares folded into the products */
+    mpz_t pos;                  /* Product of positively weighted shares */
+    mpz_t neg;                  /* Product of negatively weighted shares */
+    unsigned long generation;   /* Number of resets so far */
+    int busy;                   /* Non-zero while an adaptive quorum is
+                                   being raised outside of the lock */
+    pthread_mutex_t lock;
+    pthread_cond_t idle;        /* Signalled when busy is cleared */
+};
+
+typedef struct hcs_combiner hcs_combiner;
+
+/* Initialise a combiner for @p l servers requiring @p w shares, under the
+ * modulus @p mod. If @p quorum is not NULL, it holds the @p w distinct
+ * server indices whose shares will be used. Returns NULL on allocation
+ * failure or an invalid quorum. */
+hcs_combiner* hcs_init_combiner(const mpz_t mod, const mpz_t delta,
+        unsigned long l, unsigned long w, const unsigned long *quorum);
+
+/* Add the share of server @p i. Shares from servers outside a fixed quorum,
+ * from unknown servers, or which repeat a server are ignored. Returns
+ * non-zero if the quorum is complete. */
+int hcs_combiner_add(hcs_combiner *cb, unsigned long i, const mpz_t share);
+
+/* Return non-zero if the quorum is complete. */
+int hcs_combiner_complete(hcs_combiner *cb);
+
+/* Set @p rop to the combined product of the quorum's weighted shares.
+ * Returns zero if the quorum is not complete, or if a share was not
+ * invertible. */
+int hcs_combiner_product(hcs_combiner *cb, mpz_t rop);
+
+/* Discard all shares, keeping any fixed quorum, to combine the shares of
+ * another ciphertext. Adds still in progress for the previous ciphertext
+ * are discarded rather than folded into the next product. */
+void hcs_combiner_reset(hcs_combiner *cb);
+
+/* Free a combiner and all associated memory. */
+void hcs_free_combiner(hcs_combiner *cb);
+
+/* Set @p rop to the product of the shares of the first ciphertext in @p hs
+ * from the servers flagged among the first @p l. Each is raised to twice
+ * its Lagrange coefficient over exactly the flagged servers, modulo @p mod.
+ * This is the batch counterpart of a combiner. Returns zero on allocation
+ * failure, if fewer than @p w servers are flagged, or if a share was not
+ * invertible. */
+int hcs_combine_shares(mpz_t rop, const mpz_t mod, const mpz_t delta,
+        unsigned long l, unsigned long w, hcs_shares *hs);
+
+/* As hcs_combine_shares, for every ciphertext held by @p hs. The Lagrange
+ * coefficients are computed once, and a single inversion is shared by all
+ * ciphertexts. @p rop must hold hs->count values. */
+int hcs_combine_shares_batch(mpz_t *rop, const mpz_t mod, const mpz_t delta,
+        unsigned long l, unsigned long w, hcs_shares *hs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,67 @@
+/*
+ * @file cpu.c
+ *
+ * Processor feature detection with cpuid. On other architectures, or other
+ * compilers, no features are reported and every kernel uses its portable
+ * variant.
+ */
+
+#include <stddef.h>
+#include "cpu.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__))
+#   define HCS_HAVE_CPUID 1
+#   include <cpuid.h>
+#endif
+
+/* Detection results are written once and only ever read afterwards, so
+ * concurrent first calls are benign as every thread computes the same
+ * value. */
+static unsigned int cpu_detected = 0;
+static int cpu_probed = 0;
+static unsigned int cpu_disabled = 0;
+
+#ifdef HCS_HAVE_CPUID
+static unsigned int cpu_probe(void)
+{
+    unsigned int a, b, c, d, features = 0;
+
+    if (!__get_cpuid(1, &a, &b, &c, &d))
+        return 0;
+
+    if (c & bit_SSSE3)
+        features |= HCS_CPU_SSSE3;
+    if (c & bit_SSE4_1)
+        features |= HCS_CPU_SSE41;
+
+    if (__get_cpuid_max(0, NULL) < 7)
+        return features;
+
+    __cpuid_count(7, 0, a, b, c, d);
+    if (b & bit_SHA)
+        features |= HCS_CPU_SHA;
+
+    return features;
+}
+#else
+static unsigned int cpu_probe(void)
+{
+    return 0;
+}
+#endif
+
+unsigned int hcs_cpu_features(void)
+{
+    if (!__atomic_load_n(&cpu_probed, __ATOMIC_ACQUIRE)) {
+        cpu_detected = cpu_probe();
+        __atomic_store_n(&cpu_probed, 1, __ATOMIC_RELEASE);
+    }
+
+    return cpu_detected & ~__atomic_load_n(&cpu_disabled, __ATOMIC_RELAXED);
+}
+
+void hcs_cpu_disable(unsigned int mask)
+{
+    __atomic_store_n(&cpu_disabled, mask, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,38 @@
+/**
+ * @file cpu.h
+ *
+ * Runtime detection of processor features. Kernels with architecture
+ * specific variants consult this once when first used and select the best
+ * variant the running processor supports, so the library itself is always
+ * built for the baseline architecture.
+ *
+ * Only features some kernel dispatches on are reported. A new one is added
+ * here along with the first variant which uses it.
+ */
+
+#ifndef HCS_CPU_H
+#define HCS_CPU_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HCS_CPU_SSSE3       (1u << 0)   /* Supplemental SSE3 */
+#define HCS_CPU_SSE41       (1u << 1)   /* SSE4.1 */
+#define HCS_CPU_SHA         (1u << 2)   /* SHA-1 and SHA-256 extensions */
+
+/* Return the features of the running processor as a mask of HCS_CPU_*
+ * values, less any disabled with hcs_cpu_disable. The processor is only
+ * queried on the first call. */
+unsigned int hcs_cpu_features(void);
+
+/* Hide the features in mask from hcs_cpu_features, so that kernels resolved
+ * afterwards use a less specialised variant. Passing 0 restores every
+ * feature. Only for testing. */
+void hcs_cpu_disable(unsigned int mask);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,83 @@
+/*
+ * @file json.c
+ */
+
+#include <limits.h>
+#include <stdlib.h>
+#include <gmp.h>
+#include "json.h"
+#include "parson.h"
+#include "util.h"
+
+JSON_Value* hcs_json_init_object(void)
+{
+    JSON_Value *root = json_value_init_object();
+    if (root == NULL)
+        return NULL;
+
+    if (json_object_set_number(json_value_get_object(root), "v",
+                HCS_JSON_VERSION) != JSONSuccess) {
+        json_value_free(root);
+        return NULL;
+    }
+
+    return root;
+}
+
+int hcs_json_set_mpz(JSON_Object *obj, const char *name, const mpz_t op)
+{
+    char *buffer = mpz_get_str(NULL, 16, op);
+    if (buffer == NULL)
+        return 0;
+
+    int ok = json_object_set_string(obj, name, buffer) == JSONSuccess;
+    free(buffer);
+    return ok;
+}
+
+/* Base of the values of @p obj, or zero if its version is unknown */
+static int json_base(const JSON_Object *obj)
+{
+    JSON_Value *v = json_object_get_value(obj, "v");
+    if (v == NULL)
+        return HCS_INTERNAL_BASE;
+    if (json_value_get_type(v) == JSONNumber &&
+            json_value_get_number(v) == HCS_JSON_VERSION)
+        return 16;
+    return 0;
+}
+
+int hcs_json_get_mpz(const JSON_Object *obj, const char *name, mpz_t rop)
+{
+    if (obj == NULL)
+        return 0;
+
+    const int base = json_base(obj);
+    const char *str = json_object_get_string(obj, name);
+    return base && str && mpz_set_str(rop, str, base) == 0;
+}
+
+int hcs_json_get_ulong(const JSON_Object *obj, const char *name,
+        unsigned long *rop)
+{
+    if (obj == NULL)
+        return 0;
+
+    JSON_Value *v = json_object_get_value(obj, name);
+    if (v == NULL || json_value_get_type(v) != JSONNumber)
+        return 0;
+
+    const double d = json_value_get_number(v);
+    if (d < 0 || d >= ULONG_MAX || d != (unsigned long)d)
+        return 0;
+
+    *rop = d;
+    return 1;
+}
+
+char* hcs_json_finish(JSON_Value *root, int ok)
+{
+    char *retstr = ok ? json_serialize_to_string(root) : NULL;
+    json_value_free(root);
+    return retstr;
+}
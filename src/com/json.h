@@ -0,0 +1,52 @@
+/**
+ * @file json.h
+ *
+ * Encoding of values in the JSON objects produced by the export functions.
+ *
+ * Objects written by earlier versions hold every mpz_t as a base 62 string
+ * and carry no version. Base 62 is not a power of two, so GMP converts it by
+ * repeated division, which is costly for large values. Objects are now
+ * written with "v": 2 and every mpz_t as a hexadecimal string, which GMP
+ * converts in linear time. Readers pick the base from the version, so both
+ * forms are accepted on import.
+ */
+
+#ifndef HCS_JSON_H
+#define HCS_JSON_H
+
+#include <gmp.h>
+#include "parson.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Version written by the export functions. */
+#define HCS_JSON_VERSION 2
+
+/* Return a new empty object tagged with HCS_JSON_VERSION, or NULL on
+ * allocation failure. */
+JSON_Value* hcs_json_init_object(void);
+
+/* Store @p op under @p name. Returns non-zero on success. */
+int hcs_json_set_mpz(JSON_Object *obj, const char *name, const mpz_t op);
+
+/* Read @p name into @p rop, in the base given by the version of @p obj.
+ * Returns zero if @p obj is NULL, the value is missing or malformed, or the
+ * version is unknown. */
+int hcs_json_get_mpz(const JSON_Object *obj, const char *name, mpz_t rop);
+
+/* Read the non-negative integer @p name into @p rop. Returns zero if @p obj
+ * is NULL or the value is missing, not a number or out of range. */
+int hcs_json_get_ulong(const JSON_Object *obj, const char *name,
+        unsigned long *rop);
+
+/* Serialize @p root if @p ok is non-zero, and free it. Returns NULL if @p ok
+ * is zero or on allocation failure. */
+char* hcs_json_finish(JSON_Value *root, int ok);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
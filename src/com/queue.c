@@ -0,0 +1,99 @@
+/*
+ * @file queue.c
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include "queue.h"
+
+int hcs_queue_init(hcs_queue *q, unsigned long capacity)
+{
+    q->items = malloc(sizeof(void*) * (capacity ? capacity : 1));
+    if (q->items == NULL)
+        return 0;
+
+    if (pthread_mutex_init(&q->lock, NULL))
+        goto failure;
+
+    if (pthread_cond_init(&q->not_empty, NULL)) {
+        pthread_mutex_destroy(&q->lock);
+        goto failure;
+    }
+
+    if (pthread_cond_init(&q->not_full, NULL)) {
+        pthread_cond_destroy(&q->not_empty);
+        pthread_mutex_destroy(&q->lock);
+        goto failure;
+    }
+
+    q->capacity = capacity ? capacity : 1;
+    q->head = 0;
+    q->count = 0;
+    q->closed = 0;
+    return 1;
+
+failure:
+    free(q->items);
+    return 0;
+}
+
+void hcs_queue_destroy(hcs_queue *q)
+{
+    pthread_cond_destroy(&q->not_full);
+    pthread_cond_destroy(&q->not_empty);
+    pthread_mutex_destroy(&q->lock);
+    free(q->items);
+}
+
+int hcs_queue_push(hcs_queue *q, void *item)
+{
+    pthread_mutex_lock(&q->lock);
+    while (q->count == q->capacity && !q->closed)
+        pthread_cond_wait(&q->not_full, &q->lock);
+
+    if (q->closed) {
+        pthread_mutex_unlock(&q->lock);
+        return 0;
+    }
+
+    q->items[(q->head + q->count) % q->capacity] = item;
+    q->count++;
+    pthread_cond_signal(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+    return 1;
+}
+
+void* hcs_queue_pop(hcs_queue *q)
+{
+    void *item = NULL;
+
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0 && !q->closed)
+        pthread_cond_wait(&q->not_empty, &q->lock);
+
+    if (q->count) {
+        item = q->items[q->head];
+        q->head = (q->head + 1) % q->capacity;
+        q->count--;
+        pthread_cond_signal(&q->not_full);
+    }
+
+    pthread_mutex_unlock(&q->lock);
+    return item;
+}
+
+void hcs_queue_close(hcs_queue *q)
+{
+    pthread_mutex_lock(&q->lock);
+    q->closed = 1;
+    pthread_cond_broadcast(&q->not_empty);
+    pthread_cond_broadcast(&q->not_full);
+    pthread_mutex_unlock(&q->lock);
+}
+
+void hcs_queue_reopen(hcs_queue *q)
+{
+    pthread_mutex_lock(&q->lock);
+    q->closed = 0;
+    pthread_mutex_unlock(&q->lock);
+}
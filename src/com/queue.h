@@ -0,0 +1,58 @@
+/**
+ * @file queue.h
+ *
+ * A bounded blocking queue of pointers, used to connect the stages of a
+ * pipeline running on separate threads. Producers block while the queue is
+ * full and consumers block while it is empty, so a slow stage applies back
+ * pressure to the stages before it rather than letting work pile up.
+ *
+ * Closing a queue wakes every waiting thread. Items already queued can still
+ * be popped, after which pop reports the end of the queue.
+ */
+
+#ifndef HCS_QUEUE_H
+#define HCS_QUEUE_H
+
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    void **items;               /* Circular buffer of queued items */
+    unsigned long capacity;     /* Maximum number of queued items */
+    unsigned long head;         /* Index of the oldest item */
+    unsigned long count;        /* Number of queued items */
+    int closed;                 /* Non-zero once no more items will arrive */
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+} hcs_queue;
+
+/* Initialise @p q to hold at most @p capacity items. Returns non-zero on
+ * success. */
+int hcs_queue_init(hcs_queue *q, unsigned long capacity);
+
+/* Release the resources of @p q. No thread may be waiting on it. */
+void hcs_queue_destroy(hcs_queue *q);
+
+/* Append @p item, waiting while the queue is full. Returns zero if the
+ * queue was closed, in which case @p item was not queued. */
+int hcs_queue_push(hcs_queue *q, void *item);
+
+/* Remove the oldest item, waiting while the queue is empty. Returns NULL
+ * once the queue is closed and empty. */
+void* hcs_queue_pop(hcs_queue *q);
+
+/* Close @p q, waking all waiting threads. */
+void hcs_queue_close(hcs_queue *q);
+
+/* Allow items to be pushed to @p q again after it was closed. */
+void hcs_queue_reopen(hcs_queue *q);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
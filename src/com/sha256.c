@@ -0,0 +1,223 @@
+/*
+ * @file sha256.c
+ *
+ * SHA-256 as specified in FIPS 180-4. A portable compression function is
+ * always available. On x86-64 the SHA extensions are used instead when the
+ * processor reports them at runtime (see cpu.h), so the library does not
+ * need to be built with any architecture specific flags.
+ */
+
+#include <string.h>
+#include <stdint.h>
+#include "cpu.h"
+#include "sha256.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__))
+#   define HCS_HAVE_SHANI 1
+#   include <immintrin.h>
+#endif
+
+static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROR(x, n)   (((x) >> (n)) | ((x) << (32 - (n))))
+#define CH(x,y,z)   (((x) & (y)) ^ (~(x) & (z)))
+#define MAJ(x,y,z)  (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+#define BSIG0(x)    (ROR(x, 2) ^ ROR(x, 13) ^ ROR(x, 22))
+#define BSIG1(x)    (ROR(x, 6) ^ ROR(x, 11) ^ ROR(x, 25))
+#define SSIG0(x)    (ROR(x, 7) ^ ROR(x, 18) ^ ((x) >> 3))
+#define SSIG1(x)    (ROR(x, 17) ^ ROR(x, 19) ^ ((x) >> 10))
+
+static void sha256_compress_generic(uint32_t h[8], const uint8_t *p,
+                                    size_t blocks)
+{
+    uint32_t w[64];
+
+    while (blocks--) {
+        for (int i = 0; i < 16; ++i) {
+            w[i] = (uint32_t)p[4*i] << 24 | (uint32_t)p[4*i+1] << 16 |
+                   (uint32_t)p[4*i+2] << 8 | (uint32_t)p[4*i+3];
+        }
+        for (int i = 16; i < 64; ++i)
+            w[i] = SSIG1(w[i-2]) + w[i-7] + SSIG0(w[i-15]) + w[i-16];
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3],
+                 e = h[4], f = h[5], g = h[6], k = h[7];
+
+        for (int i = 0; i < 64; ++i) {
+            uint32_t t1 = k + BSIG1(e) + CH(e, f, g) + K[i] + w[i];
+            uint32_t t2 = BSIG0(a) + MAJ(a, b, c);
+            k = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+        h[4] += e; h[5] += f; h[6] += g; h[7] += k;
+        p += 64;
+    }
+}
+
+#ifdef HCS_HAVE_SHANI
+__attribute__((target("sha,sse4.1")))
+static void sha256_compress_shani(uint32_t h[8], const uint8_t *p,
+                                  size_t blocks)
+{
+    const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+                                        0x0405060700010203ULL);
+    __m128i state0, state1, save0, save1, t, w[4];
+
+    /* Reorder the state into the ABEF/CDGH layout the instructions use */
+    t = _mm_loadu_si128((const __m128i*)&h[0]);
+    state1 = _mm_loadu_si128((const __m128i*)&h[4]);
+    t = _mm_shuffle_epi32(t, 0xB1);
+    state1 = _mm_shuffle_epi32(state1, 0x1B);
+    state0 = _mm_alignr_epi8(t, state1, 8);
+    state1 = _mm_blend_epi16(state1, t, 0xF0);
+
+    while (blocks--) {
+        save0 = state0;
+        save1 = state1;
+
+        for (int i = 0; i < 16; ++i) {
+            if (i < 4) {
+                t = _mm_loadu_si128((const __m128i*)(p + 16*i));
+                w[i] = _mm_shuffle_epi8(t, mask);
+            }
+            else {
+                t = _mm_sha256msg1_epu32(w[i & 3], w[(i+1) & 3]);
+                t = _mm_add_epi32(t, _mm_alignr_epi8(w[(i+3) & 3],
+                                                     w[(i+2) & 3], 4));
+                w[i & 3] = _mm_sha256msg2_epu32(t, w[(i+3) & 3]);
+            }
+
+            t = _mm_add_epi32(w[i & 3],
+                              _mm_loadu_si128((const __m128i*)&K[4*i]));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, t);
+            t = _mm_shuffle_epi32(t, 0x0E);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, t);
+        }
+
+        state0 = _mm_add_epi32(state0, save0);
+        state1 = _mm_add_epi32(state1, save1);
+        p += 64;
+    }
+
+    t = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    state0 = _mm_blend_epi16(t, state1, 0xF0);
+    state1 = _mm_alignr_epi8(state1, t, 8);
+    _mm_storeu_si128((__m128i*)&h[0], state0);
+    _mm_storeu_si128((__m128i*)&h[4], state1);
+}
+
+static int cpu_has_shani(void)
+{
+    const unsigned int need = HCS_CPU_SHA | HCS_CPU_SSSE3 | HCS_CPU_SSE41;
+    return (hcs_cpu_features() & need) == need;
+}
+#endif
+
+typedef void (*sha256_compress_fn)(uint32_t*, const uint8_t*, size_t);
+
+/* Resolved on first use. Races on initialisation are benign as every thread
+ * will resolve the same function. */
+static sha256_compress_fn sha256_compress = NULL;
+static int sha256_generic_forced = 0;
+
+static sha256_compress_fn sha256_resolve(void)
+{
+    sha256_compress_fn fn = sha256_compress_generic;
+#ifdef HCS_HAVE_SHANI
+    if (!sha256_generic_forced && cpu_has_shani())
+        fn = sha256_compress_shani;
+#endif
+    sha256_compress = fn;
+    return fn;
+}
+
+int sha256_accelerated(void)
+{
+    return (sha256_compress ? sha256_compress : sha256_resolve())
+                != sha256_compress_generic;
+}
+
+void sha256_force_generic(int enable)
+{
+    sha256_generic_forced = enable;
+    sha256_resolve();
+}
+
+void sha256_init(sha256_state *self)
+{
+    static const uint32_t iv[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+
+    memcpy(self->h, iv, sizeof(iv));
+    self->length = 0;
+    self->bufpos = 0;
+}
+
+void sha256_update(sha256_state *self, const unsigned char *p, size_t length)
+{
+    sha256_compress_fn compress = sha256_compress ? sha256_compress
+                                                  : sha256_resolve();
+    self->length += length;
+
+    if (self->bufpos) {
+        size_t take = 64 - self->bufpos;
+        if (take > length)
+            take = length;
+
+        memcpy(self->buf + self->bufpos, p, take);
+        self->bufpos += take;
+        p += take;
+        length -= take;
+
+        if (self->bufpos < 64)
+            return;
+
+        compress(self->h, self->buf, 1);
+        self->bufpos = 0;
+    }
+
+    if (length >= 64) {
+        compress(self->h, p, length / 64);
+        p += length & ~(size_t)63;
+        length &= 63;
+    }
+
+    memcpy(self->buf, p, length);
+    self->bufpos = length;
+}
+
+void sha256_digest(sha256_state *self, unsigned char *out)
+{
+    uint8_t pad[72] = { 0x80 };
+    const uint64_t bits = self->length * 8;
+    const size_t padlen = (self->bufpos < 56 ? 56 : 120) - self->bufpos;
+
+    for (int i = 0; i < 8; ++i)
+        pad[padlen + i] = (uint8_t)(bits >> (56 - 8*i));
+    sha256_update(self, pad, padlen + 8);
+
+    for (int i = 0; i < 8; ++i) {
+        out[4*i]   = (uint8_t)(self->h[i] >> 24);
+        out[4*i+1] = (uint8_t)(self->h[i] >> 16);
+        out[4*i+2] = (uint8_t)(self->h[i] >> 8);
+        out[4*i+3] = (uint8_t)(self->h[i]);
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#define SHA256_DIGEST_SIZE 32
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t h[8];      /* The current hash state */
+    uint64_t length;    /* Total number of bytes added to the hash */
+    uint8_t buf[64];    /* Partially filled block awaiting compression */
+    uint8_t bufpos;     /* Number of bytes currently in the buffer */
+} sha256_state;
+
+void sha256_init(sha256_state *self);
+void sha256_update(sha256_state *self, const unsigned char *p, size_t length);
+void sha256_digest(sha256_state *self, unsigned char *out);
+
+/* Returns non-zero if the compression function in use is hardware
+ * accelerated. Exposed for testing and diagnostics. */
+int sha256_accelerated(void);
+
+/* Force use of the portable compression function. Only for testing. */
+void sha256_force_generic(int enable);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
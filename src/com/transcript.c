@@ -0,0 +1,123 @@
+/*
+ * @file transcript.c
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <gmp.h>
+#include "ripemd160.h"
+#include "sha256.h"
+#include "transcript.h"
+
+#define HCS_TRANSCRIPT_BUFSIZE 128
+#define HCS_MAX_DIGEST_SIZE 32
+
+static void sha256_init_(void *s)
+{
+    sha256_init(s);
+}
+
+static void sha256_update_(void *s, const unsigned char *p, size_t length)
+{
+    sha256_update(s, p, length);
+}
+
+static void sha256_digest_(void *s, unsigned char *out)
+{
+    sha256_digest(s, out);
+}
+
+static void ripemd160_init_(void *s)
+{
+    ripemd160_init(s);
+}
+
+static void ripemd160_update_(void *s, const unsigned char *p, size_t length)
+{
+    ripemd160_update(s, p, (int)length);
+}
+
+static void ripemd160_digest_(void *s, unsigned char *out)
+{
+    ripemd160_digest(s, out);
+}
+
+static const hcs_hash_backend backends[] = {
+    [HCS_HASH_SHA256] = {
+        SHA256_DIGEST_SIZE, sha256_init_, sha256_update_, sha256_digest_
+    },
+    [HCS_HASH_RIPEMD160] = {
+        RIPEMD160_DIGEST_SIZE, ripemd160_init_, ripemd160_update_,
+        ripemd160_digest_
+    },
+};
+
+void hcs_transcript_init(hcs_transcript *tr, int hash_type)
+{
+    assert(hash_type >= 0 &&
+           (size_t)hash_type < sizeof(backends) / sizeof(backends[0]));
+
+    tr->hash = &backends[hash_type];
+    tr->hash->init(&tr->state);
+}
+
+void hcs_transcript_absorb_bytes(hcs_transcript *tr, const unsigned char *p,
+                                 size_t length)
+{
+    hcs_transcript_absorb_ul(tr, length);
+    tr->hash->update(&tr->state, p, length);
+}
+
+void hcs_transcript_absorb_ul(hcs_transcript *tr, unsigned long op)
+{
+    const uint64_t v = (uint64_t)op;
+    unsigned char buf[8];
+
+    for (int i = 0; i < 8; ++i)
+        buf[i] = (unsigned char)(v >> (56 - 8*i));
+    tr->hash->update(&tr->state, buf, 8);
+}
+
+/* Limbs are read directly from the mpz_t, most significant first, and
+ * written big-endian into a small stack buffer which is flushed whenever it
+ * fills. Leading zero bytes of the top limb are skipped so the bytes hashed
+ * are exactly those mpz_export would produce. */
+void hcs_transcript_absorb_mpz(hcs_transcript *tr, const mpz_t op)
+{
+    unsigned char buf[HCS_TRANSCRIPT_BUFSIZE];
+    const size_t limbs = mpz_size(op);
+    const mp_limb_t *d = mpz_limbs_read(op);
+    const size_t lb = sizeof(mp_limb_t);
+    size_t pos = 0;
+
+    hcs_transcript_absorb_ul(tr, mpz_sgn(op) ? mpz_sizeinbase(op, 256) : 0);
+
+    for (size_t i = limbs; i-- > 0; ) {
+        const mp_limb_t limb = d[i];
+        size_t b = lb;
+
+        if (i == limbs - 1) {
+            while (b > 1 && ((limb >> (8 * (b - 1))) & 0xff) == 0)
+                b--;
+        }
+
+        while (b--) {
+            buf[pos++] = (unsigned char)(limb >> (8 * b));
+            if (pos == sizeof(buf)) {
+                tr->hash->update(&tr->state, buf, pos);
+                pos = 0;
+            }
+        }
+    }
+
+    if (pos)
+        tr->hash->update(&tr->state, buf, pos);
+}
+
+void hcs_transcript_challenge(hcs_transcript *tr, mpz_t rop)
+{
+    unsigned char digest[HCS_MAX_DIGEST_SIZE];
+
+    tr->hash->digest(&tr->state, digest);
+    mpz_import(rop, tr->hash->digest_size, 1, 1, 1, 0, digest);
+}
@@ -0,0 +1,88 @@
+/**
+ * @file transcript.h
+ *
+ * A Fiat-Shamir transcript. Values are absorbed one after another into a
+ * running hash, and a challenge is squeezed out at the end. mpz_t values
+ * are read limb by limb and hashed in canonical big-endian order without
+ * any intermediate export buffer, so absorbing never allocates.
+ *
+ * Byte strings and mpz_t values are prefixed by their length in bytes, and
+ * unsigned longs always take 8 bytes, so that different sequences of values
+ * can never produce the same hash input.
+ */
+
+#ifndef HCS_TRANSCRIPT_H
+#define HCS_TRANSCRIPT_H
+
+#include <stddef.h>
+#include <gmp.h>
+#include "ripemd160.h"
+#include "sha256.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Available hash backends */
+#define HCS_HASH_SHA256    0
+#define HCS_HASH_RIPEMD160 1
+
+/* Backend used by all proofs in this library */
+#define HCS_HASH_DEFAULT HCS_HASH_SHA256
+
+/**
+ * Operations a hash backend must provide. New backends only need to add an
+ * entry here and a member to the state union below.
+ */
+typedef struct {
+    size_t digest_size;
+    void (*init)(void *state);
+    void (*update)(void *state, const unsigned char *p, size_t length);
+    void (*digest)(void *state, unsigned char *out);
+} hcs_hash_backend;
+
+/**
+ * A running transcript. This lives on the stack and requires no cleanup.
+ */
+typedef struct {
+    const hcs_hash_backend *hash;
+    union {
+        sha256_state sha256;
+        ripemd160_state ripemd160;
+    } state;
+} hcs_transcript;
+
+/**
+ * Start a new transcript using the hash backend @p hash_type.
+ */
+void hcs_transcript_init(hcs_transcript *tr, int hash_type);
+
+/**
+ * Absorb the magnitude of @p op into the transcript.
+ */
+void hcs_transcript_absorb_mpz(hcs_transcript *tr, const mpz_t op);
+
+/**
+ * Absorb @p op as an unsigned 64-bit big-endian value.
+ */
+void hcs_transcript_absorb_ul(hcs_transcript *tr, unsigned long op);
+
+/**
+ * Absorb @p length bytes from @p p, prefixed by @p length as with
+ * hcs_transcript_absorb_ul. Absorbing the bytes mpz_export produces for a
+ * non-negative value is the same as absorbing the value itself.
+ */
+void hcs_transcript_absorb_bytes(hcs_transcript *tr, const unsigned char *p,
+                                 size_t length);
+
+/**
+ * Finish the transcript and store the digest, read as a big-endian integer,
+ * in @p rop. The transcript must be initialised again before reuse.
+ */
+void hcs_transcript_challenge(hcs_transcript *tr, mpz_t rop);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
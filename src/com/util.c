@@ -3,11 +3,13 @@
  */
 
 #include <assert.h>
+#include <stdlib.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <gmp.h>
-#include "ripemd160.h"
+#include "../../include/libhcs/hcs_scrub.h"
+#include "omp.h"
 #include "util.h"
 
 #ifdef _WIN32
@@ -31,27 +33,78 @@ static void memset_s(void *v, int c, size_t n)
 
 /* Zero a single mpz_t variable. mpz_clear does not seem to be required
  * to zero memory before freeing it, so we must do it ourselves. A
- * function mpn_zero exists which performs this. */
+ * function mpn_zero exists which performs this. The size is reset too, as
+ * a value with zeroed limbs but a non-zero size is not a valid mpz_t. */
 inline void mpz_zero(mpz_t op)
 {
     mpn_zero(op->_mp_d, op->_mp_alloc);
+    op->_mp_size = 0;
 }
 
-/* Call mpz_zero with a va_list. This follows mpz_clears and mpz_inits
- * in that it is a NULL-terminated va_list */
-void mpz_zeros(mpz_t op, ...)
-{
-    va_list va;
-    va_start(va, op);
+/* Apply an action to each mpz_t of a NULL-terminated va_list. This follows
+ * mpz_clears and mpz_inits. */
+enum { ZERO_SCRUB = 1, ZERO_CLEAR = 2 };
 
+static void zero_list(int action, mpz_t op, va_list va)
+{
     /* Use the internal mpz names pre-typedef so we can assign pointers, as
      * mpz_t is defined as __mpz_struct[1] which is non-assignable */
     __mpz_struct *ptr = op;
     do {
-        mpz_zero(ptr);
+        if (action & ZERO_SCRUB)
+            mpz_zero(ptr);
+        else
+            mpz_set_ui(ptr, 0);
+        if (action & ZERO_CLEAR)
+            mpz_clear(ptr);
     } while ((ptr = va_arg(va, __mpz_struct*)));
 }
 
+void mpz_zeros(mpz_t op, ...)
+{
+    va_list va;
+    va_start(va, op);
+    zero_list(ZERO_SCRUB, op, va);
+    va_end(va);
+}
+
+void mpz_zeros_secret(mpz_t op, ...)
+{
+    const int scrub = hcs_get_scrub_policy() != HCS_SCRUB_NONE;
+    va_list va;
+    va_start(va, op);
+    zero_list(scrub ? ZERO_SCRUB : 0, op, va);
+    va_end(va);
+}
+
+void mpz_zeros_public(mpz_t op, ...)
+{
+    const int scrub = hcs_get_scrub_policy() == HCS_SCRUB_ALL;
+    va_list va;
+    va_start(va, op);
+    zero_list(scrub ? ZERO_SCRUB : 0, op, va);
+    va_end(va);
+}
+
+void mpz_clears_secret(mpz_t op, ...)
+{
+    va_list va;
+    va_start(va, op);
+
+    /* Clearing without scrubbing skips the reset entirely */
+    if (hcs_get_scrub_policy() != HCS_SCRUB_NONE) {
+        zero_list(ZERO_SCRUB | ZERO_CLEAR, op, va);
+    }
+    else {
+        __mpz_struct *ptr = op;
+        do {
+            mpz_clear(ptr);
+        } while ((ptr = va_arg(va, __mpz_struct*)));
+    }
+
+    va_end(va);
+}
+
 /* Attempts to get n bits of seed data from /dev/urandom. The number of
  * bits is always round up to the nearest 8. Asking for 78 bits of seed
  * will gather 80 bits, for example. */
@@ -103,7 +156,8 @@ int mpz_seed(mpz_t seed, int bits)
  * values until we get one with gcd(rop, op) of n. If one has knowledge about
  * the value of rop, then calling this function may not be neccessary. i.e.
  * if rop is prime, we can just call urandomm directly. */
-void mpz_random_in_mult_group(mpz_t rop, gmp_randstate_t rstate, mpz_t op)
+void mpz_random_in_mult_group(mpz_t rop, gmp_randstate_t rstate,
+        const mpz_t op)
 {
     mpz_t t1;
     mpz_init(t1);
@@ -291,6 +345,35 @@ void internal_fast_random_safe_prime(mpz_t rop1, mpz_t rop2, gmp_randstate_t rst
     } while (mpz_probab_prime_p(rop2, 25) == 0);
 }
 
+/* Find p = 2kr + 1 by trying random even multipliers of r, then map random
+ * values into the order r subgroup until a non-identity one is found. Since
+ * r is prime, any element of the subgroup other than 1 generates it. */
+void mpz_random_schnorr_group(mpz_t p, mpz_t r, mpz_t g,
+        gmp_randstate_t rstate, mp_bitcnt_t pbits, mp_bitcnt_t rbits)
+{
+    mpz_t k;
+    mpz_init(k);
+
+    internal_naive_random_prime(r, rstate, rbits - 1);
+    do {
+        mpz_urandomb(k, rstate, pbits - mpz_sizeinbase(r, 2));
+        mpz_setbit(k, pbits - mpz_sizeinbase(r, 2));
+        mpz_clrbit(k, 0);
+        mpz_mul(p, k, r);
+        mpz_add_ui(p, p, 1);
+    } while (mpz_probab_prime_p(p, 25) == 0);
+
+    /* k = (p - 1) / r */
+    mpz_sub_ui(k, p, 1);
+    mpz_divexact(k, k, r);
+    do {
+        mpz_urandomm(g, rstate, p);
+        mpz_powm(g, g, k, p);
+    } while (mpz_cmp_ui(g, 1) <= 0);
+
+    mpz_clear(k);
+}
+
 /* Chinese remainder theorem case where k = 2 using Bezout's identity. Unlike
  * other mpz functions rop must not be an aliased with any of the other
  * arguments! This is done to save excessive copying in this function, plus
@@ -317,68 +400,334 @@ void mpz_2crt(mpz_t rop, mpz_t con1_a, mpz_t con1_m, mpz_t con2_a, mpz_t con2_m)
     mpz_clear(t);
 }
 
-/* Hash an mpz_t value and an unsigned long using ripemd160, and store a
- * corresponding integer into rop. Care is taken to ensure that this is
- * cross-platform and doesn't depend on the order of bytes. */
-void mpz_ripemd_mpz_ul(mpz_t rop, mpz_t op1, unsigned long op2) {
-    ripemd160_state ctx;
-    ripemd160_init(&ctx);
-
-    size_t countp;
-    unsigned char *datap = mpz_export(NULL, &countp, 1, 1, -1, 0, op1);
-    ripemd160_update(&ctx, datap, countp);
-    free(datap);
-
-    // Ripemd160 function will handle different byte ordering for different
-    // endian machines.
-    const uint64_t op2_u64 = (uint64_t) op2;
-    unsigned char *op2_cp = (unsigned char*)&op2_u64;
-    ripemd160_update(&ctx, op2_cp, 8);
-
-    unsigned char hdigest[RIPEMD160_DIGEST_SIZE];
-    ripemd160_digest(&ctx, hdigest);
-    mpz_import(rop, RIPEMD160_DIGEST_SIZE, 1, 1, -1, 0, hdigest);
+/* Walk the product tree from node i, marking leaves under coprime subtrees
+ * as valid and isolating the leaves responsible for failing subtrees. */
+static unsigned long coprime_descend(mpz_t *tree, unsigned long i,
+        unsigned long size, unsigned long count, const mpz_t n, mpz_t t,
+        int *valid)
+{
+    unsigned long lo = i, hi = i + 1;
+    while (lo < size) {
+        lo *= 2;
+        hi *= 2;
+    }
+
+    /* Subtree only covers padding */
+    if (lo - size >= count)
+        return 0;
+
+    mpz_gcd(t, tree[i], n);
+    if (mpz_cmp_ui(t, 1) == 0)
+        return 0;
+
+    if (i >= size) {
+        valid[i - size] = 0;
+        return 1;
+    }
+
+    return coprime_descend(tree, 2*i, size, count, n, t, valid) +
+           coprime_descend(tree, 2*i + 1, size, count, n, t, valid);
 }
 
-#define HCS_MALLOC_BYTES_REQ(mpz) ((mpz_sizeinbase(mpz, 2) + 7) / 8) * 8
-
-void mpz_ripemd_3mpz_ul(mpz_t rop, mpz_t op1, mpz_t op2, mpz_t op3, unsigned long op4) {
-    ripemd160_state ctx;
-    ripemd160_init(&ctx);
-
-    size_t countp;
-    unsigned char *datap;
-
-    const size_t
-        s1 = ((mpz_sizeinbase(op1, 2) + 7) / 8) * 8,
-        s2 = ((mpz_sizeinbase(op2, 2) + 7) / 8) * 8,
-        s3 = ((mpz_sizeinbase(op3, 2) + 7) / 8) * 8;
-
-    const size_t
-    toalloc = s1 > s2
-                ? s1 > s3
-                    ? s1 : s3
-                : s2 > s3
-                    ? s2 : s3;
-
-    datap = malloc(toalloc);
-    mpz_export(datap, &countp, 1, 1, -1, 0, op1);
-    ripemd160_update(&ctx, datap, countp);
-    mpz_export(datap, &countp, 1, 1, -1, 0, op2);
-    ripemd160_update(&ctx, datap, countp);
-    mpz_export(datap, &countp, 1, 1, -1, 0, op3);
-    ripemd160_update(&ctx, datap, countp);
-    free(datap);
-
-    // Ripemd160 function will handle different byte ordering for different
-    // endian machines.
-    const uint64_t op4_u64 = (uint64_t) op4;
-    unsigned char *op4_cp = (unsigned char*)&op4_u64;
-    ripemd160_update(&ctx, op4_cp, 8);
-
-    unsigned char hdigest[RIPEMD160_DIGEST_SIZE];
-    ripemd160_digest(&ctx, hdigest);
-    mpz_import(rop, RIPEMD160_DIGEST_SIZE, 1, 1, -1, 0, hdigest);
+unsigned long mpz_coprime_batch(const mpz_t n, mpz_t *op, unsigned long count,
+                                int *valid)
+{
+    unsigned long size = 1, failed;
+    mpz_t *tree, t;
+
+    if (count == 0)
+        return 0;
+
+    while (size < count)
+        size *= 2;
+
+    tree = malloc(sizeof(mpz_t) * 2 * size);
+    if (tree == NULL)
+        return count;
+
+    mpz_init(t);
+    for (unsigned long i = 1; i < 2 * size; ++i)
+        mpz_init_set_ui(tree[i], 1);
+
+    /* Leaves hold each value mod n. Excluded values and padding are 1. */
+    #pragma omp parallel for
+    for (unsigned long i = 0; i < count; ++i) {
+        if (valid == NULL || valid[i])
+            mpz_mod(tree[size + i], op[i], n);
+    }
+
+    /* Each level of the tree is independent and can be formed in parallel */
+    for (unsigned long level = size / 2; level >= 1; level /= 2) {
+        #pragma omp parallel for
+        for (unsigned long i = level; i < 2 * level; ++i) {
+            mpz_mul(tree[i], tree[2*i], tree[2*i + 1]);
+            mpz_mod(tree[i], tree[i], n);
+        }
+    }
+
+    if (valid == NULL) {
+        mpz_gcd(t, tree[1], n);
+        failed = mpz_cmp_ui(t, 1) != 0;
+    }
+    else {
+        failed = coprime_descend(tree, 1, size, count, n, t, valid);
+    }
+
+    for (unsigned long i = 1; i < 2 * size; ++i)
+        mpz_clear(tree[i]);
+    free(tree);
+    mpz_clear(t);
+
+    return failed;
+}
+
+int mpz_validate_batch(const mpz_t n, const mpz_t bound, mpz_t *op,
+                       unsigned long count, int *valid)
+{
+    unsigned long failed = 0;
+
+    for (unsigned long i = 0; i < count; ++i) {
+        const int in_range = mpz_sgn(op[i]) > 0 && mpz_cmp(op[i], bound) < 0;
+        if (valid)
+            valid[i] = in_range;
+        else if (!in_range)
+            return 0;
+        failed += !in_range;
+    }
+
+    failed += mpz_coprime_batch(n, op, count, valid);
+    return failed == 0;
+}
+
+int mpz_invert_batch(mpz_t *rop, mpz_t *op, unsigned long count,
+                     const mpz_t mod)
+{
+    int retval = 0;
+    mpz_t *prefix, inv, t;
+
+    if (count == 0)
+        return 1;
+
+    prefix = malloc(sizeof(mpz_t) * count);
+    if (prefix == NULL)
+        return 0;
+
+    /* prefix[i] = op[0] * ... * op[i] */
+    mpz_init_set(prefix[0], op[0]);
+    for (unsigned long i = 1; i < count; ++i) {
+        mpz_init(prefix[i]);
+        mpz_mul(prefix[i], prefix[i-1], op[i]);
+        mpz_mod(prefix[i], prefix[i], mod);
+    }
+
+    mpz_inits(inv, t, NULL);
+    if (!mpz_invert(inv, prefix[count-1], mod))
+        goto failure;
+
+    /* inv holds (op[0] * ... * op[i])^-1 at the start of each step. op[i] is
+     * read before rop[i] is written, so the arrays may be aliased. */
+    for (unsigned long i = count - 1; i > 0; --i) {
+        mpz_mul(t, inv, prefix[i-1]);
+        mpz_mod(t, t, mod);
+        mpz_mul(inv, inv, op[i]);
+        mpz_mod(inv, inv, mod);
+        mpz_swap(rop[i], t);
+    }
+    mpz_swap(rop[0], inv);
+    retval = 1;
+
+failure:
+    for (unsigned long i = 0; i < count; ++i)
+        mpz_clear(prefix[i]);
+    free(prefix);
+    mpz_clears(inv, t, NULL);
+    return retval;
+}
+
+int mpz_powm_signed(mpz_t rop, const mpz_t base, const mpz_t exp,
+                    const mpz_t order, const mpz_t mod)
+{
+    int retval = 1;
+    mpz_t e, t;
+    mpz_inits(e, t, NULL);
+
+    mpz_fdiv_r(e, exp, order);
+    mpz_mul_2exp(t, e, 1);
+
+    if (mpz_cmp(t, order) > 0) {
+        mpz_sub(e, order, e);
+        if (mpz_invert(t, base, mod))
+            mpz_powm(rop, t, e, mod);
+        else
+            retval = 0;
+    }
+    else {
+        mpz_powm(rop, base, e, mod);
+    }
+
+    mpz_clears(e, t, NULL);
+    return retval;
+}
+
+void mpz_lagrange_coeff(mpz_t rop, const mpz_t delta, const unsigned long *x,
+                        unsigned long count, unsigned long i)
+{
+    mpz_t den;
+    mpz_init_set_ui(den, 1);
+    mpz_set(rop, delta);
+
+    for (unsigned long j = 0; j < count; ++j) {
+        if (j == i)
+            continue;
+
+        mpz_mul_ui(rop, rop, x[j]);
+        if (x[j] > x[i]) {
+            mpz_mul_ui(den, den, x[j] - x[i]);
+        }
+        else {
+            mpz_mul_ui(den, den, x[i] - x[j]);
+            mpz_neg(den, den);
+        }
+    }
+
+    mpz_divexact(rop, rop, den);
+    mpz_clear(den);
+}
+
+void mpz_multi_powm_table(mpz_t *table, mpz_t *base, unsigned long count,
+                          const mpz_t mod)
+{
+    const unsigned long size = 1UL << HCS_MULTI_POWM_WINDOW;
+
+    for (unsigned long i = 0; i < count; ++i) {
+        mpz_t *row = table + i * size;
+        mpz_set_ui(row[0], 1);
+        mpz_mod(row[1], base[i], mod);
+        for (unsigned long j = 2; j < size; ++j) {
+            mpz_mul(row[j], row[j-1], row[1]);
+            mpz_mod(row[j], row[j], mod);
+        }
+    }
+}
+
+void mpz_multi_powm_precomp(mpz_t rop, mpz_t *table, mpz_t *exp,
+                            unsigned long count, const mpz_t mod)
+{
+    const unsigned long mask = (1UL << HCS_MULTI_POWM_WINDOW) - 1;
+    size_t bits = 0;
+
+    for (unsigned long i = 0; i < count; ++i) {
+        if (mpz_sgn(exp[i]) != 0) {
+            const size_t b = mpz_sizeinbase(exp[i], 2);
+            if (b > bits)
+                bits = b;
+        }
+    }
+
+    mpz_set_ui(rop, 1);
+
+    /* The window width divides the limb size, so a window never straddles
+     * two limbs */
+    int started = 0;
+    for (size_t w = (bits + HCS_MULTI_POWM_WINDOW - 1) / HCS_MULTI_POWM_WINDOW;
+            w-- > 0; ) {
+        const size_t bit = w * HCS_MULTI_POWM_WINDOW;
+
+        if (started) {
+            for (int k = 0; k < HCS_MULTI_POWM_WINDOW; ++k) {
+                mpz_mul(rop, rop, rop);
+                mpz_mod(rop, rop, mod);
+            }
+        }
+
+        for (unsigned long i = 0; i < count; ++i) {
+            const unsigned long digit =
+                (mpz_getlimbn(exp[i], bit / GMP_NUMB_BITS)
+                    >> (bit % GMP_NUMB_BITS)) & mask;
+
+            if (digit) {
+                mpz_mul(rop, rop, table[(i << HCS_MULTI_POWM_WINDOW) + digit]);
+                mpz_mod(rop, rop, mod);
+                started = 1;
+            }
+        }
+    }
+
+    /* Reduce in case every exponent was zero and mod is 1 */
+    mpz_mod(rop, rop, mod);
+}
+
+int mpz_multi_powm(mpz_t rop, mpz_t *base, mpz_t *exp, unsigned long count,
+                   const mpz_t mod)
+{
+    const unsigned long size = count << HCS_MULTI_POWM_WINDOW;
+    mpz_t *table = malloc(sizeof(mpz_t) * (size ? size : 1));
+    mpz_t t;
+
+    if (table == NULL)
+        return 0;
+
+    for (unsigned long i = 0; i < size; ++i)
+        mpz_init(table[i]);
+
+    mpz_init(t);
+    mpz_multi_powm_table(table, base, count, mod);
+    mpz_multi_powm_precomp(t, table, exp, count, mod);
+    mpz_swap(rop, t);
+    mpz_clear(t);
+
+    for (unsigned long i = 0; i < size; ++i)
+        mpz_clear(table[i]);
+    free(table);
+    return 1;
+}
+
+void mpz_fixed_powm_table(mpz_t *table, const mpz_t base, mp_bitcnt_t bits,
+                          const mpz_t mod)
+{
+    const unsigned long size = 1UL << HCS_MULTI_POWM_WINDOW;
+    const unsigned long windows = HCS_FIXED_POWM_SIZE(bits) / size;
+
+    mpz_mod(table[1], base, mod);
+    for (unsigned long i = 0; i < windows; ++i) {
+        mpz_t *row = table + i * size;
+
+        /* The base of each window is the one before raised to the size */
+        if (i > 0) {
+            mpz_mul(row[1], row[-1], row[1 - (long)size]);
+            mpz_mod(row[1], row[1], mod);
+        }
+
+        mpz_set_ui(row[0], 1);
+        for (unsigned long j = 2; j < size; ++j) {
+            mpz_mul(row[j], row[j-1], row[1]);
+            mpz_mod(row[j], row[j], mod);
+        }
+    }
+}
+
+void mpz_fixed_powm_precomp(mpz_t rop, mpz_t *table, const mpz_t exp,
+                            mp_bitcnt_t bits, const mpz_t mod)
+{
+    const unsigned long mask = (1UL << HCS_MULTI_POWM_WINDOW) - 1;
+    const unsigned long windows =
+        HCS_FIXED_POWM_SIZE(bits) >> HCS_MULTI_POWM_WINDOW;
+
+    mpz_set_ui(rop, 1);
+    for (unsigned long i = 0; i < windows; ++i) {
+        const size_t bit = i * HCS_MULTI_POWM_WINDOW;
+        const unsigned long digit =
+            (mpz_getlimbn(exp, bit / GMP_NUMB_BITS)
+                >> (bit % GMP_NUMB_BITS)) & mask;
+
+        if (digit) {
+            mpz_mul(rop, rop, table[(i << HCS_MULTI_POWM_WINDOW) + digit]);
+            mpz_mod(rop, rop, mod);
+        }
+    }
+
+    /* Reduce in case exp was zero and mod is 1 */
+    mpz_mod(rop, rop, mod);
 }
 
 #ifdef UTIL_MAIN
@@ -36,6 +36,26 @@ void mpz_zero(mpz_t op);
  */
 void mpz_zeros(mpz_t op, ...);
 
+/**
+ * Sets each of a NULL-terminated list of secret mpz_t to zero, scrubbing
+ * their memory unless the scrub policy is HCS_SCRUB_NONE.
+ */
+void mpz_zeros_secret(mpz_t op, ...);
+
+/**
+ * Sets each of a NULL-terminated list of public mpz_t to zero, scrubbing
+ * their memory only if the scrub policy is HCS_SCRUB_ALL.
+ */
+void mpz_zeros_public(mpz_t op, ...);
+
+/**
+ * Releases a NULL-terminated list of secret mpz_t, scrubbing them first
+ * unless the scrub policy is HCS_SCRUB_NONE. Scratch values derived from
+ * secrets are released with this in place of mpz_clears. Public scratch is
+ * released with mpz_clears and never scrubbed.
+ */
+void mpz_clears_secret(mpz_t op, ...);
+
 /* These are generally not called directly, except for testing purposes */
 void internal_fast_random_prime(mpz_t rop, gmp_randstate_t rstate, mp_bitcnt_t bitcnt);
 void internal_naive_random_prime(mpz_t rop, gmp_randstate_t rstate, mp_bitcnt_t bitcnt);
@@ -74,19 +94,150 @@ void mpz_2crt(mpz_t rop, mpz_t con1_a, mpz_t con1_m, mpz_t con2_a,
               mpz_t con2_m);
 
 /**
- * Generate a random dsa prime @p rop.
+ * Determine which of the @p count values in @p op are coprime to @p n. The
+ * values are multiplied together mod @p n in a product tree, so that a single
+ * gcd is enough when every value is coprime. When a subtree fails, its two
+ * halves are tested in turn until the offending values are isolated.
+ *
+ * If @p valid is not NULL, then on entry any index with a zero flag is
+ * excluded from testing, and on return every remaining index is set to
+ * non-zero if coprime and zero otherwise. If @p valid is NULL only the
+ * single root gcd is computed.
+ *
+ * @return The number of tested values which are not coprime to @p n. If
+ *         @p valid is NULL, this is only zero or non-zero.
+ */
+unsigned long mpz_coprime_batch(const mpz_t n, mpz_t *op, unsigned long count,
+                                int *valid);
+
+/**
+ * Check that each of the @p count values in @p op lies in the range
+ * 0 < op < @p bound and is coprime to @p n, as a ciphertext must. The range
+ * is checked first, and coprimality with mpz_coprime_batch. @p valid is
+ * treated as by mpz_coprime_batch, and if it is NULL the scan stops at the
+ * first value out of range.
+ *
+ * @return non-zero if every value is valid, else zero
+ */
+int mpz_validate_batch(const mpz_t n, const mpz_t bound, mpz_t *op,
+                       unsigned long count, int *valid);
+
+/**
+ * Invert each of the @p count values in @p op modulo @p mod, storing the
+ * results in @p rop, using Montgomery's trick. Only a single modular
+ * inversion is performed, at the cost of three multiplications per value.
+ * @p rop and @p op may be the same array.
+ *
+ * @return non-zero on success, zero if some value is not invertible, in
+ *         which case @p rop is left unmodified
+ */
+int mpz_invert_batch(mpz_t *rop, mpz_t *op, unsigned long count,
+                     const mpz_t mod);
+
+/**
+ * Compute @p base ^ @p exp mod @p mod, where the exponent only matters
+ * modulo @p order. The exponent is reduced into the range
+ * (-@p order / 2, @p order / 2], and a negative exponent is applied to the
+ * inverse of @p base. This is what makes negative and very large scalars
+ * cheap.
+ *
+ * @return non-zero on success, zero if @p base needed to be inverted but is
+ *         not invertible
+ */
+int mpz_powm_signed(mpz_t rop, const mpz_t base, const mpz_t exp,
+                    const mpz_t order, const mpz_t mod);
+
+/**
+ * Compute the Lagrange coefficient at zero of the point x[@p i], among the
+ * @p count distinct non-zero abscissae in @p x, scaled by @p delta. That is,
+ * @p delta times the product over j != i of x[j] / (x[j] - x[i]).
+ *
+ * @p delta must be a multiple of every difference of abscissae, as l! is
+ * when all abscissae lie in [1, l], so that the result is an integer.
  */
-void mpz_random_dsa_prime(mpz_t rop, gmp_randstate_t rstate,
-                          mp_bitcnt_t bitcnt);
+void mpz_lagrange_coeff(mpz_t rop, const mpz_t delta, const unsigned long *x,
+                        unsigned long count, unsigned long i);
+
+/**
+ * Window width, in bits, of the multi-exponentiation tables. Each base has
+ * 2^HCS_MULTI_POWM_WINDOW entries in its table.
+ */
+#define HCS_MULTI_POWM_WINDOW 4
+
+/**
+ * Fill @p table with the powers base[i]^j mod @p mod for 0 <= j <
+ * 2^HCS_MULTI_POWM_WINDOW, with base i occupying the entries starting at
+ * i * 2^HCS_MULTI_POWM_WINDOW. @p table must hold @p count <<
+ * HCS_MULTI_POWM_WINDOW initialised values. A table depends only on the
+ * bases, so it can be reused for any number of exponent vectors.
+ */
+void mpz_multi_powm_table(mpz_t *table, mpz_t *base, unsigned long count,
+                          const mpz_t mod);
+
+/**
+ * Compute the product of base[i]^exp[i] mod @p mod over the @p count bases
+ * whose powers are in @p table, using Straus' interleaved method. The
+ * squarings are shared between all bases, so the cost is that of a single
+ * exponentiation plus one multiplication per non-zero window of each
+ * exponent. The exponents must be non-negative. @p rop must not alias any
+ * exponent or table entry.
+ */
+void mpz_multi_powm_precomp(mpz_t rop, mpz_t *table, mpz_t *exp,
+                            unsigned long count, const mpz_t mod);
+
+/**
+ * Compute the product of base[i]^exp[i] mod @p mod over @p count bases.
+ * This builds a table with mpz_multi_powm_table for a single use.
+ *
+ * @return non-zero on success, zero on allocation failure
+ */
+int mpz_multi_powm(mpz_t rop, mpz_t *base, mpz_t *exp, unsigned long count,
+                   const mpz_t mod);
+
+/**
+ * Number of table entries needed by mpz_fixed_powm_table for exponents of
+ * at most @p bits bits.
+ */
+#define HCS_FIXED_POWM_SIZE(bits) \
+    ((((bits) + HCS_MULTI_POWM_WINDOW - 1) / HCS_MULTI_POWM_WINDOW) \
+        << HCS_MULTI_POWM_WINDOW)
+
+/**
+ * Fill @p table for exponentiations of a fixed @p base by exponents of at
+ * most @p bits bits. Window i holds base^(j * 2^(i * HCS_MULTI_POWM_WINDOW))
+ * mod @p mod for 0 <= j < 2^HCS_MULTI_POWM_WINDOW, in the layout of
+ * mpz_multi_powm_table. @p table must hold HCS_FIXED_POWM_SIZE(@p bits)
+ * initialised values.
+ */
+void mpz_fixed_powm_table(mpz_t *table, const mpz_t base, mp_bitcnt_t bits,
+                          const mpz_t mod);
+
+/**
+ * Compute base^@p exp mod @p mod from a table filled by
+ * mpz_fixed_powm_table. No squarings are needed, so the cost is one
+ * multiplication per non-zero window of @p exp. @p exp must be non-negative
+ * and have at most @p bits bits. @p rop must not alias @p exp or any table
+ * entry.
+ */
+void mpz_fixed_powm_precomp(mpz_t rop, mpz_t *table, const mpz_t exp,
+                            mp_bitcnt_t bits, const mpz_t mod);
+
+/**
+ * Generate a Schnorr group: a prime @p r of @p rbits bits, a prime @p p of
+ * @p pbits or @p pbits + 1 bits with p = 2kr + 1, and a generator @p g of the
+ * subgroup of order @p r in Z_p*. Only @p r and @p p need primality tests,
+ * so this is far cheaper than finding a safe prime of the same size.
+ * @p rbits must be less than @p pbits.
+ */
+void mpz_random_schnorr_group(mpz_t p, mpz_t r, mpz_t g,
+        gmp_randstate_t rstate, mp_bitcnt_t pbits, mp_bitcnt_t rbits);
 
 /**
  * Generate a random value in the multiplicative group @p op*, storing the
  * result in @p rop.
  */
-void mpz_random_in_mult_group(mpz_t rop, gmp_randstate_t rstate, mpz_t op);
-
-void mpz_ripemd_mpz_ul(mpz_t rop, mpz_t op1, unsigned long op2);
-void mpz_ripemd_3mpz_ul(mpz_t rop, mpz_t op1, mpz_t op2, mpz_t op3, unsigned long op4);
+void mpz_random_in_mult_group(mpz_t rop, gmp_randstate_t rstate,
+        const mpz_t op);
 
 #ifdef __cplusplus
 }
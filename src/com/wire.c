@@ -0,0 +1,62 @@
+/*
+ * @file wire.c
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <gmp.h>
+#include "wire.h"
+
+size_t hcs_wire_mpz_size(const mpz_t op)
+{
+    return 4 + (mpz_sgn(op) ? (mpz_sizeinbase(op, 2) + 7) / 8 : 0);
+}
+
+unsigned char* hcs_wire_put_u32(unsigned char *buf, uint32_t v)
+{
+    buf[0] = v >> 24;
+    buf[1] = v >> 16;
+    buf[2] = v >> 8;
+    buf[3] = v;
+    return buf + 4;
+}
+
+unsigned char* hcs_wire_put_mpz(unsigned char *buf, const mpz_t op)
+{
+    size_t len = 0;
+
+    if (mpz_sgn(op))
+        mpz_export(buf + 4, &len, 1, 1, 1, 0, op);
+
+    hcs_wire_put_u32(buf, len);
+    return buf + 4 + len;
+}
+
+uint32_t hcs_wire_get_u32(const unsigned char *buf)
+{
+    return (uint32_t)buf[0] << 24 | (uint32_t)buf[1] << 16 |
+           (uint32_t)buf[2] << 8 | buf[3];
+}
+
+int hcs_wire_read_u32(hcs_transport *t, uint32_t *rop)
+{
+    unsigned char buf[4];
+    if (!hcs_transport_read(t, buf, 4))
+        return 0;
+
+    *rop = hcs_wire_get_u32(buf);
+    return 1;
+}
+
+int hcs_wire_read_mpz(hcs_transport *t, mpz_t rop, size_t max,
+        unsigned char *scratch)
+{
+    uint32_t len;
+    if (!hcs_wire_read_u32(t, &len) || len > max)
+        return 0;
+    if (!hcs_transport_read(t, scratch, len))
+        return 0;
+
+    mpz_import(rop, len, 1, 1, 1, 0, scratch);
+    return 1;
+}
@@ -0,0 +1,47 @@
+/**
+ * @file wire.h
+ *
+ * Compact binary encoding of values sent over an hcs_transport. Integers
+ * are 32-bit big-endian. A non-negative mpz_t is its byte length as an
+ * integer followed by its magnitude in big-endian order, so zero is just a
+ * zero length.
+ */
+
+#ifndef HCS_WIRE_H
+#define HCS_WIRE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <gmp.h>
+#include "../../include/libhcs/hcs_transport.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Number of bytes hcs_wire_put_mpz writes for @p op. */
+size_t hcs_wire_mpz_size(const mpz_t op);
+
+/* Store @p v at @p buf, returning the position after it. */
+unsigned char* hcs_wire_put_u32(unsigned char *buf, uint32_t v);
+
+/* Store the non-negative @p op at @p buf, returning the position after it. */
+unsigned char* hcs_wire_put_mpz(unsigned char *buf, const mpz_t op);
+
+/* Return the integer stored at @p buf. */
+uint32_t hcs_wire_get_u32(const unsigned char *buf);
+
+/* Read an integer from @p t into @p rop. Returns non-zero on success. */
+int hcs_wire_read_u32(hcs_transport *t, uint32_t *rop);
+
+/* Read a value of at most @p max bytes from @p t into @p rop, using
+ * @p scratch of at least @p max bytes. Returns zero if the stream failed or
+ * the value is too long. */
+int hcs_wire_read_mpz(hcs_transport *t, mpz_t rop, size_t max,
+        unsigned char *scratch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
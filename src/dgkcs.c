@@ -0,0 +1,560 @@
+/*
+ * @file dgkcs.c
+ *
+ * Implementation of the Damgard-Geisler-Kroigaard Cryptosystem (dgkcs).
+ *
+ * The primes are chosen with p - 1 = 2 * u * v_p * f_p and q - 1 =
+ * 2 * u * v_q * f_q, for t-bit primes v_p and v_q. A ciphertext is
+ * c = g^m * h^r mod n, where h has order v_p * v_q, so raising c to v_p mod p
+ * removes the mask and leaves (g^v_p)^m, an element of order u. Only zero
+ * maps to 1, which is all a comparison needs, and other plaintexts are found
+ * in a table of the u powers of g^v_p mod p.
+ *
+ * As h has order v_p * v_q, a random exponent of 5t / 2 bits suffices, and
+ * both g and h are fixed, so each exponentiation is done with a fixed-base
+ * table and needs no squarings.
+ */
+
+#include <stdlib.h>
+#include <gmp.h>
+
+#include "../include/libhcs/hcs_random.h"
+#include "../include/libhcs/dgkcs.h"
+#include "com/json.h"
+#include "com/parson.h"
+#include "com/util.h"
+
+/* Number of bits in a plaintext exponent, which is less than u */
+static unsigned long ubits(unsigned long u)
+{
+    unsigned long b = 0;
+    for (; u; u >>= 1) b++;
+    return b;
+}
+
+dgkcs_public_key* dgkcs_init_public_key(void)
+{
+    dgkcs_public_key *pk = malloc(sizeof(dgkcs_public_key));
+    if (!pk) return NULL;
+
+    pk->u = pk->t = pk->rbits = 0;
+    pk->gtab = pk->htab = NULL;
+    mpz_inits(pk->n, pk->g, pk->h, NULL);
+    return pk;
+}
+
+dgkcs_private_key* dgkcs_init_private_key(void)
+{
+    dgkcs_private_key *vk = malloc(sizeof(dgkcs_private_key));
+    if (!vk) return NULL;
+
+    vk->u = vk->t = 0;
+    vk->dlog = NULL;
+    mpz_inits(vk->p, vk->q, vk->vp, vk->vq, vk->g, vk->gp, vk->n, NULL);
+    return vk;
+}
+
+static mpz_t* alloc_table(unsigned long size)
+{
+    mpz_t *table = malloc(sizeof(mpz_t) * size);
+    if (table == NULL)
+        return NULL;
+
+    for (unsigned long i = 0; i < size; ++i)
+        mpz_init(table[i]);
+    return table;
+}
+
+static void free_table(mpz_t *table, unsigned long size)
+{
+    for (unsigned long i = 0; i < size; ++i)
+        mpz_clear(table[i]);
+    free(table);
+}
+
+/* Build the fixed-base tables of g and h from u, t, n, g and h */
+static int public_precompute(dgkcs_public_key *pk)
+{
+    pk->rbits = 5 * pk->t / 2;
+    pk->gtab = alloc_table(HCS_FIXED_POWM_SIZE(ubits(pk->u)));
+    pk->htab = alloc_table(HCS_FIXED_POWM_SIZE(pk->rbits));
+    if (pk->gtab == NULL || pk->htab == NULL)
+        return 0;
+
+    mpz_fixed_powm_table(pk->gtab, pk->g, ubits(pk->u), pk->n);
+    mpz_fixed_powm_table(pk->htab, pk->h, pk->rbits, pk->n);
+    return 1;
+}
+
+static int compare_dlog(const void *a, const void *b)
+{
+    const mp_limb_t x = ((const dgkcs_dlog_entry*)a)->key;
+    const mp_limb_t y = ((const dgkcs_dlog_entry*)b)->key;
+    return (x > y) - (x < y);
+}
+
+/* Derive the remaining private values from p, q, vp, g and u. Returns zero
+ * if g^vp is 1 mod p, or on allocation failure. */
+static int private_precompute(dgkcs_private_key *vk)
+{
+    mpz_mul(vk->n, vk->p, vk->q);
+    mpz_powm(vk->gp, vk->g, vk->vp, vk->p);
+    if (mpz_cmp_ui(vk->gp, 1) == 0)
+        return 0;
+
+    vk->dlog = malloc(sizeof(dgkcs_dlog_entry) * vk->u);
+    if (vk->dlog == NULL)
+        return 0;
+
+    /* Only the low limb of each power is kept, and a match is confirmed
+     * against the full value when decrypting */
+    mpz_t t1;
+    mpz_init_set_ui(t1, 1);
+    for (unsigned long m = 0; m < vk->u; ++m) {
+        vk->dlog[m].key = mpz_getlimbn(t1, 0);
+        vk->dlog[m].m = m;
+        mpz_mul(t1, t1, vk->gp);
+        mpz_mod(t1, t1, vk->p);
+    }
+    mpz_clears_secret(t1, NULL);
+
+    qsort(vk->dlog, vk->u, sizeof(dgkcs_dlog_entry), compare_dlog);
+    return 1;
+}
+
+/* Find a prime v of t bits, and a prime p of about pbits bits with
+ * p - 1 = 2 * u * v * f */
+static void random_dgk_prime(mpz_t p, mpz_t v, gmp_randstate_t rstate,
+        unsigned long u, unsigned long t, unsigned long pbits)
+{
+    mpz_t m, f;
+    mpz_inits(m, f, NULL);
+
+    mpz_random_prime(v, rstate, t - 1);
+    mpz_mul_ui(m, v, 2 * u);
+
+    const unsigned long fbits = pbits - mpz_sizeinbase(m, 2);
+    do {
+        mpz_urandomb(f, rstate, fbits);
+        mpz_setbit(f, fbits - 1);
+        mpz_mul(p, m, f);
+        mpz_add_ui(p, p, 1);
+    } while (mpz_probab_prime_p(p, 25) == 0);
+
+    mpz_clears_secret(m, f, NULL);
+}
+
+/* Find an element of Z_p* of order a * b, for primes a and b, or of order
+ * a if b is 1 */
+static void element_of_order(mpz_t rop, gmp_randstate_t rstate,
+        const mpz_t p, const mpz_t a, unsigned long b)
+{
+    mpz_t e, t1;
+    mpz_inits(e, t1, NULL);
+
+    mpz_sub_ui(e, p, 1);
+    mpz_divexact(e, e, a);
+    mpz_divexact_ui(e, e, b);
+
+    do {
+        mpz_random_in_mult_group(rop, rstate, p);
+        mpz_powm(rop, rop, e, p);
+        mpz_powm_ui(t1, rop, b, p);
+        if (mpz_cmp_ui(t1, 1) == 0)
+            continue;
+        if (b == 1)
+            break;
+        mpz_powm(t1, rop, a, p);
+    } while (mpz_cmp_ui(t1, 1) == 0);
+
+    mpz_clears_secret(e, t1, NULL);
+}
+
+int dgkcs_generate_key_pair(dgkcs_public_key *pk, dgkcs_private_key *vk,
+        hcs_random *hr, const unsigned long bits, const unsigned long umin)
+{
+    const unsigned long pbits = bits / 2;
+    const unsigned long t = bits / 4 < DGKCS_T_BITS ? bits / 4 : DGKCS_T_BITS;
+    int retval = 0;
+
+    if (umin > DGKCS_MAX_U)
+        return 0;
+
+    dgkcs_clear_public_key(pk);
+    dgkcs_clear_private_key(vk);
+
+    mpz_t t1, t2;
+    mpz_inits(t1, t2, NULL);
+
+    mpz_set_ui(t1, umin > 2 ? umin - 1 : 1);
+    mpz_nextprime(t1, t1);
+    if (mpz_cmp_ui(t1, DGKCS_MAX_U) > 0)
+        goto failure;
+
+    /* Leave at least 16 random bits in each cofactor f */
+    const unsigned long u = mpz_get_ui(t1);
+    if (pbits < t + ubits(u) + 18)
+        goto failure;
+
+    random_dgk_prime(vk->p, vk->vp, hr->rstate, u, t, pbits);
+    do {
+        random_dgk_prime(vk->q, vk->vq, hr->rstate, u, t, pbits);
+    } while (mpz_cmp(vk->vp, vk->vq) == 0 || mpz_cmp(vk->p, vk->q) == 0);
+
+    /* g has order u * v_p mod p and u * v_q mod q, and h has order v_p mod
+     * p and v_q mod q */
+    element_of_order(t1, hr->rstate, vk->p, vk->vp, u);
+    element_of_order(t2, hr->rstate, vk->q, vk->vq, u);
+    mpz_2crt(vk->g, t1, vk->p, t2, vk->q);
+    element_of_order(t1, hr->rstate, vk->p, vk->vp, 1);
+    element_of_order(t2, hr->rstate, vk->q, vk->vq, 1);
+    mpz_2crt(pk->h, t1, vk->p, t2, vk->q);
+
+    pk->u = vk->u = u;
+    pk->t = vk->t = t;
+    mpz_mul(pk->n, vk->p, vk->q);
+    mpz_set(pk->g, vk->g);
+
+    retval = public_precompute(pk) && private_precompute(vk);
+
+failure:
+    mpz_clears_secret(t1, t2, NULL);
+    return retval;
+}
+
+/* Set rop = g^m * h^r mod n. rop must not alias r. */
+static void encrypt_exp(const dgkcs_public_key *pk, mpz_t rop,
+        unsigned long m, const mpz_t r)
+{
+    mpz_t t1, t2;
+    mpz_init(t2);
+    mpz_init_set_ui(t1, m);
+
+    mpz_fixed_powm_precomp(t2, pk->gtab, t1, ubits(pk->u), pk->n);
+    mpz_fixed_powm_precomp(rop, pk->htab, r, pk->rbits, pk->n);
+    mpz_mul(rop, rop, t2);
+    mpz_mod(rop, rop, pk->n);
+
+    mpz_clears_secret(t1, t2, NULL);
+}
+
+void dgkcs_encrypt(const dgkcs_public_key *pk, hcs_random *hr, mpz_t rop,
+        mpz_t plain1)
+{
+    mpz_t r;
+    mpz_init(r);
+
+    mpz_urandomb(r, hr->rstate, pk->rbits);
+    encrypt_exp(pk, rop, mpz_fdiv_ui(plain1, pk->u), r);
+
+    mpz_clears_secret(r, NULL);
+}
+
+/* Encrypt the plaintexts m[i] < u into rop[i]. The random state cannot be
+ * shared between threads, so every exponent is drawn before any work is
+ * spread out. */
+static int encrypt_many(const dgkcs_public_key *pk, hcs_random *hr,
+        mpz_t *rop, const unsigned long *m, unsigned long count)
+{
+    mpz_t *r = alloc_table(count);
+    if (r == NULL)
+        return 0;
+
+    for (unsigned long i = 0; i < count; ++i)
+        mpz_urandomb(r[i], hr->rstate, pk->rbits);
+
+    #pragma omp parallel for
+    for (unsigned long i = 0; i < count; ++i)
+        encrypt_exp(pk, rop[i], m[i], r[i]);
+
+    for (unsigned long i = 0; i < count; ++i)
+        mpz_zeros_secret(r[i], NULL);
+    free_table(r, count);
+    return 1;
+}
+
+int dgkcs_encrypt_batch(const dgkcs_public_key *pk, hcs_random *hr,
+        mpz_t *rop, mpz_t *plain, unsigned long count)
+{
+    unsigned long *m = malloc(sizeof(unsigned long) * count);
+    if (m == NULL)
+        return 0;
+
+    for (unsigned long i = 0; i < count; ++i)
+        m[i] = mpz_fdiv_ui(plain[i], pk->u);
+
+    int retval = encrypt_many(pk, hr, rop, m, count);
+    free(m);
+    return retval;
+}
+
+int dgkcs_encrypt_bits(const dgkcs_public_key *pk, hcs_random *hr,
+        mpz_t *rop, mpz_t plain1, unsigned long count)
+{
+    unsigned long *m = malloc(sizeof(unsigned long) * count);
+    if (m == NULL)
+        return 0;
+
+    for (unsigned long i = 0; i < count; ++i)
+        m[i] = mpz_tstbit(plain1, i);
+
+    int retval = encrypt_many(pk, hr, rop, m, count);
+    free(m);
+    return retval;
+}
+
+void dgkcs_reencrypt(const dgkcs_public_key *pk, hcs_random *hr, mpz_t rop,
+        mpz_t op)
+{
+    mpz_t r, t1;
+    mpz_inits(r, t1, NULL);
+
+    mpz_urandomb(r, hr->rstate, pk->rbits);
+    mpz_fixed_powm_precomp(t1, pk->htab, r, pk->rbits, pk->n);
+    mpz_mul(rop, op, t1);
+    mpz_mod(rop, rop, pk->n);
+
+    mpz_clears_secret(r, t1, NULL);
+}
+
+void dgkcs_ep_add(const dgkcs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t plain1)
+{
+    mpz_t t1, t2;
+    mpz_inits(t1, t2, NULL);
+
+    mpz_fdiv_r_ui(t1, plain1, pk->u);
+    mpz_fixed_powm_precomp(t2, pk->gtab, t1, ubits(pk->u), pk->n);
+    mpz_mul(rop, cipher1, t2);
+    mpz_mod(rop, rop, pk->n);
+
+    mpz_clears(t1, t2, NULL);
+}
+
+void dgkcs_ee_add(const dgkcs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t cipher2)
+{
+    mpz_mul(rop, cipher1, cipher2);
+    mpz_mod(rop, rop, pk->n);
+}
+
+int dgkcs_ee_sub(const dgkcs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t cipher2)
+{
+    mpz_t t1;
+    mpz_init(t1);
+
+    int retval = mpz_invert(t1, cipher2, pk->n);
+    if (retval) {
+        mpz_mul(rop, cipher1, t1);
+        mpz_mod(rop, rop, pk->n);
+    }
+
+    mpz_clear(t1);
+    return retval;
+}
+
+void dgkcs_ep_mul(const dgkcs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t plain1)
+{
+    mpz_powm_ui(rop, cipher1, mpz_fdiv_ui(plain1, pk->u), pk->n);
+}
+
+int dgkcs_e_neg(const dgkcs_public_key *pk, mpz_t rop, mpz_t cipher1)
+{
+    mpz_t t1;
+    mpz_init(t1);
+
+    int retval = mpz_invert(t1, cipher1, pk->n);
+    if (retval)
+        mpz_set(rop, t1);
+
+    mpz_clear(t1);
+    return retval;
+}
+
+/* Set rop = cipher1^vp mod p, which is gp^m for the plaintext m */
+static void strip_mask(const dgkcs_private_key *vk, mpz_t rop, mpz_t cipher1)
+{
+    mpz_mod(rop, cipher1, vk->p);
+    mpz_powm(rop, rop, vk->vp, vk->p);
+}
+
+int dgkcs_is_zero(const dgkcs_private_key *vk, mpz_t cipher1)
+{
+    mpz_t t1;
+    mpz_init(t1);
+
+    strip_mask(vk, t1, cipher1);
+    const int retval = mpz_cmp_ui(t1, 1) == 0;
+
+    mpz_clears_secret(t1, NULL);
+    return retval;
+}
+
+void dgkcs_is_zero_batch(const dgkcs_private_key *vk, int *rop,
+        mpz_t *cipher, unsigned long count)
+{
+    #pragma omp parallel for
+    for (unsigned long i = 0; i < count; ++i)
+        rop[i] = dgkcs_is_zero(vk, cipher[i]);
+}
+
+int dgkcs_decrypt(const dgkcs_private_key *vk, mpz_t rop, mpz_t cipher1)
+{
+    int retval = 0;
+    mpz_t z, t1;
+    mpz_inits(z, t1, NULL);
+
+    strip_mask(vk, z, cipher1);
+    const mp_limb_t key = mpz_getlimbn(z, 0);
+
+    /* Find the first entry with this key */
+    unsigned long lo = 0, hi = vk->u;
+    while (lo < hi) {
+        const unsigned long mid = lo + (hi - lo) / 2;
+        if (vk->dlog[mid].key < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    for (; lo < vk->u && vk->dlog[lo].key == key; ++lo) {
+        mpz_powm_ui(t1, vk->gp, vk->dlog[lo].m, vk->p);
+        if (mpz_cmp(t1, z) == 0) {
+            mpz_set_ui(rop, vk->dlog[lo].m);
+            retval = 1;
+            break;
+        }
+    }
+
+    mpz_clears_secret(z, t1, NULL);
+    return retval;
+}
+
+void dgkcs_clear_public_key(dgkcs_public_key *pk)
+{
+    if (pk->gtab) {
+        free_table(pk->gtab, HCS_FIXED_POWM_SIZE(ubits(pk->u)));
+        pk->gtab = NULL;
+    }
+    if (pk->htab) {
+        free_table(pk->htab, HCS_FIXED_POWM_SIZE(pk->rbits));
+        pk->htab = NULL;
+    }
+
+    pk->u = pk->t = pk->rbits = 0;
+    mpz_zeros_public(pk->n, pk->g, pk->h, NULL);
+}
+
+void dgkcs_clear_private_key(dgkcs_private_key *vk)
+{
+    mpz_zeros_secret(vk->p, vk->q, vk->vp, vk->vq, vk->gp, NULL);
+    mpz_zeros_public(vk->g, vk->n, NULL);
+
+    free(vk->dlog);
+    vk->dlog = NULL;
+    vk->u = vk->t = 0;
+}
+
+void dgkcs_free_public_key(dgkcs_public_key *pk)
+{
+    dgkcs_clear_public_key(pk);
+    mpz_clears(pk->n, pk->g, pk->h, NULL);
+    free(pk);
+}
+
+void dgkcs_free_private_key(dgkcs_private_key *vk)
+{
+    dgkcs_clear_private_key(vk);
+    mpz_clears(vk->p, vk->q, vk->vp, vk->vq, vk->g, vk->gp, vk->n, NULL);
+    free(vk);
+}
+
+int dgkcs_verify_key_pair(const dgkcs_public_key *pk,
+        const dgkcs_private_key *vk)
+{
+    return pk->u == vk->u && mpz_cmp(vk->n, pk->n) == 0 &&
+           mpz_cmp(vk->g, pk->g) == 0;
+}
+
+char *dgkcs_export_public_key(const dgkcs_public_key *pk)
+{
+    JSON_Value *root = hcs_json_init_object();
+    if (root == NULL)
+        return NULL;
+
+    JSON_Object *obj = json_value_get_object(root);
+    int ok = json_object_set_number(obj, "u", pk->u) == JSONSuccess &&
+             json_object_set_number(obj, "t", pk->t) == JSONSuccess &&
+             hcs_json_set_mpz(obj, "n", pk->n) &&
+             hcs_json_set_mpz(obj, "g", pk->g) &&
+             hcs_json_set_mpz(obj, "h", pk->h);
+    return hcs_json_finish(root, ok);
+}
+
+char *dgkcs_export_private_key(const dgkcs_private_key *vk)
+{
+    JSON_Value *root = hcs_json_init_object();
+    if (root == NULL)
+        return NULL;
+
+    JSON_Object *obj = json_value_get_object(root);
+    int ok = json_object_set_number(obj, "u", vk->u) == JSONSuccess &&
+             json_object_set_number(obj, "t", vk->t) == JSONSuccess &&
+             hcs_json_set_mpz(obj, "p", vk->p) &&
+             hcs_json_set_mpz(obj, "q", vk->q) &&
+             hcs_json_set_mpz(obj, "vp", vk->vp) &&
+             hcs_json_set_mpz(obj, "vq", vk->vq) &&
+             hcs_json_set_mpz(obj, "g", vk->g);
+    return hcs_json_finish(root, ok);
+}
+
+int dgkcs_import_public_key(dgkcs_public_key *pk, const char *json)
+{
+    unsigned long u, t;
+    dgkcs_clear_public_key(pk);
+
+    JSON_Value *root = json_parse_string(json);
+    JSON_Object *obj = json_value_get_object(root);
+    int ok = hcs_json_get_ulong(obj, "u", &u) &&
+             hcs_json_get_ulong(obj, "t", &t) &&
+             hcs_json_get_mpz(obj, "n", pk->n) &&
+             hcs_json_get_mpz(obj, "g", pk->g) &&
+             hcs_json_get_mpz(obj, "h", pk->h);
+    json_value_free(root);
+    if (!ok || u < 2 || u > DGKCS_MAX_U || mpz_sgn(pk->n) <= 0)
+        return 0;
+
+    /* The randomiser table is sized from 5t / 2 bits, so t is held to the
+     * bound key generation uses before it is multiplied */
+    if (t == 0 || t > DGKCS_T_BITS || 5 * t / 2 >= mpz_sizeinbase(pk->n, 2))
+        return 0;
+
+    pk->u = u;
+    pk->t = t;
+    return public_precompute(pk);
+}
+
+int dgkcs_import_private_key(dgkcs_private_key *vk, const char *json)
+{
+    unsigned long u, t;
+    dgkcs_clear_private_key(vk);
+
+    JSON_Value *root = json_parse_string(json);
+    JSON_Object *obj = json_value_get_object(root);
+    int ok = hcs_json_get_ulong(obj, "u", &u) &&
+             hcs_json_get_ulong(obj, "t", &t) &&
+             hcs_json_get_mpz(obj, "p", vk->p) &&
+             hcs_json_get_mpz(obj, "q", vk->q) &&
+             hcs_json_get_mpz(obj, "vp", vk->vp) &&
+             hcs_json_get_mpz(obj, "vq", vk->vq) &&
+             hcs_json_get_mpz(obj, "g", vk->g);
+    json_value_free(root);
+    if (!ok || u < 2 || u > DGKCS_MAX_U || mpz_sgn(vk->p) <= 0)
+        return 0;
+
+    vk->u = u;
+    vk->t = t;
+    return private_precompute(vk);
+}
@@ -11,26 +11,28 @@
 
 #include "../include/libhcs/hcs_random.h"
 #include "../include/libhcs/djcs.h"
+#include "com/json.h"
 #include "com/parson.h"
 #include "com/util.h"
 
 /*
  * Algorithm as seen in the initial paper. Simple optimizations
- * have been added. rop and op can be aliases.
+ * have been added. rop and op can be aliases. s may be any level up to vk->s.
  */
-static void dlog_s(djcs_private_key *vk, mpz_t rop, mpz_t op)
+static void dlog_s(const djcs_private_key *vk, unsigned long s, mpz_t rop,
+        mpz_t op)
 {
     mpz_t a, t1, t2, t3, kfact;
     mpz_inits(a, t1, t2, t3, kfact, NULL);
 
     /* Optimization: L(a mod n^(j+1)) = L(a mod n^(s+1)) mod n^j
      * where j <= s */
-    mpz_mod(a, op, vk->n[vk->s]);
+    mpz_mod(a, op, vk->n[s]);
     mpz_sub_ui(a, a, 1);
     mpz_divexact(a, a, vk->n[0]);
 
     mpz_set_ui(rop, 0);
-    for (unsigned long j = 1; j <= vk->s; ++j) {
+    for (unsigned long j = 1; j <= s; ++j) {
         /* t1 = L(a mod n^j+1) */
         mpz_mod(t1, a, vk->n[j-1]);
 
@@ -60,8 +62,8 @@ static void dlog_s(djcs_private_key *vk, mpz_t rop, mpz_t op)
         mpz_set(rop, t1);
     }
 
-    mpz_zeros(a, t1, t2, t3, kfact, NULL);
-    mpz_clears(a, t1, t2, t3, kfact, NULL);
+    mpz_clears_secret(a, t1, t2, t3, NULL);
+    mpz_clear(kfact);
 }
 
 djcs_public_key* djcs_init_public_key(void)
@@ -121,7 +123,7 @@ int djcs_generate_key_pair(djcs_public_key *pk, djcs_private_key *vk,
     }
 
     mpz_powm(vk->mu, pk->g, vk->d, vk->n[vk->s]);
-    dlog_s(vk, vk->mu, vk->mu);
+    dlog_s(vk, vk->s, vk->mu, vk->mu);
     mpz_invert(vk->mu, vk->mu, vk->n[vk->s-1]);
 
     mpz_clear(p);
@@ -130,7 +132,8 @@ int djcs_generate_key_pair(djcs_public_key *pk, djcs_private_key *vk,
     return 0;
 }
 
-void djcs_encrypt(djcs_public_key *pk, hcs_random *hr, mpz_t rop, mpz_t plain1)
+void djcs_encrypt(const djcs_public_key *pk, hcs_random *hr, mpz_t rop,
+        mpz_t plain1)
 {
     mpz_t t1;
     mpz_init(t1);
@@ -144,7 +147,23 @@ void djcs_encrypt(djcs_public_key *pk, hcs_random *hr, mpz_t rop, mpz_t plain1)
     mpz_clear(t1);
 }
 
-void djcs_reencrypt(djcs_public_key *pk, hcs_random *hr, mpz_t rop, mpz_t op)
+void djcs_encrypt_s(const djcs_public_key *pk, hcs_random *hr, mpz_t rop,
+        mpz_t plain1, unsigned long s)
+{
+    mpz_t t1;
+    mpz_init(t1);
+
+    mpz_random_in_mult_group(t1, hr->rstate, pk->n[0]);
+    mpz_powm(rop, pk->g, plain1, pk->n[s]);
+    mpz_powm(t1, t1, pk->n[s-1], pk->n[s]);
+    mpz_mul(rop, rop, t1);
+    mpz_mod(rop, rop, pk->n[s]);
+
+    mpz_clear(t1);
+}
+
+void djcs_reencrypt(const djcs_public_key *pk, hcs_random *hr, mpz_t rop,
+        mpz_t op)
 {
     mpz_t t1;
     mpz_init(t1);
@@ -157,7 +176,8 @@ void djcs_reencrypt(djcs_public_key *pk, hcs_random *hr, mpz_t rop, mpz_t op)
     mpz_clear(t1);
 }
 
-void djcs_ep_add(djcs_public_key *pk, mpz_t rop, mpz_t cipher1, mpz_t plain1)
+void djcs_ep_add(const djcs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t plain1)
 {
     mpz_t t1;
     mpz_init(t1);
@@ -170,169 +190,284 @@ void djcs_ep_add(djcs_public_key *pk, mpz_t rop, mpz_t cipher1, mpz_t plain1)
     mpz_clear(t1);
 }
 
-void djcs_ee_add(djcs_public_key *pk, mpz_t rop, mpz_t cipher1, mpz_t cipher2)
+void djcs_ee_add(const djcs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t cipher2)
 {
     mpz_mul(rop, cipher1, cipher2);
     mpz_mod(rop, rop, pk->n[pk->s]);
 }
 
-void djcs_ep_mul(djcs_public_key *pk, mpz_t rop, mpz_t cipher1, mpz_t plain1)
+int djcs_ep_mul(const djcs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t plain1)
+{
+    return mpz_powm_signed(rop, cipher1, plain1, pk->n[pk->s-1], pk->n[pk->s]);
+}
+
+int djcs_e_neg(const djcs_public_key *pk, mpz_t rop, mpz_t cipher1)
 {
-    mpz_powm(rop, cipher1, plain1, pk->n[pk->s]);
+    mpz_t t1;
+    mpz_init(t1);
+
+    int retval = mpz_invert(t1, cipher1, pk->n[pk->s]);
+    if (retval)
+        mpz_set(rop, t1);
+
+    mpz_clear(t1);
+    return retval;
 }
 
-void djcs_decrypt(djcs_private_key *vk, mpz_t rop, mpz_t cipher1)
+int djcs_ee_sub(const djcs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t cipher2)
+{
+    mpz_t t1;
+    mpz_init(t1);
+
+    int retval = mpz_invert(t1, cipher2, pk->n[pk->s]);
+    if (retval) {
+        mpz_mul(rop, cipher1, t1);
+        mpz_mod(rop, rop, pk->n[pk->s]);
+    }
+
+    mpz_clear(t1);
+    return retval;
+}
+
+void djcs_ep_sub(const djcs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t plain1)
+{
+    mpz_t t1, t2, t3;
+    mpz_inits(t1, t2, t3, NULL);
+
+    /* As g = n + 1, g^x = sum_{i=0}^{s} C(x, i) * n^i mod n^(s+1), which
+     * takes s binomial coefficients in place of a full exponentiation */
+    mpz_neg(t1, plain1);
+    mpz_mod(t1, t1, pk->n[pk->s-1]);
+    mpz_set_ui(t2, 1);
+    for (unsigned long i = 1; i <= pk->s; ++i) {
+        mpz_bin_ui(t3, t1, i);
+        mpz_mod(t3, t3, pk->n[pk->s-i]);
+        mpz_addmul(t2, t3, pk->n[i-1]);
+    }
+
+    mpz_mul(rop, cipher1, t2);
+    mpz_mod(rop, rop, pk->n[pk->s]);
+
+    mpz_clears(t1, t2, t3, NULL);
+}
+
+int djcs_e_neg_batch(const djcs_public_key *pk, mpz_t *rop, mpz_t *cipher,
+        unsigned long count)
+{
+    return mpz_invert_batch(rop, cipher, count, pk->n[pk->s]);
+}
+
+int djcs_ee_sub_batch(const djcs_public_key *pk, mpz_t *rop, mpz_t *cipher1,
+        mpz_t *cipher2, unsigned long count)
+{
+    int retval = 0;
+    mpz_t *inv = malloc(sizeof(mpz_t) * count);
+    if (inv == NULL)
+        return 0;
+
+    for (unsigned long i = 0; i < count; ++i)
+        mpz_init(inv[i]);
+
+    if (!mpz_invert_batch(inv, cipher2, count, pk->n[pk->s]))
+        goto failure;
+
+    #pragma omp parallel for
+    for (unsigned long i = 0; i < count; ++i) {
+        mpz_mul(rop[i], cipher1[i], inv[i]);
+        mpz_mod(rop[i], rop[i], pk->n[pk->s]);
+    }
+    retval = 1;
+
+failure:
+    for (unsigned long i = 0; i < count; ++i)
+        mpz_clear(inv[i]);
+    free(inv);
+    return retval;
+}
+
+void djcs_decrypt(const djcs_private_key *vk, mpz_t rop, mpz_t cipher1)
 {
     mpz_powm(rop, cipher1, vk->d, vk->n[vk->s]);
-    dlog_s(vk, rop, rop);
+    dlog_s(vk, vk->s, rop, rop);
     mpz_mul(rop, rop, vk->mu);
     mpz_mod(rop, rop, vk->n[vk->s-1]);
 }
 
+void djcs_decrypt_s(const djcs_private_key *vk, mpz_t rop, mpz_t cipher1,
+        unsigned long s)
+{
+    mpz_t t1;
+    mpz_init(t1);
+
+    /* mu is d^-1 mod n^s for the key's s, and an inverse modulo n^s is also
+     * an inverse modulo every lower power of n */
+    mpz_mod(t1, vk->mu, vk->n[s-1]);
+    mpz_powm(rop, cipher1, vk->d, vk->n[s]);
+    dlog_s(vk, s, rop, rop);
+    mpz_mul(rop, rop, t1);
+    mpz_mod(rop, rop, vk->n[s-1]);
+
+    mpz_clears_secret(t1, NULL);
+}
+
 void djcs_clear_public_key(djcs_public_key *pk)
 {
     if (pk->n) {
-        for (unsigned long i = 0; i < pk->s; ++i) {
-            mpz_zero(pk->n[i]);
+        for (unsigned long i = 0; i <= pk->s; ++i) {
+            mpz_zeros_public(pk->n[i], NULL);
             mpz_clear(pk->n[i]);
         }
         free(pk->n);
+        pk->n = NULL;
     }
 
-    mpz_zero(pk->g);
+    mpz_zeros_public(pk->g, NULL);
 }
 
 void djcs_clear_private_key(djcs_private_key *vk)
 {
     if (vk->n) {
-        for (unsigned long i = 0; i < vk->s; ++i) {
-            mpz_zero(vk->n[i]);
+        for (unsigned long i = 0; i <= vk->s; ++i)
             mpz_clear(vk->n[i]);
-        }
         free(vk->n);
+        vk->n = NULL;
     }
 
-    mpz_zero(vk->mu);
-    mpz_zero(vk->d);
+    mpz_zeros_secret(vk->mu, vk->d, NULL);
 }
 
 void djcs_free_public_key(djcs_public_key *pk)
 {
-    if (pk->n) {
-        for (unsigned long i = 0; i <= pk->s; ++i) {
-            mpz_zero(pk->n[i]);
-            mpz_clear(pk->n[i]);
-        }
-        free(pk->n);
-    }
-
+    djcs_clear_public_key(pk);
     mpz_clear(pk->g);
     free(pk);
 }
 
 void djcs_free_private_key(djcs_private_key *vk)
 {
-    if (vk->n) {
-        for (unsigned long i = 0; i <= vk->s; ++i) {
-            mpz_zero(vk->n[i]);
-            mpz_clear(vk->n[i]);
-        }
-        free(vk->n);
-    }
-
-    mpz_clear(vk->mu);
-    mpz_clear(vk->d);
+    djcs_clear_private_key(vk);
+    mpz_clears(vk->mu, vk->d, NULL);
     free(vk);
 }
 
-int djcs_verify_key_pair(djcs_public_key *pk, djcs_private_key *vk)
+int djcs_verify_key_pair(const djcs_public_key *pk, const djcs_private_key *vk)
 {
     return (mpz_cmp(vk->n[0], pk->n[0]) == 0) && (pk->s == vk->s);
 }
 
-char *djcs_export_public_key(djcs_public_key *pk)
+int djcs_validate_batch(const djcs_public_key *pk, mpz_t *cipher,
+        unsigned long count, int *valid)
 {
-    char *buffer;
-    char *retstr;
+    return mpz_validate_batch(pk->n[0], pk->n[pk->s], cipher, count, valid);
+}
 
-    JSON_Value *root = json_value_init_object();
-    JSON_Object *obj  = json_value_get_object(root);
-    buffer = mpz_get_str(NULL, HCS_INTERNAL_BASE, pk->n[0]);
-    json_object_set_number(obj, "s", pk->s);
-    json_object_set_string(obj, "n", buffer);
-    retstr = json_serialize_to_string(root);
+char *djcs_export_public_key(const djcs_public_key *pk)
+{
+    JSON_Value *root = hcs_json_init_object();
+    if (root == NULL)
+        return NULL;
 
-    json_value_free(root);
-    free(buffer);
-    return retstr;
+    JSON_Object *obj = json_value_get_object(root);
+    int ok = json_object_set_number(obj, "s", pk->s) == JSONSuccess &&
+             hcs_json_set_mpz(obj, "n", pk->n[0]);
+    return hcs_json_finish(root, ok);
 }
 
-char *djcs_export_private_key(djcs_private_key *vk)
+char *djcs_export_private_key(const djcs_private_key *vk)
 {
-    char *buffer;
-    char *retstr;
-
-    /* Allocate space for largest buffer output value used */
-    size_t buffer_size = mpz_sizeinbase((mpz_cmp(vk->n[0], vk->d) >= 0
-            ? vk->n[0] : vk->d), HCS_INTERNAL_BASE) + 2;
-    buffer = malloc(buffer_size);
+    JSON_Value *root = hcs_json_init_object();
+    if (root == NULL)
+        return NULL;
 
-    JSON_Value *root = json_value_init_object();
     JSON_Object *obj = json_value_get_object(root);
-    json_object_set_number(obj, "s", vk->s);
-    mpz_get_str(buffer, HCS_INTERNAL_BASE, vk->n[0]);
-    json_object_set_string(obj, "n", buffer);
-    mpz_get_str(buffer, HCS_INTERNAL_BASE, vk->d);
-    json_object_set_string(obj, "d", buffer);
-    retstr = json_serialize_to_string(root);
+    int ok = json_object_set_number(obj, "s", vk->s) == JSONSuccess &&
+             hcs_json_set_mpz(obj, "n", vk->n[0]) &&
+             hcs_json_set_mpz(obj, "d", vk->d);
+    return hcs_json_finish(root, ok);
+}
 
-    json_value_free(root);
-    free(buffer);
-    return retstr;
+/* Allocate @p *rop and set it to the powers n^1, ..., n^(s+1) of the value
+ * of "n" in @p obj. Returns zero if the value is missing or malformed. */
+static int import_modulus(const JSON_Object *obj, unsigned long s,
+        mpz_t **rop)
+{
+    mpz_t *n = malloc(sizeof(mpz_t) * (s + 1));
+    if (n == NULL)
+        return 0;
+
+    mpz_init(n[0]);
+    if (!hcs_json_get_mpz(obj, "n", n[0]) || mpz_cmp_ui(n[0], 1) <= 0) {
+        mpz_clear(n[0]);
+        free(n);
+        return 0;
+    }
+
+    for (unsigned long i = 1; i <= s; ++i) {
+        mpz_init(n[i]);
+        mpz_mul(n[i], n[i-1], n[0]);
+    }
+
+    *rop = n;
+    return 1;
 }
 
 int djcs_import_public_key(djcs_public_key *pk, const char *json)
 {
+    unsigned long s;
+    mpz_t *n;
     JSON_Value *root = json_parse_string(json);
     JSON_Object *obj = json_value_get_object(root);
-    pk->s = json_object_get_number(obj, "s");
-    pk->n = malloc(sizeof(mpz_t) * (pk->s + 1));
 
-    mpz_init(pk->n[0]);
-    mpz_set_str(pk->n[0], json_object_get_string(obj, "n"), HCS_INTERNAL_BASE);
+    if (!hcs_json_get_ulong(obj, "s", &s) || s < 1 ||
+            !import_modulus(obj, s, &n)) {
+        json_value_free(root);
+        return 0;
+    }
     json_value_free(root);
 
+    /* Any key previously held is replaced */
+    djcs_clear_public_key(pk);
+    pk->s = s;
+    pk->n = n;
+
     /* Calculate remaining values */
     mpz_add_ui(pk->g, pk->n[0], 1);
-    for (unsigned long i = 1; i <= pk->s; ++i) {
-        mpz_init_set(pk->n[i], pk->n[i-1]);
-        mpz_mul(pk->n[i], pk->n[i], pk->n[0]);
-    }
-
-    return 0;
+    return 1;
 }
 
 int djcs_import_private_key(djcs_private_key *vk, const char *json)
 {
+    unsigned long s;
+    mpz_t *n;
     JSON_Value *root = json_parse_string(json);
     JSON_Object *obj = json_value_get_object(root);
-    vk->s = json_object_get_number(obj, "s");
-    vk->n = malloc(sizeof(mpz_t) * (vk->s + 1));
 
-    mpz_init(vk->n[0]);
-    mpz_set_str(vk->n[0], json_object_get_string(obj, "n"), HCS_INTERNAL_BASE);
-    mpz_set_str(vk->d, json_object_get_string(obj, "d"), HCS_INTERNAL_BASE);
-    json_value_free(root);
+    if (!hcs_json_get_ulong(obj, "s", &s) || s < 1 ||
+            !import_modulus(obj, s, &n)) {
+        json_value_free(root);
+        return 0;
+    }
 
-    /* Calculate remaining values */
-    for (unsigned long i = 1; i <= vk->s; ++i) {
-        mpz_init_set(vk->n[i], vk->n[i-1]);
-        mpz_mul(vk->n[i], vk->n[i], vk->n[0]);
+    /* Any key previously held is replaced */
+    djcs_clear_private_key(vk);
+    vk->s = s;
+    vk->n = n;
+
+    int ok = hcs_json_get_mpz(obj, "d", vk->d);
+    json_value_free(root);
+    if (!ok) {
+        djcs_clear_private_key(vk);
+        return 0;
     }
 
+    /* Calculate remaining values */
     mpz_add_ui(vk->mu, vk->n[0], 1);
     mpz_powm(vk->mu, vk->mu, vk->d, vk->n[vk->s]);
-    dlog_s(vk, vk->mu, vk->mu);
+    dlog_s(vk, vk->s, vk->mu, vk->mu);
     mpz_invert(vk->mu, vk->mu, vk->n[vk->s-1]);
-    return 0;
+    return 1;
 }
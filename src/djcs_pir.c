@@ -0,0 +1,354 @@
+/*
+ * @file djcs_pir.c
+ *
+ * Recursive private information retrieval over djcs.
+ *
+ * Intermediate ciphertexts are stored chunk-major, so that the inputs of a
+ * column at the next level, one per position along the dimension being
+ * folded, are contiguous and can be passed directly as exponents.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <gmp.h>
+
+#include "../include/libhcs/hcs_random.h"
+#include "../include/libhcs/djcs.h"
+#include "../include/libhcs/djcs_pir.h"
+#include "com/util.h"
+
+/* Smallest r such that r^k >= x */
+static unsigned long ceil_root(unsigned long x, unsigned long k)
+{
+    unsigned long r;
+    mpz_t t;
+    mpz_init_set_ui(t, x);
+
+    mpz_root(t, t, k);
+    r = mpz_get_ui(t);
+    mpz_pow_ui(t, t, k);
+    if (mpz_cmp_ui(t, x) < 0)
+        r++;
+
+    mpz_clear(t);
+    return r;
+}
+
+static mpz_t* init_array(unsigned long count)
+{
+    mpz_t *a = malloc(sizeof(mpz_t) * (count ? count : 1));
+    if (a == NULL)
+        return NULL;
+
+    for (unsigned long i = 0; i < count; ++i)
+        mpz_init(a[i]);
+    return a;
+}
+
+static void free_array(mpz_t *a, unsigned long count)
+{
+    if (a == NULL)
+        return;
+
+    for (unsigned long i = 0; i < count; ++i)
+        mpz_clear(a[i]);
+    free(a);
+}
+
+djcs_pir_params* djcs_pir_init_params(const djcs_public_key *pk,
+        unsigned long records, size_t record_size, unsigned long d)
+{
+    if (d == 0 || d > pk->s || records == 0 || record_size == 0)
+        return NULL;
+
+    djcs_pir_params *pp = malloc(sizeof(djcs_pir_params));
+    if (pp == NULL)
+        return NULL;
+
+    pp->dim = malloc(sizeof(unsigned long) * d);
+    if (pp->dim == NULL)
+        goto failure;
+
+    pp->pk = pk;
+    pp->d = d;
+    pp->records = records;
+    pp->record_size = record_size;
+
+    /* Spare levels go to the first dimension, whose plaintexts are records */
+    pp->s = pk->s - d + 1;
+    pp->chunk_size = (mpz_sizeinbase(pk->n[pp->s-1], 2) - 1) / 8;
+    if (pp->chunk_size == 0)
+        goto failure;
+    pp->chunks = (record_size + pp->chunk_size - 1) / pp->chunk_size;
+
+    /* Each dimension covers what remains of the records as evenly as
+     * possible, so the padding is limited to the last dimension */
+    unsigned long covered = 1;
+    pp->query_size = 0;
+    for (unsigned long j = 0; j < d; ++j) {
+        const unsigned long remaining = (records + covered - 1) / covered;
+        pp->dim[j] = ceil_root(remaining, d - j);
+        covered *= pp->dim[j];
+        pp->query_size += pp->dim[j];
+    }
+
+    return pp;
+
+failure:
+    free(pp->dim);
+    free(pp);
+    return NULL;
+}
+
+void djcs_pir_free_params(djcs_pir_params *pp)
+{
+    free(pp->dim);
+    free(pp);
+}
+
+djcs_pir_db* djcs_pir_open_db(const char *path)
+{
+    struct stat st;
+    djcs_pir_db *db = malloc(sizeof(djcs_pir_db));
+    if (db == NULL)
+        return NULL;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        goto failure;
+
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        goto failure;
+    }
+
+    db->size = st.st_size;
+    db->data = NULL;
+    db->mapped = 0;
+
+    if (db->size) {
+        void *data = mmap(NULL, db->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            goto failure;
+        }
+
+        /* The first dimension is scanned front to back */
+        posix_madvise(data, db->size, POSIX_MADV_SEQUENTIAL);
+        db->data = data;
+        db->mapped = 1;
+    }
+
+    close(fd);
+    return db;
+
+failure:
+    free(db);
+    return NULL;
+}
+
+djcs_pir_db* djcs_pir_init_db(const void *data, size_t size)
+{
+    djcs_pir_db *db = malloc(sizeof(djcs_pir_db));
+    if (db == NULL)
+        return NULL;
+
+    db->data = data;
+    db->size = size;
+    db->mapped = 0;
+    return db;
+}
+
+void djcs_pir_free_db(djcs_pir_db *db)
+{
+    if (db->mapped)
+        munmap((void *)db->data, db->size);
+    free(db);
+}
+
+int djcs_pir_query(const djcs_pir_params *pp, hcs_random *hr, mpz_t *query,
+        unsigned long index)
+{
+    if (index >= pp->records)
+        return 0;
+
+    mpz_t t;
+    mpz_init(t);
+
+    unsigned long offset = 0;
+    for (unsigned long j = 0; j < pp->d; ++j) {
+        const unsigned long coord = index % pp->dim[j];
+        index /= pp->dim[j];
+
+        for (unsigned long i = 0; i < pp->dim[j]; ++i) {
+            mpz_set_ui(t, i == coord);
+            djcs_encrypt_s(pp->pk, hr, query[offset + i], t, pp->s + j);
+        }
+        offset += pp->dim[j];
+    }
+
+    mpz_clears_secret(t, NULL);
+    return 1;
+}
+
+/* Fold the database along the first dimension. out holds pp->chunks rows of
+ * cols ciphertexts at level pp->s. */
+static int respond_first(const djcs_pir_params *pp, const djcs_pir_db *db,
+        mpz_t *out, unsigned long cols, mpz_t *table)
+{
+    const unsigned long dim = pp->dim[0];
+    const mpz_srcptr mod = pp->pk->n[pp->s];
+    int failed = 0;
+
+    #pragma omp parallel
+    {
+        mpz_t *exp = init_array(dim);
+        if (exp == NULL)
+            __atomic_store_n(&failed, 1, __ATOMIC_RELAXED);
+
+        #pragma omp for schedule(dynamic)
+        for (unsigned long c = 0; c < cols; ++c) {
+            if (exp == NULL)
+                continue;
+
+            for (unsigned long k = 0; k < pp->chunks; ++k) {
+                const size_t offset = k * pp->chunk_size;
+                const size_t len = pp->record_size - offset < pp->chunk_size ?
+                                   pp->record_size - offset : pp->chunk_size;
+
+                for (unsigned long i = 0; i < dim; ++i) {
+                    const unsigned long r = c * dim + i;
+
+                    if (r < pp->records)
+                        mpz_import(exp[i], len, 1, 1, 1, 0, db->data +
+                                   r * pp->record_size + offset);
+                    else
+                        mpz_set_ui(exp[i], 0);
+                }
+
+                mpz_multi_powm_precomp(out[k * cols + c], table, exp, dim,
+                                       mod);
+            }
+        }
+
+        free_array(exp, dim);
+    }
+
+    return !failed;
+}
+
+/* Fold the ciphertexts in prev along dimension j, where prev holds
+ * pp->chunks rows of cols * pp->dim[j] ciphertexts. */
+static void respond_next(const djcs_pir_params *pp, unsigned long j,
+        mpz_t *out, mpz_t *prev, unsigned long cols, mpz_t *table)
+{
+    const unsigned long dim = pp->dim[j];
+    const mpz_srcptr mod = pp->pk->n[pp->s + j];
+    const unsigned long total = pp->chunks * cols;
+
+    #pragma omp parallel for schedule(dynamic)
+    for (unsigned long x = 0; x < total; ++x) {
+        const unsigned long k = x / cols, c = x % cols;
+        mpz_multi_powm_precomp(out[x], table, prev + (k * cols + c) * dim,
+                               dim, mod);
+    }
+}
+
+int djcs_pir_respond(const djcs_pir_params *pp, const djcs_pir_db *db,
+        mpz_t *answer, mpz_t *query)
+{
+    int retval = 0;
+    unsigned long max_dim = 0, cols = 1, table_size;
+    mpz_t *table = NULL, *prev = NULL, *out = NULL;
+    unsigned long prev_size = 0, out_size = 0;
+
+    if (db->size / pp->record_size < pp->records)
+        return 0;
+
+    for (unsigned long j = 0; j < pp->d; ++j) {
+        if (pp->dim[j] > max_dim)
+            max_dim = pp->dim[j];
+        if (j > 0)
+            cols *= pp->dim[j];
+    }
+
+    table_size = max_dim << HCS_MULTI_POWM_WINDOW;
+    table = init_array(table_size);
+    if (table == NULL)
+        goto failure;
+
+    out_size = pp->chunks * cols;
+    out = init_array(out_size);
+    if (out == NULL)
+        goto failure;
+
+    mpz_multi_powm_table(table, query, pp->dim[0], pp->pk->n[pp->s]);
+    if (!respond_first(pp, db, out, cols, table))
+        goto failure;
+
+    unsigned long offset = pp->dim[0];
+    for (unsigned long j = 1; j < pp->d; ++j) {
+        free_array(prev, prev_size);
+        prev = out;
+        prev_size = out_size;
+
+        cols /= pp->dim[j];
+        out_size = pp->chunks * cols;
+        out = init_array(out_size);
+        if (out == NULL)
+            goto failure;
+
+        mpz_multi_powm_table(table, query + offset, pp->dim[j],
+                             pp->pk->n[pp->s + j]);
+        respond_next(pp, j, out, prev, cols, table);
+        offset += pp->dim[j];
+    }
+
+    for (unsigned long k = 0; k < pp->chunks; ++k)
+        mpz_swap(answer[k], out[k]);
+    retval = 1;
+
+failure:
+    free_array(table, table_size);
+    free_array(prev, prev_size);
+    free_array(out, out_size);
+    return retval;
+}
+
+int djcs_pir_decode(const djcs_pir_params *pp, const djcs_private_key *vk,
+        unsigned char *record, mpz_t *answer)
+{
+    int retval = 0;
+    mpz_t t;
+    mpz_init(t);
+
+    for (unsigned long k = 0; k < pp->chunks; ++k) {
+        const size_t offset = k * pp->chunk_size;
+        const size_t len = pp->record_size - offset < pp->chunk_size ?
+                           pp->record_size - offset : pp->chunk_size;
+
+        /* Peel the layers from the outermost dimension inwards */
+        mpz_set(t, answer[k]);
+        for (unsigned long j = pp->d; j-- > 0; )
+            djcs_decrypt_s(vk, t, t, pp->s + j);
+
+        const size_t count = (mpz_sizeinbase(t, 2) + 7) / 8;
+        if (count > len)
+            goto failure;
+
+        memset(record + offset, 0, len);
+        if (mpz_sgn(t) != 0)
+            mpz_export(record + offset + len - count, NULL, 1, 1, 1, 0, t);
+    }
+    retval = 1;
+
+failure:
+    mpz_clears_secret(t, NULL);
+    return retval;
+}
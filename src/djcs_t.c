@@ -22,26 +22,28 @@
 #include <gmp.h>
 
 #include "../include/libhcs/hcs_random.h"
+#include "../include/libhcs/hcs_shares.h"
 #include "../include/libhcs/djcs_t.h"
+#include "com/combiner.h"
 #include "com/util.h"
 
-static void dlog_s(djcs_t_private_key *vk, mpz_t rop, mpz_t op)
+static void dlog_s(const djcs_t_public_key *pk, mpz_t rop, mpz_t op)
 {
     mpz_t a, t1, t2, t3, kfact;
     mpz_inits(a, t1, t2, t3, kfact, NULL);
 
     /* Optimization: L(a mod n^(j+1)) = L(a mod n^(s+1)) mod n^j
      * where j <= s */
-    mpz_mod(a, op, vk->n[vk->s]);
+    mpz_mod(a, op, pk->n[pk->s]);
     mpz_sub_ui(a, a, 1);
-    mpz_divexact(a, a, vk->n[0]);
+    mpz_divexact(a, a, pk->n[0]);
 
     /* rop and op can be aliased; store value in a */
     mpz_set_ui(rop, 0);
 
-    for (unsigned long j = 1; j <= vk->s; ++j) {
+    for (unsigned long j = 1; j <= pk->s; ++j) {
         /* t1 = L(a mod n^j+1) */
-        mpz_mod(t1, a, vk->n[j-1]);
+        mpz_mod(t1, a, pk->n[j-1]);
 
         /* t2 = i */
         mpz_set(t2, rop);
@@ -54,23 +56,23 @@ static void dlog_s(djcs_t_private_key *vk, mpz_t rop, mpz_t op)
 
             /* t2 = t2 * i mod n^j */
             mpz_mul(t2, t2, rop);
-            mpz_mod(t2, t2, vk->n[j-1]);
+            mpz_mod(t2, t2, pk->n[j-1]);
 
             /* t1 = t1 - (t2 * n^(k-1)) * k!^(-1)) mod n^j */
-            mpz_invert(t3, kfact, vk->n[j-1]);
+            mpz_invert(t3, kfact, pk->n[j-1]);
             mpz_mul(t3, t3, t2);
-            mpz_mod(t3, t3, vk->n[j-1]);
-            mpz_mul(t3, t3, vk->n[k-2]);
-            mpz_mod(t3, t3, vk->n[j-1]);
+            mpz_mod(t3, t3, pk->n[j-1]);
+            mpz_mul(t3, t3, pk->n[k-2]);
+            mpz_mod(t3, t3, pk->n[j-1]);
             mpz_sub(t1, t1, t3);
-            mpz_mod(t1, t1, vk->n[j-1]);
+            mpz_mod(t1, t1, pk->n[j-1]);
         }
 
         mpz_set(rop, t1);
     }
 
-    mpz_zeros(a, t1, t2, t3, kfact, NULL);
-    mpz_clears(a, t1, t2, t3, kfact, NULL);
+    mpz_clears_secret(a, t1, t2, t3, NULL);
+    mpz_clear(kfact);
 }
 
 #if 0
@@ -88,7 +90,9 @@ djcs_t_public_key* djcs_t_init_public_key(void)
     djcs_t_public_key *pk = malloc(sizeof(djcs_t_public_key));
     if (!pk) return NULL;
 
-    mpz_init(pk->g);
+    pk->w = pk->l = pk->s = 0;
+    pk->n = NULL;
+    mpz_inits(pk->g, pk->delta, NULL);
     return pk;
 }
 
@@ -98,9 +102,11 @@ djcs_t_private_key* djcs_t_init_private_key(void)
     if (!vk) return NULL;
 
     vk->w = vk->l = vk->s = 0;
+    vk->n = NULL;
+    vk->vi = NULL;
     mpz_inits(vk->p, vk->ph, vk->q, vk->qh,
              vk->v, vk->nsm, vk->m,
-             vk->d, vk->delta, NULL);
+             vk->d, NULL);
 
     return vk;
 }
@@ -132,13 +138,14 @@ void djcs_t_generate_key_pair(djcs_t_public_key *pk, djcs_t_private_key *vk, hcs
     pk->s = s;
     vk->s = s;
 
-    /* n = p * q */
+    /* n = p * q, and n[i] = n^(i+1) */
     mpz_init(pk->n[0]);
     mpz_mul(pk->n[0], vk->p, vk->q);
+    mpz_init_set(vk->n[0], pk->n[0]);
 
     for (unsigned long i = 1; i <= pk->s; ++i) {
         mpz_init(pk->n[i]);
-        mpz_pow_ui(pk->n[i], pk->n[i-1], 2);
+        mpz_mul(pk->n[i], pk->n[i-1], pk->n[0]);
         mpz_init_set(vk->n[i], pk->n[i]);
     }
 
@@ -156,9 +163,10 @@ void djcs_t_generate_key_pair(djcs_t_public_key *pk, djcs_t_private_key *vk, hcs
     /* Compute n^s * m */
     mpz_mul(vk->nsm, vk->n[vk->s-1], vk->m);
 
-    /* Set l and w in private key */
-    vk->l = l;
-    vk->w = w;
+    /* Set l and w in both keys, since combining shares only needs the
+     * public key */
+    pk->l = vk->l = l;
+    pk->w = vk->w = w;
 
     /* Allocate space for verification values */
     vk->vi = malloc(sizeof(mpz_t) * l);
@@ -166,7 +174,7 @@ void djcs_t_generate_key_pair(djcs_t_public_key *pk, djcs_t_private_key *vk, hcs
         mpz_init(vk->vi[i]);
 
     /* Precompute delta = l! */
-    mpz_fac_ui(vk->delta, vk->l);
+    mpz_fac_ui(pk->delta, pk->l);
 
     /* Compute v being a cyclic generator of squares. This group is
      * always cyclic of order n * p' * q' since n is a safe prime product. */
@@ -176,7 +184,8 @@ void djcs_t_generate_key_pair(djcs_t_public_key *pk, djcs_t_private_key *vk, hcs
     mpz_clear(t2);
 }
 
-void djcs_t_encrypt(djcs_t_public_key *pk, hcs_random *hr, mpz_t rop, mpz_t plain1)
+void djcs_t_encrypt(const djcs_t_public_key *pk, hcs_random *hr, mpz_t rop,
+        mpz_t plain1)
 {
     mpz_t t1;
     mpz_init(t1);
@@ -190,7 +199,8 @@ void djcs_t_encrypt(djcs_t_public_key *pk, hcs_random *hr, mpz_t rop, mpz_t plai
     mpz_clear(t1);
 }
 
-void djcs_t_reencrypt(djcs_t_public_key *pk, hcs_random *hr, mpz_t rop, mpz_t op)
+void djcs_t_reencrypt(const djcs_t_public_key *pk, hcs_random *hr, mpz_t rop,
+        mpz_t op)
 {
     mpz_t t1;
     mpz_init(t1);
@@ -203,7 +213,8 @@ void djcs_t_reencrypt(djcs_t_public_key *pk, hcs_random *hr, mpz_t rop, mpz_t op
     mpz_clear(t1);
 }
 
-void djcs_t_ep_add(djcs_t_public_key *pk, mpz_t rop, mpz_t cipher1, mpz_t plain1)
+void djcs_t_ep_add(const djcs_t_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t plain1)
 {
     mpz_t t1;
     mpz_init(t1);
@@ -216,13 +227,15 @@ void djcs_t_ep_add(djcs_t_public_key *pk, mpz_t rop, mpz_t cipher1, mpz_t plain1
     mpz_clear(t1);
 }
 
-void djcs_t_ee_add(djcs_t_public_key *pk, mpz_t rop, mpz_t cipher1, mpz_t cipher2)
+void djcs_t_ee_add(const djcs_t_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t cipher2)
 {
     mpz_mul(rop, cipher1, cipher2);
     mpz_mod(rop, rop, pk->n[pk->s]);
 }
 
-void djcs_t_ep_mul(djcs_t_public_key *pk, mpz_t rop, mpz_t cipher1, mpz_t plain1)
+void djcs_t_ep_mul(const djcs_t_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t plain1)
 {
     mpz_powm(rop, cipher1, plain1, pk->n[pk->s]);
 }
@@ -241,7 +254,8 @@ mpz_t* djcs_t_init_polynomial(djcs_t_private_key *vk, hcs_random *hr)
     return coeff;
 }
 
-void djcs_t_compute_polynomial(djcs_t_private_key *vk, mpz_t *coeff, mpz_t rop, const unsigned long x)
+void djcs_t_compute_polynomial(const djcs_t_private_key *vk, mpz_t *coeff,
+        mpz_t rop, const unsigned long x)
 {
     mpz_t t1, t2;
     mpz_init(t1);
@@ -283,67 +297,91 @@ void djcs_t_set_auth_server(djcs_t_auth_server *au, mpz_t si, unsigned long i)
     au->i = i + 1; /* Assume 0-index and correct internally. */
 }
 
-void djcs_t_share_decrypt(djcs_t_private_key *vk, djcs_t_auth_server *au,
+void djcs_t_share_decrypt(const djcs_t_public_key *pk, djcs_t_auth_server *au,
         mpz_t rop, mpz_t cipher1)
 {
     mpz_t t1;
     mpz_init(t1);
 
-    mpz_mul(t1, au->si, vk->delta);
+    mpz_mul(t1, au->si, pk->delta);
     mpz_mul_ui(t1, t1, 2);
-    mpz_powm(rop, cipher1, t1, vk->n[vk->s]);
+    mpz_powm(rop, cipher1, t1, pk->n[pk->s]);
 
-    mpz_clear(t1);
+    mpz_clears_secret(t1, NULL);
 }
 
-void djcs_t_share_combine(djcs_t_private_key *vk, mpz_t rop, mpz_t *c)
+/* Recover the plaintext from the combined value c' = c^(4 * delta^2 * d) */
+static int combine_finish(const djcs_t_public_key *pk, mpz_t rop)
 {
-    mpz_t t1, t2, t3;
+    int retval;
+    mpz_t t1;
     mpz_init(t1);
-    mpz_init(t2);
-    mpz_init(t3);
-
-    /* Could alter loop to choose a random subset instead of always 0-indexing. */
-    mpz_set_ui(rop, 1);
-    for (unsigned long i = 0; i < vk->l; ++i) {
-
-        if (mpz_cmp_ui(c[i], 0) == 0)
-            continue; /* This share adds zero to the sum so skip. */
-
-        /* Compute lambda_{0,i}^S. This is computed using the values of the
-         * shares, not the indices? */
-        mpz_set(t1, vk->delta);
-        for (unsigned long j = 0; j < vk->l; ++j) {
-            if ((j == i) || mpz_cmp_ui(c[j], 0) == 0)
-                continue; /* i' in S\i and non-zero */
-
-            long v = (long)j - (long)i;
-            mpz_tdiv_q_ui(t1, t1, (v < 0 ? v*-1 : v));
-            if (v < 0) mpz_neg(t1, t1);
-            mpz_mul_ui(t1, t1, j + 1);
-        }
-
-        mpz_abs(t2, t1);
-        mpz_mul_ui(t2, t2, 2);
-        mpz_powm(t2, c[i], t2, vk->n[vk->s]);
-        if (mpz_sgn(t1) < 0) mpz_invert(t2, t2, vk->n[vk->s]);
-        mpz_mul(rop, rop, t2);
-        mpz_mod(rop, rop, vk->n[vk->s]);
-    }
 
     /* We now have c', so use algorithm from Theorem 1 to derive the result */
-    dlog_s(vk, rop, rop);
+    dlog_s(pk, rop, rop);
 
-    /* Multiply by (4*delta^2)^-1 mod n^2 to get result */
-    mpz_pow_ui(t1, vk->delta, 2);
+    /* Multiply by (4*delta^2)^-1 mod n^s to get result */
+    mpz_pow_ui(t1, pk->delta, 2);
     mpz_mul_ui(t1, t1, 4);
-    assert(mpz_invert(t1, t1, vk->n[vk->s-1])); // assume this inverse exists for now, add a check
-    mpz_mul(rop, rop, t1);
-    mpz_mod(rop, rop, vk->n[vk->s-1]);
+    retval = mpz_invert(t1, t1, pk->n[pk->s-1]) != 0;
+    if (retval) {
+        mpz_mul(rop, rop, t1);
+        mpz_mod(rop, rop, pk->n[pk->s-1]);
+    }
 
     mpz_clear(t1);
-    mpz_clear(t2);
-    mpz_clear(t3);
+    return retval;
+}
+
+int djcs_t_share_combine(const djcs_t_public_key *pk, mpz_t rop,
+        hcs_shares *hs)
+{
+    /* rop = c' */
+    return hcs_combine_shares(rop, pk->n[pk->s], pk->delta, pk->l, pk->w,
+                              hs) &&
+           combine_finish(pk, rop);
+}
+
+int djcs_t_share_combine_batch(const djcs_t_public_key *pk, mpz_t *rop,
+        hcs_shares *hs)
+{
+    int valid = 1;
+    if (!hcs_combine_shares_batch(rop, pk->n[pk->s], pk->delta, pk->l, pk->w,
+                                  hs))
+        return 0;
+
+    #pragma omp parallel for reduction(&&:valid)
+    for (unsigned long r = 0; r < hs->count; ++r)
+        valid = combine_finish(pk, rop[r]) && valid;
+
+    return valid;
+}
+
+djcs_t_combiner* djcs_t_init_combiner(const djcs_t_public_key *pk,
+        const unsigned long *quorum)
+{
+    return hcs_init_combiner(pk->n[pk->s], pk->delta, pk->l, pk->w, quorum);
+}
+
+int djcs_t_combiner_add(djcs_t_combiner *cb, unsigned long i, mpz_t share)
+{
+    return hcs_combiner_add(cb, i, share);
+}
+
+int djcs_t_combiner_result(const djcs_t_public_key *pk, djcs_t_combiner *cb,
+        mpz_t rop)
+{
+    return hcs_combiner_product(cb, rop) && combine_finish(pk, rop);
+}
+
+void djcs_t_combiner_reset(djcs_t_combiner *cb)
+{
+    hcs_combiner_reset(cb);
+}
+
+void djcs_t_free_combiner(djcs_t_combiner *cb)
+{
+    hcs_free_combiner(cb);
 }
 
 void djcs_t_free_auth_server(djcs_t_auth_server *au)
@@ -354,44 +392,49 @@ void djcs_t_free_auth_server(djcs_t_auth_server *au)
 
 void djcs_t_clear_public_key(djcs_t_public_key *pk)
 {
-    mpz_zero(pk->g);
+    if (pk->n) {
+        for (unsigned long i = 0; i <= pk->s; ++i)
+            mpz_clear(pk->n[i]);
+        free(pk->n);
+        pk->n = NULL;
+    }
+
+    mpz_zeros_public(pk->g, pk->delta, NULL);
 }
 
 void djcs_t_clear_private_key(djcs_t_private_key *vk)
 {
-    mpz_zeros(vk->p, vk->ph, vk->q, vk->qh, vk->v, vk->nsm, vk->m,
-              vk->d, vk->delta, NULL);
+    mpz_zeros_secret(vk->p, vk->ph, vk->q, vk->qh, vk->nsm, vk->m, vk->d,
+                     NULL);
+    mpz_zeros_public(vk->v, NULL);
 
     if (vk->vi) {
         for (unsigned long i = 0; i < vk->l; ++i)
             mpz_clear(vk->vi[i]);
         free(vk->vi);
+        vk->vi = NULL;
     }
 
     if (vk->n) {
         for (unsigned long i = 0; i <= vk->s; ++i)
             mpz_clear(vk->n[i]);
         free(vk->n);
+        vk->n = NULL;
     }
 }
 
 void djcs_t_free_public_key(djcs_t_public_key *pk)
 {
-    mpz_clear(pk->g);
-
-    if (pk->n) {
-        for (unsigned long i = 0; i <= pk->s; ++i)
-            mpz_clear(pk->n[i]);
-        free(pk->n);
-    }
-
+    djcs_t_clear_public_key(pk);
+    mpz_clears(pk->g, pk->delta, NULL);
     free(pk);
 }
 
 void djcs_t_free_private_key(djcs_t_private_key *vk)
 {
-    mpz_clears(vk->p, vk->ph, vk->q, vk->qh, vk->v, vk->nsm, vk->m,
-               vk->d, vk->delta, NULL);
+    mpz_clears_secret(vk->p, vk->ph, vk->q, vk->qh, vk->nsm, vk->m, vk->d,
+                      NULL);
+    mpz_clear(vk->v);
 
     if (vk->vi) {
         for (unsigned long i = 0; i < vk->l; ++i)
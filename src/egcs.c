@@ -17,7 +17,7 @@ egcs_public_key* egcs_init_public_key(void)
     egcs_public_key *pk = malloc(sizeof(egcs_public_key));
     if (pk == NULL) return NULL;
 
-    mpz_inits(pk->g, pk->q, pk->h, NULL);
+    mpz_inits(pk->g, pk->q, pk->r, pk->h, NULL);
     return pk;
 }
 
@@ -26,27 +26,26 @@ egcs_private_key* egcs_init_private_key(void)
     egcs_private_key *vk = malloc(sizeof(egcs_private_key));
     if (vk == NULL) return NULL;
 
-    mpz_inits(vk->x, vk->q, NULL);
+    mpz_inits(vk->x, vk->q, vk->r, NULL);
     return vk;
 }
 
 void egcs_generate_key_pair(egcs_public_key *pk, egcs_private_key *vk,
         hcs_random *hr, const unsigned long bits)
 {
-    mpz_t t;
-    mpz_init(t);
+    mp_bitcnt_t rbits = bits / 2 < EGCS_ORDER_BITS ? bits / 2
+                                                    : EGCS_ORDER_BITS;
+
+    /* Working in the subgroup of prime order r keeps every exponent short */
+    mpz_random_schnorr_group(pk->q, pk->r, pk->g, hr->rstate, bits, rbits);
 
-    mpz_random_prime(pk->q, hr->rstate, bits);
-    mpz_sub_ui(pk->q, pk->q, 1);
-    mpz_urandomm(pk->g, hr->rstate, pk->q);
-    mpz_urandomm(vk->x, hr->rstate, pk->q);
-    mpz_add_ui(pk->q, pk->q, 1);
-    mpz_add_ui(pk->g, pk->g, 1);
+    /* x uniform in [1, r - 1] */
+    mpz_sub_ui(vk->x, pk->r, 1);
+    mpz_urandomm(vk->x, hr->rstate, vk->x);
     mpz_add_ui(vk->x, vk->x, 1);
     mpz_powm(pk->h, pk->g, vk->x, pk->q);
     mpz_set(vk->q, pk->q);
-
-    mpz_clear(t);
+    mpz_set(vk->r, pk->r);
 }
 
 egcs_cipher* egcs_init_cipher(void)
@@ -64,35 +63,65 @@ void egcs_set(egcs_cipher *rop, egcs_cipher *op)
     mpz_set(rop->c2, op->c2);
 }
 
-void egcs_encrypt(egcs_public_key *pk, hcs_random *hr, egcs_cipher *rop,
-                  mpz_t plain1)
+int egcs_encrypt(const egcs_public_key *pk, hcs_random *hr, egcs_cipher *rop,
+                 mpz_t plain1)
 {
-    mpz_t t;
-    mpz_init(t);
+    int valid = 0;
+    mpz_t t, c1, c2, s;
+    mpz_inits(t, c1, c2, s, NULL);
 
-    mpz_sub_ui(pk->q, pk->q, 1);
-    mpz_urandomm(t, hr->rstate, pk->q);
+    /* Uniform in [1, r - 1], as g has order r */
+    mpz_sub_ui(t, pk->r, 1);
+    mpz_urandomm(t, hr->rstate, t);
     mpz_add_ui(t, t, 1);
-    mpz_add_ui(pk->q, pk->q, 1);
 
+    /* c2^r = plain1^r, so a message outside the subgroup could be tested
+     * against guesses. Membership is checked alongside the encryption. */
     #pragma omp parallel sections
     {
         #pragma omp section
         {
-            mpz_powm(rop->c1, pk->g, t, pk->q);
+            mpz_powm(s, plain1, pk->r, pk->q);
+            valid = mpz_cmp_ui(s, 1) == 0;
         }
         #pragma omp section
         {
-            mpz_powm(rop->c2, pk->h, t, pk->q);
-            mpz_mul(rop->c2, rop->c2, plain1);
-            mpz_mod(rop->c2, rop->c2, pk->q);
+            mpz_powm(c1, pk->g, t, pk->q);
+        }
+        #pragma omp section
+        {
+            mpz_powm(c2, pk->h, t, pk->q);
+            mpz_mul(c2, c2, plain1);
+            mpz_mod(c2, c2, pk->q);
         }
     }
 
-    mpz_clear(t);
+    if (valid) {
+        mpz_swap(rop->c1, c1);
+        mpz_swap(rop->c2, c2);
+    }
+
+    mpz_clears_secret(t, s, NULL);
+    mpz_clears(c1, c2, NULL);
+    return valid;
+}
+
+void egcs_reencrypt(const egcs_public_key *pk, hcs_random *hr,
+        egcs_cipher *rop, egcs_cipher *op)
+{
+    egcs_cipher one;
+    mpz_t t;
+    mpz_inits(one.c1, one.c2, NULL);
+    mpz_init_set_ui(t, 1);
+
+    /* Multiply by a fresh encryption of 1 */
+    egcs_encrypt(pk, hr, &one, t);
+    egcs_ee_mul(pk, rop, op, &one);
+
+    mpz_clears(one.c1, one.c2, t, NULL);
 }
 
-void egcs_ee_mul(egcs_public_key *pk, egcs_cipher *rop, egcs_cipher *ct1,
+void egcs_ee_mul(const egcs_public_key *pk, egcs_cipher *rop, egcs_cipher *ct1,
         egcs_cipher *ct2)
 {
     #pragma omp parallel sections
@@ -110,24 +139,23 @@ void egcs_ee_mul(egcs_public_key *pk, egcs_cipher *rop, egcs_cipher *ct1,
     }
 }
 
-void egcs_decrypt(egcs_private_key *vk, mpz_t rop, egcs_cipher *ct)
+void egcs_decrypt(const egcs_private_key *vk, mpz_t rop, egcs_cipher *ct)
 {
     mpz_t t;
     mpz_init(t);
 
-    mpz_sub_ui(t, vk->q, 1);
-    mpz_sub(t, t, vk->x);
+    /* c1 has order r, so c1^(r - x) = c1^-x */
+    mpz_sub(t, vk->r, vk->x);
     mpz_powm(rop, ct->c1, t, vk->q);
     mpz_mul(rop, rop, ct->c2);
     mpz_mod(rop, rop, vk->q);
 
-    mpz_clear(t);
+    mpz_clears_secret(t, NULL);
 }
 
 void egcs_clear_cipher(egcs_cipher *ct)
 {
-    mpz_zero(ct->c1);
-    mpz_zero(ct->c2);
+    mpz_zeros_public(ct->c1, ct->c2, NULL);
 }
 
 void egcs_free_cipher(egcs_cipher *ct)
@@ -139,28 +167,28 @@ void egcs_free_cipher(egcs_cipher *ct)
 
 void egcs_clear_public_key(egcs_public_key *pk)
 {
-    mpz_zero(pk->g);
-    mpz_zero(pk->q);
-    mpz_zero(pk->h);
+    mpz_zeros_public(pk->g, pk->q, pk->r, pk->h, NULL);
 }
 
 void egcs_clear_private_key(egcs_private_key *vk)
 {
-    mpz_zero(vk->x);
-    mpz_zero(vk->q);
+    mpz_zeros_secret(vk->x, NULL);
+    mpz_zeros_public(vk->q, vk->r, NULL);
 }
 
 void egcs_free_public_key(egcs_public_key *pk)
 {
     mpz_clear(pk->g);
     mpz_clear(pk->q);
+    mpz_clear(pk->r);
     mpz_clear(pk->h);
     free(pk);
 }
 
 void egcs_free_private_key(egcs_private_key *vk)
 {
-    mpz_clear(vk->x);
+    mpz_clears_secret(vk->x, NULL);
     mpz_clear(vk->q);
+    mpz_clear(vk->r);
     free(vk);
 }
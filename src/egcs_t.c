@@ -0,0 +1,301 @@
+/**
+ * @file egcs_t.c
+ *
+ * An implementation of the threshold ElGamal cryptosystem.
+ *
+ * The secret x is shared over Z_r, where r is the prime order of the
+ * subgroup generated by g. Server i holds x_i = P(i) and publishes
+ * c1^(x_i). The shares are combined with the same routine as the threshold
+ * Paillier schemes, giving c1^(2 * delta * x) for integer Lagrange
+ * coefficients. As c1 has order r and r > l, 2 * delta is invertible mod r,
+ * so a single exponentiation by -(2 * delta)^-1 mod r recovers c1^-x, which
+ * unmasks c2 without any inversion mod q.
+ */
+
+#include <stdlib.h>
+#include <gmp.h>
+
+#include "../include/libhcs/hcs_random.h"
+#include "../include/libhcs/hcs_shares.h"
+#include "../include/libhcs/egcs.h"
+#include "../include/libhcs/egcs_t.h"
+#include "com/combiner.h"
+#include "com/util.h"
+#include "com/omp.h"
+
+egcs_t_public_key* egcs_t_init_public_key(void)
+{
+    egcs_t_public_key *pk = malloc(sizeof(egcs_t_public_key));
+    if (!pk) return NULL;
+
+    pk->w = pk->l = 0;
+    mpz_inits(pk->g, pk->q, pk->r, pk->h, pk->delta, pk->dinv, NULL);
+    return pk;
+}
+
+egcs_t_private_key* egcs_t_init_private_key(void)
+{
+    egcs_t_private_key *vk = malloc(sizeof(egcs_t_private_key));
+    if (!vk) return NULL;
+
+    vk->w = vk->l = 0;
+    mpz_inits(vk->x, vk->r, NULL);
+    return vk;
+}
+
+int egcs_t_generate_key_pair(egcs_t_public_key *pk, egcs_t_private_key *vk,
+        hcs_random *hr, const unsigned long bits, const unsigned long w,
+        const unsigned long l)
+{
+    if (w == 0 || w > l)
+        return 0;
+
+    mp_bitcnt_t rbits = bits / 2 < EGCS_T_ORDER_BITS ? bits / 2
+                                                      : EGCS_T_ORDER_BITS;
+    mpz_random_schnorr_group(pk->q, pk->r, pk->g, hr->rstate, bits, rbits);
+
+    /* x uniform in [1, r - 1] */
+    mpz_sub_ui(vk->x, pk->r, 1);
+    mpz_urandomm(vk->x, hr->rstate, vk->x);
+    mpz_add_ui(vk->x, vk->x, 1);
+    mpz_powm(pk->h, pk->g, vk->x, pk->q);
+    mpz_set(vk->r, pk->r);
+
+    pk->w = vk->w = w;
+    pk->l = vk->l = l;
+
+    /* Precompute delta = l! and -(2 * delta)^-1 mod r, which only exists
+     * when r > l */
+    mpz_fac_ui(pk->delta, pk->l);
+    mpz_mul_ui(pk->dinv, pk->delta, 2);
+    if (mpz_invert(pk->dinv, pk->dinv, pk->r) == 0)
+        return 0;
+    mpz_sub(pk->dinv, pk->r, pk->dinv);
+
+    return 1;
+}
+
+int egcs_t_encrypt(const egcs_t_public_key *pk, hcs_random *hr,
+        egcs_cipher *rop, mpz_t plain1)
+{
+    int valid = 0;
+    mpz_t t, c1, c2, s;
+    mpz_inits(t, c1, c2, s, NULL);
+
+    /* Uniform in [1, r - 1], as g has order r */
+    mpz_sub_ui(t, pk->r, 1);
+    mpz_urandomm(t, hr->rstate, t);
+    mpz_add_ui(t, t, 1);
+
+    /* Raising c2 to r cancels h^t, leaving plain1^r, so a message outside
+     * the subgroup would reveal its coset. Its membership is tested
+     * alongside the encryption. */
+    #pragma omp parallel sections
+    {
+        #pragma omp section
+        {
+            mpz_powm(s, plain1, pk->r, pk->q);
+            valid = mpz_cmp_ui(s, 1) == 0;
+        }
+        #pragma omp section
+        {
+            mpz_powm(c1, pk->g, t, pk->q);
+        }
+        #pragma omp section
+        {
+            mpz_powm(c2, pk->h, t, pk->q);
+            mpz_mul(c2, c2, plain1);
+            mpz_mod(c2, c2, pk->q);
+        }
+    }
+
+    if (valid) {
+        mpz_swap(rop->c1, c1);
+        mpz_swap(rop->c2, c2);
+    }
+
+    mpz_clears_secret(t, s, NULL);
+    mpz_clears(c1, c2, NULL);
+    return valid;
+}
+
+void egcs_t_reencrypt(const egcs_t_public_key *pk, hcs_random *hr,
+        egcs_cipher *rop, egcs_cipher *op)
+{
+    egcs_cipher one;
+    mpz_t t;
+    mpz_inits(one.c1, one.c2, NULL);
+    mpz_init_set_ui(t, 1);
+
+    /* Multiply by a fresh encryption of 1 */
+    egcs_t_encrypt(pk, hr, &one, t);
+    egcs_t_ee_mul(pk, rop, op, &one);
+
+    mpz_clears(one.c1, one.c2, t, NULL);
+}
+
+void egcs_t_ee_mul(const egcs_t_public_key *pk, egcs_cipher *rop,
+        egcs_cipher *ct1, egcs_cipher *ct2)
+{
+    mpz_mul(rop->c1, ct1->c1, ct2->c1);
+    mpz_mod(rop->c1, rop->c1, pk->q);
+    mpz_mul(rop->c2, ct1->c2, ct2->c2);
+    mpz_mod(rop->c2, rop->c2, pk->q);
+}
+
+egcs_t_polynomial* egcs_t_init_polynomial(egcs_t_private_key *vk,
+        hcs_random *hr)
+{
+    egcs_t_polynomial *px;
+
+    if ((px = malloc(sizeof(egcs_t_polynomial))) == NULL)
+        return NULL;
+    if ((px->coeff = malloc(sizeof(mpz_t) * vk->w)) == NULL) {
+        free(px);
+        return NULL;
+    }
+
+    px->n = vk->w;
+    mpz_init_set(px->coeff[0], vk->x);
+    for (unsigned long i = 1; i < px->n; ++i) {
+        mpz_init(px->coeff[i]);
+        mpz_urandomm(px->coeff[i], hr->rstate, vk->r);
+    }
+
+    return px;
+}
+
+void egcs_t_compute_polynomial(const egcs_t_private_key *vk,
+        egcs_t_polynomial *px, mpz_t rop, const unsigned long x)
+{
+    /* Horner's rule; the coefficients stay below r so rop never grows past
+     * r * (x + 1) */
+    mpz_set(rop, px->coeff[px->n - 1]);
+    for (unsigned long i = px->n - 1; i-- > 0;) {
+        mpz_mul_ui(rop, rop, x + 1);        // Correct for server 0-indexing
+        mpz_add(rop, rop, px->coeff[i]);
+        mpz_mod(rop, rop, vk->r);
+    }
+}
+
+void egcs_t_free_polynomial(egcs_t_polynomial *px)
+{
+    for (unsigned long i = 0; i < px->n; ++i)
+        mpz_clears_secret(px->coeff[i], NULL);
+    free(px->coeff);
+    free(px);
+}
+
+egcs_t_auth_server* egcs_t_init_auth_server(void)
+{
+    egcs_t_auth_server *au = malloc(sizeof(egcs_t_auth_server));
+    if (!au) return NULL;
+
+    mpz_init(au->si);
+    return au;
+}
+
+void egcs_t_set_auth_server(egcs_t_auth_server *au, mpz_t si,
+        unsigned long i)
+{
+    mpz_set(au->si, si);
+    au->i = i + 1; // Input is assumed to be 0-indexed (from array)
+}
+
+int egcs_t_share_decrypt(const egcs_t_public_key *pk, egcs_t_auth_server *au,
+        mpz_t rop, egcs_cipher *ct)
+{
+    /* A c1 of small order in Z_q* would reveal si modulo that order, so
+     * only elements of the order r subgroup are raised to the share */
+    if (mpz_sgn(ct->c1) <= 0 || mpz_cmp(ct->c1, pk->q) >= 0)
+        return 0;
+
+    mpz_t t;
+    mpz_init(t);
+    mpz_powm(t, ct->c1, pk->r, pk->q);
+    const int valid = mpz_cmp_ui(t, 1) == 0;
+    mpz_clear(t);
+
+    if (valid)
+        mpz_powm(rop, ct->c1, au->si, pk->q);
+    return valid;
+}
+
+int egcs_t_share_decrypt_batch(const egcs_t_public_key *pk,
+        egcs_t_auth_server *au, mpz_t *rop, egcs_cipher **ct,
+        unsigned long count)
+{
+    int failed = 0;
+
+    #pragma omp parallel for
+    for (unsigned long i = 0; i < count; ++i) {
+        if (!egcs_t_share_decrypt(pk, au, rop[i], ct[i]))
+            __atomic_store_n(&failed, 1, __ATOMIC_RELAXED);
+    }
+
+    return !failed;
+}
+
+/* Recover the plaintext from the combined value c' = c1^(2 * delta * x) */
+static void combine_finish(const egcs_t_public_key *pk, mpz_t rop,
+        egcs_cipher *ct)
+{
+    /* c'^(-(2 * delta)^-1) = c1^-x */
+    mpz_powm(rop, rop, pk->dinv, pk->q);
+    mpz_mul(rop, rop, ct->c2);
+    mpz_mod(rop, rop, pk->q);
+}
+
+int egcs_t_share_combine(const egcs_t_public_key *pk, mpz_t rop,
+        egcs_cipher *ct, hcs_shares *hs)
+{
+    if (!hcs_combine_shares(rop, pk->q, pk->delta, pk->l, pk->w, hs))
+        return 0;
+
+    combine_finish(pk, rop, ct);
+    return 1;
+}
+
+int egcs_t_share_combine_batch(const egcs_t_public_key *pk, mpz_t *rop,
+        egcs_cipher **ct, hcs_shares *hs)
+{
+    if (!hcs_combine_shares_batch(rop, pk->q, pk->delta, pk->l, pk->w,
+                                  hs))
+        return 0;
+
+    #pragma omp parallel for
+    for (unsigned long r = 0; r < hs->count; ++r)
+        combine_finish(pk, rop[r], ct[r]);
+
+    return 1;
+}
+
+void egcs_t_free_auth_server(egcs_t_auth_server *au)
+{
+    mpz_clears_secret(au->si, NULL);
+    free(au);
+}
+
+void egcs_t_clear_public_key(egcs_t_public_key *pk)
+{
+    mpz_zeros_public(pk->g, pk->q, pk->r, pk->h, pk->delta, pk->dinv, NULL);
+}
+
+void egcs_t_clear_private_key(egcs_t_private_key *vk)
+{
+    mpz_zeros_secret(vk->x, NULL);
+    mpz_zeros_public(vk->r, NULL);
+}
+
+void egcs_t_free_public_key(egcs_t_public_key *pk)
+{
+    mpz_clears(pk->g, pk->q, pk->r, pk->h, pk->delta, pk->dinv, NULL);
+    free(pk);
+}
+
+void egcs_t_free_private_key(egcs_t_private_key *vk)
+{
+    mpz_clears_secret(vk->x, NULL);
+    mpz_clear(vk->r);
+    free(vk);
+}
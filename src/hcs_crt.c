@@ -0,0 +1,108 @@
+/**
+ * @file hcs_crt.c
+ *
+ * Chinese remainder theorem recombination using Garner's algorithm. Given
+ * residues a[i] mod m[i], the result is built up as
+ *
+ *      x_0 = a[0]
+ *      x_i = x_{i-1} + ((a[i] - x_{i-1}) * mi[i] mod m[i]) * mp[i]
+ *
+ * where mp[i] is the product of all previous moduli and mi[i] its inverse
+ * mod m[i]. Each x_i is the recombination of the first i+1 residues.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <gmp.h>
+
+#include "../include/libhcs/hcs_crt.h"
+#include "com/util.h"
+
+hcs_crt* hcs_init_crt(unsigned long k)
+{
+    if (k == 0)
+        return NULL;
+
+    hcs_crt *crt = malloc(sizeof(hcs_crt));
+    if (!crt)
+        return NULL;
+
+    crt->m = malloc(sizeof(mpz_t) * k);
+    crt->mp = malloc(sizeof(mpz_t) * (k + 1));
+    crt->mi = malloc(sizeof(mpz_t) * k);
+    if (!crt->m || !crt->mp || !crt->mi)
+        goto failure;
+
+    crt->k = k;
+    for (unsigned long i = 0; i < k; ++i)
+        mpz_inits(crt->m[i], crt->mp[i], crt->mi[i], NULL);
+    mpz_init(crt->mp[k]);
+
+    return crt;
+
+failure:
+    free(crt->m);
+    free(crt->mp);
+    free(crt->mi);
+    free(crt);
+    return NULL;
+}
+
+void hcs_crt_set_modulus(hcs_crt *crt, mpz_t m, unsigned long index)
+{
+    assert(index < crt->k);
+    mpz_set(crt->m[index], m);
+}
+
+int hcs_crt_precompute(hcs_crt *crt)
+{
+    if (crt->k == 0)
+        return 0;
+
+    mpz_set_ui(crt->mp[0], 1);
+    mpz_set_ui(crt->mi[0], 1);
+
+    for (unsigned long i = 1; i < crt->k; ++i) {
+        mpz_mul(crt->mp[i], crt->mp[i-1], crt->m[i-1]);
+        if (!mpz_invert(crt->mi[i], crt->mp[i], crt->m[i]))
+            return 0;
+    }
+
+    mpz_mul(crt->mp[crt->k], crt->mp[crt->k-1], crt->m[crt->k-1]);
+    return 1;
+}
+
+void hcs_crt_combine(const hcs_crt *crt, mpz_t rop, mpz_t *a)
+{
+    mpz_t t;
+    mpz_init(t);
+
+    mpz_mod(rop, a[0], crt->m[0]);
+    for (unsigned long i = 1; i < crt->k; ++i) {
+        mpz_sub(t, a[i], rop);
+        mpz_mul(t, t, crt->mi[i]);
+        mpz_mod(t, t, crt->m[i]);
+        mpz_addmul(rop, t, crt->mp[i]);
+    }
+
+    mpz_clear(t);
+}
+
+void hcs_clear_crt(hcs_crt *crt)
+{
+    for (unsigned long i = 0; i < crt->k; ++i)
+        mpz_zeros_secret(crt->m[i], crt->mp[i], crt->mi[i], NULL);
+    mpz_zeros_secret(crt->mp[crt->k], NULL);
+}
+
+void hcs_free_crt(hcs_crt *crt)
+{
+    for (unsigned long i = 0; i < crt->k; ++i)
+        mpz_clears(crt->m[i], crt->mp[i], crt->mi[i], NULL);
+    mpz_clear(crt->mp[crt->k]);
+
+    free(crt->m);
+    free(crt->mp);
+    free(crt->mi);
+    free(crt);
+}
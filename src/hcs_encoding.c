@@ -0,0 +1,502 @@
+/**
+ * @file hcs_encoding.c
+ *
+ * Encoding of real numbers as a mantissa and base-2 exponent. Every
+ * homomorphic operation on an encoded ciphertext is the same for pcs, pcs_t
+ * and djcs given the plaintext and ciphertext moduli and the generator, so
+ * only encryption and decryption dispatch on the scheme.
+ *
+ * Doubles are converted through their exact 53-bit mantissa, so encoding
+ * never depends on the floating-point rounding mode.
+ */
+
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <gmp.h>
+
+#include "../include/libhcs/djcs.h"
+#include "../include/libhcs/hcs_encoding.h"
+#include "../include/libhcs/hcs_random.h"
+#include "../include/libhcs/pcs.h"
+#include "../include/libhcs/pcs_t.h"
+#include "com/omp.h"
+#include "com/util.h"
+
+static hcs_encoding* init_encoding(hcs_encoding_scheme scheme, mpz_srcptr n,
+        mpz_srcptr n2, mpz_srcptr g)
+{
+    hcs_encoding *enc = malloc(sizeof(hcs_encoding));
+    if (!enc)
+        return NULL;
+
+    enc->scheme = scheme;
+    enc->n = n;
+    enc->n2 = n2;
+    enc->g = g;
+
+    /* A third of the space either side leaves a gap which catches overflow
+     * of a sum of two maximal values */
+    mpz_init(enc->max);
+    mpz_sub_ui(enc->max, n, 1);
+    mpz_fdiv_q_ui(enc->max, enc->max, 3);
+    return enc;
+}
+
+hcs_encoding* hcs_init_encoding_pcs(const pcs_public_key *pk)
+{
+    hcs_encoding *enc = init_encoding(HCS_ENCODING_PCS, pk->n, pk->n2, pk->g);
+    if (enc)
+        enc->pk.pcs = pk;
+    return enc;
+}
+
+hcs_encoding* hcs_init_encoding_pcs_t(const pcs_t_public_key *pk)
+{
+    hcs_encoding *enc = init_encoding(HCS_ENCODING_PCS_T, pk->n, pk->n2,
+                                      pk->g);
+    if (enc)
+        enc->pk.pcs_t = pk;
+    return enc;
+}
+
+hcs_encoding* hcs_init_encoding_djcs(const djcs_public_key *pk)
+{
+    hcs_encoding *enc = init_encoding(HCS_ENCODING_DJCS, pk->n[pk->s-1],
+                                      pk->n[pk->s], pk->g);
+    if (enc)
+        enc->pk.djcs = pk;
+    return enc;
+}
+
+void hcs_free_encoding(hcs_encoding *enc)
+{
+    mpz_clear(enc->max);
+    free(enc);
+}
+
+void hcs_encoded_init(hcs_encoded_number *op)
+{
+    mpz_init(op->mantissa);
+    op->exponent = 0;
+}
+
+void hcs_encoded_clear(hcs_encoded_number *op)
+{
+    mpz_clear(op->mantissa);
+}
+
+void hcs_encrypted_init(hcs_encrypted_number *op)
+{
+    mpz_init(op->cipher);
+    op->exponent = 0;
+}
+
+void hcs_encrypted_clear(hcs_encrypted_number *op)
+{
+    mpz_clear(op->cipher);
+}
+
+int hcs_encode_mpz(const hcs_encoding *enc, hcs_encoded_number *rop,
+        const mpz_t mantissa, long exponent)
+{
+    if (mpz_cmpabs(mantissa, enc->max) > 0)
+        return 0;
+
+    mpz_set(rop->mantissa, mantissa);
+    rop->exponent = exponent;
+    return 1;
+}
+
+/* Set rop * 2^exponent to exactly value, where rop has at most DBL_MANT_DIG
+ * significant bits. */
+static void split_double(mpz_t rop, long *exponent, double value)
+{
+    int e;
+    const double f = frexp(value, &e);
+
+    /* f is in [0.5, 1), so scaling by 2^DBL_MANT_DIG gives an integer */
+    mpz_set_d(rop, f * (double)(1ULL << DBL_MANT_DIG));
+    *exponent = (long)e - DBL_MANT_DIG;
+}
+
+int hcs_encode_fixed(const hcs_encoding *enc, hcs_encoded_number *rop,
+        double value, long exponent)
+{
+    long e;
+
+    if (!isfinite(value))
+        return 0;
+
+    mpz_t t;
+    mpz_init(t);
+    split_double(t, &e, value);
+
+    if (e >= exponent) {
+        mpz_mul_2exp(t, t, e - exponent);
+    }
+    else {
+        /* Round half away from zero */
+        const mp_bitcnt_t d = exponent - e;
+        const int negative = mpz_sgn(t) < 0;
+
+        mpz_abs(t, t);
+        const int half = mpz_tstbit(t, d - 1);
+        mpz_fdiv_q_2exp(t, t, d);
+        if (half)
+            mpz_add_ui(t, t, 1);
+        if (negative)
+            mpz_neg(t, t);
+    }
+
+    const int retval = hcs_encode_mpz(enc, rop, t, exponent);
+    mpz_clear(t);
+    return retval;
+}
+
+int hcs_encode_double(const hcs_encoding *enc, hcs_encoded_number *rop,
+        double value)
+{
+    if (!isfinite(value))
+        return 0;
+
+    if (value == 0) {
+        mpz_set_ui(rop->mantissa, 0);
+        rop->exponent = 0;
+        return 1;
+    }
+
+    split_double(rop->mantissa, &rop->exponent, value);
+
+    /* Strip trailing zero bits so the exponent is as large as possible */
+    const mp_bitcnt_t tz = mpz_scan1(rop->mantissa, 0);
+    mpz_tdiv_q_2exp(rop->mantissa, rop->mantissa, tz);
+    rop->exponent += tz;
+
+    /* At most 53 bits, which fits any key this library can generate */
+    return mpz_cmpabs(rop->mantissa, enc->max) <= 0;
+}
+
+double hcs_decode_double(const hcs_encoded_number *op)
+{
+    long e;
+
+    if (mpz_sgn(op->mantissa) == 0)
+        return 0.0;
+
+    const double d = mpz_get_d_2exp(&e, op->mantissa);
+    e += op->exponent;
+
+    if (e > INT_MAX)
+        return d < 0 ? -HUGE_VAL : HUGE_VAL;
+    if (e < INT_MIN)
+        return d < 0 ? -0.0 : 0.0;
+    return ldexp(d, (int)e);
+}
+
+int hcs_decode_plaintext(const hcs_encoding *enc, hcs_encoded_number *rop,
+        const mpz_t plain, long exponent)
+{
+    int retval = 1;
+    mpz_t t;
+    mpz_init(t);
+
+    mpz_mod(t, plain, enc->n);
+    if (mpz_cmp(t, enc->max) > 0) {
+        mpz_sub(t, t, enc->n);
+        if (mpz_cmpabs(t, enc->max) > 0)
+            retval = 0;
+    }
+
+    if (retval) {
+        mpz_swap(rop->mantissa, t);
+        rop->exponent = exponent;
+    }
+
+    mpz_clear(t);
+    return retval;
+}
+
+void hcs_encrypt_encoded(const hcs_encoding *enc, hcs_random *hr,
+        hcs_encrypted_number *rop, const hcs_encoded_number *op)
+{
+    mpz_t t;
+    mpz_init(t);
+    mpz_mod(t, op->mantissa, enc->n);
+
+    switch (enc->scheme) {
+    case HCS_ENCODING_PCS:
+        pcs_encrypt(enc->pk.pcs, hr, rop->cipher, t);
+        break;
+    case HCS_ENCODING_PCS_T:
+        pcs_t_encrypt(enc->pk.pcs_t, hr, rop->cipher, t);
+        break;
+    case HCS_ENCODING_DJCS:
+        djcs_encrypt(enc->pk.djcs, hr, rop->cipher, t);
+        break;
+    }
+    rop->exponent = op->exponent;
+
+    mpz_clear(t);
+}
+
+int hcs_decrypt_encoded_pcs(const hcs_encoding *enc,
+        const pcs_private_key *vk, hcs_encoded_number *rop,
+        const hcs_encrypted_number *op)
+{
+    mpz_t t;
+    mpz_init_set(t, op->cipher);
+    pcs_decrypt(vk, t, t);
+
+    const int retval = hcs_decode_plaintext(enc, rop, t, op->exponent);
+    mpz_clears_secret(t, NULL);
+    return retval;
+}
+
+int hcs_decrypt_encoded_djcs(const hcs_encoding *enc,
+        const djcs_private_key *vk, hcs_encoded_number *rop,
+        const hcs_encrypted_number *op)
+{
+    mpz_t t;
+    mpz_init_set(t, op->cipher);
+    djcs_decrypt(vk, t, t);
+
+    const int retval = hcs_decode_plaintext(enc, rop, t, op->exponent);
+    mpz_clears_secret(t, NULL);
+    return retval;
+}
+
+/* Multiply the plaintext of op by 2^d */
+static void shift_cipher(const hcs_encoding *enc, mpz_t rop, mpz_srcptr op,
+        unsigned long d)
+{
+    mpz_t e;
+    mpz_init(e);
+    mpz_setbit(e, d);
+    mpz_powm(rop, op, e, enc->n2);
+    mpz_clear(e);
+}
+
+void hcs_encrypted_rescale(const hcs_encoding *enc, hcs_encrypted_number *rop,
+        const hcs_encrypted_number *op, long exponent)
+{
+    if (exponent >= op->exponent) {
+        mpz_set(rop->cipher, op->cipher);
+        rop->exponent = op->exponent;
+        return;
+    }
+
+    shift_cipher(enc, rop->cipher, op->cipher, op->exponent - exponent);
+    rop->exponent = exponent;
+}
+
+/* Set rop to op1 + op2, or op1 - op2 if negate is set, rescaling whichever
+ * operand has the larger exponent. Returns zero, leaving rop unmodified, if
+ * op2 must be negated but is not invertible. */
+static int combine(const hcs_encoding *enc, hcs_encrypted_number *rop,
+        const hcs_encrypted_number *op1, const hcs_encrypted_number *op2,
+        int negate)
+{
+    const long e = op1->exponent < op2->exponent ? op1->exponent
+                                                 : op2->exponent;
+    mpz_srcptr a = op1->cipher, b = op2->cipher;
+    mpz_t t1, t2;
+    mpz_inits(t1, t2, NULL);
+
+    if (negate) {
+        if (!mpz_invert(t2, b, enc->n2)) {
+            mpz_clears(t1, t2, NULL);
+            return 0;
+        }
+        b = t2;
+    }
+
+    if (op1->exponent > e) {
+        shift_cipher(enc, t1, a, op1->exponent - e);
+        a = t1;
+    }
+    else if (op2->exponent > e) {
+        shift_cipher(enc, t1, b, op2->exponent - e);
+        b = t1;
+    }
+
+    mpz_mul(rop->cipher, a, b);
+    mpz_mod(rop->cipher, rop->cipher, enc->n2);
+    rop->exponent = e;
+
+    mpz_clears(t1, t2, NULL);
+    return 1;
+}
+
+void hcs_encrypted_add(const hcs_encoding *enc, hcs_encrypted_number *rop,
+        const hcs_encrypted_number *op1, const hcs_encrypted_number *op2)
+{
+    /* Only a difference can fail */
+    combine(enc, rop, op1, op2, 0);
+}
+
+int hcs_encrypted_sub(const hcs_encoding *enc, hcs_encrypted_number *rop,
+        const hcs_encrypted_number *op1, const hcs_encrypted_number *op2)
+{
+    return combine(enc, rop, op1, op2, 1);
+}
+
+/* Set rop to op1 + mantissa * 2^exponent, or op1 - mantissa * 2^exponent if
+ * negate is set. The plaintext is moved in preference to the ciphertext. */
+static void combine_plain(const hcs_encoding *enc, hcs_encrypted_number *rop,
+        const hcs_encrypted_number *op1, const mpz_t mantissa, long exponent,
+        int negate)
+{
+    long e = op1->exponent;
+    mpz_t t1, t2;
+    mpz_inits(t1, t2, NULL);
+
+    if (exponent >= e) {
+        mpz_set(t1, op1->cipher);
+        mpz_mul_2exp(t2, mantissa, exponent - e);
+    }
+    else {
+        shift_cipher(enc, t1, op1->cipher, e - exponent);
+        e = exponent;
+        mpz_set(t2, mantissa);
+    }
+
+    /* Each scheme's ep_sub forms g^-x directly from g = n + 1, where ep_add
+     * would take a full exponentiation */
+    if (!negate)
+        mpz_neg(t2, t2);
+
+    switch (enc->scheme) {
+    case HCS_ENCODING_PCS:
+        pcs_ep_sub(enc->pk.pcs, rop->cipher, t1, t2);
+        break;
+    case HCS_ENCODING_PCS_T:
+        pcs_t_ep_sub(enc->pk.pcs_t, rop->cipher, t1, t2);
+        break;
+    case HCS_ENCODING_DJCS:
+        djcs_ep_sub(enc->pk.djcs, rop->cipher, t1, t2);
+        break;
+    }
+    rop->exponent = e;
+
+    mpz_clears(t1, t2, NULL);
+}
+
+void hcs_encrypted_add_encoded(const hcs_encoding *enc,
+        hcs_encrypted_number *rop, const hcs_encrypted_number *op1,
+        const hcs_encoded_number *op2)
+{
+    combine_plain(enc, rop, op1, op2->mantissa, op2->exponent, 0);
+}
+
+void hcs_encrypted_sub_encoded(const hcs_encoding *enc,
+        hcs_encrypted_number *rop, const hcs_encrypted_number *op1,
+        const hcs_encoded_number *op2)
+{
+    combine_plain(enc, rop, op1, op2->mantissa, op2->exponent, 1);
+}
+
+int hcs_encrypted_neg(const hcs_encoding *enc, hcs_encrypted_number *rop,
+        const hcs_encrypted_number *op)
+{
+    mpz_t t;
+    mpz_init(t);
+
+    const int retval = mpz_invert(t, op->cipher, enc->n2);
+    if (retval) {
+        mpz_swap(rop->cipher, t);
+        rop->exponent = op->exponent;
+    }
+
+    mpz_clear(t);
+    return retval;
+}
+
+int hcs_encrypted_mul_encoded(const hcs_encoding *enc,
+        hcs_encrypted_number *rop, const hcs_encrypted_number *op1,
+        const hcs_encoded_number *op2)
+{
+    const long e = op1->exponent + op2->exponent;
+    if (!mpz_powm_signed(rop->cipher, op1->cipher, op2->mantissa, enc->n,
+                         enc->n2))
+        return 0;
+    rop->exponent = e;
+    return 1;
+}
+
+static int cmp_exponent_desc(const void *a, const void *b)
+{
+    const long ea = (*(const hcs_encrypted_number* const*)a)->exponent;
+    const long eb = (*(const hcs_encrypted_number* const*)b)->exponent;
+    return (ea < eb) - (ea > eb);
+}
+
+int hcs_encrypted_sum(const hcs_encoding *enc, hcs_encrypted_number *rop,
+        const hcs_encrypted_number *op, unsigned long count)
+{
+    if (count == 0) {
+        /* 1 is a valid encryption of zero under every scheme here */
+        mpz_set_ui(rop->cipher, 1);
+        rop->exponent = 0;
+        return 1;
+    }
+
+    const hcs_encrypted_number **sorted = malloc(sizeof(*sorted) * count);
+    if (!sorted)
+        return 0;
+
+    for (unsigned long i = 0; i < count; ++i)
+        sorted[i] = &op[i];
+    qsort(sorted, count, sizeof(*sorted), cmp_exponent_desc);
+
+    /* Horner's rule over the exponents: each squaring applied to the
+     * accumulator rescales every term added so far at once */
+    mpz_t acc;
+    long e = sorted[0]->exponent;
+    mpz_init_set_ui(acc, 1);
+
+    for (unsigned long i = 0; i < count; ++i) {
+        if (sorted[i]->exponent < e) {
+            shift_cipher(enc, acc, acc, e - sorted[i]->exponent);
+            e = sorted[i]->exponent;
+        }
+        mpz_mul(acc, acc, sorted[i]->cipher);
+        mpz_mod(acc, acc, enc->n2);
+    }
+
+    mpz_swap(rop->cipher, acc);
+    rop->exponent = e;
+
+    mpz_clear(acc);
+    free(sorted);
+    return 1;
+}
+
+void hcs_encrypted_align_batch(const hcs_encoding *enc,
+        hcs_encrypted_number *op, unsigned long count)
+{
+    if (count == 0)
+        return;
+
+    long e = op[0].exponent;
+    for (unsigned long i = 1; i < count; ++i) {
+        if (op[i].exponent < e)
+            e = op[i].exponent;
+    }
+
+    #pragma omp parallel for schedule(dynamic)
+    for (unsigned long i = 0; i < count; ++i) {
+        if (op[i].exponent != e)
+            hcs_encrypted_rescale(enc, &op[i], &op[i], e);
+    }
+}
+
+void hcs_encrypted_add_batch(const hcs_encoding *enc,
+        hcs_encrypted_number *rop, const hcs_encrypted_number *op1,
+        const hcs_encrypted_number *op2, unsigned long count)
+{
+    #pragma omp parallel for schedule(dynamic)
+    for (unsigned long i = 0; i < count; ++i)
+        hcs_encrypted_add(enc, &rop[i], &op1[i], &op2[i]);
+}
@@ -0,0 +1,419 @@
+/**
+ * @file hcs_groupby.c
+ *
+ * Sharded group-by aggregation of additive ciphertexts.
+ *
+ * Each shard keeps its groups in dense arrays of keys and accumulators, in
+ * the order they were first seen, and a power-of-two table of buckets which
+ * holds the index of a group plus one, or zero if empty. Buckets are found
+ * by Fibonacci hashing and linear probing. Only the table is rebuilt as it
+ * grows, so accumulators are never moved, and a bucket costs a single word.
+ *
+ * Accumulators of a shard which has been merged are left initialised, and
+ * are reused by the groups it sees next.
+ */
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gmp.h>
+
+#include "../include/libhcs/djcs.h"
+#include "../include/libhcs/hcs_groupby.h"
+#include "../include/libhcs/pcs.h"
+#include "../include/libhcs/pcs_t.h"
+#include "com/omp.h"
+
+/* Accumulators are reduced once they reach this many times the size of the
+ * modulus. The product of a large accumulator and a ciphertext costs little
+ * more than the product of two ciphertexts, but a reduction is skipped. */
+#define GROUPBY_LAZY 4
+
+#define GROUPBY_INITIAL_BUCKETS 16
+
+typedef struct {
+    unsigned long *table;   /* Index + 1 of the group in each bucket */
+    unsigned int shift;     /* 64 - log2 of the number of buckets */
+    unsigned long buckets;  /* Number of buckets */
+    unsigned long count;    /* Number of groups */
+    unsigned long alloc;    /* Number of initialised accumulators */
+    unsigned long *key;     /* Key of each group */
+    mpz_t *acc;             /* Accumulator of each group */
+    char pad[64];           /* Keeps shards of different threads apart */
+} groupby_shard;
+
+struct hcs_groupby {
+    mpz_srcptr n;           /* Plaintext modulus */
+    mpz_srcptr mod;         /* Ciphertext modulus */
+    mp_size_t lazy;         /* Size in limbs at which accumulators reduce */
+    unsigned long shards;
+    groupby_shard *shard;
+};
+
+static unsigned long bucket_of(const groupby_shard *s, unsigned long key)
+{
+    return (unsigned long)(((uint64_t)key * UINT64_C(0x9e3779b97f4a7c15))
+                           >> s->shift);
+}
+
+static int init_shard(groupby_shard *s)
+{
+    s->table = calloc(GROUPBY_INITIAL_BUCKETS, sizeof(unsigned long));
+    if (s->table == NULL)
+        return 0;
+
+    s->buckets = GROUPBY_INITIAL_BUCKETS;
+    s->shift = 64 - 4;
+    s->count = 0;
+    s->alloc = 0;
+    s->key = NULL;
+    s->acc = NULL;
+    return 1;
+}
+
+static void clear_shard(groupby_shard *s)
+{
+    for (unsigned long i = 0; i < s->alloc; ++i)
+        mpz_clear(s->acc[i]);
+    free(s->acc);
+    free(s->key);
+    free(s->table);
+}
+
+static void empty_shard(groupby_shard *s)
+{
+    memset(s->table, 0, sizeof(unsigned long) * s->buckets);
+    s->count = 0;
+}
+
+/* Double the number of buckets, reinserting every group by key */
+static int grow_table(groupby_shard *s)
+{
+    unsigned long *table = calloc(2 * s->buckets, sizeof(unsigned long));
+    if (table == NULL)
+        return 0;
+
+    free(s->table);
+    s->table = table;
+    s->buckets *= 2;
+    s->shift--;
+
+    for (unsigned long i = 0; i < s->count; ++i) {
+        unsigned long b = bucket_of(s, s->key[i]);
+        while (s->table[b])
+            b = (b + 1) & (s->buckets - 1);
+        s->table[b] = i + 1;
+    }
+
+    return 1;
+}
+
+static int grow_groups(groupby_shard *s)
+{
+    const unsigned long alloc = s->alloc ? 2 * s->alloc : 16;
+
+    unsigned long *key = realloc(s->key, sizeof(unsigned long) * alloc);
+    if (key == NULL)
+        return 0;
+    s->key = key;
+
+    mpz_t *acc = realloc(s->acc, sizeof(mpz_t) * alloc);
+    if (acc == NULL)
+        return 0;
+    s->acc = acc;
+
+    for (unsigned long i = s->alloc; i < alloc; ++i)
+        mpz_init(s->acc[i]);
+    s->alloc = alloc;
+    return 1;
+}
+
+/* Return the index of group @p key in @p s, adding it if it is new. @p fresh
+ * is set if the group was added, in which case its accumulator holds an
+ * unspecified value. Returns ULONG_MAX on allocation failure. */
+static unsigned long find_or_add(groupby_shard *s, unsigned long key,
+        int *fresh)
+{
+    unsigned long b = bucket_of(s, key);
+    for (; s->table[b]; b = (b + 1) & (s->buckets - 1)) {
+        if (s->key[s->table[b] - 1] == key) {
+            *fresh = 0;
+            return s->table[b] - 1;
+        }
+    }
+
+    /* Keep the table at most half full, so probes stay short */
+    if (2 * (s->count + 1) > s->buckets) {
+        if (!grow_table(s))
+            return ULONG_MAX;
+        b = bucket_of(s, key);
+        while (s->table[b])
+            b = (b + 1) & (s->buckets - 1);
+    }
+    if (s->count == s->alloc && !grow_groups(s))
+        return ULONG_MAX;
+
+    s->key[s->count] = key;
+    s->table[b] = s->count + 1;
+    *fresh = 1;
+    return s->count++;
+}
+
+static void accumulate(const hcs_groupby *gb, mpz_t acc, const mpz_t op)
+{
+    mpz_mul(acc, acc, op);
+    if (mpz_size(acc) >= (size_t)gb->lazy)
+        mpz_mod(acc, acc, gb->mod);
+}
+
+static hcs_groupby* init_groupby(mpz_srcptr n, mpz_srcptr mod,
+        unsigned long shards)
+{
+    unsigned long ready = 0;
+    hcs_groupby *gb = malloc(sizeof(hcs_groupby));
+    if (gb == NULL)
+        return NULL;
+
+    if (shards == 0)
+        shards = omp_get_max_threads();
+
+    gb->n = n;
+    gb->mod = mod;
+    gb->lazy = GROUPBY_LAZY * mpz_size(mod);
+    gb->shards = shards;
+    gb->shard = malloc(sizeof(groupby_shard) * shards);
+    if (gb->shard == NULL)
+        goto failure;
+
+    for (; ready < shards; ++ready) {
+        if (!init_shard(&gb->shard[ready]))
+            goto failure;
+    }
+
+    return gb;
+
+failure:
+    for (unsigned long i = 0; i < ready; ++i)
+        clear_shard(&gb->shard[i]);
+    free(gb->shard);
+    free(gb);
+    return NULL;
+}
+
+hcs_groupby* hcs_init_groupby_pcs(const pcs_public_key *pk,
+        unsigned long shards)
+{
+    return init_groupby(pk->n, pk->n2, shards);
+}
+
+hcs_groupby* hcs_init_groupby_pcs_t(const pcs_t_public_key *pk,
+        unsigned long shards)
+{
+    return init_groupby(pk->n, pk->n2, shards);
+}
+
+hcs_groupby* hcs_init_groupby_djcs(const djcs_public_key *pk,
+        unsigned long shards)
+{
+    return init_groupby(pk->n[pk->s-1], pk->n[pk->s], shards);
+}
+
+unsigned long hcs_groupby_shards(const hcs_groupby *gb)
+{
+    return gb->shards;
+}
+
+int hcs_groupby_add(hcs_groupby *gb, unsigned long shard, unsigned long key,
+        mpz_t cipher)
+{
+    int fresh;
+    groupby_shard *s = &gb->shard[shard];
+    unsigned long i = find_or_add(s, key, &fresh);
+    if (i == ULONG_MAX)
+        return 0;
+
+    if (fresh)
+        mpz_set(s->acc[i], cipher);
+    else
+        accumulate(gb, s->acc[i], cipher);
+    return 1;
+}
+
+int hcs_groupby_add_batch(hcs_groupby *gb, const unsigned long *key,
+        mpz_t *cipher, unsigned long count)
+{
+    int valid = 1;
+
+    /* Each thread owns the shard of its own number */
+    #pragma omp parallel num_threads(gb->shards) reduction(&&:valid)
+    {
+        const unsigned long shard = omp_get_thread_num();
+
+        #pragma omp for schedule(static)
+        for (unsigned long i = 0; i < count; ++i)
+            valid = hcs_groupby_add(gb, shard, key[i], cipher[i]) && valid;
+    }
+
+    return valid;
+}
+
+/* Fold every group of @p src into @p dst and empty @p src. New groups take
+ * the accumulator of @p src by swapping, so they cost no arithmetic. */
+static int merge_shard(const hcs_groupby *gb, groupby_shard *dst,
+        groupby_shard *src)
+{
+    for (unsigned long i = 0; i < src->count; ++i) {
+        int fresh;
+        unsigned long j = find_or_add(dst, src->key[i], &fresh);
+        if (j == ULONG_MAX)
+            return 0;
+
+        if (fresh)
+            mpz_swap(dst->acc[j], src->acc[i]);
+        else
+            accumulate(gb, dst->acc[j], src->acc[i]);
+    }
+
+    empty_shard(src);
+    return 1;
+}
+
+int hcs_groupby_finish(hcs_groupby *gb)
+{
+    int valid = 1;
+
+    /* Round k merges shards 2^k apart, halving those left each round */
+    for (unsigned long step = 1; step < gb->shards; step *= 2) {
+        #pragma omp parallel for schedule(dynamic) reduction(&&:valid)
+        for (unsigned long i = 0; i < gb->shards; i += 2 * step) {
+            if (i + step < gb->shards) {
+                valid = merge_shard(gb, &gb->shard[i], &gb->shard[i + step])
+                        && valid;
+            }
+        }
+
+        if (!valid)
+            return 0;
+    }
+
+    groupby_shard *s = &gb->shard[0];
+
+    #pragma omp parallel for
+    for (unsigned long i = 0; i < s->count; ++i)
+        mpz_mod(s->acc[i], s->acc[i], gb->mod);
+
+    return 1;
+}
+
+unsigned long hcs_groupby_count(const hcs_groupby *gb)
+{
+    return gb->shard[0].count;
+}
+
+unsigned long hcs_groupby_key(const hcs_groupby *gb, unsigned long index)
+{
+    return gb->shard[0].key[index];
+}
+
+mpz_srcptr hcs_groupby_cipher(const hcs_groupby *gb, unsigned long index)
+{
+    return gb->shard[0].acc[index];
+}
+
+int hcs_groupby_find(const hcs_groupby *gb, unsigned long key,
+        unsigned long *index)
+{
+    const groupby_shard *s = &gb->shard[0];
+
+    for (unsigned long b = bucket_of(s, key); s->table[b];
+            b = (b + 1) & (s->buckets - 1)) {
+        if (s->key[s->table[b] - 1] == key) {
+            *index = s->table[b] - 1;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* Groups per packed plaintext. The top bit of n is left clear, so a full
+ * plaintext is always below n. */
+static unsigned long groups_per_plaintext(const hcs_groupby *gb,
+        mp_bitcnt_t bits)
+{
+    return bits ? (mpz_sizeinbase(gb->n, 2) - 1) / bits : 0;
+}
+
+unsigned long hcs_groupby_packed_count(const hcs_groupby *gb,
+        mp_bitcnt_t bits)
+{
+    const unsigned long per = groups_per_plaintext(gb, bits);
+    if (per == 0)
+        return 0;
+
+    return (hcs_groupby_count(gb) + per - 1) / per;
+}
+
+int hcs_groupby_pack(const hcs_groupby *gb, mpz_t *rop, mp_bitcnt_t bits)
+{
+    const groupby_shard *s = &gb->shard[0];
+    const unsigned long per = groups_per_plaintext(gb, bits);
+    const unsigned long packed = hcs_groupby_packed_count(gb, bits);
+    if (packed == 0)
+        return per != 0;
+
+    mpz_t shift;
+    mpz_init(shift);
+    mpz_setbit(shift, bits);
+
+    /* Horner's rule from the highest group down, so each group is shifted
+     * by raising the running product to 2^bits */
+    #pragma omp parallel for
+    for (unsigned long p = 0; p < packed; ++p) {
+        unsigned long j = (p + 1) * per;
+        if (j > s->count)
+            j = s->count;
+
+        mpz_set(rop[p], s->acc[--j]);
+        while (j-- > p * per) {
+            mpz_powm(rop[p], rop[p], shift, gb->mod);
+            mpz_mul(rop[p], rop[p], s->acc[j]);
+            mpz_mod(rop[p], rop[p], gb->mod);
+        }
+    }
+
+    mpz_clear(shift);
+    return 1;
+}
+
+int hcs_groupby_unpack(const hcs_groupby *gb, mpz_t *rop, mpz_t *plain,
+        mp_bitcnt_t bits)
+{
+    const unsigned long per = groups_per_plaintext(gb, bits);
+    const unsigned long count = hcs_groupby_count(gb);
+    if (per == 0)
+        return 0;
+
+    #pragma omp parallel for
+    for (unsigned long i = 0; i < count; ++i) {
+        mpz_fdiv_q_2exp(rop[i], plain[i / per], (i % per) * bits);
+        mpz_fdiv_r_2exp(rop[i], rop[i], bits);
+    }
+
+    return 1;
+}
+
+void hcs_groupby_reset(hcs_groupby *gb)
+{
+    for (unsigned long i = 0; i < gb->shards; ++i)
+        empty_shard(&gb->shard[i]);
+}
+
+void hcs_free_groupby(hcs_groupby *gb)
+{
+    for (unsigned long i = 0; i < gb->shards; ++i)
+        clear_shard(&gb->shard[i]);
+    free(gb->shard);
+    free(gb);
+}
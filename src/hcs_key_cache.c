@@ -0,0 +1,349 @@
+/**
+ * @file hcs_key_cache.c
+ *
+ * A sharded cache of imported public keys. The cache owns one reference to
+ * each entry it holds, and every successful lookup hands out another. An
+ * entry removed from the cache is freed by whichever of the cache or its
+ * last user drops the final reference.
+ *
+ * Lookups only take the shard lock in shared mode. Reference counts and
+ * CLOCK bits are updated with atomic builtins so concurrent readers do not
+ * need exclusive access. Keys are imported outside of any lock, so a slow
+ * import never blocks lookups of other keys in the same shard.
+ */
+
+#define _POSIX_C_SOURCE 200809L /* For pthread_rwlock_t */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gmp.h>
+
+#include "../include/libhcs/djcs.h"
+#include "../include/libhcs/hcs_key_cache.h"
+#include "../include/libhcs/pcs.h"
+#include "com/sha256.h"
+
+/* Number of independently locked shards in a cache */
+#define HCS_KEY_CACHE_SHARDS 16
+
+/* Number of hash chains in each shard */
+#define HCS_KEY_CACHE_BUCKETS 256
+
+/* Initial length of the CLOCK ring of each shard */
+#define HCS_KEY_CACHE_RING_INIT 16
+
+/* A single shard of a cache. The CLOCK ring is an array of every entry in
+ * the shard, swept by hand. */
+typedef struct {
+    pthread_rwlock_t lock;
+    hcs_cached_key *bucket[HCS_KEY_CACHE_BUCKETS];
+    hcs_cached_key **ring;
+    unsigned long count;
+    unsigned long alloc;
+    unsigned long hand;
+    size_t size;
+} hcs_key_cache_shard;
+
+struct hcs_key_cache {
+    size_t budget;      /* Memory budget of each shard in bytes */
+    hcs_key_cache_shard shard[HCS_KEY_CACHE_SHARDS];
+};
+
+hcs_key_cache* hcs_init_key_cache(size_t budget)
+{
+    hcs_key_cache *cache = malloc(sizeof(hcs_key_cache));
+    if (!cache)
+        return NULL;
+
+    cache->budget = budget / HCS_KEY_CACHE_SHARDS;
+    for (int i = 0; i < HCS_KEY_CACHE_SHARDS; ++i) {
+        hcs_key_cache_shard *shard = &cache->shard[i];
+
+        if (pthread_rwlock_init(&shard->lock, NULL)) {
+            while (i--)
+                pthread_rwlock_destroy(&cache->shard[i].lock);
+            free(cache);
+            return NULL;
+        }
+
+        memset(shard->bucket, 0, sizeof(shard->bucket));
+        shard->ring = NULL;
+        shard->count = shard->alloc = shard->hand = 0;
+        shard->size = 0;
+    }
+
+    return cache;
+}
+
+void hcs_key_fingerprint(hcs_key_type type, const char *json,
+        unsigned char *out)
+{
+    sha256_state st;
+    const unsigned char tag = (unsigned char)type;
+
+    /* The key type is hashed so identical strings of different types can
+     * never be confused */
+    sha256_init(&st);
+    sha256_update(&st, &tag, 1);
+    sha256_update(&st, (const unsigned char*)json, strlen(json));
+    sha256_digest(&st, out);
+}
+
+static size_t mpz_bytes(const mpz_t op)
+{
+    return mpz_size(op) * sizeof(mp_limb_t);
+}
+
+static void free_entry(hcs_cached_key *e)
+{
+    /* The cache is the only owner, so it may cast away const to free */
+    switch (e->type) {
+    case HCS_KEY_PCS:
+        pcs_free_public_key((pcs_public_key*)e->key.pcs);
+        break;
+    case HCS_KEY_DJCS:
+        djcs_free_public_key((djcs_public_key*)e->key.djcs);
+        break;
+    }
+    free(e);
+}
+
+/* Import a key into a new entry. This is the expensive part of a miss, and
+ * is done without holding any lock. */
+static hcs_cached_key* import_entry(hcs_key_type type, const char *json,
+        const unsigned char *fp)
+{
+    hcs_cached_key *e = malloc(sizeof(hcs_cached_key));
+    pcs_public_key *pcs;
+    djcs_public_key *djcs;
+
+    if (!e)
+        return NULL;
+
+    e->type = type;
+    e->size = sizeof(hcs_cached_key);
+
+    switch (type) {
+    case HCS_KEY_PCS:
+        if ((pcs = pcs_init_public_key()) == NULL)
+            goto failure;
+        if (!pcs_import_public_key(pcs, json)) {
+            pcs_free_public_key(pcs);
+            goto failure;
+        }
+
+        e->key.pcs = pcs;
+        e->size += sizeof(pcs_public_key) + mpz_bytes(pcs->n) +
+                   mpz_bytes(pcs->g) + mpz_bytes(pcs->n2);
+        break;
+
+    case HCS_KEY_DJCS:
+        if ((djcs = djcs_init_public_key()) == NULL)
+            goto failure;
+        if (!djcs_import_public_key(djcs, json)) {
+            djcs_free_public_key(djcs);
+            goto failure;
+        }
+
+        e->key.djcs = djcs;
+        e->size += sizeof(djcs_public_key) + mpz_bytes(djcs->g);
+        for (unsigned long i = 0; i <= djcs->s; ++i)
+            e->size += sizeof(mpz_t) + mpz_bytes(djcs->n[i]);
+        break;
+
+    default:
+        goto failure;
+    }
+
+    memcpy(e->fingerprint, fp, HCS_KEY_FINGERPRINT_SIZE);
+    e->refcount = 0;
+    e->referenced = 0;
+    e->next = NULL;
+    return e;
+
+failure:
+    free(e);
+    return NULL;
+}
+
+static hcs_key_cache_shard* shard_of(hcs_key_cache *cache,
+        const unsigned char *fp)
+{
+    return &cache->shard[fp[0] % HCS_KEY_CACHE_SHARDS];
+}
+
+static hcs_cached_key** bucket_of(hcs_key_cache_shard *shard,
+        const unsigned char *fp)
+{
+    return &shard->bucket[(fp[1] | fp[2] << 8) % HCS_KEY_CACHE_BUCKETS];
+}
+
+/* Must be called with the shard lock held in either mode. A found entry
+ * gains a reference for the caller. */
+static hcs_cached_key* find_entry(hcs_key_cache_shard *shard,
+        const unsigned char *fp)
+{
+    for (hcs_cached_key *e = *bucket_of(shard, fp); e; e = e->next) {
+        if (memcmp(e->fingerprint, fp, HCS_KEY_FINGERPRINT_SIZE) == 0) {
+            __atomic_add_fetch(&e->refcount, 1, __ATOMIC_RELAXED);
+            __atomic_store_n(&e->referenced, 1, __ATOMIC_RELAXED);
+            return e;
+        }
+    }
+
+    return NULL;
+}
+
+/* Must be called with the shard lock held exclusively. Removes the entry at
+ * position i of the ring, dropping the reference held by the cache. */
+static void remove_entry(hcs_key_cache_shard *shard, unsigned long i)
+{
+    hcs_cached_key *e = shard->ring[i];
+    hcs_cached_key **p = bucket_of(shard, e->fingerprint);
+
+    while (*p != e)
+        p = &(*p)->next;
+    *p = e->next;
+
+    shard->ring[i] = shard->ring[--shard->count];
+    shard->size -= e->size;
+    hcs_key_cache_release(e);
+}
+
+/* Must be called with the shard lock held exclusively. Sweep the CLOCK hand
+ * until the shard is back within budget, giving each recently used entry a
+ * second chance. The entry @p keep was just added and is never evicted. */
+static void evict(hcs_key_cache *cache, hcs_key_cache_shard *shard,
+        hcs_cached_key *keep)
+{
+    while (shard->size > cache->budget && shard->count > 1) {
+        if (shard->hand >= shard->count)
+            shard->hand = 0;
+
+        hcs_cached_key *e = shard->ring[shard->hand];
+        if (e == keep ||
+                __atomic_exchange_n(&e->referenced, 0, __ATOMIC_RELAXED)) {
+            shard->hand++;
+            continue;
+        }
+
+        /* The last entry is moved into this slot, so the hand stays */
+        remove_entry(shard, shard->hand);
+    }
+}
+
+/* Must be called with the shard lock held exclusively. */
+static int insert_entry(hcs_key_cache_shard *shard, hcs_cached_key *e)
+{
+    if (shard->count == shard->alloc) {
+        const unsigned long alloc = shard->alloc ? 2 * shard->alloc
+                                                 : HCS_KEY_CACHE_RING_INIT;
+        hcs_cached_key **ring = realloc(shard->ring, sizeof(*ring) * alloc);
+        if (!ring)
+            return 0;
+
+        shard->ring = ring;
+        shard->alloc = alloc;
+    }
+
+    hcs_cached_key **b = bucket_of(shard, e->fingerprint);
+    e->next = *b;
+    *b = e;
+
+    shard->ring[shard->count++] = e;
+    shard->size += e->size;
+
+    /* One reference for the cache, one for the caller */
+    e->refcount = 2;
+    e->referenced = 1;
+    return 1;
+}
+
+hcs_cached_key* hcs_key_cache_get(hcs_key_cache *cache, hcs_key_type type,
+        const char *json)
+{
+    unsigned char fp[HCS_KEY_FINGERPRINT_SIZE];
+    hcs_cached_key *e, *found;
+
+    hcs_key_fingerprint(type, json, fp);
+    hcs_key_cache_shard *shard = shard_of(cache, fp);
+
+    pthread_rwlock_rdlock(&shard->lock);
+    found = find_entry(shard, fp);
+    pthread_rwlock_unlock(&shard->lock);
+
+    if (found)
+        return found;
+
+    e = import_entry(type, json, fp);
+    if (!e)
+        return NULL;
+
+    pthread_rwlock_wrlock(&shard->lock);
+
+    /* Another thread may have imported the same key in the meantime */
+    found = find_entry(shard, fp);
+    if (found) {
+        pthread_rwlock_unlock(&shard->lock);
+        free_entry(e);
+        return found;
+    }
+
+    if (!insert_entry(shard, e)) {
+        pthread_rwlock_unlock(&shard->lock);
+        free_entry(e);
+        return NULL;
+    }
+
+    evict(cache, shard, e);
+    pthread_rwlock_unlock(&shard->lock);
+    return e;
+}
+
+void hcs_key_cache_release(hcs_cached_key *key)
+{
+    if (__atomic_sub_fetch(&key->refcount, 1, __ATOMIC_ACQ_REL) == 0)
+        free_entry(key);
+}
+
+unsigned long hcs_key_cache_count(hcs_key_cache *cache)
+{
+    unsigned long count = 0;
+
+    for (int i = 0; i < HCS_KEY_CACHE_SHARDS; ++i) {
+        pthread_rwlock_rdlock(&cache->shard[i].lock);
+        count += cache->shard[i].count;
+        pthread_rwlock_unlock(&cache->shard[i].lock);
+    }
+
+    return count;
+}
+
+size_t hcs_key_cache_size(hcs_key_cache *cache)
+{
+    size_t size = 0;
+
+    for (int i = 0; i < HCS_KEY_CACHE_SHARDS; ++i) {
+        pthread_rwlock_rdlock(&cache->shard[i].lock);
+        size += cache->shard[i].size;
+        pthread_rwlock_unlock(&cache->shard[i].lock);
+    }
+
+    return size;
+}
+
+void hcs_free_key_cache(hcs_key_cache *cache)
+{
+    for (int i = 0; i < HCS_KEY_CACHE_SHARDS; ++i) {
+        hcs_key_cache_shard *shard = &cache->shard[i];
+
+        while (shard->count)
+            remove_entry(shard, shard->count - 1);
+
+        free(shard->ring);
+        pthread_rwlock_destroy(&shard->lock);
+    }
+
+    free(cache);
+}
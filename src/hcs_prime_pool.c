@@ -0,0 +1,388 @@
+/**
+ * @file hcs_prime_pool.c
+ *
+ * A bounded pool of primes, optionally filled by a background thread. The
+ * thread only holds the pool lock while adding a finished prime, so takers
+ * never wait on prime generation itself.
+ *
+ * Saved pools are plain text. The first line records the bit count and
+ * prime type, and each following line holds one prime (and for safe primes
+ * its Sophie Germain counterpart) in base HCS_INTERNAL_BASE.
+ */
+
+#define _GNU_SOURCE /* For SCHED_IDLE */
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <gmp.h>
+
+#include "../include/libhcs/hcs_prime_pool.h"
+#include "../include/libhcs/hcs_random.h"
+#include "com/util.h"
+
+#define HCS_PRIME_POOL_MAGIC "hcs_prime_pool"
+
+/* Number of Miller-Rabin rounds used when checking loaded primes */
+#define HCS_PRIME_POOL_REPS 25
+
+/* Safe primes built by mpz_random_safe_prime fall up to this many bits
+ * short of the requested size, so loaded safe primes may be as well */
+#define HCS_PRIME_POOL_SAFE_SLACK 4
+
+/* The type of prime, the capacity and the arrays are fixed when a pool is
+ * created, so they are read without the lock. Everything else is guarded by
+ * it. */
+struct hcs_prime_pool {
+    mp_bitcnt_t bits;       /* Bit count each prime was generated with */
+    int safe;               /* Non-zero if the pool holds safe primes */
+    unsigned long capacity; /* Maximum number of primes held */
+    unsigned long count;    /* Number of primes currently held */
+    mpz_t *p;               /* Pooled primes */
+    mpz_t *q;               /* (p - 1) / 2 for each safe prime in p */
+    hcs_random *hr;         /* Random state used only by the thread */
+    pthread_t thread;       /* Background filling thread */
+    pthread_mutex_t lock;   /* Guards count, the held primes and the flags
+                               below */
+    pthread_cond_t wake;    /* Signalled when the pool needs refilling */
+    int running;            /* Non-zero while the background thread runs */
+    int stop;               /* Set to ask the background thread to exit */
+};
+
+hcs_prime_pool* hcs_init_prime_pool(mp_bitcnt_t bits, int safe,
+        unsigned long capacity)
+{
+    hcs_prime_pool *pool = malloc(sizeof(hcs_prime_pool));
+    if (!pool)
+        return NULL;
+
+    pool->p = malloc(sizeof(mpz_t) * capacity);
+    pool->q = malloc(sizeof(mpz_t) * capacity);
+    pool->hr = hcs_init_random();
+    if (!pool->p || !pool->q || !pool->hr)
+        goto failure;
+
+    if (pthread_mutex_init(&pool->lock, NULL))
+        goto failure;
+
+    if (pthread_cond_init(&pool->wake, NULL)) {
+        pthread_mutex_destroy(&pool->lock);
+        goto failure;
+    }
+
+    for (unsigned long i = 0; i < capacity; ++i)
+        mpz_inits(pool->p[i], pool->q[i], NULL);
+
+    pool->bits = bits;
+    pool->safe = safe;
+    pool->capacity = capacity;
+    pool->count = 0;
+    pool->running = 0;
+    pool->stop = 0;
+    return pool;
+
+failure:
+    if (pool->hr)
+        hcs_free_random(pool->hr);
+    free(pool->p);
+    free(pool->q);
+    free(pool);
+    return NULL;
+}
+
+mp_bitcnt_t hcs_prime_pool_bits_for_key(unsigned long key_bits)
+{
+    /* Matches the prime sizes chosen by pcs and pcs_t key generation */
+    return 1 + (key_bits - 1) / 2;
+}
+
+mp_bitcnt_t hcs_prime_pool_bits(const hcs_prime_pool *pool)
+{
+    return pool->bits;
+}
+
+int hcs_prime_pool_safe(const hcs_prime_pool *pool)
+{
+    return pool->safe;
+}
+
+static void generate_prime(hcs_prime_pool *pool, hcs_random *hr,
+        mpz_t p, mpz_t q)
+{
+    if (pool->safe)
+        mpz_random_safe_prime(p, q, hr->rstate, pool->bits);
+    else
+        mpz_random_prime(p, hr->rstate, pool->bits);
+}
+
+/* Must be called with the lock held. Returns zero if the pool is full. */
+static int push_prime(hcs_prime_pool *pool, mpz_t p, mpz_t q)
+{
+    if (pool->count == pool->capacity)
+        return 0;
+
+    mpz_set(pool->p[pool->count], p);
+    if (pool->safe)
+        mpz_set(pool->q[pool->count], q);
+    pool->count++;
+    return 1;
+}
+
+static void* pool_thread(void *arg)
+{
+    hcs_prime_pool *pool = arg;
+
+#ifdef SCHED_IDLE
+    /* Best effort, a pool filled at normal priority is still useful */
+    struct sched_param sp = { 0 };
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &sp);
+#endif
+
+    mpz_t p, q;
+    mpz_inits(p, q, NULL);
+
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->stop) {
+        if (pool->count == pool->capacity) {
+            pthread_cond_wait(&pool->wake, &pool->lock);
+            continue;
+        }
+
+        pthread_mutex_unlock(&pool->lock);
+        generate_prime(pool, pool->hr, p, q);
+        pthread_mutex_lock(&pool->lock);
+
+        push_prime(pool, p, q);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    mpz_zeros_secret(p, q, NULL);
+    mpz_clears(p, q, NULL);
+    return NULL;
+}
+
+int hcs_prime_pool_start(hcs_prime_pool *pool)
+{
+    int retval = 1;
+
+    pthread_mutex_lock(&pool->lock);
+    if (!pool->running) {
+        pool->stop = 0;
+        pool->running = pthread_create(&pool->thread, NULL, pool_thread,
+                                       pool) == 0;
+        retval = pool->running;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return retval;
+}
+
+void hcs_prime_pool_stop(hcs_prime_pool *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    if (!pool->running) {
+        pthread_mutex_unlock(&pool->lock);
+        return;
+    }
+
+    pool->stop = 1;
+    pthread_cond_signal(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    pthread_join(pool->thread, NULL);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->running = 0;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void hcs_prime_pool_fill(hcs_prime_pool *pool, hcs_random *hr,
+        unsigned long count)
+{
+    if (count > pool->capacity)
+        count = pool->capacity;
+
+    mpz_t p, q;
+    mpz_inits(p, q, NULL);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->count < count) {
+        pthread_mutex_unlock(&pool->lock);
+        generate_prime(pool, hr, p, q);
+        pthread_mutex_lock(&pool->lock);
+
+        push_prime(pool, p, q);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    mpz_zeros_secret(p, q, NULL);
+    mpz_clears(p, q, NULL);
+}
+
+int hcs_prime_pool_take(hcs_prime_pool *pool, mpz_t p, mpz_t q)
+{
+    pthread_mutex_lock(&pool->lock);
+    if (pool->count == 0) {
+        pthread_mutex_unlock(&pool->lock);
+        return 0;
+    }
+
+    pool->count--;
+    mpz_swap(p, pool->p[pool->count]);
+    mpz_zeros_secret(pool->p[pool->count], NULL);
+    if (pool->safe) {
+        if (q)
+            mpz_swap(q, pool->q[pool->count]);
+        mpz_zeros_secret(pool->q[pool->count], NULL);
+    }
+
+    /* Wake the background thread to replace what was taken */
+    pthread_cond_signal(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    return 1;
+}
+
+unsigned long hcs_prime_pool_count(hcs_prime_pool *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    const unsigned long count = pool->count;
+    pthread_mutex_unlock(&pool->lock);
+    return count;
+}
+
+int hcs_prime_pool_save(hcs_prime_pool *pool, const char *path)
+{
+    int retval = 0;
+
+    const int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd == -1)
+        return 0;
+
+    /* The mode passed to open only applies if the file did not exist */
+    if (fchmod(fd, 0600)) {
+        close(fd);
+        return 0;
+    }
+
+    FILE *fp = fdopen(fd, "w");
+    if (!fp) {
+        close(fd);
+        return 0;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+
+    if (fprintf(fp, "%s %lu %d\n", HCS_PRIME_POOL_MAGIC,
+                (unsigned long)pool->bits, pool->safe) < 0)
+        goto failure;
+
+    for (unsigned long i = 0; i < pool->count; ++i) {
+        if (!mpz_out_str(fp, HCS_INTERNAL_BASE, pool->p[i]))
+            goto failure;
+        if (pool->safe) {
+            if (fputc(' ', fp) == EOF ||
+                    !mpz_out_str(fp, HCS_INTERNAL_BASE, pool->q[i]))
+                goto failure;
+        }
+        if (fputc('\n', fp) == EOF)
+            goto failure;
+    }
+
+    retval = 1;
+
+failure:
+    pthread_mutex_unlock(&pool->lock);
+    if (fclose(fp) == EOF)
+        retval = 0;
+    return retval;
+}
+
+/* A loaded prime is only accepted if it is of the type and size the pool
+ * generates, so an edited file cannot hand out primes for a small modulus.
+ * mpz_random_prime always gives bits + 1 bits. */
+static int check_prime(hcs_prime_pool *pool, mpz_t p, mpz_t q, mpz_t t)
+{
+    const size_t size = mpz_sizeinbase(p, 2);
+
+    if (pool->safe) {
+        if (size + HCS_PRIME_POOL_SAFE_SLACK < pool->bits ||
+                size > pool->bits + 1)
+            return 0;
+    }
+    else if (size != pool->bits + 1) {
+        return 0;
+    }
+
+    if (!mpz_probab_prime_p(p, HCS_PRIME_POOL_REPS))
+        return 0;
+    if (!pool->safe)
+        return 1;
+
+    mpz_mul_2exp(t, q, 1);
+    mpz_add_ui(t, t, 1);
+    return mpz_cmp(t, p) == 0 && mpz_probab_prime_p(q, HCS_PRIME_POOL_REPS);
+}
+
+int hcs_prime_pool_load(hcs_prime_pool *pool, const char *path)
+{
+    int retval = 0, safe;
+    unsigned long bits;
+    char magic[sizeof(HCS_PRIME_POOL_MAGIC)];
+
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+        return 0;
+
+    if (fscanf(fp, "%14s %lu %d", magic, &bits, &safe) != 3 ||
+            strcmp(magic, HCS_PRIME_POOL_MAGIC) != 0 ||
+            bits != pool->bits || !safe != !pool->safe) {
+        fclose(fp);
+        return 0;
+    }
+
+    mpz_t p, q, t;
+    mpz_inits(p, q, t, NULL);
+
+    while (mpz_inp_str(p, fp, HCS_INTERNAL_BASE)) {
+        if (pool->safe && !mpz_inp_str(q, fp, HCS_INTERNAL_BASE))
+            goto failure;
+
+        if (!check_prime(pool, p, q, t))
+            goto failure;
+
+        pthread_mutex_lock(&pool->lock);
+        push_prime(pool, p, q);
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    /* mpz_inp_str also fails on a malformed entry, so require EOF */
+    retval = feof(fp) != 0;
+
+failure:
+    mpz_zeros_secret(p, q, t, NULL);
+    mpz_clears(p, q, t, NULL);
+    fclose(fp);
+    return retval;
+}
+
+void hcs_free_prime_pool(hcs_prime_pool *pool)
+{
+    hcs_prime_pool_stop(pool);
+
+    for (unsigned long i = 0; i < pool->capacity; ++i) {
+        mpz_zeros_secret(pool->p[i], pool->q[i], NULL);
+        mpz_clears(pool->p[i], pool->q[i], NULL);
+    }
+
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->lock);
+    hcs_free_random(pool->hr);
+    free(pool->p);
+    free(pool->q);
+    free(pool);
+}
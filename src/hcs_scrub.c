@@ -0,0 +1,21 @@
+/**
+ * @file hcs_scrub.c
+ *
+ * Storage for the process-wide scrubbing policy. It is read on every release
+ * of a tagged value, so it is a plain integer accessed with relaxed atomics
+ * rather than anything requiring a lock.
+ */
+
+#include "../include/libhcs/hcs_scrub.h"
+
+static int scrub_policy = HCS_SCRUB_DEFAULT;
+
+void hcs_set_scrub_policy(hcs_scrub_policy policy)
+{
+    __atomic_store_n(&scrub_policy, (int)policy, __ATOMIC_RELAXED);
+}
+
+hcs_scrub_policy hcs_get_scrub_policy(void)
+{
+    return (hcs_scrub_policy)__atomic_load_n(&scrub_policy, __ATOMIC_RELAXED);
+}
@@ -1,78 +1,167 @@
 #include <assert.h>
+#include <limits.h>
 #include <stdlib.h>
+#include <string.h>
 #include <gmp.h>
 
 #include "../include/libhcs/hcs_shares.h"
 
-hcs_shares* hcs_init_shares(unsigned long size)
+#define HCS_FLAG_BITS (sizeof(unsigned long) * CHAR_BIT)
+
+static unsigned long mask_words(unsigned long size)
 {
-    hcs_shares *hs = malloc(sizeof(hcs_shares));
-    if (!hs)
-        goto failure;
+    return (size + HCS_FLAG_BITS - 1) / HCS_FLAG_BITS;
+}
 
-    hs->shares = malloc(sizeof(mpz_t) * size);
-    if (!hs->shares)
-        goto failure;
+hcs_shares* hcs_init_shares(unsigned long size)
+{
+    return hcs_init_shares_batch(size, 1, 0);
+}
 
-    hs->flag = malloc(sizeof(int) * size);
-    if (!hs->flag)
-        goto failure;
+/* The structure and its bookkeeping arrays share a single allocation. Each
+ * array is a multiple of the word size, so every one stays aligned. */
+hcs_shares* hcs_init_shares_batch(unsigned long size, unsigned long count,
+        mp_bitcnt_t bits)
+{
+    const unsigned long words = mask_words(size);
+    hcs_shares *hs = calloc(1, sizeof(hcs_shares) +
+            sizeof(mp_size_t) * size * count +
+            sizeof(unsigned long) * words +
+            sizeof(void*) * size);
+    if (hs == NULL)
+        return NULL;
 
     hs->size = size;
-
-    for (unsigned long i = 0; i < hs->size; ++i)
-        mpz_init(hs->shares[i]);
+    hs->count = count;
+    hs->used = (mp_size_t*)(hs + 1);
+    hs->mask = (unsigned long*)(hs->used + size * count);
+    hs->server_id = (void**)(hs->mask + words);
+
+    hs->limbs = (bits + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS;
+    hs->arena = NULL;
+    if (hs->limbs) {
+        hs->arena = malloc(sizeof(mp_limb_t) * hs->limbs * size * count);
+        if (hs->arena == NULL) {
+            free(hs);
+            return NULL;
+        }
+    }
 
     return hs;
+}
 
-failure:
-    if (hs->flag)
-        free(hs->flag);
-    if (hs->shares)
-        free(hs->shares);
-    if (hs)
-        free(hs);
+/* Move the arena to a larger stride of @p limbs per share */
+static int grow_arena(hcs_shares *hs, mp_size_t limbs)
+{
+    const unsigned long total = hs->size * hs->count;
+    mp_limb_t *arena = malloc(sizeof(mp_limb_t) * limbs * total);
+    if (arena == NULL)
+        return 0;
+
+    for (unsigned long k = 0; k < total; ++k) {
+        memcpy(arena + k * limbs, hs->arena + k * hs->limbs,
+               sizeof(mp_limb_t) * hs->used[k]);
+    }
+
+    free(hs->arena);
+    hs->arena = arena;
+    hs->limbs = limbs;
+    return 1;
+}
 
-    return NULL;
+int hcs_set_share(hcs_shares *hs, mpz_t value, unsigned long index)
+{
+    return hcs_set_batch_share(hs, value, 0, index);
 }
 
-void hcs_set_share(hcs_shares *hs, mpz_t share_value, unsigned long share_id)
+int hcs_set_batch_share(hcs_shares *hs, mpz_t value, unsigned long row,
+        unsigned long index)
 {
-    assert(share_id < hs->size);
-    mpz_set(hs->shares[share_id], share_value);
-    hs->flag[share_id] = 1;
+    assert(row < hs->count && index < hs->size);
+    assert(mpz_sgn(value) >= 0);
+
+    const mp_size_t n = mpz_size(value);
+    if (n > hs->limbs && !grow_arena(hs, n))
+        return 0;
+
+    const unsigned long k = row * hs->size + index;
+    mpn_copyi(hs->arena + k * hs->limbs, mpz_limbs_read(value), n);
+    hs->used[k] = n;
+    hcs_set_flag(hs, index);
+    return 1;
 }
 
-void hcs_set_flag(hcs_shares *hs, unsigned long share_id)
+mpz_srcptr hcs_get_share(const hcs_shares *hs, mpz_ptr view,
+        unsigned long row, unsigned long index)
 {
-    assert(share_id < hs->size);
-    hs->flag[share_id] = 1;
+    assert(row < hs->count && index < hs->size);
+
+    const unsigned long k = row * hs->size + index;
+    return mpz_roinit_n(view, hs->arena + k * hs->limbs, hs->used[k]);
 }
 
-void hcs_clear_flag(hcs_shares *hs, unsigned long share_id)
+/* Setting a flag of one server may race with another in the same word, so
+ * the bitmap is updated atomically */
+void hcs_set_flag(hcs_shares *hs, unsigned long index)
 {
-    assert(share_id < hs->size);
-    hs->flag[share_id] = 0;
+    assert(index < hs->size);
+    __atomic_or_fetch(&hs->mask[index / HCS_FLAG_BITS],
+                      1UL << (index % HCS_FLAG_BITS), __ATOMIC_RELAXED);
 }
 
-void hcs_toggle_flag(hcs_shares *hs, unsigned long share_id)
+void hcs_clear_flag(hcs_shares *hs, unsigned long index)
 {
-    assert(share_id < hs->size);
-    hs->flag[share_id] = !hs->flag[share_id];
+    assert(index < hs->size);
+    __atomic_and_fetch(&hs->mask[index / HCS_FLAG_BITS],
+                       ~(1UL << (index % HCS_FLAG_BITS)), __ATOMIC_RELAXED);
 }
 
-int hcs_tst_flag(hcs_shares *hs, unsigned long share_id)
+void hcs_toggle_flag(hcs_shares *hs, unsigned long index)
 {
-    assert(share_id < hs->size);
-    return hs->flag[share_id];
+    assert(index < hs->size);
+    __atomic_xor_fetch(&hs->mask[index / HCS_FLAG_BITS],
+                       1UL << (index % HCS_FLAG_BITS), __ATOMIC_RELAXED);
 }
 
-void hcs_free_shares(hcs_shares *hs)
+int hcs_tst_flag(hcs_shares *hs, unsigned long index)
 {
-    for (unsigned long i = 0; i < hs->size; ++i)
-        mpz_clear(hs->shares[i]);
+    assert(index < hs->size);
+    return (hs->mask[index / HCS_FLAG_BITS] >> (index % HCS_FLAG_BITS)) & 1;
+}
 
-    free(hs->flag);
-    free(hs->shares);
+unsigned long hcs_count_flags(const hcs_shares *hs)
+{
+    unsigned long count = 0;
+    for (unsigned long k = 0; k < mask_words(hs->size); ++k)
+        count += __builtin_popcountl(hs->mask[k]);
+    return count;
+}
+
+unsigned long hcs_next_flag(const hcs_shares *hs, unsigned long index)
+{
+    if (index >= hs->size)
+        return hs->size;
+
+    unsigned long k = index / HCS_FLAG_BITS;
+    unsigned long word = hs->mask[k] & (~0UL << (index % HCS_FLAG_BITS));
+
+    while (word == 0) {
+        if (++k == mask_words(hs->size))
+            return hs->size;
+        word = hs->mask[k];
+    }
+
+    return k * HCS_FLAG_BITS + __builtin_ctzl(word);
+}
+
+void hcs_reset_shares(hcs_shares *hs)
+{
+    memset(hs->used, 0, sizeof(mp_size_t) * hs->size * hs->count);
+    memset(hs->mask, 0, sizeof(unsigned long) * mask_words(hs->size));
+}
+
+void hcs_free_shares(hcs_shares *hs)
+{
+    free(hs->arena);
     free(hs);
 }
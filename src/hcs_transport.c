@@ -0,0 +1,352 @@
+/**
+ * @file hcs_transport.c
+ *
+ * Byte streams over file descriptors and in-process pairs.
+ *
+ * An in-process pair shares two growable buffers, one per direction, under a
+ * single lock. Shutting down either end closes both directions, and the
+ * buffers are released by whichever end is freed last.
+ */
+
+#define _POSIX_C_SOURCE 200809L /* For MSG_NOSIGNAL */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../include/libhcs/hcs_transport.h"
+
+/* Size of the read buffer of a descriptor transport */
+#define HCS_TRANSPORT_BUFFER 65536
+
+enum {
+    TRANSPORT_FD,
+    TRANSPORT_MEMORY
+};
+
+/* Bytes in flight in one direction of a pair */
+typedef struct {
+    unsigned char *data;
+    size_t start;               /* Offset of the first unread byte */
+    size_t count;               /* Number of unread bytes */
+    size_t capacity;
+    int closed;                 /* Non-zero once no more bytes will arrive */
+} transport_channel;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t readable;
+    transport_channel chan[2];
+    int refs;                   /* Ends not yet freed */
+} transport_pipe;
+
+struct hcs_transport {
+    int kind;
+    int fd;
+    int socket;                 /* Cleared once send reports ENOTSOCK */
+    unsigned char *buf;         /* Read buffer of a descriptor */
+    size_t pos;                 /* Offset of the first unread buffered byte */
+    size_t len;                 /* End of the buffered bytes */
+    transport_pipe *pipe;
+    int side;                   /* Reads chan[side], writes the other */
+};
+
+hcs_transport* hcs_init_transport_fd(int fd)
+{
+    hcs_transport *t = malloc(sizeof(hcs_transport));
+    if (t == NULL)
+        return NULL;
+
+    t->buf = malloc(HCS_TRANSPORT_BUFFER);
+    if (t->buf == NULL) {
+        free(t);
+        return NULL;
+    }
+
+    t->kind = TRANSPORT_FD;
+    t->fd = fd;
+    t->socket = 1;
+    t->pos = 0;
+    t->len = 0;
+    t->pipe = NULL;
+    return t;
+}
+
+int hcs_init_transport_pair(hcs_transport **a, hcs_transport **b)
+{
+    transport_pipe *p = calloc(1, sizeof(transport_pipe));
+    hcs_transport *ta = malloc(sizeof(hcs_transport));
+    hcs_transport *tb = malloc(sizeof(hcs_transport));
+    if (!p || !ta || !tb)
+        goto failure;
+
+    if (pthread_mutex_init(&p->lock, NULL))
+        goto failure;
+    if (pthread_cond_init(&p->readable, NULL)) {
+        pthread_mutex_destroy(&p->lock);
+        goto failure;
+    }
+    p->refs = 2;
+
+    ta->kind = tb->kind = TRANSPORT_MEMORY;
+    ta->fd = tb->fd = -1;
+    ta->buf = tb->buf = NULL;
+    ta->pipe = tb->pipe = p;
+    ta->side = 0;
+    tb->side = 1;
+
+    *a = ta;
+    *b = tb;
+    return 1;
+
+failure:
+    free(tb);
+    free(ta);
+    free(p);
+    return 0;
+}
+
+int hcs_listen_unix(const char *path, int backlog)
+{
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return -1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+
+    unlink(path);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) ||
+            listen(fd, backlog)) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+hcs_transport* hcs_accept_unix(int fd)
+{
+    int conn;
+    while ((conn = accept(fd, NULL, NULL)) < 0 && errno == EINTR)
+        ;
+    if (conn < 0)
+        return NULL;
+
+    hcs_transport *t = hcs_init_transport_fd(conn);
+    if (t == NULL)
+        close(conn);
+    return t;
+}
+
+hcs_transport* hcs_connect_unix(const char *path)
+{
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return NULL;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return NULL;
+
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr))) {
+        close(fd);
+        return NULL;
+    }
+
+    hcs_transport *t = hcs_init_transport_fd(fd);
+    if (t == NULL)
+        close(fd);
+    return t;
+}
+
+static int read_fd(hcs_transport *t, unsigned char *buf, size_t len)
+{
+    while (len) {
+        if (t->pos < t->len) {
+            size_t n = t->len - t->pos < len ? t->len - t->pos : len;
+            memcpy(buf, t->buf + t->pos, n);
+            t->pos += n;
+            buf += n;
+            len -= n;
+            continue;
+        }
+
+        /* Large reads bypass the buffer */
+        unsigned char *dst = len >= HCS_TRANSPORT_BUFFER ? buf : t->buf;
+        size_t want = len >= HCS_TRANSPORT_BUFFER ? len : HCS_TRANSPORT_BUFFER;
+        ssize_t r = read(t->fd, dst, want);
+
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            return 0;
+
+        if (dst == buf) {
+            buf += r;
+            len -= r;
+        }
+        else {
+            t->pos = 0;
+            t->len = r;
+        }
+    }
+
+    return 1;
+}
+
+static int write_fd(hcs_transport *t, const unsigned char *buf, size_t len)
+{
+    while (len) {
+        ssize_t r;
+
+        /* send avoids SIGPIPE when the peer has gone away */
+        if (t->socket) {
+            r = send(t->fd, buf, len, MSG_NOSIGNAL);
+            if (r < 0 && errno == ENOTSOCK) {
+                t->socket = 0;
+                continue;
+            }
+        }
+        else {
+            r = write(t->fd, buf, len);
+        }
+
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            return 0;
+
+        buf += r;
+        len -= r;
+    }
+
+    return 1;
+}
+
+static int read_memory(hcs_transport *t, unsigned char *buf, size_t len)
+{
+    transport_pipe *p = t->pipe;
+    transport_channel *c = &p->chan[t->side];
+
+    pthread_mutex_lock(&p->lock);
+    while (len) {
+        while (c->count == 0 && !c->closed)
+            pthread_cond_wait(&p->readable, &p->lock);
+        if (c->count == 0)
+            break;
+
+        size_t n = c->count < len ? c->count : len;
+        memcpy(buf, c->data + c->start, n);
+        c->start += n;
+        c->count -= n;
+        buf += n;
+        len -= n;
+    }
+    pthread_mutex_unlock(&p->lock);
+
+    return len == 0;
+}
+
+static int write_memory(hcs_transport *t, const unsigned char *buf,
+        size_t len)
+{
+    transport_pipe *p = t->pipe;
+    transport_channel *c = &p->chan[!t->side];
+    int retval = 0;
+
+    pthread_mutex_lock(&p->lock);
+    if (c->closed)
+        goto end;
+
+    if (c->start + c->count + len > c->capacity) {
+        memmove(c->data, c->data + c->start, c->count);
+        c->start = 0;
+
+        if (c->count + len > c->capacity) {
+            size_t capacity = 2 * c->capacity;
+            if (capacity < c->count + len)
+                capacity = c->count + len;
+
+            unsigned char *data = realloc(c->data, capacity);
+            if (data == NULL)
+                goto end;
+            c->data = data;
+            c->capacity = capacity;
+        }
+    }
+
+    memcpy(c->data + c->start + c->count, buf, len);
+    c->count += len;
+    pthread_cond_broadcast(&p->readable);
+    retval = 1;
+
+end:
+    pthread_mutex_unlock(&p->lock);
+    return retval;
+}
+
+int hcs_transport_read(hcs_transport *t, void *buf, size_t len)
+{
+    return t->kind == TRANSPORT_FD ? read_fd(t, buf, len)
+                                   : read_memory(t, buf, len);
+}
+
+int hcs_transport_write(hcs_transport *t, const void *buf, size_t len)
+{
+    return t->kind == TRANSPORT_FD ? write_fd(t, buf, len)
+                                   : write_memory(t, buf, len);
+}
+
+void hcs_transport_shutdown(hcs_transport *t)
+{
+    if (t->kind == TRANSPORT_FD) {
+        shutdown(t->fd, SHUT_RDWR);
+        return;
+    }
+
+    pthread_mutex_lock(&t->pipe->lock);
+    t->pipe->chan[0].closed = t->pipe->chan[1].closed = 1;
+    pthread_cond_broadcast(&t->pipe->readable);
+    pthread_mutex_unlock(&t->pipe->lock);
+}
+
+void hcs_free_transport(hcs_transport *t)
+{
+    if (t->kind == TRANSPORT_FD) {
+        close(t->fd);
+        free(t->buf);
+        free(t);
+        return;
+    }
+
+    transport_pipe *p = t->pipe;
+    hcs_transport_shutdown(t);
+
+    pthread_mutex_lock(&p->lock);
+    const int last = --p->refs == 0;
+    pthread_mutex_unlock(&p->lock);
+
+    if (last) {
+        pthread_cond_destroy(&p->readable);
+        pthread_mutex_destroy(&p->lock);
+        free(p->chan[0].data);
+        free(p->chan[1].data);
+        free(p);
+    }
+
+    free(t);
+}
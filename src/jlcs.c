@@ -0,0 +1,335 @@
+/*
+ * @file jlcs.c
+ *
+ * Implementation of the Joye-Libert Cryptosystem (jlcs).
+ *
+ * A ciphertext is c = y^m * x^(2^k) mod n. Raising it to e = (p - 1) / 2^k
+ * mod p removes the mask, as x^(2^k * e) = x^(p-1) = 1, leaving (y^e)^m,
+ * where y^e is a primitive 2^k-th root of unity mod p since y is a
+ * non-residue. The discrete logarithm in this group of order 2^k is found a
+ * bit at a time, low bits first: once the bits below j are removed,
+ * squaring k - 1 - j times leaves 1 exactly when bit j is clear.
+ *
+ * The powers y^(-e * 2^j) used to clear each bit are computed once with the
+ * private key, so decryption takes one exponentiation by e, about k^2 / 2
+ * squarings and at most k multiplications, all mod p.
+ */
+
+#include <stdlib.h>
+#include <gmp.h>
+
+#include "../include/libhcs/hcs_random.h"
+#include "../include/libhcs/jlcs.h"
+#include "com/json.h"
+#include "com/parson.h"
+#include "com/util.h"
+
+jlcs_public_key* jlcs_init_public_key(void)
+{
+    jlcs_public_key *pk = malloc(sizeof(jlcs_public_key));
+    if (!pk) return NULL;
+
+    pk->k = 0;
+    mpz_inits(pk->n, pk->y, pk->k2, NULL);
+    return pk;
+}
+
+jlcs_private_key* jlcs_init_private_key(void)
+{
+    jlcs_private_key *vk = malloc(sizeof(jlcs_private_key));
+    if (!vk) return NULL;
+
+    vk->k = 0;
+    vk->d = NULL;
+    mpz_inits(vk->p, vk->q, vk->y, vk->e, vk->n, NULL);
+    return vk;
+}
+
+/* Derive the remaining private values from p, q, y and k. Returns zero if
+ * p is not 1 mod 2^k or on allocation failure. */
+static int private_from_primes(jlcs_private_key *vk)
+{
+    mpz_mul(vk->n, vk->p, vk->q);
+    mpz_sub_ui(vk->e, vk->p, 1);
+    if (vk->k == 0 || mpz_sgn(vk->e) <= 0 ||
+            mpz_scan1(vk->e, 0) < vk->k)
+        return 0;
+    mpz_tdiv_q_2exp(vk->e, vk->e, vk->k);
+
+    vk->d = malloc(sizeof(mpz_t) * vk->k);
+    if (vk->d == NULL)
+        return 0;
+
+    /* d[0] = y^-e, then each entry is the square of the last */
+    mpz_init(vk->d[0]);
+    mpz_powm(vk->d[0], vk->y, vk->e, vk->p);
+    mpz_invert(vk->d[0], vk->d[0], vk->p);
+    for (unsigned long j = 1; j < vk->k; ++j) {
+        mpz_init(vk->d[j]);
+        mpz_mul(vk->d[j], vk->d[j-1], vk->d[j-1]);
+        mpz_mod(vk->d[j], vk->d[j], vk->p);
+    }
+
+    return 1;
+}
+
+int jlcs_generate_key_pair(jlcs_public_key *pk, jlcs_private_key *vk,
+        hcs_random *hr, const unsigned long bits, const unsigned long k)
+{
+    const unsigned long pbits = bits / 2;
+
+    if (k == 0 || k > bits / 4)
+        return 0;
+
+    /* Release the table of any key previously held */
+    jlcs_clear_private_key(vk);
+
+    /* p = 2^k * p' + 1, with p' filling the remaining bits */
+    do {
+        mpz_urandomb(vk->p, hr->rstate, pbits - k);
+        mpz_setbit(vk->p, pbits - k - 1);
+        mpz_mul_2exp(vk->p, vk->p, k);
+        mpz_add_ui(vk->p, vk->p, 1);
+    } while (mpz_probab_prime_p(vk->p, 25) == 0);
+
+    do {
+        mpz_random_prime(vk->q, hr->rstate, pbits - 1);
+    } while (mpz_fdiv_ui(vk->q, 4) != 3);
+
+    /* y must be a non-residue mod both primes, so its Jacobi symbol mod n
+     * is 1 and it cannot be told apart from a square */
+    mpz_mul(pk->n, vk->p, vk->q);
+    do {
+        mpz_urandomm(pk->y, hr->rstate, pk->n);
+    } while (mpz_legendre(pk->y, vk->p) != -1 ||
+             mpz_legendre(pk->y, vk->q) != -1);
+
+    pk->k = vk->k = k;
+    mpz_set_ui(pk->k2, 0);
+    mpz_setbit(pk->k2, k);
+    mpz_set(vk->y, pk->y);
+
+    return private_from_primes(vk);
+}
+
+void jlcs_encrypt(const jlcs_public_key *pk, hcs_random *hr, mpz_t rop,
+        mpz_t plain1)
+{
+    mpz_t t1;
+    mpz_init(t1);
+
+    #pragma omp parallel sections
+    {
+        #pragma omp section
+        {
+            mpz_random_in_mult_group(t1, hr->rstate, pk->n);
+            mpz_powm(t1, t1, pk->k2, pk->n);
+        }
+        #pragma omp section
+        {
+            mpz_fdiv_r_2exp(rop, plain1, pk->k);
+            mpz_powm(rop, pk->y, rop, pk->n);
+        }
+    }
+
+    mpz_mul(rop, rop, t1);
+    mpz_mod(rop, rop, pk->n);
+
+    mpz_clear(t1);
+}
+
+void jlcs_reencrypt(const jlcs_public_key *pk, hcs_random *hr, mpz_t rop,
+        mpz_t op)
+{
+    mpz_t t1;
+    mpz_init(t1);
+
+    mpz_random_in_mult_group(t1, hr->rstate, pk->n);
+    mpz_powm(t1, t1, pk->k2, pk->n);
+    mpz_mul(rop, op, t1);
+    mpz_mod(rop, rop, pk->n);
+
+    mpz_clear(t1);
+}
+
+void jlcs_ep_add(const jlcs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t plain1)
+{
+    mpz_t t1;
+    mpz_init(t1);
+
+    mpz_fdiv_r_2exp(t1, plain1, pk->k);
+    mpz_powm(t1, pk->y, t1, pk->n);
+    mpz_mul(rop, cipher1, t1);
+    mpz_mod(rop, rop, pk->n);
+
+    mpz_clear(t1);
+}
+
+void jlcs_ee_add(const jlcs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t cipher2)
+{
+    mpz_mul(rop, cipher1, cipher2);
+    mpz_mod(rop, rop, pk->n);
+}
+
+void jlcs_ep_mul(const jlcs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t plain1)
+{
+    mpz_t t1;
+    mpz_init(t1);
+
+    mpz_fdiv_r_2exp(t1, plain1, pk->k);
+    mpz_powm(rop, cipher1, t1, pk->n);
+
+    mpz_clear(t1);
+}
+
+void jlcs_e_neg(const jlcs_public_key *pk, mpz_t rop, mpz_t cipher1)
+{
+    mpz_invert(rop, cipher1, pk->n);
+}
+
+void jlcs_decrypt(const jlcs_private_key *vk, mpz_t rop, mpz_t cipher1)
+{
+    mpz_t c, z;
+    mpz_inits(c, z, NULL);
+
+    mpz_mod(c, cipher1, vk->p);
+    mpz_powm(c, c, vk->e, vk->p);
+
+    mpz_set_ui(rop, 0);
+    for (unsigned long j = 0; j < vk->k; ++j) {
+        /* z = c^(2^(k-1-j)) is 1 or -1, as the bits below j are cleared */
+        mpz_set(z, c);
+        for (unsigned long i = j + 1; i < vk->k; ++i) {
+            mpz_mul(z, z, z);
+            mpz_mod(z, z, vk->p);
+        }
+
+        if (mpz_cmp_ui(z, 1) != 0) {
+            mpz_setbit(rop, j);
+            mpz_mul(c, c, vk->d[j]);
+            mpz_mod(c, c, vk->p);
+        }
+    }
+
+    mpz_clears_secret(c, z, NULL);
+}
+
+void jlcs_clear_public_key(jlcs_public_key *pk)
+{
+    pk->k = 0;
+    mpz_zeros_public(pk->n, pk->y, pk->k2, NULL);
+}
+
+void jlcs_clear_private_key(jlcs_private_key *vk)
+{
+    mpz_zeros_secret(vk->p, vk->q, vk->e, NULL);
+    mpz_zeros_public(vk->y, vk->n, NULL);
+
+    if (vk->d) {
+        for (unsigned long j = 0; j < vk->k; ++j)
+            mpz_clears_secret(vk->d[j], NULL);
+        free(vk->d);
+        vk->d = NULL;
+    }
+    vk->k = 0;
+}
+
+void jlcs_free_public_key(jlcs_public_key *pk)
+{
+    jlcs_clear_public_key(pk);
+    mpz_clears(pk->n, pk->y, pk->k2, NULL);
+    free(pk);
+}
+
+void jlcs_free_private_key(jlcs_private_key *vk)
+{
+    jlcs_clear_private_key(vk);
+    mpz_clears(vk->p, vk->q, vk->y, vk->e, vk->n, NULL);
+    free(vk);
+}
+
+int jlcs_verify_key_pair(const jlcs_public_key *pk, const jlcs_private_key *vk)
+{
+    return pk->k == vk->k && mpz_cmp(vk->n, pk->n) == 0;
+}
+
+char *jlcs_export_public_key(const jlcs_public_key *pk)
+{
+    JSON_Value *root = hcs_json_init_object();
+    if (root == NULL)
+        return NULL;
+
+    JSON_Object *obj = json_value_get_object(root);
+    int ok = json_object_set_number(obj, "k", pk->k) == JSONSuccess &&
+             hcs_json_set_mpz(obj, "n", pk->n) &&
+             hcs_json_set_mpz(obj, "y", pk->y);
+    return hcs_json_finish(root, ok);
+}
+
+char *jlcs_export_private_key(const jlcs_private_key *vk)
+{
+    JSON_Value *root = hcs_json_init_object();
+    if (root == NULL)
+        return NULL;
+
+    JSON_Object *obj = json_value_get_object(root);
+    int ok = json_object_set_number(obj, "k", vk->k) == JSONSuccess &&
+             hcs_json_set_mpz(obj, "p", vk->p) &&
+             hcs_json_set_mpz(obj, "q", vk->q) &&
+             hcs_json_set_mpz(obj, "y", vk->y);
+    return hcs_json_finish(root, ok);
+}
+
+int jlcs_import_public_key(jlcs_public_key *pk, const char *json)
+{
+    unsigned long k;
+    JSON_Value *root = json_parse_string(json);
+    JSON_Object *obj = json_value_get_object(root);
+    int ok = hcs_json_get_ulong(obj, "k", &k) &&
+             hcs_json_get_mpz(obj, "n", pk->n) &&
+             hcs_json_get_mpz(obj, "y", pk->y);
+    json_value_free(root);
+
+    /* 2^k must be smaller than n, which also keeps mpz_setbit from
+     * aborting on a huge k taken from the other party */
+    if (!ok || k == 0 || k >= mpz_sizeinbase(pk->n, 2))
+        return 0;
+
+    pk->k = k;
+    mpz_set_ui(pk->k2, 0);
+    mpz_setbit(pk->k2, k);
+    return 1;
+}
+
+int jlcs_import_private_key(jlcs_private_key *vk, const char *json)
+{
+    unsigned long k;
+    jlcs_clear_private_key(vk);
+
+    JSON_Value *root = json_parse_string(json);
+    JSON_Object *obj = json_value_get_object(root);
+    int ok = hcs_json_get_ulong(obj, "k", &k) &&
+             hcs_json_get_mpz(obj, "p", vk->p) &&
+             hcs_json_get_mpz(obj, "q", vk->q) &&
+             hcs_json_get_mpz(obj, "y", vk->y);
+    json_value_free(root);
+    if (!ok)
+        return 0;
+
+    vk->k = k;
+    if (!private_from_primes(vk))
+        return 0;
+
+    /* Decryption reads the message bits off the power residue symbol of
+     * y, which only works if y is a non-residue mod p. p is odd here, as
+     * private_from_primes requires 2^k | p - 1. */
+    if (mpz_legendre(vk->y, vk->p) != -1) {
+        jlcs_clear_private_key(vk);
+        return 0;
+    }
+
+    return 1;
+}
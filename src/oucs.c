@@ -0,0 +1,280 @@
+/*
+ * @file oucs.c
+ *
+ * Implementation of the Okamoto-Uchiyama Cryptosystem (oucs).
+ *
+ * With n = p^2 * q, the subgroup of Z_(p^2)* of order p has an easy discrete
+ * logarithm: for x = 1 mod p, L(x) = (x - 1) / p is additive. A ciphertext
+ * c = g^m * h^r mod n, with h = g^n, gives c^(p-1) = (g^(p-1))^m mod p^2.
+ * The mask vanishes since h^(p-1) = g^(n(p-1)), and the order p(p-1) of
+ * Z_(p^2)* divides n(p-1). Decryption is therefore
+ * m = L(c^(p-1) mod p^2) * L(g^(p-1) mod p^2)^-1 mod p, and the second
+ * factor is computed once with the private key.
+ */
+
+#include <stdlib.h>
+#include <gmp.h>
+
+#include "../include/libhcs/hcs_random.h"
+#include "../include/libhcs/oucs.h"
+#include "com/json.h"
+#include "com/parson.h"
+#include "com/util.h"
+
+oucs_public_key* oucs_init_public_key(void)
+{
+    oucs_public_key *pk = malloc(sizeof(oucs_public_key));
+    if (!pk) return NULL;
+
+    pk->mbits = 0;
+    mpz_inits(pk->n, pk->g, pk->h, NULL);
+    return pk;
+}
+
+oucs_private_key* oucs_init_private_key(void)
+{
+    oucs_private_key *vk = malloc(sizeof(oucs_private_key));
+    if (!vk) return NULL;
+
+    mpz_inits(vk->p, vk->q, vk->g, vk->p2, vk->hp, vk->n, NULL);
+    return vk;
+}
+
+/* Set vk->hp = L(g^(p-1) mod p^2)^-1 mod p. Returns zero if g^(p-1) = 1
+ * mod p^2, or g is not prime to p, in which case g cannot be used. */
+static int compute_hp(oucs_private_key *vk)
+{
+    mpz_sub_ui(vk->hp, vk->p, 1);
+    mpz_powm(vk->hp, vk->g, vk->hp, vk->p2);
+    mpz_sub_ui(vk->hp, vk->hp, 1);
+    if (!mpz_divisible_p(vk->hp, vk->p))
+        return 0;
+    mpz_divexact(vk->hp, vk->hp, vk->p);
+    return mpz_invert(vk->hp, vk->hp, vk->p) != 0;
+}
+
+/* Derive the public values from n and g. Key generation takes both primes
+ * of equal size b + 1 bits, so n has 3b + 1 to 3b + 3 bits and p > 2^b. */
+static void public_from_n(oucs_public_key *pk)
+{
+    pk->mbits = (mpz_sizeinbase(pk->n, 2) - 1) / 3;
+    mpz_powm(pk->h, pk->g, pk->n, pk->n);
+}
+
+void oucs_generate_key_pair(oucs_public_key *pk, oucs_private_key *vk,
+                            hcs_random *hr, const unsigned long bits)
+{
+    do {
+        mpz_random_prime(vk->p, hr->rstate, bits / 3);
+        mpz_random_prime(vk->q, hr->rstate, bits / 3);
+    } while (mpz_cmp(vk->p, vk->q) == 0);
+
+    mpz_pow_ui(vk->p2, vk->p, 2);
+    mpz_mul(vk->n, vk->p2, vk->q);
+
+    /* Almost every g works, as only 1 in p of Z_(p^2)* has g^(p-1) = 1 */
+    do {
+        mpz_random_in_mult_group(vk->g, hr->rstate, vk->n);
+    } while (!compute_hp(vk));
+
+    mpz_set(pk->n, vk->n);
+    mpz_set(pk->g, vk->g);
+    public_from_n(pk);
+}
+
+void oucs_encrypt(const oucs_public_key *pk, hcs_random *hr, mpz_t rop,
+        mpz_t plain1)
+{
+    mpz_t t1;
+    mpz_init(t1);
+
+    #pragma omp parallel sections
+    {
+        #pragma omp section
+        {
+            mpz_urandomm(t1, hr->rstate, pk->n);
+            mpz_powm(t1, pk->h, t1, pk->n);
+        }
+        #pragma omp section
+        {
+            mpz_powm(rop, pk->g, plain1, pk->n);
+        }
+    }
+
+    mpz_mul(rop, rop, t1);
+    mpz_mod(rop, rop, pk->n);
+
+    mpz_clear(t1);
+}
+
+void oucs_reencrypt(const oucs_public_key *pk, hcs_random *hr, mpz_t rop,
+        mpz_t op)
+{
+    mpz_t t1;
+    mpz_init(t1);
+
+    mpz_urandomm(t1, hr->rstate, pk->n);
+    mpz_powm(t1, pk->h, t1, pk->n);
+    mpz_mul(rop, op, t1);
+    mpz_mod(rop, rop, pk->n);
+
+    mpz_clear(t1);
+}
+
+void oucs_ep_add(const oucs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t plain1)
+{
+    mpz_t t1;
+    mpz_init(t1);
+
+    mpz_powm(t1, pk->g, plain1, pk->n);
+    mpz_mul(rop, cipher1, t1);
+    mpz_mod(rop, rop, pk->n);
+
+    mpz_clear(t1);
+}
+
+void oucs_ee_add(const oucs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t cipher2)
+{
+    mpz_mul(rop, cipher1, cipher2);
+    mpz_mod(rop, rop, pk->n);
+}
+
+void oucs_ep_mul(const oucs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t plain1)
+{
+    mpz_powm(rop, cipher1, plain1, pk->n);
+}
+
+int oucs_e_neg(const oucs_public_key *pk, mpz_t rop, mpz_t cipher1)
+{
+    mpz_t t1;
+    mpz_init(t1);
+
+    int retval = mpz_invert(t1, cipher1, pk->n);
+    if (retval)
+        mpz_set(rop, t1);
+
+    mpz_clear(t1);
+    return retval;
+}
+
+int oucs_ee_sub(const oucs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t cipher2)
+{
+    mpz_t t1;
+    mpz_init(t1);
+
+    int retval = mpz_invert(t1, cipher2, pk->n);
+    if (retval) {
+        mpz_mul(rop, cipher1, t1);
+        mpz_mod(rop, rop, pk->n);
+    }
+
+    mpz_clear(t1);
+    return retval;
+}
+
+void oucs_decrypt(const oucs_private_key *vk, mpz_t rop, mpz_t cipher1)
+{
+    mpz_t t1;
+    mpz_init(t1);
+
+    /* Reducing first keeps the exponentiation entirely mod p^2 */
+    mpz_mod(rop, cipher1, vk->p2);
+    mpz_sub_ui(t1, vk->p, 1);
+    mpz_powm(rop, rop, t1, vk->p2);
+    mpz_sub_ui(rop, rop, 1);
+    mpz_divexact(rop, rop, vk->p);
+    mpz_mul(rop, rop, vk->hp);
+    mpz_mod(rop, rop, vk->p);
+
+    mpz_clear(t1);
+}
+
+void oucs_clear_public_key(oucs_public_key *pk)
+{
+    pk->mbits = 0;
+    mpz_zeros_public(pk->n, pk->g, pk->h, NULL);
+}
+
+void oucs_clear_private_key(oucs_private_key *vk)
+{
+    mpz_zeros_secret(vk->p, vk->q, vk->p2, vk->hp, NULL);
+    mpz_zeros_public(vk->g, vk->n, NULL);
+}
+
+void oucs_free_public_key(oucs_public_key *pk)
+{
+    oucs_clear_public_key(pk);
+    mpz_clears(pk->n, pk->g, pk->h, NULL);
+    free(pk);
+}
+
+void oucs_free_private_key(oucs_private_key *vk)
+{
+    oucs_clear_private_key(vk);
+    mpz_clears(vk->p, vk->q, vk->g, vk->p2, vk->hp, vk->n, NULL);
+    free(vk);
+}
+
+int oucs_verify_key_pair(const oucs_public_key *pk, const oucs_private_key *vk)
+{
+    return mpz_cmp(vk->n, pk->n) == 0;
+}
+
+char *oucs_export_public_key(const oucs_public_key *pk)
+{
+    JSON_Value *root = hcs_json_init_object();
+    if (root == NULL)
+        return NULL;
+
+    JSON_Object *obj = json_value_get_object(root);
+    int ok = hcs_json_set_mpz(obj, "n", pk->n) &&
+             hcs_json_set_mpz(obj, "g", pk->g);
+    return hcs_json_finish(root, ok);
+}
+
+char *oucs_export_private_key(const oucs_private_key *vk)
+{
+    JSON_Value *root = hcs_json_init_object();
+    if (root == NULL)
+        return NULL;
+
+    JSON_Object *obj = json_value_get_object(root);
+    int ok = hcs_json_set_mpz(obj, "p", vk->p) &&
+             hcs_json_set_mpz(obj, "q", vk->q) &&
+             hcs_json_set_mpz(obj, "g", vk->g);
+    return hcs_json_finish(root, ok);
+}
+
+int oucs_import_public_key(oucs_public_key *pk, const char *json)
+{
+    JSON_Value *root = json_parse_string(json);
+    JSON_Object *obj = json_value_get_object(root);
+    int ok = hcs_json_get_mpz(obj, "n", pk->n) &&
+             hcs_json_get_mpz(obj, "g", pk->g);
+    json_value_free(root);
+    if (!ok)
+        return 0;
+
+    public_from_n(pk);
+    return 1;
+}
+
+int oucs_import_private_key(oucs_private_key *vk, const char *json)
+{
+    JSON_Value *root = json_parse_string(json);
+    JSON_Object *obj = json_value_get_object(root);
+    int ok = hcs_json_get_mpz(obj, "p", vk->p) &&
+             hcs_json_get_mpz(obj, "q", vk->q) &&
+             hcs_json_get_mpz(obj, "g", vk->g);
+    json_value_free(root);
+    if (!ok || mpz_sgn(vk->p) <= 0)
+        return 0;
+
+    mpz_pow_ui(vk->p2, vk->p, 2);
+    mpz_mul(vk->n, vk->p2, vk->q);
+    return compute_hp(vk);
+}
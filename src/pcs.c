@@ -9,7 +9,8 @@
  * The chinese remainder theorem is used during the decryption process. The
  * decrypted result is calculated seperately under mod p and mod q, and the
  * two results are then applied with the chinese remainder theorem to get the
- * decrypted result mod n.
+ * decrypted result mod n. The CRT context is computed once with the private
+ * key, so recombination only costs a single multiply-add per decryption.
  *
  * We also have a preprocessor flag which will allow a g chosen such that it is
  * small. The main improvement in speed here is found in the encryption phase
@@ -41,8 +42,11 @@
 #include <string.h>
 #include <gmp.h>
 
+#include "../include/libhcs/hcs_crt.h"
+#include "../include/libhcs/hcs_prime_pool.h"
 #include "../include/libhcs/hcs_random.h"
 #include "../include/libhcs/pcs.h"
+#include "com/json.h"
 #include "com/omp.h"
 #include "com/parson.h"
 #include "com/util.h"
@@ -59,35 +63,37 @@ pcs_private_key* pcs_init_private_key(void)
 {
     pcs_private_key *vk = malloc(sizeof(pcs_private_key));
     if (!vk) return NULL;
+
+    vk->crt = hcs_init_crt(2);
+    if (!vk->crt) {
+        free(vk);
+        return NULL;
+    }
+
     mpz_inits(vk->p, vk->p2, vk->q, vk->q2, vk->hp, vk->hq, vk->mu,
               vk->lambda, vk->n, vk->n2, NULL);
     return vk;
 }
 
-void pcs_generate_key_pair(pcs_public_key *pk, pcs_private_key *vk,
-                           hcs_random *hr, const unsigned long bits)
+/* Derive the remaining key values from the primes vk->p and vk->q. This uses
+ * some assumptions in calculating the key values. Primarily based on p and q
+ * being similar bit lengths. */
+static void key_pair_from_primes(pcs_public_key *pk, pcs_private_key *vk)
 {
-    /* This key generation function uses some assumptions in calculating the
-     * key values. Primarily based on p and q being similar bit lengths. */
-
-    /* We do not want p and q to be identical primes. This is very unlikely,
-     * but we check regardless. */
-    do {
-        mpz_random_prime(vk->p, hr->rstate, 1 + (bits-1)/2);
-        mpz_random_prime(vk->q, hr->rstate, 1 + (bits-1)/2);
-    } while (mpz_cmp(vk->p, vk->q) == 0);
-
     mpz_pow_ui(vk->p2, vk->p, 2);
     mpz_pow_ui(vk->q2, vk->q, 2);
     mpz_mul(vk->n, vk->p, vk->q);
     mpz_sub_ui(vk->lambda, vk->p, 1);
-    mpz_sub_ui(vk->q, vk->q, 1);
-    mpz_lcm(vk->lambda, vk->lambda, vk->q);
-    mpz_add_ui(vk->q, vk->q, 1);
+    mpz_sub_ui(vk->hq, vk->q, 1);     /* hq is scratch until computed below */
+    mpz_lcm(vk->lambda, vk->lambda, vk->hq);
     mpz_pow_ui(vk->n2, vk->n, 2);
     mpz_set(pk->n, vk->n);
     mpz_set(pk->n2, vk->n2);
 
+    hcs_crt_set_modulus(vk->crt, vk->p, 0);
+    hcs_crt_set_modulus(vk->crt, vk->q, 1);
+    hcs_crt_precompute(vk->crt);
+
 /* The following is a optimization of the scheme, which allows a smaller g
  * value, and hence produces some speedup in the encryption process. This is
  * minor, and is not really something the caller needs to be aware of; hence
@@ -130,7 +136,46 @@ void pcs_generate_key_pair(pcs_public_key *pk, pcs_private_key *vk,
     }
 }
 
-void pcs_encrypt_r(pcs_public_key *pk, mpz_t rop, mpz_t plain1, mpz_t r)
+void pcs_generate_key_pair(pcs_public_key *pk, pcs_private_key *vk,
+                           hcs_random *hr, const unsigned long bits)
+{
+    /* We do not want p and q to be identical primes. This is very unlikely,
+     * but we check regardless. */
+    do {
+        mpz_random_prime(vk->p, hr->rstate, 1 + (bits-1)/2);
+        mpz_random_prime(vk->q, hr->rstate, 1 + (bits-1)/2);
+    } while (mpz_cmp(vk->p, vk->q) == 0);
+
+    key_pair_from_primes(pk, vk);
+}
+
+/* Take a prime from the pool if it holds primes of the right size, otherwise
+ * generate one inline. Safe primes are still primes, so either pool type
+ * will do. */
+static void pool_prime(hcs_prime_pool *pool, hcs_random *hr, mpz_t rop,
+        mp_bitcnt_t bits)
+{
+    if (pool && hcs_prime_pool_bits(pool) == bits &&
+            hcs_prime_pool_take(pool, rop, NULL))
+        return;
+
+    mpz_random_prime(rop, hr->rstate, bits);
+}
+
+void pcs_generate_key_pair_pool(pcs_public_key *pk, pcs_private_key *vk,
+        hcs_random *hr, hcs_prime_pool *pool, const unsigned long bits)
+{
+    const mp_bitcnt_t pbits = hcs_prime_pool_bits_for_key(bits);
+
+    do {
+        pool_prime(pool, hr, vk->p, pbits);
+        pool_prime(pool, hr, vk->q, pbits);
+    } while (mpz_cmp(vk->p, vk->q) == 0);
+
+    key_pair_from_primes(pk, vk);
+}
+
+void pcs_encrypt_r(const pcs_public_key *pk, mpz_t rop, mpz_t plain1, mpz_t r)
 {
     mpz_t t1;
     mpz_init(t1);
@@ -149,7 +194,8 @@ void pcs_encrypt_r(pcs_public_key *pk, mpz_t rop, mpz_t plain1, mpz_t r)
     mpz_clear(t1);
 }
 
-void pcs_encrypt(pcs_public_key *pk, hcs_random *hr, mpz_t rop, mpz_t plain1)
+void pcs_encrypt(const pcs_public_key *pk, hcs_random *hr, mpz_t rop,
+        mpz_t plain1)
 {
     mpz_t t1;
     mpz_init(t1);
@@ -173,7 +219,8 @@ void pcs_encrypt(pcs_public_key *pk, hcs_random *hr, mpz_t rop, mpz_t plain1)
     mpz_clear(t1);
 }
 
-void pcs_reencrypt(pcs_public_key *pk, hcs_random *hr, mpz_t rop, mpz_t op)
+void pcs_reencrypt(const pcs_public_key *pk, hcs_random *hr, mpz_t rop,
+        mpz_t op)
 {
     mpz_t t1;
     mpz_init(t1);
@@ -186,45 +233,44 @@ void pcs_reencrypt(pcs_public_key *pk, hcs_random *hr, mpz_t rop, mpz_t op)
     mpz_clear(t1);
 }
 
-void pcs_decrypt(pcs_private_key *vk, mpz_t rop, mpz_t cipher1)
+void pcs_decrypt(const pcs_private_key *vk, mpz_t rop, mpz_t cipher1)
 {
-    mpz_t t1, t2;
-    mpz_init(t1);
-    mpz_init(t2);
+    mpz_t t[2];
+    mpz_init(t[0]);
+    mpz_init(t[1]);
 
     #pragma omp parallel sections
     {
         #pragma omp section
         {
             /* Calculate component mod p */
-            mpz_sub_ui(t1, vk->p, 1);
-            mpz_powm(t1, cipher1, t1, vk->p2);
-            mpz_sub_ui(t1, t1, 1);
-            mpz_tdiv_q(t1, t1, vk->p);
-            mpz_mul(t1, t1, vk->hp);
-            mpz_mod(t1, t1, vk->p);
+            mpz_sub_ui(t[0], vk->p, 1);
+            mpz_powm(t[0], cipher1, t[0], vk->p2);
+            mpz_sub_ui(t[0], t[0], 1);
+            mpz_tdiv_q(t[0], t[0], vk->p);
+            mpz_mul(t[0], t[0], vk->hp);
+            mpz_mod(t[0], t[0], vk->p);
         }
         #pragma omp section
         {
             /* Calculate component mod q */
-            mpz_sub_ui(t2, vk->q, 1);
-            mpz_powm(t2, cipher1, t2, vk->q2);
-            mpz_sub_ui(t2, t2, 1);
-            mpz_tdiv_q(t2, t2, vk->q);
-            mpz_mul(t2, t2, vk->hq);
-            mpz_mod(t2, t2, vk->q);
+            mpz_sub_ui(t[1], vk->q, 1);
+            mpz_powm(t[1], cipher1, t[1], vk->q2);
+            mpz_sub_ui(t[1], t[1], 1);
+            mpz_tdiv_q(t[1], t[1], vk->q);
+            mpz_mul(t[1], t[1], vk->hq);
+            mpz_mod(t[1], t[1], vk->q);
         }
     }
 
-    /* Combine to form mod n */
-    mpz_2crt(rop, t1, vk->p, t2, vk->q);
-    mpz_mod(rop, rop, vk->n);
+    /* Combine to form mod n. The result is already reduced. */
+    hcs_crt_combine(vk->crt, rop, t);
 
-    mpz_clear(t1);
-    mpz_clear(t2);
+    mpz_clears_secret(t[0], t[1], NULL);
 }
 
-void pcs_ep_add(pcs_public_key *pk, mpz_t rop, mpz_t cipher1, mpz_t plain1)
+void pcs_ep_add(const pcs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t plain1)
 {
     mpz_t t1;
     mpz_init(t1);
@@ -237,26 +283,111 @@ void pcs_ep_add(pcs_public_key *pk, mpz_t rop, mpz_t cipher1, mpz_t plain1)
     mpz_clear(t1);
 }
 
-void pcs_ee_add(pcs_public_key *pk, mpz_t rop, mpz_t cipher1, mpz_t cipher2)
+void pcs_ee_add(const pcs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t cipher2)
 {
     mpz_mul(rop, cipher1, cipher2);
     mpz_mod(rop, rop, pk->n2);
 }
 
-void pcs_ep_mul(pcs_public_key *pk, mpz_t rop, mpz_t cipher1, mpz_t plain1)
+int pcs_ep_mul(const pcs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t plain1)
+{
+    return mpz_powm_signed(rop, cipher1, plain1, pk->n, pk->n2);
+}
+
+int pcs_e_neg(const pcs_public_key *pk, mpz_t rop, mpz_t cipher1)
+{
+    mpz_t t1;
+    mpz_init(t1);
+
+    int retval = mpz_invert(t1, cipher1, pk->n2);
+    if (retval)
+        mpz_set(rop, t1);
+
+    mpz_clear(t1);
+    return retval;
+}
+
+int pcs_ee_sub(const pcs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t cipher2)
+{
+    mpz_t t1;
+    mpz_init(t1);
+
+    int retval = mpz_invert(t1, cipher2, pk->n2);
+    if (retval) {
+        mpz_mul(rop, cipher1, t1);
+        mpz_mod(rop, rop, pk->n2);
+    }
+
+    mpz_clear(t1);
+    return retval;
+}
+
+void pcs_ep_sub(const pcs_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t plain1)
+{
+    mpz_t t1;
+    mpz_init(t1);
+
+    /* As g = n + 1, g^(-m) = 1 + (-m mod n) * n mod n^2, which is already
+     * reduced, so no exponentiation or inversion is needed */
+    mpz_neg(t1, plain1);
+    mpz_mod(t1, t1, pk->n);
+    mpz_mul(t1, t1, pk->n);
+    mpz_add_ui(t1, t1, 1);
+    mpz_mul(rop, cipher1, t1);
+    mpz_mod(rop, rop, pk->n2);
+
+    mpz_clear(t1);
+}
+
+int pcs_e_neg_batch(const pcs_public_key *pk, mpz_t *rop, mpz_t *cipher,
+        unsigned long count)
 {
-    mpz_powm(rop, cipher1, plain1, pk->n2);
+    return mpz_invert_batch(rop, cipher, count, pk->n2);
+}
+
+int pcs_ee_sub_batch(const pcs_public_key *pk, mpz_t *rop, mpz_t *cipher1,
+        mpz_t *cipher2, unsigned long count)
+{
+    int retval = 0;
+    mpz_t *inv = malloc(sizeof(mpz_t) * count);
+    if (inv == NULL)
+        return 0;
+
+    for (unsigned long i = 0; i < count; ++i)
+        mpz_init(inv[i]);
+
+    if (!mpz_invert_batch(inv, cipher2, count, pk->n2))
+        goto failure;
+
+    #pragma omp parallel for
+    for (unsigned long i = 0; i < count; ++i) {
+        mpz_mul(rop[i], cipher1[i], inv[i]);
+        mpz_mod(rop[i], rop[i], pk->n2);
+    }
+    retval = 1;
+
+failure:
+    for (unsigned long i = 0; i < count; ++i)
+        mpz_clear(inv[i]);
+    free(inv);
+    return retval;
 }
 
 void pcs_clear_public_key(pcs_public_key *pk)
 {
-    mpz_zeros(pk->g, pk->n, pk->n2, NULL);
+    mpz_zeros_public(pk->g, pk->n, pk->n2, NULL);
 }
 
 void pcs_clear_private_key(pcs_private_key *vk)
 {
-    mpz_zeros(vk->p, vk->p2, vk->q, vk->q2, vk->hp, vk->hq, vk->mu,
-              vk->lambda, vk->n, vk->n2, NULL);
+    mpz_zeros_secret(vk->p, vk->p2, vk->q, vk->q2, vk->hp, vk->hq, vk->mu,
+                     vk->lambda, NULL);
+    mpz_zeros_public(vk->n, vk->n2, NULL);
+    hcs_clear_crt(vk->crt);
 }
 
 void pcs_free_private_key(pcs_private_key *vk)
@@ -264,6 +395,7 @@ void pcs_free_private_key(pcs_private_key *vk)
     pcs_clear_private_key(vk);
     mpz_clears(vk->p, vk->p2, vk->q, vk->q2, vk->hp, vk->hq, vk->mu,
                vk->lambda, vk->n, vk->n2, NULL);
+    hcs_free_crt(vk->crt);
     free(vk);
 }
 
@@ -274,91 +406,87 @@ void pcs_free_public_key(pcs_public_key *pk)
     free(pk);
 }
 
-int pcs_verify_key_pair(pcs_public_key *pk, pcs_private_key *vk)
+int pcs_verify_key_pair(const pcs_public_key *pk, const pcs_private_key *vk)
 {
     return mpz_cmp(vk->n, pk->n) == 0;
 }
 
-char *pcs_export_public_key(pcs_public_key *pk)
+int pcs_validate_batch(const pcs_public_key *pk, mpz_t *cipher,
+        unsigned long count, int *valid)
 {
-    char *buffer;
-    char *retstr;
+    return mpz_validate_batch(pk->n, pk->n2, cipher, count, valid);
+}
 
-    JSON_Value *root = json_value_init_object();
-    JSON_Object *obj  = json_value_get_object(root);
-    buffer = mpz_get_str(NULL, HCS_INTERNAL_BASE, pk->n);
-    json_object_set_string(obj, "n", buffer);
-    retstr = json_serialize_to_string(root);
+char *pcs_export_public_key(const pcs_public_key *pk)
+{
+    JSON_Value *root = hcs_json_init_object();
+    if (root == NULL)
+        return NULL;
 
-    json_value_free(root);
-    free(buffer);
-    return retstr;
+    JSON_Object *obj = json_value_get_object(root);
+    return hcs_json_finish(root, hcs_json_set_mpz(obj, "n", pk->n));
 }
 
-char *pcs_export_private_key(pcs_private_key *vk)
+char *pcs_export_private_key(const pcs_private_key *vk)
 {
-    char *buffer;
-    char *retstr;
-
-    /* Allocate space for largest buffer output value used */
-    size_t buffer_size = mpz_sizeinbase((mpz_cmp(vk->p, vk->q) >= 0
-            ? vk->p : vk->q), HCS_INTERNAL_BASE) + 2;
-    buffer = malloc(buffer_size);
+    JSON_Value *root = hcs_json_init_object();
+    if (root == NULL)
+        return NULL;
 
-    JSON_Value *root = json_value_init_object();
     JSON_Object *obj = json_value_get_object(root);
-    mpz_get_str(buffer, HCS_INTERNAL_BASE, vk->p);
-    json_object_set_string(obj, "p", buffer);
-    mpz_get_str(buffer, HCS_INTERNAL_BASE, vk->q);
-    json_object_set_string(obj, "q", buffer);
-    retstr = json_serialize_to_string(root);
-
-    json_value_free(root);
-    free(buffer);
-    return retstr;
+    int ok = hcs_json_set_mpz(obj, "p", vk->p) &&
+             hcs_json_set_mpz(obj, "q", vk->q);
+    return hcs_json_finish(root, ok);
 }
 
 int pcs_import_public_key(pcs_public_key *pk, const char *json)
 {
     JSON_Value *root = json_parse_string(json);
-    JSON_Object *obj = json_value_get_object(root);
-    mpz_set_str(pk->n, json_object_get_string(obj, "n"), HCS_INTERNAL_BASE);
+    int ok = hcs_json_get_mpz(json_value_get_object(root), "n", pk->n);
     json_value_free(root);
+    if (!ok)
+        return 0;
 
     /* Calculate remaining values */
     mpz_add_ui(pk->g, pk->n, 1);
     mpz_pow_ui(pk->n2, pk->n, 2);
-    return 0;
+    return 1;
 }
 
 int pcs_import_private_key(pcs_private_key *vk, const char *json)
 {
     JSON_Value *root = json_parse_string(json);
     JSON_Object *obj = json_value_get_object(root);
-    mpz_set_str(vk->p, json_object_get_string(obj, "p"), HCS_INTERNAL_BASE);
-    mpz_set_str(vk->q, json_object_get_string(obj, "q"), HCS_INTERNAL_BASE);
+    int ok = hcs_json_get_mpz(obj, "p", vk->p) &&
+             hcs_json_get_mpz(obj, "q", vk->q);
     json_value_free(root);
+    if (!ok)
+        return 0;
 
     /* Calculate remaining values */
     mpz_pow_ui(vk->p2, vk->p, 2);
     mpz_pow_ui(vk->q2, vk->q, 2);
     mpz_mul(vk->n, vk->p, vk->q);
     mpz_sub_ui(vk->lambda, vk->p, 1);
-    mpz_sub_ui(vk->q, vk->q, 1);
-    mpz_lcm(vk->lambda, vk->lambda, vk->q);
-    mpz_add_ui(vk->q, vk->q, 1);
+    mpz_sub_ui(vk->hq, vk->q, 1);     /* hq is scratch until computed below */
+    mpz_lcm(vk->lambda, vk->lambda, vk->hq);
     mpz_pow_ui(vk->n2, vk->n, 2);
-    mpz_invert(vk->mu, vk->lambda, vk->n);
+
+    /* g = n + 1 is held in mu until it is no longer needed */
+    mpz_add_ui(vk->mu, vk->n, 1);
     mpz_sub_ui(vk->hp, vk->p, 1);
-    mpz_add_ui(vk->hq, vk->n, 1);
-    mpz_powm(vk->hp, vk->hq, vk->hp, vk->p2);
+    mpz_powm(vk->hp, vk->mu, vk->hp, vk->p2);
     mpz_sub_ui(vk->hp, vk->hp, 1);
     mpz_tdiv_q(vk->hp, vk->hp, vk->p);
     mpz_invert(vk->hp, vk->hp, vk->p);
     mpz_sub_ui(vk->hq, vk->q, 1);
-    mpz_powm(vk->hq, vk->hq, vk->hq, vk->q2);
+    mpz_powm(vk->hq, vk->mu, vk->hq, vk->q2);
     mpz_sub_ui(vk->hq, vk->hq, 1);
     mpz_tdiv_q(vk->hq, vk->hq, vk->q);
     mpz_invert(vk->hq, vk->hq, vk->q);
-    return 0;
+    mpz_invert(vk->mu, vk->lambda, vk->n);
+    hcs_crt_set_modulus(vk->crt, vk->p, 0);
+    hcs_crt_set_modulus(vk->crt, vk->q, 1);
+    hcs_crt_precompute(vk->crt);
+    return 1;
 }
@@ -0,0 +1,389 @@
+/*
+ * @file pcs_ope.c
+ *
+ * Oblivious polynomial evaluation and private set intersection over pcs.
+ *
+ * Every point is evaluated as one multi-exponentiation over the coefficients
+ * of its bucket, plus g, which adds the point itself for set intersection.
+ * The table row for g is the same for every bucket, so each thread fills it
+ * once and only rebuilds the coefficient rows. Each result is then
+ * rerandomised by a fresh n-th residue s^n. Powers of one shared residue
+ * would keep every output's randomness in the group it generates, which a
+ * receiver holding the factorisation could test guesses against.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <gmp.h>
+
+#include "../include/libhcs/hcs_random.h"
+#include "../include/libhcs/pcs.h"
+#include "../include/libhcs/pcs_ope.h"
+#include "com/sha256.h"
+#include "com/util.h"
+
+static mpz_t* init_array(unsigned long count)
+{
+    mpz_t *a = malloc(sizeof(mpz_t) * (count ? count : 1));
+    if (a == NULL)
+        return NULL;
+
+    for (unsigned long i = 0; i < count; ++i)
+        mpz_init(a[i]);
+    return a;
+}
+
+static void free_array(mpz_t *a, unsigned long count)
+{
+    if (a == NULL)
+        return;
+
+    for (unsigned long i = 0; i < count; ++i)
+        mpz_clear(a[i]);
+    free(a);
+}
+
+static void free_array_secret(mpz_t *a, unsigned long count)
+{
+    if (a == NULL)
+        return;
+
+    for (unsigned long i = 0; i < count; ++i)
+        mpz_clears_secret(a[i], NULL);
+    free(a);
+}
+
+pcs_ope_poly* pcs_ope_init_poly(void)
+{
+    pcs_ope_poly *poly = malloc(sizeof(pcs_ope_poly));
+    if (poly == NULL)
+        return NULL;
+
+    poly->buckets = 0;
+    poly->degree = 0;
+    poly->coeff = NULL;
+    return poly;
+}
+
+unsigned long pcs_ope_bucket(const mpz_t x, unsigned long buckets)
+{
+    unsigned char digest[32];
+    unsigned long long h = 0;
+    size_t count = (mpz_sizeinbase(x, 2) + 7) / 8;
+    sha256_state st;
+
+    unsigned char *bytes = malloc(count ? count : 1);
+    if (bytes == NULL)
+        return mpz_fdiv_ui(x, buckets);
+
+    if (mpz_sgn(x) != 0)
+        mpz_export(bytes, &count, 1, 1, 1, 0, x);
+    else
+        count = 0;
+
+    sha256_init(&st);
+    sha256_update(&st, bytes, count);
+    sha256_digest(&st, digest);
+    free(bytes);
+
+    for (int i = 0; i < 8; ++i)
+        h = (h << 8) | digest[i];
+    return h % buckets;
+}
+
+/* Sort the indices of values by bucket. On return, the values of bucket b
+ * are order[start[b]] up to order[start[b+1]]. On failure both arrays are
+ * released and set to NULL, so callers may free them again. */
+static int sort_by_bucket(mpz_t *values, unsigned long count,
+        unsigned long buckets, unsigned long **order, unsigned long **start)
+{
+    unsigned long *bucket = malloc(sizeof(unsigned long) * (count ? count : 1));
+    *order = malloc(sizeof(unsigned long) * (count ? count : 1));
+    *start = calloc(buckets + 1, sizeof(unsigned long));
+
+    if (bucket == NULL || *order == NULL || *start == NULL) {
+        free(bucket);
+        free(*order);
+        free(*start);
+        *order = *start = NULL;
+        return 0;
+    }
+
+    #pragma omp parallel for
+    for (unsigned long i = 0; i < count; ++i)
+        bucket[i] = pcs_ope_bucket(values[i], buckets);
+
+    for (unsigned long i = 0; i < count; ++i)
+        (*start)[bucket[i] + 1]++;
+    for (unsigned long b = 0; b < buckets; ++b)
+        (*start)[b + 1] += (*start)[b];
+
+    /* Place each value at the end of its bucket's run so far, using the
+     * entry after the bucket as a cursor */
+    for (unsigned long i = 0; i < count; ++i)
+        (*order)[(*start)[bucket[i]]++] = i;
+    for (unsigned long b = buckets; b > 0; --b)
+        (*start)[b] = (*start)[b - 1];
+    (*start)[0] = 0;
+
+    free(bucket);
+    return 1;
+}
+
+int pcs_ope_encrypt_set(const pcs_public_key *pk, hcs_random *hr,
+        pcs_ope_poly *poly, mpz_t *set, unsigned long count,
+        unsigned long buckets)
+{
+    int retval = 0;
+    unsigned long *order = NULL, *start = NULL, degree = 0, size = 0;
+    mpz_t *plain = NULL, *r = NULL, *coeff = NULL;
+
+    if (buckets == 0)
+        buckets = count / 4 ? count / 4 : 1;
+
+    if (!sort_by_bucket(set, count, buckets, &order, &start))
+        return 0;
+
+    for (unsigned long b = 0; b < buckets; ++b) {
+        if (start[b + 1] - start[b] > degree)
+            degree = start[b + 1] - start[b];
+    }
+
+    size = buckets * (degree + 1);
+    plain = init_array(size);
+    r = init_array(size);
+    coeff = init_array(size);
+    if (plain == NULL || r == NULL || coeff == NULL)
+        goto failure;
+
+    /* Expand prod (z - x) over the roots of each bucket. Coefficients above
+     * the number of roots stay zero. */
+    #pragma omp parallel for schedule(dynamic)
+    for (unsigned long b = 0; b < buckets; ++b) {
+        mpz_t *c = plain + b * (degree + 1);
+        mpz_set_ui(c[0], 1);
+
+        for (unsigned long k = start[b]; k < start[b + 1]; ++k) {
+            mpz_srcptr x = set[order[k]];
+            const unsigned long roots = k - start[b];
+
+            mpz_set(c[roots + 1], c[roots]);
+            for (unsigned long i = roots; i > 0; --i) {
+                mpz_mul(c[i], c[i], x);
+                mpz_sub(c[i], c[i - 1], c[i]);
+                mpz_mod(c[i], c[i], pk->n);
+            }
+            mpz_mul(c[0], c[0], x);
+            mpz_neg(c[0], c[0]);
+            mpz_mod(c[0], c[0], pk->n);
+        }
+    }
+
+    /* Randomness is drawn in order so the expensive encryptions may run in
+     * parallel */
+    for (unsigned long i = 0; i < size; ++i)
+        mpz_random_in_mult_group(r[i], hr->rstate, pk->n);
+
+    #pragma omp parallel for
+    for (unsigned long i = 0; i < size; ++i)
+        pcs_encrypt_r(pk, coeff[i], plain[i], r[i]);
+
+    pcs_ope_clear_poly(poly);
+    poly->buckets = buckets;
+    poly->degree = degree;
+    poly->coeff = coeff;
+    coeff = NULL;
+    retval = 1;
+
+failure:
+    free_array_secret(plain, size);
+    free_array_secret(r, size);
+    free_array(coeff, size);
+    free(order);
+    free(start);
+    return retval;
+}
+
+/* Evaluate poly at each point. If psi is set, rop[perm[j]] is set to
+ * Enc(blind[j] * P(y) + y), otherwise rop[j] is set to Enc(P(y)). */
+static int evaluate(const pcs_public_key *pk, hcs_random *hr,
+        const pcs_ope_poly *poly, mpz_t *rop, mpz_t *points,
+        unsigned long count, int psi)
+{
+    int retval = 0, failed = 0;
+    const unsigned long coeffs = poly->degree + 1;
+    const unsigned long width = coeffs + 1;
+    const unsigned long row = 1UL << HCS_MULTI_POWM_WINDOW;
+    unsigned long *order = NULL, *start = NULL, *perm = NULL;
+    mpz_t *blind = NULL, *k = NULL, *shared = NULL, base[1];
+
+    if (count == 0)
+        return 1;
+
+    mpz_init_set(base[0], pk->g);
+    if (!sort_by_bucket(points, count, poly->buckets, &order, &start))
+        goto failure;
+
+    blind = init_array(psi ? count : 0);
+    k = init_array(count);
+    shared = init_array(row);
+    perm = malloc(sizeof(unsigned long) * count);
+    if (blind == NULL || k == NULL || shared == NULL || perm == NULL)
+        goto failure;
+
+    /* k[j] is the base of the fresh n-th residue rerandomising output j */
+    for (unsigned long j = 0; j < count; ++j) {
+        mpz_random_in_mult_group(k[j], hr->rstate, pk->n);
+        perm[j] = j;
+    }
+
+    if (psi) {
+        for (unsigned long j = 0; j < count; ++j)
+            mpz_random_in_mult_group(blind[j], hr->rstate, pk->n);
+
+        for (unsigned long j = count - 1; j > 0; --j) {
+            const unsigned long i = gmp_urandomm_ui(hr->rstate, j + 1);
+            const unsigned long t = perm[i];
+            perm[i] = perm[j];
+            perm[j] = t;
+        }
+    }
+
+    mpz_multi_powm_table(shared, base, 1, pk->n2);
+
+    #pragma omp parallel
+    {
+        mpz_t *table = init_array(width * row);
+        mpz_t *exp = init_array(width);
+        mpz_t t;
+        mpz_init(t);
+
+        if (table == NULL || exp == NULL) {
+            __atomic_store_n(&failed, 1, __ATOMIC_RELAXED);
+        }
+        else {
+            for (unsigned long i = 0; i < row; ++i)
+                mpz_set(table[coeffs * row + i], shared[i]);
+        }
+
+        #pragma omp for schedule(dynamic)
+        for (unsigned long b = 0; b < poly->buckets; ++b) {
+            if (table == NULL || exp == NULL || start[b] == start[b + 1])
+                continue;
+
+            mpz_multi_powm_table(table, poly->coeff + b * coeffs, coeffs,
+                                 pk->n2);
+
+            for (unsigned long x = start[b]; x < start[b + 1]; ++x) {
+                const unsigned long j = order[x];
+
+                /* exp[i] = blind * y^i mod n */
+                if (psi)
+                    mpz_set(t, blind[j]);
+                else
+                    mpz_set_ui(t, 1);
+                for (unsigned long i = 0; i < coeffs; ++i) {
+                    mpz_set(exp[i], t);
+                    mpz_mul(t, t, points[j]);
+                    mpz_mod(t, t, pk->n);
+                }
+
+                if (psi)
+                    mpz_mod(exp[coeffs], points[j], pk->n);
+                else
+                    mpz_set_ui(exp[coeffs], 0);
+
+                mpz_multi_powm_precomp(rop[perm[j]], table, exp, width,
+                                       pk->n2);
+
+                /* k[j]^n is an encryption of zero */
+                mpz_powm(t, k[j], pk->n, pk->n2);
+                mpz_mul(rop[perm[j]], rop[perm[j]], t);
+                mpz_mod(rop[perm[j]], rop[perm[j]], pk->n2);
+            }
+        }
+
+        mpz_clear(t);
+        free_array(table, width * row);
+        free_array(exp, width);
+    }
+
+    retval = !failed;
+
+failure:
+    free_array_secret(blind, psi ? count : 0);
+    free_array_secret(k, count);
+    free_array(shared, row);
+    mpz_clear(base[0]);
+    free(perm);
+    free(order);
+    free(start);
+    return retval;
+}
+
+int pcs_ope_evaluate(const pcs_public_key *pk, hcs_random *hr,
+        const pcs_ope_poly *poly, mpz_t *rop, mpz_t *points,
+        unsigned long count)
+{
+    return evaluate(pk, hr, poly, rop, points, count, 0);
+}
+
+int pcs_psi_respond(const pcs_public_key *pk, hcs_random *hr,
+        const pcs_ope_poly *poly, mpz_t *rop, mpz_t *points,
+        unsigned long count)
+{
+    return evaluate(pk, hr, poly, rop, points, count, 1);
+}
+
+static int cmp_mpz(const void *a, const void *b)
+{
+    return mpz_cmp(*(mpz_srcptr const *)a, *(mpz_srcptr const *)b);
+}
+
+int pcs_psi_intersect(const pcs_private_key *vk, mpz_t *rop,
+        unsigned long *found, mpz_t *response, unsigned long count,
+        mpz_t *set, unsigned long set_count)
+{
+    int retval = 0;
+    mpz_t *plain = init_array(count);
+    mpz_srcptr *sorted = malloc(sizeof(mpz_srcptr) *
+                                (set_count ? set_count : 1));
+
+    if (plain == NULL || sorted == NULL)
+        goto failure;
+
+    for (unsigned long i = 0; i < set_count; ++i)
+        sorted[i] = set[i];
+    qsort(sorted, set_count, sizeof(mpz_srcptr), cmp_mpz);
+
+    #pragma omp parallel for
+    for (unsigned long i = 0; i < count; ++i)
+        pcs_decrypt(vk, plain[i], response[i]);
+
+    *found = 0;
+    for (unsigned long i = 0; i < count; ++i) {
+        mpz_srcptr key = plain[i];
+        if (bsearch(&key, sorted, set_count, sizeof(mpz_srcptr), cmp_mpz))
+            mpz_set(rop[(*found)++], plain[i]);
+    }
+    retval = 1;
+
+failure:
+    free_array_secret(plain, plain ? count : 0);
+    free(sorted);
+    return retval;
+}
+
+void pcs_ope_clear_poly(pcs_ope_poly *poly)
+{
+    free_array(poly->coeff, poly->buckets * (poly->degree + 1));
+    poly->coeff = NULL;
+    poly->buckets = 0;
+    poly->degree = 0;
+}
+
+void pcs_ope_free_poly(pcs_ope_poly *poly)
+{
+    pcs_ope_clear_poly(poly);
+    free(poly);
+}
@@ -0,0 +1,389 @@
+/**
+ * @file pcs_stream.c
+ *
+ * Pipelined encryption and decryption of pcs records.
+ *
+ * A fixed number of chunks circulate between three queues, as in
+ * pcs_t_tally.c. The reader takes a free chunk, fills it with records and
+ * queues it both for the workers and, in order, for the writer. A worker
+ * transforms every record of a chunk in place and marks it done. The writer
+ * takes chunks in the order they were read, waits for each to be done,
+ * writes it and returns it as free. Output order therefore never depends on
+ * which worker finishes first, and a slow writer stalls the reader only
+ * through the lack of free chunks.
+ */
+
+#define _POSIX_C_SOURCE 200112L /* For sysconf */
+
+#include <ctype.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <gmp.h>
+
+#include "../include/libhcs/hcs_random.h"
+#include "../include/libhcs/pcs.h"
+#include "../include/libhcs/pcs_stream.h"
+#include "com/omp.h"
+#include "com/queue.h"
+#include "com/wire.h"
+
+#define STREAM_MAGIC 0x48435343
+
+/* Records per chunk. Queue operations are paid once per chunk, which keeps
+ * them negligible even for small keys. */
+#define STREAM_CHUNK 32
+
+typedef struct {
+    unsigned long count;        /* Records held */
+    int done;                   /* Set once transformed, under the lock */
+    mpz_t value[STREAM_CHUNK];
+} stream_chunk;
+
+typedef struct stream stream;
+
+struct stream {
+    const pcs_public_key *pk;
+    const pcs_private_key *vk;
+    /* Returns 1 if a record was read, 0 at the end of the stream and -1 if
+     * the stream is malformed */
+    int (*read)(stream *st, FILE *in, mpz_t rop);
+    void (*apply)(stream *st, hcs_random *hr, mpz_t op);
+    int (*write)(stream *st, FILE *out, mpz_t op);
+    size_t max;                 /* Largest ciphertext in bytes */
+    unsigned char *scratch;     /* Used by whichever of the reader and
+                                   writer handles ciphertexts */
+    int failed;                 /* Accessed atomically */
+    unsigned long depth;
+    stream_chunk *chunks;
+    hcs_queue free;             /* Chunks ready to be read into */
+    hcs_queue work;             /* Chunks awaiting a worker */
+    hcs_queue order;            /* Chunks in the order they were read */
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+    FILE *out;
+};
+
+typedef struct {
+    stream *st;
+    hcs_random hr;
+} stream_worker;
+
+static int init_stream(stream *st, unsigned long depth)
+{
+    st->failed = 0;
+    st->depth = depth;
+    st->chunks = malloc(sizeof(stream_chunk) * depth);
+    st->scratch = malloc(4 + st->max);
+    if (!st->chunks || !st->scratch)
+        goto failure;
+
+    if (!hcs_queue_init(&st->free, depth))
+        goto failure;
+    if (!hcs_queue_init(&st->work, depth)) {
+        hcs_queue_destroy(&st->free);
+        goto failure;
+    }
+    if (!hcs_queue_init(&st->order, depth)) {
+        hcs_queue_destroy(&st->work);
+        hcs_queue_destroy(&st->free);
+        goto failure;
+    }
+
+    if (pthread_mutex_init(&st->lock, NULL))
+        goto queues;
+    if (pthread_cond_init(&st->done, NULL)) {
+        pthread_mutex_destroy(&st->lock);
+        goto queues;
+    }
+
+    for (unsigned long i = 0; i < depth; ++i) {
+        for (unsigned long j = 0; j < STREAM_CHUNK; ++j)
+            mpz_init(st->chunks[i].value[j]);
+        hcs_queue_push(&st->free, &st->chunks[i]);
+    }
+
+    return 1;
+
+queues:
+    hcs_queue_destroy(&st->order);
+    hcs_queue_destroy(&st->work);
+    hcs_queue_destroy(&st->free);
+failure:
+    free(st->scratch);
+    free(st->chunks);
+    return 0;
+}
+
+static void clear_stream(stream *st)
+{
+    for (unsigned long i = 0; i < st->depth; ++i) {
+        for (unsigned long j = 0; j < STREAM_CHUNK; ++j)
+            mpz_clear(st->chunks[i].value[j]);
+    }
+
+    pthread_cond_destroy(&st->done);
+    pthread_mutex_destroy(&st->lock);
+    hcs_queue_destroy(&st->order);
+    hcs_queue_destroy(&st->work);
+    hcs_queue_destroy(&st->free);
+    free(st->scratch);
+    free(st->chunks);
+}
+
+static void fail(stream *st)
+{
+    __atomic_store_n(&st->failed, 1, __ATOMIC_RELAXED);
+}
+
+static void* worker_thread(void *arg)
+{
+    stream_worker *w = arg;
+    stream *st = w->st;
+    stream_chunk *c;
+
+    /* The workers already occupy every core, so the parallel sections
+     * inside each operation would only oversubscribe them */
+    omp_set_num_threads(1);
+
+    while ((c = hcs_queue_pop(&st->work)) != NULL) {
+        for (unsigned long i = 0; i < c->count; ++i)
+            st->apply(st, &w->hr, c->value[i]);
+
+        pthread_mutex_lock(&st->lock);
+        c->done = 1;
+        pthread_cond_broadcast(&st->done);
+        pthread_mutex_unlock(&st->lock);
+    }
+
+    return NULL;
+}
+
+static void* writer_thread(void *arg)
+{
+    stream *st = arg;
+    stream_chunk *c;
+
+    while ((c = hcs_queue_pop(&st->order)) != NULL) {
+        pthread_mutex_lock(&st->lock);
+        while (!c->done)
+            pthread_cond_wait(&st->done, &st->lock);
+        pthread_mutex_unlock(&st->lock);
+
+        /* After a failure chunks are still recycled, so the reader is never
+         * left waiting for a free one */
+        for (unsigned long i = 0; i < c->count; ++i) {
+            if (__atomic_load_n(&st->failed, __ATOMIC_RELAXED))
+                break;
+            if (!st->write(st, st->out, c->value[i]))
+                fail(st);
+        }
+
+        hcs_queue_push(&st->free, c);
+    }
+
+    return NULL;
+}
+
+/* Run the pipeline over @p in. If @p hr is given, each worker is seeded
+ * from it. */
+static int run_stream(stream *st, hcs_random *hr, FILE *in,
+        unsigned long workers, unsigned long depth)
+{
+    unsigned long started = 0, seeded = 0;
+    pthread_t writer, *threads = NULL;
+    stream_worker *w = NULL;
+
+    if (workers == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = cpus > 0 ? cpus : 1;
+    }
+    if (depth == 0)
+        depth = 4 * workers;
+
+    if (!init_stream(st, depth))
+        return 0;
+
+    threads = malloc(sizeof(pthread_t) * workers);
+    w = malloc(sizeof(stream_worker) * workers);
+    if (!threads || !w) {
+        fail(st);
+        goto end;
+    }
+
+    if (hr) {
+        mpz_t seed;
+        mpz_init(seed);
+        for (; seeded < workers; ++seeded) {
+            mpz_urandomb(seed, hr->rstate, HCS_RAND_SEED_BITS);
+            gmp_randinit_default(w[seeded].hr.rstate);
+            gmp_randseed(w[seeded].hr.rstate, seed);
+        }
+        mpz_clear(seed);
+    }
+
+    if (pthread_create(&writer, NULL, writer_thread, st)) {
+        fail(st);
+        goto end;
+    }
+
+    for (; started < workers; ++started) {
+        w[started].st = st;
+        if (pthread_create(&threads[started], NULL, worker_thread,
+                    &w[started]))
+            break;
+    }
+
+    /* The pipeline still makes progress with fewer workers than asked for,
+     * but never with none */
+    if (started == 0) {
+        fail(st);
+        hcs_queue_close(&st->order);
+        pthread_join(writer, NULL);
+        goto end;
+    }
+
+    while (!__atomic_load_n(&st->failed, __ATOMIC_RELAXED)) {
+        stream_chunk *c = hcs_queue_pop(&st->free);
+        int r = 1;
+
+        c->count = 0;
+        while (c->count < STREAM_CHUNK &&
+                (r = st->read(st, in, c->value[c->count])) > 0)
+            c->count++;
+
+        if (r < 0)
+            fail(st);
+
+        if (c->count) {
+            c->done = 0;
+            hcs_queue_push(&st->order, c);
+            hcs_queue_push(&st->work, c);
+        }
+        else {
+            hcs_queue_push(&st->free, c);
+        }
+
+        if (r <= 0)
+            break;
+    }
+
+    hcs_queue_close(&st->work);
+    for (unsigned long i = 0; i < started; ++i)
+        pthread_join(threads[i], NULL);
+
+    hcs_queue_close(&st->order);
+    pthread_join(writer, NULL);
+
+    if (fflush(st->out))
+        fail(st);
+
+end:
+    for (unsigned long i = 0; i < seeded; ++i)
+        gmp_randclear(w[i].hr.rstate);
+    free(w);
+    free(threads);
+
+    int retval = !st->failed;
+    clear_stream(st);
+    return retval;
+}
+
+static int read_plaintext(stream *st, FILE *in, mpz_t rop)
+{
+    int c;
+    while ((c = getc(in)) != EOF && isspace(c))
+        ;
+    if (c == EOF)
+        return ferror(in) ? -1 : 0;
+    ungetc(c, in);
+
+    if (mpz_inp_str(rop, in, 10) == 0)
+        return -1;
+    if (mpz_sgn(rop) < 0 || mpz_cmp(rop, st->pk->n) >= 0)
+        return -1;
+    return 1;
+}
+
+static int write_plaintext(stream *st, FILE *out, mpz_t op)
+{
+    (void)st;
+    return mpz_out_str(out, 10, op) != 0 && fputc('\n', out) != EOF;
+}
+
+static int read_ciphertext(stream *st, FILE *in, mpz_t rop)
+{
+    size_t got = fread(st->scratch, 1, 4, in);
+    if (got == 0 && feof(in))
+        return 0;
+    if (got != 4)
+        return -1;
+
+    uint32_t len = hcs_wire_get_u32(st->scratch);
+    if (len > st->max || fread(st->scratch, 1, len, in) != len)
+        return -1;
+
+    mpz_import(rop, len, 1, 1, 1, 0, st->scratch);
+    return 1;
+}
+
+static int write_ciphertext(stream *st, FILE *out, mpz_t op)
+{
+    size_t len = hcs_wire_put_mpz(st->scratch, op) - st->scratch;
+    return fwrite(st->scratch, 1, len, out) == len;
+}
+
+static void apply_encrypt(stream *st, hcs_random *hr, mpz_t op)
+{
+    pcs_encrypt(st->pk, hr, op, op);
+}
+
+static void apply_decrypt(stream *st, hcs_random *hr, mpz_t op)
+{
+    (void)hr;
+    pcs_decrypt(st->vk, op, op);
+}
+
+int pcs_encrypt_stream(const pcs_public_key *pk, hcs_random *hr, FILE *in,
+        FILE *out, unsigned long workers, unsigned long depth)
+{
+    unsigned char magic[4];
+    stream st;
+
+    st.pk = pk;
+    st.vk = NULL;
+    st.read = read_plaintext;
+    st.apply = apply_encrypt;
+    st.write = write_ciphertext;
+    st.max = (mpz_sizeinbase(pk->n2, 2) + 7) / 8;
+    st.out = out;
+
+    hcs_wire_put_u32(magic, STREAM_MAGIC);
+    if (fwrite(magic, 1, 4, out) != 4)
+        return 0;
+
+    return run_stream(&st, hr, in, workers, depth);
+}
+
+int pcs_decrypt_stream(const pcs_private_key *vk, FILE *in, FILE *out,
+        unsigned long workers, unsigned long depth)
+{
+    unsigned char magic[4];
+    stream st;
+
+    st.pk = NULL;
+    st.vk = vk;
+    st.read = read_ciphertext;
+    st.apply = apply_decrypt;
+    st.write = write_plaintext;
+    st.max = (mpz_sizeinbase(vk->n2, 2) + 7) / 8;
+    st.out = out;
+
+    if (fread(magic, 1, 4, in) != 4 ||
+            hcs_wire_get_u32(magic) != STREAM_MAGIC)
+        return 0;
+
+    return run_stream(&st, NULL, in, workers, depth);
+}
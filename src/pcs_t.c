@@ -18,22 +18,78 @@
 #include <string.h>
 #include <gmp.h>
 
+#include "../include/libhcs/hcs_prime_pool.h"
 #include "../include/libhcs/hcs_random.h"
 #include "../include/libhcs/hcs_shares.h"
 #include "../include/libhcs/pcs_t.h"
+#include "com/combiner.h"
+#include "com/json.h"
 #include "com/parson.h"
+#include "com/transcript.h"
 #include "com/util.h"
 
+/* Number of bits in each proof challenge. Digests are truncated to this. */
 #define HCS_HASH_SIZE 160
 
 /* This is simply L(x) when s = 1 */
-static void dlog_s(mpz_t n, mpz_t rop, mpz_t op)
+static void dlog_s(const mpz_t n, mpz_t rop, mpz_t op)
 {
     mpz_sub_ui(rop, op, 1);
     mpz_divexact(rop, rop, n);
     mpz_mod(rop, rop, n);
 }
 
+/* Recover the plaintext from the combined value c' = c^(4 * delta^2 * d) */
+static int combine_finish(const pcs_t_public_key *pk, mpz_t rop)
+{
+    int retval;
+    mpz_t t1;
+    mpz_init(t1);
+
+    dlog_s(pk->n, rop, rop);
+    mpz_pow_ui(t1, pk->delta, 2);
+    mpz_mul_ui(t1, t1, 4);
+
+    retval = mpz_invert(t1, t1, pk->n) != 0;
+    if (retval) {
+        mpz_mul(rop, rop, t1);
+        mpz_mod(rop, rop, pk->n);
+    }
+
+    mpz_clear(t1);
+    return retval;
+}
+
+/* Challenge for the n^s protocol. The modulus, the value being proven and
+ * the prover's first message are all bound into the transcript. */
+static void ns_challenge(const pcs_t_public_key *pk, mpz_t rop, mpz_t u,
+        mpz_t a, unsigned long id)
+{
+    hcs_transcript tr;
+    hcs_transcript_init(&tr, HCS_HASH_DEFAULT);
+    hcs_transcript_absorb_mpz(&tr, pk->n);
+    hcs_transcript_absorb_mpz(&tr, u);
+    hcs_transcript_absorb_mpz(&tr, a);
+    hcs_transcript_absorb_ul(&tr, id);
+    hcs_transcript_challenge(&tr, rop);
+    mpz_tdiv_r_2exp(rop, rop, HCS_HASH_SIZE);
+}
+
+/* Challenge for the 1of2 n^s protocol. */
+static void ns_1of2_challenge(const pcs_t_public_key *pk, mpz_t rop, mpz_t u,
+        pcs_t_proof *pf, unsigned long id)
+{
+    hcs_transcript tr;
+    hcs_transcript_init(&tr, HCS_HASH_DEFAULT);
+    hcs_transcript_absorb_mpz(&tr, pk->n);
+    hcs_transcript_absorb_mpz(&tr, u);
+    hcs_transcript_absorb_mpz(&tr, pf->a[0]);
+    hcs_transcript_absorb_mpz(&tr, pf->a[1]);
+    hcs_transcript_absorb_ul(&tr, id);
+    hcs_transcript_challenge(&tr, rop);
+    mpz_tdiv_r_2exp(rop, rop, HCS_HASH_SIZE);
+}
+
 pcs_t_public_key* pcs_t_init_public_key(void)
 {
     pcs_t_public_key *pk = malloc(sizeof(pcs_t_public_key));
@@ -52,6 +108,7 @@ pcs_t_private_key* pcs_t_init_private_key(void)
     if (!vk) return NULL;
 
     vk->w = vk->l = 0;
+    vk->vi = NULL;
     mpz_init(vk->v);
     mpz_init(vk->nm);
     mpz_init(vk->n);
@@ -60,11 +117,24 @@ pcs_t_private_key* pcs_t_init_private_key(void)
     return vk;
 }
 
+/* Take a safe prime and its Sophie Germain prime from the pool, or generate
+ * them inline if the pool cannot supply one. */
+static void pool_safe_prime(hcs_prime_pool *pool, hcs_random *hr, mpz_t p,
+        mpz_t q, mp_bitcnt_t bits)
+{
+    if (pool && hcs_prime_pool_safe(pool) &&
+            hcs_prime_pool_bits(pool) == bits &&
+            hcs_prime_pool_take(pool, p, q))
+        return;
+
+    mpz_random_safe_prime(p, q, hr->rstate, bits);
+}
+
 /* Look into methods of using multiparty computation to generate these keys
  * and the data so we don't have to have a trusted party for generation. */
-int pcs_t_generate_key_pair(pcs_t_public_key *pk, pcs_t_private_key *vk,
-        hcs_random *hr, const unsigned long bits, const unsigned long w,
-        const unsigned long l)
+static int generate_key_pair(pcs_t_public_key *pk, pcs_t_private_key *vk,
+        hcs_random *hr, hcs_prime_pool *pool, const unsigned long bits,
+        const unsigned long w, const unsigned long l)
 {
     /* The paper does describe some bounds on w, l */
     //assert(l / 2 <= w && w <= l);
@@ -79,8 +149,8 @@ int pcs_t_generate_key_pair(pcs_t_public_key *pk, pcs_t_private_key *vk,
     mpz_init(t4);
 
     do {
-        mpz_random_safe_prime(t1, t2, hr->rstate, 1 + (bits-1)/2);
-        mpz_random_safe_prime(t3, t4, hr->rstate, 1 + (bits-1)/2);
+        pool_safe_prime(pool, hr, t1, t2, 1 + (bits-1)/2);
+        pool_safe_prime(pool, hr, t3, t4, 1 + (bits-1)/2);
     } while (mpz_cmp(t1, t3) == 0);
 
     mpz_mul(pk->n, t1, t3);
@@ -103,15 +173,26 @@ int pcs_t_generate_key_pair(pcs_t_public_key *pk, pcs_t_private_key *vk,
     for (unsigned long i = 0; i < l; ++i)
         mpz_init(vk->vi[i]);
 
-    mpz_clear(t1);
-    mpz_clear(t2);
-    mpz_clear(t3);
-    mpz_clear(t4);
+    mpz_clears_secret(t1, t2, t3, t4, NULL);
 
     return 1;
 }
 
-void pcs_t_r_encrypt(pcs_t_public_key *pk, hcs_random *hr,
+int pcs_t_generate_key_pair(pcs_t_public_key *pk, pcs_t_private_key *vk,
+        hcs_random *hr, const unsigned long bits, const unsigned long w,
+        const unsigned long l)
+{
+    return generate_key_pair(pk, vk, hr, NULL, bits, w, l);
+}
+
+int pcs_t_generate_key_pair_pool(pcs_t_public_key *pk, pcs_t_private_key *vk,
+        hcs_random *hr, hcs_prime_pool *pool, const unsigned long bits,
+        const unsigned long w, const unsigned long l)
+{
+    return generate_key_pair(pk, vk, hr, pool, bits, w, l);
+}
+
+void pcs_t_r_encrypt(const pcs_t_public_key *pk, hcs_random *hr,
         mpz_t rop, mpz_t r, mpz_t plain1)
 {
     mpz_t t1;
@@ -126,7 +207,8 @@ void pcs_t_r_encrypt(pcs_t_public_key *pk, hcs_random *hr,
     mpz_clear(t1);
 }
 
-void pcs_t_encrypt_r(pcs_t_public_key *pk, mpz_t rop, mpz_t r, mpz_t plain1)
+void pcs_t_encrypt_r(const pcs_t_public_key *pk, mpz_t rop, mpz_t r,
+        mpz_t plain1)
 {
     mpz_t t1;
     mpz_init(t1);
@@ -139,7 +221,8 @@ void pcs_t_encrypt_r(pcs_t_public_key *pk, mpz_t rop, mpz_t r, mpz_t plain1)
     mpz_clear(t1);
 }
 
-void pcs_t_encrypt(pcs_t_public_key *pk, hcs_random *hr, mpz_t rop, mpz_t plain1)
+void pcs_t_encrypt(const pcs_t_public_key *pk, hcs_random *hr, mpz_t rop,
+        mpz_t plain1)
 {
     mpz_t t1;
     mpz_init(t1);
@@ -153,7 +236,8 @@ void pcs_t_encrypt(pcs_t_public_key *pk, hcs_random *hr, mpz_t rop, mpz_t plain1
     mpz_clear(t1);
 }
 
-void pcs_t_reencrypt(pcs_t_public_key *pk, hcs_random *hr, mpz_t rop, mpz_t op)
+void pcs_t_reencrypt(const pcs_t_public_key *pk, hcs_random *hr, mpz_t rop,
+        mpz_t op)
 {
     mpz_t t1;
     mpz_init(t1);
@@ -166,7 +250,8 @@ void pcs_t_reencrypt(pcs_t_public_key *pk, hcs_random *hr, mpz_t rop, mpz_t op)
     mpz_clear(t1);
 }
 
-void pcs_t_ep_add(pcs_t_public_key *pk, mpz_t rop, mpz_t cipher1, mpz_t plain1)
+void pcs_t_ep_add(const pcs_t_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t plain1)
 {
     mpz_t t1;
     mpz_init(t1);
@@ -179,15 +264,98 @@ void pcs_t_ep_add(pcs_t_public_key *pk, mpz_t rop, mpz_t cipher1, mpz_t plain1)
     mpz_clear(t1);
 }
 
-void pcs_t_ee_add(pcs_t_public_key *pk, mpz_t rop, mpz_t cipher1, mpz_t cipher2)
+void pcs_t_ee_add(const pcs_t_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t cipher2)
 {
     mpz_mul(rop, cipher1, cipher2);
     mpz_mod(rop, rop, pk->n2);
 }
 
-void pcs_t_ep_mul(pcs_t_public_key *pk, mpz_t rop, mpz_t cipher1, mpz_t plain1)
+int pcs_t_ep_mul(const pcs_t_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t plain1)
 {
-    mpz_powm(rop, cipher1, plain1, pk->n2);
+    return mpz_powm_signed(rop, cipher1, plain1, pk->n, pk->n2);
+}
+
+int pcs_t_e_neg(const pcs_t_public_key *pk, mpz_t rop, mpz_t cipher1)
+{
+    mpz_t t1;
+    mpz_init(t1);
+
+    int retval = mpz_invert(t1, cipher1, pk->n2);
+    if (retval)
+        mpz_set(rop, t1);
+
+    mpz_clear(t1);
+    return retval;
+}
+
+int pcs_t_ee_sub(const pcs_t_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t cipher2)
+{
+    mpz_t t1;
+    mpz_init(t1);
+
+    int retval = mpz_invert(t1, cipher2, pk->n2);
+    if (retval) {
+        mpz_mul(rop, cipher1, t1);
+        mpz_mod(rop, rop, pk->n2);
+    }
+
+    mpz_clear(t1);
+    return retval;
+}
+
+void pcs_t_ep_sub(const pcs_t_public_key *pk, mpz_t rop, mpz_t cipher1,
+        mpz_t plain1)
+{
+    mpz_t t1;
+    mpz_init(t1);
+
+    /* As g = n + 1, g^(-m) = 1 + (-m mod n) * n mod n^2, which is already
+     * reduced, so no exponentiation or inversion is needed */
+    mpz_neg(t1, plain1);
+    mpz_mod(t1, t1, pk->n);
+    mpz_mul(t1, t1, pk->n);
+    mpz_add_ui(t1, t1, 1);
+    mpz_mul(rop, cipher1, t1);
+    mpz_mod(rop, rop, pk->n2);
+
+    mpz_clear(t1);
+}
+
+int pcs_t_e_neg_batch(const pcs_t_public_key *pk, mpz_t *rop, mpz_t *cipher,
+        unsigned long count)
+{
+    return mpz_invert_batch(rop, cipher, count, pk->n2);
+}
+
+int pcs_t_ee_sub_batch(const pcs_t_public_key *pk, mpz_t *rop, mpz_t *cipher1,
+        mpz_t *cipher2, unsigned long count)
+{
+    int retval = 0;
+    mpz_t *inv = malloc(sizeof(mpz_t) * count);
+    if (inv == NULL)
+        return 0;
+
+    for (unsigned long i = 0; i < count; ++i)
+        mpz_init(inv[i]);
+
+    if (!mpz_invert_batch(inv, cipher2, count, pk->n2))
+        goto failure;
+
+    #pragma omp parallel for
+    for (unsigned long i = 0; i < count; ++i) {
+        mpz_mul(rop[i], cipher1[i], inv[i]);
+        mpz_mod(rop[i], rop[i], pk->n2);
+    }
+    retval = 1;
+
+failure:
+    for (unsigned long i = 0; i < count; ++i)
+        mpz_clear(inv[i]);
+    free(inv);
+    return retval;
 }
 
 pcs_t_proof* pcs_t_init_proof(void)
@@ -219,72 +387,66 @@ void pcs_t_set_proof(pcs_t_proof *pf, mpz_t generator, unsigned long m1,
     pf->m2 = m2;
 }
 
-void pcs_t_compute_ns_protocol(pcs_t_public_key *pk, hcs_random *hr,
+void pcs_t_compute_ns_protocol(const pcs_t_public_key *pk, hcs_random *hr,
         pcs_t_proof *pf, mpz_t cipher, mpz_t cipher_r, unsigned long id)
 {
-    mpz_t challenge, t1;
+    mpz_t challenge, r;
     mpz_init(challenge);
-    mpz_init(t1);
+    mpz_init(r);
 
     mpz_set(pf->e[0], cipher);
 
-    // Random r in Zn* and a = E(0, r)
-    mpz_set_ui(t1, 0);
-    pcs_t_r_encrypt(pk, hr, t1, pf->a[0], t1);
+    /* Random r in Zn* and a = E(0, r) */
+    mpz_random_in_mult_group(r, hr->rstate, pk->n);
+    mpz_powm(pf->a[0], r, pk->n, pk->n2);
 
-    mpz_ripemd_mpz_ul(challenge, pf->a[0], id);
+    ns_challenge(pk, challenge, cipher, pf->a[0], id);
 
     mpz_powm(pf->z[0], cipher_r, challenge, pk->n2);
-    mpz_mul(pf->z[0], pf->z[0], t1);
+    mpz_mul(pf->z[0], pf->z[0], r);
     mpz_mod(pf->z[0], pf->z[0], pk->n2);
 
-    mpz_clear(t1);
+    mpz_clears_secret(r, NULL);
     mpz_clear(challenge);
 }
 
-int pcs_t_verify_ns_protocol(pcs_t_public_key *pk, pcs_t_proof *pf,
+int pcs_t_verify_ns_protocol(const pcs_t_public_key *pk, pcs_t_proof *pf,
         unsigned long id)
 {
     int retval = 0;
 
-    mpz_t t1, t2;
+    mpz_t challenge, t1, t2;
+    mpz_init(challenge);
     mpz_init(t1);
     mpz_init(t2);
 
-    /* Ensure u, a, z are prime to n */
-    mpz_gcd(t1, pf->e[0], pk->n);
-    if (mpz_cmp_ui(t1, 1) != 0)
-        goto failure;
-
-    mpz_gcd(t1, pf->a[0], pk->n);
-    if (mpz_cmp_ui(t1, 1) != 0)
-        goto failure;
-
-    mpz_gcd(t1, pf->z[0], pk->n);
+    /* Ensure u, a, z are prime to n. Their product is prime to n exactly
+     * when each of them is, so a single gcd is enough. */
+    mpz_mul(t1, pf->e[0], pf->a[0]);
+    mpz_mod(t1, t1, pk->n);
+    mpz_mul(t1, t1, pf->z[0]);
+    mpz_gcd(t1, t1, pk->n);
     if (mpz_cmp_ui(t1, 1) != 0)
         goto failure;
 
-    mpz_set_ui(t1, 0);
-    pcs_t_encrypt_r(pk, t1, pf->z[0], t1);
-    mpz_ripemd_mpz_ul(pf->e[0], pf->a[0], id);
-    mpz_powm(t2, pf->e[0], pf->e[0], pk->n2);
+    /* z^n == a * u^e */
+    mpz_powm(t1, pf->z[0], pk->n, pk->n2);
+    ns_challenge(pk, challenge, pf->e[0], pf->a[0], id);
+    mpz_powm(t2, pf->e[0], challenge, pk->n2);
     mpz_mul(t2, t2, pf->a[0]);
     mpz_mod(t2, t2, pk->n2);
 
-    if (mpz_cmp(t1, t2) != 0) {
-        retval = 0;
-    }
-
-    retval = 1; /* Success */
+    retval = mpz_cmp(t1, t2) == 0;
 
 failure:
+    mpz_clear(challenge);
     mpz_clear(t1);
     mpz_clear(t2);
 
     return retval;
 }
 
-void pcs_t_compute_1of2_ns_protocol(pcs_t_public_key *pk, hcs_random *hr,
+void pcs_t_compute_1of2_ns_protocol(const pcs_t_public_key *pk, hcs_random *hr,
         pcs_t_proof *pf, mpz_t cipher_m, mpz_t cipher_r, unsigned long nth_power, unsigned long id)
 {
     mpz_t encrypt_value, other_value;
@@ -331,12 +493,10 @@ void pcs_t_compute_1of2_ns_protocol(pcs_t_public_key *pk, hcs_random *hr,
     /* Construct a random challenge */
     mpz_t challenge;
     mpz_init(challenge);
-    mpz_ripemd_3mpz_ul(challenge, pk->n, pf->a[0], pf->a[1], id);
+    ns_1of2_challenge(pk, challenge, cipher_m, pf, id);
 
-    mpz_ui_pow_ui(t1, 2, HCS_HASH_SIZE);
-    mpz_mod(t2, challenge, t1);
-    mpz_sub(pf->e[choice], t2, pf->e[1-choice]);
-    mpz_mod(pf->e[choice], pf->e[choice], t1);
+    mpz_sub(pf->e[choice], challenge, pf->e[1-choice]);
+    mpz_fdiv_r_2exp(pf->e[choice], pf->e[choice], HCS_HASH_SIZE);
 
     mpz_powm(t2, cipher_r, pf->e[choice], pk->n2);
     mpz_mul(t2, t2, r_hiding);
@@ -350,7 +510,7 @@ void pcs_t_compute_1of2_ns_protocol(pcs_t_public_key *pk, hcs_random *hr,
     mpz_clear(other_value);
 }
 
-int pcs_t_verify_1of2_ns_protocol(pcs_t_public_key *pk, pcs_t_proof *pf,
+int pcs_t_verify_1of2_ns_protocol(const pcs_t_public_key *pk, pcs_t_proof *pf,
         mpz_t cipher, unsigned long id)
 {
     int retval = 0;
@@ -364,8 +524,7 @@ int pcs_t_verify_1of2_ns_protocol(pcs_t_public_key *pk, pcs_t_proof *pf,
     mpz_init(t2);
 
     mpz_ui_pow_ui(pow2, 2, HCS_HASH_SIZE);
-    mpz_ripemd_3mpz_ul(challenge, pk->n, pf->a[0], pf->a[1], id);
-    mpz_mod(challenge, challenge, pow2);
+    ns_1of2_challenge(pk, challenge, cipher, pf, id);
     mpz_add(esum, pf->e[0], pf->e[1]);
     mpz_mod(esum, esum, pow2);
 
@@ -394,13 +553,6 @@ int pcs_t_verify_1of2_ns_protocol(pcs_t_public_key *pk, pcs_t_proof *pf,
     if (mpz_cmp(t1, t2) != 0)
         goto failure;
 
-    mpz_init(pow2);
-    mpz_init(challenge);
-    mpz_init(esum);
-    mpz_init(encrypt_value);
-    mpz_init(t1);
-    mpz_init(t2);
-
     retval = 1; /* Success */
 
 failure:
@@ -444,7 +596,8 @@ failure:
     return NULL;
 }
 
-void pcs_t_compute_polynomial(pcs_t_private_key *vk, pcs_t_polynomial *px, mpz_t rop,
+void pcs_t_compute_polynomial(const pcs_t_private_key *vk,
+        pcs_t_polynomial *px, mpz_t rop,
                               const unsigned long x)
 {
     mpz_t t1, t2;
@@ -459,14 +612,13 @@ void pcs_t_compute_polynomial(pcs_t_private_key *vk, pcs_t_polynomial *px, mpz_t
         mpz_mod(rop, rop, vk->nm);
     }
 
-    mpz_clear(t1);
-    mpz_clear(t2);
+    mpz_clears_secret(t1, t2, NULL);
 }
 
 void pcs_t_free_polynomial(pcs_t_polynomial *px)
 {
     for (unsigned long i = 0; i < px->n; ++i)
-        mpz_clear(px->coeff[i]);
+        mpz_clears_secret(px->coeff[i], NULL);
     free(px->coeff);
     free(px);
 }
@@ -488,7 +640,7 @@ void pcs_t_set_auth_server(pcs_t_auth_server *au, mpz_t si, unsigned long i)
 
 /* Compute a servers share and set rop to the result. rop should usually
  * be part of an array so we can call pcs_t_share_combine with ease. */
-void pcs_t_share_decrypt(pcs_t_public_key *pk, pcs_t_auth_server *au,
+void pcs_t_share_decrypt(const pcs_t_public_key *pk, pcs_t_auth_server *au,
                          mpz_t rop, mpz_t cipher1)
 {
     mpz_t t1;
@@ -498,85 +650,79 @@ void pcs_t_share_decrypt(pcs_t_public_key *pk, pcs_t_auth_server *au,
     mpz_mul_ui(t1, t1, 2);
     mpz_powm(rop, cipher1, t1, pk->n2);
 
-    mpz_clear(t1);
+    mpz_clears_secret(t1, NULL);
 }
 
-/* c is expected to be of length vk->l, the number of servers. If the share
- * is not present, then it is expected to be equal to the value zero. */
-int pcs_t_share_combine(pcs_t_public_key *pk, mpz_t rop, hcs_shares *hs)
+int pcs_t_share_combine(const pcs_t_public_key *pk, mpz_t rop, hcs_shares *hs)
 {
-    mpz_t t1, t2, t3;
-    mpz_init(t1);
-    mpz_init(t2);
-    mpz_init(t3);
-
-    mpz_set_ui(rop, 1);
-    for (unsigned long i = 0; i < pk->l; ++i) {
-
-        /* Skip zero shares */
-        if (hs->flag[i] == 0)
-            continue;
-
-        /* Compute lagrange coefficients */
-        mpz_set(t1, pk->delta);
-        for (unsigned long j = 0; j < pk->l; ++j) {
-            if ((j == i) || hs->flag[i] == 0)
-                continue; /* i' in S\i and non-zero */
+    /* rop = c' */
+    return hcs_combine_shares(rop, pk->n2, pk->delta, pk->l, pk->w, hs) &&
+           combine_finish(pk, rop);
+}
 
-            long v = (long)j - (long)i;
-            mpz_tdiv_q_ui(t1, t1, (v < 0 ? v*-1 : v));
-            if (v < 0) mpz_neg(t1, t1);
-            mpz_mul_ui(t1, t1, j + 1);
-        }
+int pcs_t_share_combine_batch(const pcs_t_public_key *pk, mpz_t *rop,
+        hcs_shares *hs)
+{
+    int valid = 1;
+    if (!hcs_combine_shares_batch(rop, pk->n2, pk->delta, pk->l, pk->w,
+                                  hs))
+        return 0;
 
-        mpz_abs(t2, t1);
-        mpz_mul_ui(t2, t2, 2);
-        mpz_powm(t2, hs->shares[i], t2, pk->n2);
+    #pragma omp parallel for reduction(&&:valid)
+    for (unsigned long r = 0; r < hs->count; ++r)
+        valid = combine_finish(pk, rop[r]) && valid;
 
-        if (mpz_sgn(t1) < 0 && !mpz_invert(t2, t2, pk->n2))
-	        return 0;
+    return valid;
+}
 
-        mpz_mul(rop, rop, t2);
-        mpz_mod(rop, rop, pk->n2);
-    }
+pcs_t_combiner* pcs_t_init_combiner(const pcs_t_public_key *pk,
+        const unsigned long *quorum)
+{
+    return hcs_init_combiner(pk->n2, pk->delta, pk->l, pk->w, quorum);
+}
 
-    /* rop = c' */
-    dlog_s(pk->n, rop, rop);
-    mpz_pow_ui(t1, pk->delta, 2);
-    mpz_mul_ui(t1, t1, 4);
+int pcs_t_combiner_add(pcs_t_combiner *cb, unsigned long i, mpz_t share)
+{
+    return hcs_combiner_add(cb, i, share);
+}
 
-    if (!mpz_invert(t1, t1, pk->n))
-		return 0;
+int pcs_t_combiner_result(const pcs_t_public_key *pk, pcs_t_combiner *cb,
+        mpz_t rop)
+{
+    return hcs_combiner_product(cb, rop) && combine_finish(pk, rop);
+}
 
-    mpz_mul(rop, rop, t1);
-    mpz_mod(rop, rop, pk->n);
+void pcs_t_combiner_reset(pcs_t_combiner *cb)
+{
+    hcs_combiner_reset(cb);
+}
 
-    mpz_clear(t1);
-    mpz_clear(t2);
-    mpz_clear(t3);
-    return 1;
+void pcs_t_free_combiner(pcs_t_combiner *cb)
+{
+    hcs_free_combiner(cb);
 }
 
 void pcs_t_free_auth_server(pcs_t_auth_server *au)
 {
-    mpz_clear(au->si);
+    mpz_clears_secret(au->si, NULL);
     free(au);
 }
 
 void pcs_t_clear_public_key(pcs_t_public_key *pk)
 {
-    mpz_zeros(pk->g, pk->n, pk->n2, pk->delta, NULL);
+    mpz_zeros_public(pk->g, pk->n, pk->n2, pk->delta, NULL);
 }
 
 void pcs_t_clear_private_key(pcs_t_private_key *vk)
 {
-    mpz_zeros(vk->v, vk->nm, vk->n,
-              vk->n2, vk->d, NULL);
+    mpz_zeros_secret(vk->nm, vk->d, NULL);
+    mpz_zeros_public(vk->v, vk->n, vk->n2, NULL);
 
     if (vk->vi) {
         for (unsigned long i = 0; i < vk->l; ++i)
             mpz_clear(vk->vi[i]);
         free (vk->vi);
+        vk->vi = NULL;
     }
 }
 
@@ -588,8 +734,8 @@ void pcs_t_free_public_key(pcs_t_public_key *pk)
 
 void pcs_t_free_private_key(pcs_t_private_key *vk)
 {
-    mpz_clears(vk->v, vk->nm, vk->n,
-               vk->n2, vk->d, NULL);
+    mpz_clears_secret(vk->nm, vk->d, NULL);
+    mpz_clears(vk->v, vk->n, vk->n2, NULL);
 
     if (vk->vi) {
         for (unsigned long i = 0; i < vk->l; ++i)
@@ -600,74 +746,46 @@ void pcs_t_free_private_key(pcs_t_private_key *vk)
     free(vk);
 }
 
-int pcs_t_verify_key_pair(pcs_t_public_key *pk, pcs_t_private_key *vk)
+int pcs_t_verify_key_pair(const pcs_t_public_key *pk,
+        const pcs_t_private_key *vk)
 {
     return mpz_cmp(vk->n, pk->n) == 0;
 }
 
-char *pcs_t_export_public_key(pcs_t_public_key *pk)
+char *pcs_t_export_public_key(const pcs_t_public_key *pk)
 {
-    char *buffer;
-    char *retstr;
-
-    JSON_Value *root = json_value_init_object();
-    JSON_Object *obj  = json_value_get_object(root);
-    buffer = mpz_get_str(NULL, HCS_INTERNAL_BASE, pk->n);
-    json_object_set_string(obj, "n", buffer);
-    json_object_set_number(obj, "w", pk->w);
-    json_object_set_number(obj, "l", pk->l);
-    retstr = json_serialize_to_string(root);
+    JSON_Value *root = hcs_json_init_object();
+    if (root == NULL)
+        return NULL;
 
-    json_value_free(root);
-    free(buffer);
-    return retstr;
+    JSON_Object *obj = json_value_get_object(root);
+    int ok = hcs_json_set_mpz(obj, "n", pk->n) &&
+             json_object_set_number(obj, "w", pk->w) == JSONSuccess &&
+             json_object_set_number(obj, "l", pk->l) == JSONSuccess;
+    return hcs_json_finish(root, ok);
 }
 
 char *pcs_t_export_proof(pcs_t_proof *pf)
 {
-    // Export all proof values
-    char *buffer;
-    char *retstr;
+    JSON_Value *root = hcs_json_init_object();
+    if (root == NULL)
+        return NULL;
 
-    JSON_Value *root = json_value_init_object();
     JSON_Object *obj = json_value_get_object(root);
-
-#define sz__(x)  mpz_sizeinbase(pf->x, HCS_INTERNAL_BASE)
-
-    const size_t buffer_len =
-        HCS_MAX2(HCS_MAX3(sz__(e[0]), sz__(e[1]), sz__(a[0])),
-            HCS_MAX3(sz__(a[1]), sz__(z[0]), sz__(z[1])));
-
-#undef sz__
-
-    buffer = malloc(buffer_len + 2);
-
-    mpz_get_str(buffer, HCS_INTERNAL_BASE, pf->e[0]);
-    json_object_set_string(obj, "e1", buffer);
-    mpz_get_str(buffer, HCS_INTERNAL_BASE, pf->e[1]);
-    json_object_set_string(obj, "e2", buffer);
-    mpz_get_str(buffer, HCS_INTERNAL_BASE, pf->a[0]);
-    json_object_set_string(obj, "a1", buffer);
-    mpz_get_str(buffer, HCS_INTERNAL_BASE, pf->a[1]);
-    json_object_set_string(obj, "a2", buffer);
-    mpz_get_str(buffer, HCS_INTERNAL_BASE, pf->z[0]);
-    json_object_set_string(obj, "z1", buffer);
-    mpz_get_str(buffer, HCS_INTERNAL_BASE, pf->z[1]);
-    json_object_set_string(obj, "z2", buffer);
-    mpz_get_str(buffer, HCS_INTERNAL_BASE, pf->generator);
-    json_object_set_string(obj, "generator", buffer);
-
-    json_object_set_number(obj, "m1", pf->m1);
-    json_object_set_number(obj, "m2", pf->m2);
-    retstr = json_serialize_to_string(root);
-
-    json_value_free(root);
-    free(buffer);
-    return retstr;
+    int ok = hcs_json_set_mpz(obj, "e1", pf->e[0]) &&
+             hcs_json_set_mpz(obj, "e2", pf->e[1]) &&
+             hcs_json_set_mpz(obj, "a1", pf->a[0]) &&
+             hcs_json_set_mpz(obj, "a2", pf->a[1]) &&
+             hcs_json_set_mpz(obj, "z1", pf->z[0]) &&
+             hcs_json_set_mpz(obj, "z2", pf->z[1]) &&
+             hcs_json_set_mpz(obj, "generator", pf->generator) &&
+             json_object_set_number(obj, "m1", pf->m1) == JSONSuccess &&
+             json_object_set_number(obj, "m2", pf->m2) == JSONSuccess;
+    return hcs_json_finish(root, ok);
 }
 
 // TODO: IMPLEMENT
-char *pcs_t_export_verify_values(pcs_t_private_key *vk)
+char *pcs_t_export_verify_values(const pcs_t_private_key *vk)
 {
     (void) vk;
     return "";
@@ -675,31 +793,32 @@ char *pcs_t_export_verify_values(pcs_t_private_key *vk)
 
 char *pcs_t_export_auth_server(pcs_t_auth_server *au)
 {
-    char *buffer;
-    char *retstr;
+    JSON_Value *root = hcs_json_init_object();
+    if (root == NULL)
+        return NULL;
 
-    JSON_Value *root = json_value_init_object();
-    JSON_Object *obj  = json_value_get_object(root);
-    buffer = mpz_get_str(NULL, HCS_INTERNAL_BASE, au->si);
-    json_object_set_string(obj, "si", buffer);
-    json_object_set_number(obj, "i", au->i);
-    retstr = json_serialize_to_string(root);
-
-    json_value_free(root);
-    free(buffer);
-    return retstr;
+    JSON_Object *obj = json_value_get_object(root);
+    int ok = hcs_json_set_mpz(obj, "si", au->si) &&
+             json_object_set_number(obj, "i", au->i) == JSONSuccess;
+    return hcs_json_finish(root, ok);
 }
 
 int pcs_t_import_public_key(pcs_t_public_key *pk, const char *json)
 {
+    unsigned long w, l;
     JSON_Value *root = json_parse_string(json);
     JSON_Object *obj = json_value_get_object(root);
-    mpz_set_str(pk->n, json_object_get_string(obj, "n"), HCS_INTERNAL_BASE);
-    pk->l = json_object_get_number(obj, "l");
-    pk->w = json_object_get_number(obj, "w");
+    int ok = hcs_json_get_mpz(obj, "n", pk->n) &&
+             hcs_json_get_ulong(obj, "w", &w) &&
+             hcs_json_get_ulong(obj, "l", &l) &&
+             w >= 1 && w <= l;
     json_value_free(root);
+    if (!ok)
+        return 1;
 
     /* Calculate remaining values */
+    pk->w = w;
+    pk->l = l;
     mpz_add_ui(pk->g, pk->n, 1);
     mpz_pow_ui(pk->n2, pk->n, 2);
     mpz_fac_ui(pk->delta, pk->l);
@@ -708,18 +827,24 @@ int pcs_t_import_public_key(pcs_t_public_key *pk, const char *json)
 
 int pcs_t_import_proof(pcs_t_proof *pf, const char *json)
 {
+    unsigned long m1, m2;
     JSON_Value *root = json_parse_string(json);
     JSON_Object *obj = json_value_get_object(root);
-    mpz_set_str(pf->e[0], json_object_get_string(obj, "e1"), HCS_INTERNAL_BASE);
-    mpz_set_str(pf->e[1], json_object_get_string(obj, "e1"), HCS_INTERNAL_BASE);
-    mpz_set_str(pf->a[0], json_object_get_string(obj, "a1"), HCS_INTERNAL_BASE);
-    mpz_set_str(pf->a[1], json_object_get_string(obj, "a2"), HCS_INTERNAL_BASE);
-    mpz_set_str(pf->z[0], json_object_get_string(obj, "z1"), HCS_INTERNAL_BASE);
-    mpz_set_str(pf->z[1], json_object_get_string(obj, "z2"), HCS_INTERNAL_BASE);
-    mpz_set_str(pf->generator, json_object_get_string(obj, "generator"), HCS_INTERNAL_BASE);
-    pf->m1 = json_object_get_number(obj, "m1");
-    pf->m2 = json_object_get_number(obj, "m2");
+    int ok = hcs_json_get_mpz(obj, "e1", pf->e[0]) &&
+             hcs_json_get_mpz(obj, "e2", pf->e[1]) &&
+             hcs_json_get_mpz(obj, "a1", pf->a[0]) &&
+             hcs_json_get_mpz(obj, "a2", pf->a[1]) &&
+             hcs_json_get_mpz(obj, "z1", pf->z[0]) &&
+             hcs_json_get_mpz(obj, "z2", pf->z[1]) &&
+             hcs_json_get_mpz(obj, "generator", pf->generator) &&
+             hcs_json_get_ulong(obj, "m1", &m1) &&
+             hcs_json_get_ulong(obj, "m2", &m2);
+    json_value_free(root);
+    if (!ok)
+        return 1;
 
+    pf->m1 = m1;
+    pf->m2 = m2;
     return 0;
 }
 
@@ -733,13 +858,16 @@ int pcs_t_import_verify_values(pcs_t_private_key *vk, const char *json)
 
 int pcs_t_import_auth_server(pcs_t_auth_server *au, const char *json)
 {
+    unsigned long i;
     JSON_Value *root = json_parse_string(json);
     JSON_Object *obj = json_value_get_object(root);
-    mpz_set_str(au->si, json_object_get_string(obj, "si"), HCS_INTERNAL_BASE);
-    au->i = json_object_get_number(obj, "i");
+    int ok = hcs_json_get_mpz(obj, "si", au->si) &&
+             hcs_json_get_ulong(obj, "i", &i);
     json_value_free(root);
+    if (!ok)
+        return 1;
 
-    /* Calculate remaining values */
+    au->i = i;
     return 0;
 }
 
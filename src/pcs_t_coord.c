@@ -0,0 +1,552 @@
+/**
+ * @file pcs_t_coord.c
+ *
+ * Batched threshold decryption over byte streams.
+ *
+ * The coordinator keeps a ring of window batch slots. The calling thread
+ * fills the next slot, sends it to every server and moves on, waiting only
+ * when that slot is still in use. A receiver thread per server adds the
+ * shares of each response to the combiners of its slot, then counts the
+ * response. Once w responses are counted and no receiver is still adding
+ * shares to the slot, every combiner holds w shares and is complete, and
+ * the receiver which observes this computes the results.
+ *
+ * A slot is only reused once every live server has answered it, so a late
+ * response can never be mistaken for one to a later batch. Servers answer
+ * in order, so this costs nothing unless one falls behind by a full window.
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <gmp.h>
+
+#include "../include/libhcs/hcs_transport.h"
+#include "../include/libhcs/pcs_t.h"
+#include "../include/libhcs/pcs_t_coord.h"
+#include "com/wire.h"
+
+/* Sent by a server when it connects */
+#define HCS_COORD_MAGIC 0x48435431
+
+/* Largest batch a server accepts */
+#define HCS_COORD_MAX_BATCH 65536
+
+#define HCS_COORD_DEFAULT_BATCH 256
+#define HCS_COORD_DEFAULT_WINDOW 4
+
+typedef struct {
+    unsigned long id;           /* Sequence number of the batch */
+    int active;                 /* Non-zero until every live server answers */
+    int claimed;                /* Non-zero once a receiver stores results */
+    int done;                   /* Non-zero once the results are stored */
+    unsigned long count;        /* Number of ciphertexts in the batch */
+    mpz_t *rop;                 /* Where the results are stored */
+    pcs_t_combiner **cb;        /* Combiner of each ciphertext */
+    unsigned long responses;    /* Responses received so far */
+    int *answered;              /* Response state of each connection */
+} coord_slot;
+
+/* Response states of a connection for a slot */
+enum {
+    SLOT_WAITING,
+    SLOT_ADDING,                /* Shares are being added to the combiners */
+    SLOT_ANSWERED
+};
+
+typedef struct {
+    struct pcs_t_coordinator *co;
+    hcs_transport *t;
+    unsigned long index;        /* Index the server announced */
+    int dead;                   /* Non-zero once the stream has failed */
+    int started;                /* Non-zero if the thread is running */
+    pthread_t thread;
+    mpz_t *share;               /* Shares of the response being read */
+    unsigned char *scratch;
+} coord_server;
+
+struct pcs_t_coordinator {
+    const pcs_t_public_key *pk;
+    unsigned long count;        /* Number of connections */
+    coord_server *server;
+    unsigned long live;         /* Connections which have not failed */
+    unsigned long batch;
+    unsigned long window;
+    coord_slot *slot;
+    unsigned long next;         /* Sequence number of the next batch */
+    unsigned long pending;      /* Batches of this call without results */
+    unsigned long finishing;    /* Slots whose results are being stored */
+    int failed;                 /* Non-zero once decryption has failed */
+    size_t max;                 /* Byte length of n^2 */
+    unsigned char *frame;       /* Request being sent */
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+};
+
+static size_t frame_size(mpz_t *op, unsigned long count)
+{
+    size_t size = 8;
+    for (unsigned long j = 0; j < count; ++j)
+        size += hcs_wire_mpz_size(op[j]);
+    return size;
+}
+
+static unsigned char* put_frame(unsigned char *buf, unsigned long id,
+        mpz_t *op, unsigned long count)
+{
+    buf = hcs_wire_put_u32(buf, id);
+    buf = hcs_wire_put_u32(buf, count);
+    for (unsigned long j = 0; j < count; ++j)
+        buf = hcs_wire_put_mpz(buf, op[j]);
+    return buf;
+}
+
+/* Grow an array of mpz_t from @p size to @p want entries */
+static mpz_t* grow(mpz_t *op, unsigned long *size, unsigned long want)
+{
+    if (want <= *size)
+        return op;
+
+    mpz_t *t = realloc(op, sizeof(mpz_t) * want);
+    if (t == NULL)
+        return NULL;
+
+    for (unsigned long j = *size; j < want; ++j)
+        mpz_init(t[j]);
+    *size = want;
+    return t;
+}
+
+int pcs_t_serve(const pcs_t_public_key *pk, pcs_t_auth_server *au,
+        hcs_transport *t)
+{
+    int retval = 0;
+    unsigned long size = 0;
+    size_t frame_capacity = 0;
+    mpz_t *cipher = NULL;
+    unsigned char *frame = NULL, hello[8];
+
+    const size_t max = (mpz_sizeinbase(pk->n2, 2) + 7) / 8;
+    unsigned char *scratch = malloc(max);
+    if (scratch == NULL)
+        return 0;
+
+    hcs_wire_put_u32(hcs_wire_put_u32(hello, HCS_COORD_MAGIC), au->i - 1);
+    if (!hcs_transport_write(t, hello, sizeof(hello)))
+        goto end;
+
+    for (;;) {
+        uint32_t id, count;
+
+        if (!hcs_wire_read_u32(t, &id)) {
+            retval = 1;
+            break;
+        }
+        if (!hcs_wire_read_u32(t, &count) || count > HCS_COORD_MAX_BATCH)
+            break;
+
+        mpz_t *grown = grow(cipher, &size, count);
+        if (grown == NULL)
+            break;
+        cipher = grown;
+
+        uint32_t read = 0;
+        while (read < count &&
+                hcs_wire_read_mpz(t, cipher[read], max, scratch))
+            read++;
+        if (read != count)
+            break;
+
+        #pragma omp parallel for
+        for (unsigned long j = 0; j < count; ++j)
+            pcs_t_share_decrypt(pk, au, cipher[j], cipher[j]);
+
+        size_t need = frame_size(cipher, count);
+        if (need > frame_capacity) {
+            unsigned char *f = realloc(frame, need);
+            if (f == NULL)
+                break;
+            frame = f;
+            frame_capacity = need;
+        }
+
+        put_frame(frame, id, cipher, count);
+        if (!hcs_transport_write(t, frame, need))
+            break;
+    }
+
+end:
+    for (unsigned long j = 0; j < size; ++j)
+        mpz_clear(cipher[j]);
+    free(cipher);
+    free(frame);
+    free(scratch);
+    return retval;
+}
+
+/* Release @p slot if its results are stored, no live server still owes it
+ * a response and no receiver is adding to its combiners. Must be called
+ * with the lock held. */
+static void try_release(pcs_t_coordinator *co, coord_slot *slot)
+{
+    if (!slot->active || !slot->done)
+        return;
+
+    for (unsigned long s = 0; s < co->count; ++s) {
+        if (slot->answered[s] == SLOT_ADDING)
+            return;
+        if (slot->answered[s] == SLOT_WAITING && !co->server[s].dead)
+            return;
+    }
+
+    slot->active = 0;
+    pthread_cond_broadcast(&co->changed);
+}
+
+/* Must be called with the lock held */
+static void mark_dead(pcs_t_coordinator *co, coord_server *sv)
+{
+    if (sv->dead)
+        return;
+
+    sv->dead = 1;
+    co->live--;
+    for (unsigned long k = 0; k < co->window; ++k)
+        try_release(co, &co->slot[k]);
+    pthread_cond_broadcast(&co->changed);
+}
+
+static void finish(pcs_t_coordinator *co, coord_slot *slot)
+{
+    int valid = 1;
+
+    #pragma omp parallel for reduction(&&:valid)
+    for (unsigned long j = 0; j < slot->count; ++j)
+        valid = pcs_t_combiner_result(co->pk, slot->cb[j], slot->rop[j]) &&
+                valid;
+
+    pthread_mutex_lock(&co->lock);
+    if (!valid)
+        co->failed = 1;
+    slot->done = 1;
+    co->pending--;
+    co->finishing--;
+    try_release(co, slot);
+    pthread_cond_broadcast(&co->changed);
+    pthread_mutex_unlock(&co->lock);
+}
+
+static void* receive_thread(void *arg)
+{
+    coord_server *sv = arg;
+    pcs_t_coordinator *co = sv->co;
+    const unsigned long s = sv - co->server;
+
+    for (;;) {
+        uint32_t id, count;
+        if (!hcs_wire_read_u32(sv->t, &id) ||
+                !hcs_wire_read_u32(sv->t, &count) || count > co->batch)
+            break;
+
+        unsigned long j;
+        for (j = 0; j < count; ++j) {
+            if (!hcs_wire_read_mpz(sv->t, sv->share[j], co->max, sv->scratch))
+                break;
+        }
+        if (j != count)
+            break;
+
+        /* A response must match a batch this server has yet to answer */
+        pthread_mutex_lock(&co->lock);
+        coord_slot *slot = &co->slot[id % co->window];
+        const int expected = !sv->dead && slot->active &&
+                (uint32_t)slot->id == id && slot->count == count &&
+                slot->answered[s] == SLOT_WAITING;
+        if (expected)
+            slot->answered[s] = SLOT_ADDING;
+        pthread_mutex_unlock(&co->lock);
+
+        if (!expected)
+            break;
+
+        for (j = 0; j < count; ++j)
+            pcs_t_combiner_add(slot->cb[j], sv->index, sv->share[j]);
+
+        /* A combiner may still be folding the share of a concurrent
+         * receiver, so the results wait until no receiver is adding. They
+         * are not stored once the caller has given up on them. */
+        pthread_mutex_lock(&co->lock);
+        slot->answered[s] = SLOT_ANSWERED;
+        slot->responses++;
+
+        int last = !slot->claimed && slot->responses >= co->pk->w &&
+                   !co->failed;
+        for (unsigned long k = 0; last && k < co->count; ++k)
+            last = slot->answered[k] != SLOT_ADDING;
+        if (last) {
+            slot->claimed = 1;
+            co->finishing++;
+        }
+        try_release(co, slot);
+        pthread_mutex_unlock(&co->lock);
+
+        if (last)
+            finish(co, slot);
+    }
+
+    pthread_mutex_lock(&co->lock);
+    mark_dead(co, sv);
+    pthread_mutex_unlock(&co->lock);
+    return NULL;
+}
+
+/* Read the greeting of @p sv. Returns non-zero if it is well formed. */
+static int greet(pcs_t_coordinator *co, coord_server *sv)
+{
+    uint32_t magic, index;
+    if (!hcs_wire_read_u32(sv->t, &magic) || magic != HCS_COORD_MAGIC ||
+            !hcs_wire_read_u32(sv->t, &index) || index >= co->pk->l)
+        return 0;
+
+    for (coord_server *p = co->server; p != sv; ++p) {
+        if (p->index == index)
+            return 0;
+    }
+
+    sv->index = index;
+    return 1;
+}
+
+pcs_t_coordinator* pcs_t_init_coordinator(const pcs_t_public_key *pk,
+        hcs_transport **servers, unsigned long count, unsigned long batch,
+        unsigned long window)
+{
+    unsigned long s = 0, k = 0, j = 0;
+
+    if (count < pk->w || batch > HCS_COORD_MAX_BATCH)
+        return NULL;
+
+    pcs_t_coordinator *co = malloc(sizeof(pcs_t_coordinator));
+    if (co == NULL)
+        return NULL;
+
+    co->pk = pk;
+    co->count = count;
+    co->live = count;
+    co->batch = batch ? batch : HCS_COORD_DEFAULT_BATCH;
+    co->window = window ? window : HCS_COORD_DEFAULT_WINDOW;
+    co->next = 0;
+    co->pending = 0;
+    co->finishing = 0;
+    co->failed = 0;
+    co->max = (mpz_sizeinbase(pk->n2, 2) + 7) / 8;
+    co->frame = NULL;
+
+    co->server = calloc(count, sizeof(coord_server));
+    co->slot = calloc(co->window, sizeof(coord_slot));
+    if (!co->server || !co->slot)
+        goto failure;
+
+    if (pthread_mutex_init(&co->lock, NULL))
+        goto failure;
+    if (pthread_cond_init(&co->changed, NULL)) {
+        pthread_mutex_destroy(&co->lock);
+        goto failure;
+    }
+
+    for (; s < count; ++s) {
+        coord_server *sv = &co->server[s];
+        sv->co = co;
+        sv->t = servers[s];
+        sv->share = malloc(sizeof(mpz_t) * co->batch);
+        sv->scratch = malloc(co->max);
+        if (!sv->share || !sv->scratch || !greet(co, sv)) {
+            free(sv->share);
+            free(sv->scratch);
+            goto destroy;
+        }
+
+        for (j = 0; j < co->batch; ++j)
+            mpz_init(sv->share[j]);
+    }
+
+    for (; k < co->window; ++k) {
+        coord_slot *slot = &co->slot[k];
+        slot->answered = malloc(sizeof(int) * count);
+        slot->cb = malloc(sizeof(pcs_t_combiner*) * co->batch);
+        if (!slot->answered || !slot->cb) {
+            free(slot->answered);
+            free(slot->cb);
+            goto destroy;
+        }
+
+        for (j = 0; j < co->batch; ++j) {
+            slot->cb[j] = pcs_t_init_combiner(pk, NULL);
+            if (slot->cb[j] == NULL)
+                break;
+        }
+        if (j != co->batch) {
+            while (j--)
+                pcs_t_free_combiner(slot->cb[j]);
+            free(slot->answered);
+            free(slot->cb);
+            goto destroy;
+        }
+    }
+
+    /* Servers without a receiver count as failed from the start */
+    for (unsigned long i = 0; i < count; ++i) {
+        coord_server *sv = &co->server[i];
+        sv->started = !pthread_create(&sv->thread, NULL, receive_thread, sv);
+        if (!sv->started) {
+            pthread_mutex_lock(&co->lock);
+            mark_dead(co, sv);
+            pthread_mutex_unlock(&co->lock);
+        }
+    }
+
+    return co;
+
+destroy:
+    while (k--) {
+        for (j = 0; j < co->batch; ++j)
+            pcs_t_free_combiner(co->slot[k].cb[j]);
+        free(co->slot[k].answered);
+        free(co->slot[k].cb);
+    }
+    while (s--) {
+        for (j = 0; j < co->batch; ++j)
+            mpz_clear(co->server[s].share[j]);
+        free(co->server[s].share);
+        free(co->server[s].scratch);
+    }
+    pthread_cond_destroy(&co->changed);
+    pthread_mutex_destroy(&co->lock);
+failure:
+    free(co->slot);
+    free(co->server);
+    free(co);
+    return NULL;
+}
+
+int pcs_t_coordinator_decrypt(pcs_t_coordinator *co, mpz_t *rop,
+        mpz_t *cipher, unsigned long count)
+{
+    int retval = 0;
+    size_t capacity = 0;
+
+    pthread_mutex_lock(&co->lock);
+    co->pending = 0;
+    pthread_mutex_unlock(&co->lock);
+
+    for (unsigned long offset = 0; offset < count; offset += co->batch) {
+        const unsigned long size = count - offset < co->batch ?
+                                   count - offset : co->batch;
+
+        pthread_mutex_lock(&co->lock);
+        coord_slot *slot = &co->slot[co->next % co->window];
+        while (slot->active && co->live >= co->pk->w && !co->failed)
+            pthread_cond_wait(&co->changed, &co->lock);
+
+        if (co->live < co->pk->w || co->failed) {
+            pthread_mutex_unlock(&co->lock);
+            goto failure;
+        }
+
+        /* No receiver touches an inactive slot */
+        for (unsigned long j = 0; j < size; ++j)
+            pcs_t_combiner_reset(slot->cb[j]);
+        for (unsigned long s = 0; s < co->count; ++s)
+            slot->answered[s] = SLOT_WAITING;
+
+        slot->id = co->next++;
+        slot->active = 1;
+        slot->claimed = 0;
+        slot->done = 0;
+        slot->count = size;
+        slot->rop = rop + offset;
+        slot->responses = 0;
+        co->pending++;
+        const unsigned long id = slot->id;
+        pthread_mutex_unlock(&co->lock);
+
+        size_t need = frame_size(cipher + offset, size);
+        if (need > capacity) {
+            unsigned char *f = realloc(co->frame, need);
+            if (f == NULL)
+                goto failure;
+            co->frame = f;
+            capacity = need;
+        }
+        put_frame(co->frame, id, cipher + offset, size);
+
+        for (unsigned long s = 0; s < co->count; ++s) {
+            coord_server *sv = &co->server[s];
+            if (!hcs_transport_write(sv->t, co->frame, need)) {
+                pthread_mutex_lock(&co->lock);
+                mark_dead(co, sv);
+                pthread_mutex_unlock(&co->lock);
+            }
+        }
+    }
+
+    pthread_mutex_lock(&co->lock);
+    while (co->pending && co->live >= co->pk->w && !co->failed)
+        pthread_cond_wait(&co->changed, &co->lock);
+    retval = !co->pending && !co->failed;
+    pthread_mutex_unlock(&co->lock);
+
+    if (retval)
+        goto end;
+
+failure:
+    /* Batches still in flight must not write to @p rop after returning */
+    pthread_mutex_lock(&co->lock);
+    co->failed = 1;
+    while (co->finishing)
+        pthread_cond_wait(&co->changed, &co->lock);
+    pthread_mutex_unlock(&co->lock);
+
+end:
+    free(co->frame);
+    co->frame = NULL;
+    return retval;
+}
+
+unsigned long pcs_t_coordinator_live(pcs_t_coordinator *co)
+{
+    pthread_mutex_lock(&co->lock);
+    const unsigned long live = co->live;
+    pthread_mutex_unlock(&co->lock);
+    return live;
+}
+
+void pcs_t_free_coordinator(pcs_t_coordinator *co)
+{
+    for (unsigned long s = 0; s < co->count; ++s)
+        hcs_transport_shutdown(co->server[s].t);
+
+    for (unsigned long s = 0; s < co->count; ++s) {
+        coord_server *sv = &co->server[s];
+        if (sv->started)
+            pthread_join(sv->thread, NULL);
+
+        for (unsigned long j = 0; j < co->batch; ++j)
+            mpz_clear(sv->share[j]);
+        free(sv->share);
+        free(sv->scratch);
+    }
+
+    for (unsigned long k = 0; k < co->window; ++k) {
+        for (unsigned long j = 0; j < co->batch; ++j)
+            pcs_t_free_combiner(co->slot[k].cb[j]);
+        free(co->slot[k].answered);
+        free(co->slot[k].cb);
+    }
+
+    pthread_cond_destroy(&co->changed);
+    pthread_mutex_destroy(&co->lock);
+    free(co->slot);
+    free(co->server);
+    free(co);
+}
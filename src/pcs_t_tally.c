@@ -0,0 +1,389 @@
+/**
+ * @file pcs_t_tally.c
+ *
+ * Pipelined tally of pcs_t ballots.
+ *
+ * A fixed number of ballot slots circulate between three queues. The reader
+ * takes a free slot, parses a ballot into it and queues it for
+ * verification. A worker verifies it and either queues it for accumulation
+ * or returns it as free. The accumulator adds it to its race and returns it
+ * as free. Since every queue can hold every slot, pushes never block, and a
+ * slow stage stalls the reader only through the lack of free slots.
+ *
+ * The accumulator also records each (race, id) pair it counts, so a replayed
+ * ballot is rejected. Only verified ballots are recorded, so a forged ballot
+ * cannot claim a voter id ahead of its owner.
+ */
+
+#define _POSIX_C_SOURCE 200112L /* For sysconf */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <gmp.h>
+
+#include "../include/libhcs/pcs_t.h"
+#include "../include/libhcs/pcs_t_tally.h"
+#include "com/queue.h"
+#include "com/util.h"
+
+typedef struct {
+    unsigned long race;
+    unsigned long id;
+    mpz_t cipher;
+    pcs_t_proof *pf;
+} tally_ballot;
+
+typedef struct {
+    unsigned long race;
+    unsigned long id;
+    int used;
+} tally_voter;
+
+struct pcs_t_tally {
+    const pcs_t_public_key *pk;
+    unsigned long races;
+    unsigned long workers;
+    unsigned long depth;
+    mpz_t *total;               /* Encrypted total of each race */
+    unsigned long *accepted;    /* Valid ballots in each race */
+    unsigned long rejected;     /* Updated atomically by the workers */
+    tally_ballot *slots;
+    hcs_queue free;             /* Slots ready to be read into */
+    hcs_queue verify;           /* Slots awaiting verification */
+    hcs_queue accumulate;       /* Verified slots awaiting accumulation */
+    tally_voter *voters;        /* Open addressing set of counted voters */
+    unsigned long voters_alloc; /* Zero or a power of two */
+    unsigned long voters_count;
+    int failed;                 /* Set by the accumulator on allocation failure */
+};
+
+pcs_t_tally* pcs_t_init_tally(const pcs_t_public_key *pk, mpz_t generator,
+        unsigned long races, unsigned long workers, unsigned long depth)
+{
+    unsigned long ready = 0;
+    pcs_t_tally *tally = malloc(sizeof(pcs_t_tally));
+    if (tally == NULL)
+        return NULL;
+
+    if (workers == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = cpus > 0 ? cpus : 1;
+    }
+    if (depth == 0)
+        depth = 4 * workers;
+
+    tally->pk = pk;
+    tally->races = races;
+    tally->workers = workers;
+    tally->depth = depth;
+    tally->rejected = 0;
+    tally->voters = NULL;
+    tally->voters_alloc = 0;
+    tally->voters_count = 0;
+    tally->failed = 0;
+    tally->total = malloc(sizeof(mpz_t) * (races ? races : 1));
+    tally->accepted = calloc(races ? races : 1, sizeof(unsigned long));
+    tally->slots = malloc(sizeof(tally_ballot) * depth);
+    if (!tally->total || !tally->accepted || !tally->slots)
+        goto failure;
+
+    for (; ready < depth; ++ready) {
+        tally->slots[ready].pf = pcs_t_init_proof();
+        if (tally->slots[ready].pf == NULL)
+            goto failure;
+
+        mpz_set(tally->slots[ready].pf->generator, generator);
+        mpz_init(tally->slots[ready].cipher);
+    }
+
+    if (!hcs_queue_init(&tally->free, depth))
+        goto failure;
+    if (!hcs_queue_init(&tally->verify, depth)) {
+        hcs_queue_destroy(&tally->free);
+        goto failure;
+    }
+    if (!hcs_queue_init(&tally->accumulate, depth)) {
+        hcs_queue_destroy(&tally->verify);
+        hcs_queue_destroy(&tally->free);
+        goto failure;
+    }
+
+    for (unsigned long r = 0; r < races; ++r)
+        mpz_init(tally->total[r]);
+
+    return tally;
+
+failure:
+    for (unsigned long i = 0; i < ready; ++i) {
+        pcs_t_free_proof(tally->slots[i].pf);
+        mpz_clear(tally->slots[i].cipher);
+    }
+    free(tally->slots);
+    free(tally->accepted);
+    free(tally->total);
+    free(tally);
+    return NULL;
+}
+
+static void* verify_thread(void *arg)
+{
+    pcs_t_tally *tally = arg;
+    tally_ballot *b;
+
+    while ((b = hcs_queue_pop(&tally->verify)) != NULL) {
+        if (pcs_t_verify_1of2_ns_protocol(tally->pk, b->pf, b->cipher,
+                    b->id)) {
+            hcs_queue_push(&tally->accumulate, b);
+        }
+        else {
+            __atomic_add_fetch(&tally->rejected, 1, __ATOMIC_RELAXED);
+            hcs_queue_push(&tally->free, b);
+        }
+    }
+
+    return NULL;
+}
+
+static unsigned long voter_slot(unsigned long race, unsigned long id,
+        unsigned long alloc)
+{
+    unsigned long h = id * 2654435761UL ^ race * 40503UL;
+    return (h ^ h >> 15) & (alloc - 1);
+}
+
+/* Doubles the voter set, keeping the load factor at most one half */
+static int grow_voters(pcs_t_tally *tally)
+{
+    unsigned long alloc = tally->voters_alloc ? 2 * tally->voters_alloc : 64;
+    tally_voter *voters = calloc(alloc, sizeof(tally_voter));
+    if (voters == NULL)
+        return 0;
+
+    for (unsigned long i = 0; i < tally->voters_alloc; ++i) {
+        tally_voter *v = &tally->voters[i];
+        if (!v->used)
+            continue;
+
+        unsigned long j = voter_slot(v->race, v->id, alloc);
+        while (voters[j].used)
+            j = (j + 1) & (alloc - 1);
+        voters[j] = *v;
+    }
+
+    free(tally->voters);
+    tally->voters = voters;
+    tally->voters_alloc = alloc;
+    return 1;
+}
+
+/* Returns 1 if the voter was recorded, 0 if it already was and -1 on
+ * allocation failure */
+static int record_voter(pcs_t_tally *tally, unsigned long race,
+        unsigned long id)
+{
+    if (2 * (tally->voters_count + 1) > tally->voters_alloc &&
+            !grow_voters(tally))
+        return -1;
+
+    unsigned long j = voter_slot(race, id, tally->voters_alloc);
+    for (; tally->voters[j].used; j = (j + 1) & (tally->voters_alloc - 1)) {
+        if (tally->voters[j].race == race && tally->voters[j].id == id)
+            return 0;
+    }
+
+    tally->voters[j].race = race;
+    tally->voters[j].id = id;
+    tally->voters[j].used = 1;
+    tally->voters_count++;
+    return 1;
+}
+
+static void* accumulate_thread(void *arg)
+{
+    pcs_t_tally *tally = arg;
+    tally_ballot *b;
+
+    while ((b = hcs_queue_pop(&tally->accumulate)) != NULL) {
+        int r = record_voter(tally, b->race, b->id);
+        if (r <= 0) {
+            if (r < 0)
+                tally->failed = 1;
+            else
+                __atomic_add_fetch(&tally->rejected, 1, __ATOMIC_RELAXED);
+            hcs_queue_push(&tally->free, b);
+            continue;
+        }
+
+        pcs_t_ee_add(tally->pk, tally->total[b->race], tally->total[b->race],
+                     b->cipher);
+        tally->accepted[b->race]++;
+        hcs_queue_push(&tally->free, b);
+    }
+
+    return NULL;
+}
+
+/* Returns 1 if a ballot was read, 0 at the end of the stream and -1 if the
+ * stream is malformed */
+static int read_ballot(FILE *in, tally_ballot *b)
+{
+    int r = fscanf(in, "%lu %lu", &b->race, &b->id);
+    if (r == EOF)
+        return ferror(in) ? -1 : 0;
+    if (r != 2)
+        return -1;
+
+    mpz_ptr fields[] = {
+        b->cipher, b->pf->e[0], b->pf->e[1], b->pf->a[0], b->pf->a[1],
+        b->pf->z[0], b->pf->z[1]
+    };
+
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); ++i) {
+        if (mpz_inp_str(fields[i], in, HCS_INTERNAL_BASE) == 0)
+            return -1;
+    }
+
+    return 1;
+}
+
+int pcs_t_tally_run(pcs_t_tally *tally, FILE *in, pcs_t_tally_request request,
+        void *arg)
+{
+    int retval = 1;
+    unsigned long started = 0;
+    pthread_t accumulator, *workers;
+
+    workers = malloc(sizeof(pthread_t) * tally->workers);
+    if (workers == NULL)
+        return 0;
+
+    for (unsigned long r = 0; r < tally->races; ++r) {
+        mpz_set_ui(tally->total[r], 1);
+        tally->accepted[r] = 0;
+    }
+    tally->rejected = 0;
+    tally->failed = 0;
+
+    for (unsigned long i = 0; i < tally->voters_alloc; ++i)
+        tally->voters[i].used = 0;
+    tally->voters_count = 0;
+
+    hcs_queue_reopen(&tally->verify);
+    hcs_queue_reopen(&tally->accumulate);
+    for (unsigned long i = 0; i < tally->depth; ++i)
+        hcs_queue_push(&tally->free, &tally->slots[i]);
+
+    if (pthread_create(&accumulator, NULL, accumulate_thread, tally)) {
+        retval = 0;
+        goto drain;
+    }
+
+    for (; started < tally->workers; ++started) {
+        if (pthread_create(&workers[started], NULL, verify_thread, tally))
+            break;
+    }
+
+    /* The pipeline still makes progress with fewer workers than asked for,
+     * but never with none */
+    if (started == 0) {
+        retval = 0;
+        hcs_queue_close(&tally->accumulate);
+        pthread_join(accumulator, NULL);
+        goto drain;
+    }
+
+    for (;;) {
+        tally_ballot *b = hcs_queue_pop(&tally->free);
+        int r = read_ballot(in, b);
+
+        if (r <= 0) {
+            hcs_queue_push(&tally->free, b);
+            if (r < 0)
+                retval = 0;
+            break;
+        }
+
+        if (b->race >= tally->races) {
+            __atomic_add_fetch(&tally->rejected, 1, __ATOMIC_RELAXED);
+            hcs_queue_push(&tally->free, b);
+            continue;
+        }
+
+        hcs_queue_push(&tally->verify, b);
+    }
+
+    hcs_queue_close(&tally->verify);
+    for (unsigned long i = 0; i < started; ++i)
+        pthread_join(workers[i], NULL);
+
+    hcs_queue_close(&tally->accumulate);
+    pthread_join(accumulator, NULL);
+
+    if (tally->failed)
+        retval = 0;
+
+    if (retval && request) {
+        for (unsigned long r = 0; r < tally->races; ++r)
+            request(arg, r, tally->total[r], tally->accepted[r]);
+    }
+
+drain:
+    /* Every slot is back on the free queue once the threads have exited */
+    while (tally->free.count)
+        hcs_queue_pop(&tally->free);
+
+    free(workers);
+    return retval;
+}
+
+unsigned long pcs_t_tally_accepted(const pcs_t_tally *tally,
+        unsigned long race)
+{
+    return race < tally->races ? tally->accepted[race] : 0;
+}
+
+unsigned long pcs_t_tally_rejected(const pcs_t_tally *tally)
+{
+    return tally->rejected;
+}
+
+int pcs_t_tally_write_ballot(FILE *out, unsigned long race, unsigned long id,
+        mpz_t cipher, pcs_t_proof *pf)
+{
+    mpz_ptr fields[] = {
+        cipher, pf->e[0], pf->e[1], pf->a[0], pf->a[1], pf->z[0], pf->z[1]
+    };
+
+    if (fprintf(out, "%lu %lu", race, id) < 0)
+        return 0;
+
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); ++i) {
+        if (fputc(' ', out) == EOF ||
+                mpz_out_str(out, HCS_INTERNAL_BASE, fields[i]) == 0)
+            return 0;
+    }
+
+    return fputc('\n', out) != EOF;
+}
+
+void pcs_t_free_tally(pcs_t_tally *tally)
+{
+    hcs_queue_destroy(&tally->accumulate);
+    hcs_queue_destroy(&tally->verify);
+    hcs_queue_destroy(&tally->free);
+
+    for (unsigned long i = 0; i < tally->depth; ++i) {
+        pcs_t_free_proof(tally->slots[i].pf);
+        mpz_clear(tally->slots[i].cipher);
+    }
+    for (unsigned long r = 0; r < tally->races; ++r)
+        mpz_clear(tally->total[r]);
+
+    free(tally->voters);
+    free(tally->slots);
+    free(tally->accepted);
+    free(tally->total);
+    free(tally);
+}
@@ -0,0 +1,259 @@
+#define CATCH_CONFIG_RUNNER
+#include "catch.hpp"
+
+#include <cstdlib>
+#include <string>
+#include <gmpxx.h>
+#include "../include/libhcs/dgkcs.h"
+
+static hcs_random *hr;
+static dgkcs_public_key *pk;
+static dgkcs_private_key *vk;
+
+static mpz_class round_trip(const mpz_class &m)
+{
+    mpz_class a(m);
+    dgkcs_encrypt(pk, hr, a.get_mpz_t(), a.get_mpz_t());
+    REQUIRE( dgkcs_decrypt(vk, a.get_mpz_t(), a.get_mpz_t()) );
+    return a;
+}
+
+TEST_CASE( "Key generation" ) {
+    mpz_class t, vp(vk->vp), vq(vk->vq);
+
+    REQUIRE( dgkcs_verify_key_pair(pk, vk) );
+    REQUIRE( pk->u == 41 );
+    REQUIRE( mpz_cmp(vk->n, pk->n) == 0 );
+
+    /* u * v_p divides p - 1, and g and h have the expected orders */
+    t = mpz_class(vk->p) - 1;
+    REQUIRE( mpz_divisible_p(t.get_mpz_t(), vp.get_mpz_t()) );
+    REQUIRE( mpz_divisible_ui_p(t.get_mpz_t(), pk->u) );
+    REQUIRE( mpz_sizeinbase(vk->vp, 2) >= pk->t );
+
+    t = vp * vq;
+    mpz_powm(t.get_mpz_t(), pk->h, t.get_mpz_t(), pk->n);
+    REQUIRE( t == 1 );
+    t = vp * vq * pk->u;
+    mpz_powm(t.get_mpz_t(), pk->g, t.get_mpz_t(), pk->n);
+    REQUIRE( t == 1 );
+    t = vp * vq;
+    mpz_powm(t.get_mpz_t(), pk->g, t.get_mpz_t(), pk->n);
+    REQUIRE( t != 1 );
+
+    dgkcs_public_key *pk2 = dgkcs_init_public_key();
+    dgkcs_private_key *vk2 = dgkcs_init_private_key();
+    REQUIRE( !dgkcs_generate_key_pair(pk2, vk2, hr, 512, DGKCS_MAX_U + 1) );
+    REQUIRE( !dgkcs_generate_key_pair(pk2, vk2, hr, 64, 40) );
+
+    /* The plaintext space may be as small as a single bit */
+    REQUIRE( dgkcs_generate_key_pair(pk2, vk2, hr, 512, 0) );
+    REQUIRE( pk2->u == 2 );
+    dgkcs_free_public_key(pk2);
+    dgkcs_free_private_key(vk2);
+}
+
+TEST_CASE( "Encryption/Decryption" ) {
+    mpz_class a, b, c, u(pk->u);
+
+    for (unsigned long m = 0; m < pk->u; ++m)
+        REQUIRE( round_trip(m) == m );
+
+    /* Plaintexts are taken mod u */
+    REQUIRE( round_trip(u + 5) == 5 );
+    REQUIRE( round_trip(-1) == u - 1 );
+
+    /* Only a multiple of u tests as zero */
+    a = 0; dgkcs_encrypt(pk, hr, a.get_mpz_t(), a.get_mpz_t());
+    REQUIRE( dgkcs_is_zero(vk, a.get_mpz_t()) );
+    a = u; dgkcs_encrypt(pk, hr, a.get_mpz_t(), a.get_mpz_t());
+    REQUIRE( dgkcs_is_zero(vk, a.get_mpz_t()) );
+    a = 1; dgkcs_encrypt(pk, hr, a.get_mpz_t(), a.get_mpz_t());
+    REQUIRE( !dgkcs_is_zero(vk, a.get_mpz_t()) );
+
+    /* A value outside the subgroup is rejected, leaving rop alone */
+    a = 2; c = 99;
+    REQUIRE( !dgkcs_decrypt(vk, c.get_mpz_t(), a.get_mpz_t()) );
+    REQUIRE( c == 99 );
+
+#define TEST_OP(op, x, y, r)\
+    a = (x); b = (y);\
+    dgkcs_encrypt(pk, hr, a.get_mpz_t(), a.get_mpz_t());\
+    dgkcs_encrypt(pk, hr, b.get_mpz_t(), b.get_mpz_t());\
+    op;\
+    REQUIRE( dgkcs_decrypt(vk, c.get_mpz_t(), c.get_mpz_t()) );\
+    REQUIRE( c == (r) )
+
+    TEST_OP(dgkcs_ee_add(pk, c.get_mpz_t(), a.get_mpz_t(), b.get_mpz_t()),
+            30, 20, 9);
+    TEST_OP(REQUIRE( dgkcs_ee_sub(pk, c.get_mpz_t(), a.get_mpz_t(),
+                                  b.get_mpz_t()) ),
+            3, 5, u - 2);
+    TEST_OP(dgkcs_reencrypt(pk, hr, c.get_mpz_t(), a.get_mpz_t()), 17, 0, 17);
+    REQUIRE( a != c );
+
+#undef TEST_OP
+
+    a = 12;
+    b = 7;
+    dgkcs_encrypt(pk, hr, c.get_mpz_t(), a.get_mpz_t());
+    dgkcs_ep_add(pk, c.get_mpz_t(), c.get_mpz_t(), b.get_mpz_t());
+    dgkcs_ep_mul(pk, c.get_mpz_t(), c.get_mpz_t(), b.get_mpz_t());
+    REQUIRE( dgkcs_decrypt(vk, c.get_mpz_t(), c.get_mpz_t()) );
+    REQUIRE( c == (12 + 7) * 7 % u );
+
+    dgkcs_encrypt(pk, hr, c.get_mpz_t(), a.get_mpz_t());
+    REQUIRE( dgkcs_e_neg(pk, c.get_mpz_t(), c.get_mpz_t()) );
+    REQUIRE( dgkcs_decrypt(vk, c.get_mpz_t(), c.get_mpz_t()) );
+    REQUIRE( c == u - 12 );
+
+    /* A value sharing a factor with n has no inverse, leaving rop alone */
+    c = 5;
+    REQUIRE( !dgkcs_e_neg(pk, c.get_mpz_t(), vk->p) );
+    REQUIRE( !dgkcs_ee_sub(pk, c.get_mpz_t(), a.get_mpz_t(), vk->p) );
+    REQUIRE( c == 5 );
+}
+
+TEST_CASE( "Batch encryption" ) {
+    const unsigned long count = 12;
+    mpz_t v[count];
+    int zero[count];
+    mpz_class a;
+
+    for (unsigned long i = 0; i < count; ++i)
+        mpz_init_set_ui(v[i], i * 5);
+
+    /* The plaintexts may be overwritten in place */
+    REQUIRE( dgkcs_encrypt_batch(pk, hr, v, v, count) );
+    dgkcs_is_zero_batch(vk, zero, v, count);
+    for (unsigned long i = 0; i < count; ++i) {
+        REQUIRE( dgkcs_decrypt(vk, a.get_mpz_t(), v[i]) );
+        REQUIRE( a == i * 5 % pk->u );
+        REQUIRE( !zero[i] == (i * 5 % pk->u != 0) );
+    }
+
+    a = 0xa5c;
+    REQUIRE( dgkcs_encrypt_bits(pk, hr, v, a.get_mpz_t(), count) );
+    dgkcs_is_zero_batch(vk, zero, v, count);
+    for (unsigned long i = 0; i < count; ++i)
+        REQUIRE( zero[i] == !mpz_tstbit(a.get_mpz_t(), i) );
+
+    for (unsigned long i = 0; i < count; ++i)
+        mpz_clear(v[i]);
+}
+
+/* Decide x < y from the encrypted bits of x and the plaintext bits of y.
+ * c_i = x_i - y_i + 1 + 3 * sum_{j > i} (x_j xor y_j) is zero exactly at the
+ * highest differing bit when x_i = 0 and y_i = 1. */
+static bool less_than(unsigned long x, unsigned long y, unsigned long l)
+{
+    mpz_t ex[16], c[16];
+    int zero[16];
+    mpz_class a, sum, one(1);
+
+    for (unsigned long i = 0; i < l; ++i)
+        mpz_inits(ex[i], c[i], NULL);
+
+    a = x;
+    dgkcs_encrypt_bits(pk, hr, ex, a.get_mpz_t(), l);
+    a = 0;
+    dgkcs_encrypt(pk, hr, sum.get_mpz_t(), a.get_mpz_t());
+
+    for (unsigned long i = l; i-- > 0; ) {
+        const unsigned long yi = (y >> i) & 1;
+
+        /* E(x_i - y_i + 1) */
+        a = 1 - (long)yi;
+        dgkcs_ep_add(pk, c[i], ex[i], a.get_mpz_t());
+        dgkcs_ee_add(pk, c[i], c[i], sum.get_mpz_t());
+
+        /* E(x_i xor y_i) */
+        if (yi) {
+            REQUIRE( dgkcs_e_neg(pk, ex[i], ex[i]) );
+            dgkcs_ep_add(pk, ex[i], ex[i], one.get_mpz_t());
+        }
+        a = 3;
+        dgkcs_ep_mul(pk, ex[i], ex[i], a.get_mpz_t());
+        dgkcs_ee_add(pk, sum.get_mpz_t(), sum.get_mpz_t(), ex[i]);
+    }
+
+    dgkcs_is_zero_batch(vk, zero, c, l);
+    bool lt = false;
+    for (unsigned long i = 0; i < l; ++i) {
+        lt = lt || zero[i];
+        mpz_clears(ex[i], c[i], NULL);
+    }
+    return lt;
+}
+
+TEST_CASE( "Comparison" ) {
+    /* 3l + 2 < u for l = 12 */
+    const unsigned long pairs[][2] = {
+        { 0, 0 }, { 0, 1 }, { 1, 0 }, { 1000, 1001 }, { 4095, 4095 },
+        { 2048, 2047 }, { 1234, 3210 }, { 4095, 0 }
+    };
+
+    for (const auto &p : pairs)
+        REQUIRE( less_than(p[0], p[1], 12) == (p[0] < p[1]) );
+}
+
+TEST_CASE( "Key import" ) {
+    dgkcs_public_key *pk2 = dgkcs_init_public_key();
+    dgkcs_private_key *vk2 = dgkcs_init_private_key();
+    mpz_class a, b;
+
+    char *json = dgkcs_export_public_key(pk);
+    REQUIRE( json != NULL );
+    REQUIRE( dgkcs_import_public_key(pk2, json) );
+    /* Importing over a held key releases its tables */
+    REQUIRE( dgkcs_import_public_key(pk2, json) );
+    free(json);
+    REQUIRE( pk2->rbits == pk->rbits );
+
+    json = dgkcs_export_private_key(vk);
+    REQUIRE( json != NULL );
+    REQUIRE( dgkcs_import_private_key(vk2, json) );
+    REQUIRE( dgkcs_import_private_key(vk2, json) );
+    free(json);
+    REQUIRE( dgkcs_verify_key_pair(pk2, vk2) );
+
+    a = 37;
+    dgkcs_encrypt(pk2, hr, b.get_mpz_t(), a.get_mpz_t());
+    REQUIRE( dgkcs_decrypt(vk, b.get_mpz_t(), b.get_mpz_t()) );
+    REQUIRE( a == b );
+    dgkcs_encrypt(pk, hr, b.get_mpz_t(), a.get_mpz_t());
+    REQUIRE( dgkcs_decrypt(vk2, b.get_mpz_t(), b.get_mpz_t()) );
+    REQUIRE( a == b );
+
+    REQUIRE( !dgkcs_import_public_key(pk2, "{\"v\": 2, \"u\": 1}") );
+    REQUIRE( !dgkcs_import_private_key(vk2, "not json") );
+
+    /* t is bounded before it sizes the randomiser table */
+    for (const char *t : { "0", "257", "100000000" }) {
+        std::string key = std::string("{\"v\": 2, \"u\": ") +
+            std::to_string(pk->u) + ", \"t\": " + t +
+            ", \"n\": \"" + mpz_class(pk->n).get_str(16) +
+            "\", \"g\": \"" + mpz_class(pk->g).get_str(16) +
+            "\", \"h\": \"" + mpz_class(pk->h).get_str(16) + "\"}";
+        REQUIRE( !dgkcs_import_public_key(pk2, key.c_str()) );
+    }
+
+    dgkcs_free_public_key(pk2);
+    dgkcs_free_private_key(vk2);
+}
+
+int main(int argc, char *argv[])
+{
+    hr = hcs_init_random();
+    pk = dgkcs_init_public_key();
+    vk = dgkcs_init_private_key();
+    if (!dgkcs_generate_key_pair(pk, vk, hr, 512, 40))
+        return 1;
+
+    int result = Catch::Session().run(argc, argv);
+
+    dgkcs_free_public_key(pk);
+    dgkcs_free_private_key(vk);
+    hcs_free_random(hr);
+    return result;
+}
@@ -0,0 +1,279 @@
+#define CATCH_CONFIG_RUNNER
+#include "catch.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <gmpxx.h>
+#include "../include/libhcs/djcs.h"
+#include "../include/libhcs++/djcs.hpp"
+#include "../include/libhcs/djcs_pir.h"
+#include "../include/libhcs/hcs_groupby.h"
+
+static hcs_random *hr;
+static djcs_public_key *pk;
+static djcs_private_key *vk;
+
+TEST_CASE( "Encryption/Decryption at each level" ) {
+    mpz_class a, b;
+
+    for (unsigned long s = 1; s <= pk->s; ++s) {
+        a = "1234567890123456789";
+        djcs_encrypt_s(pk, hr, b.get_mpz_t(), a.get_mpz_t(), s);
+        REQUIRE( mpz_cmp(b.get_mpz_t(), pk->n[s]) < 0 );
+        djcs_decrypt_s(vk, b.get_mpz_t(), b.get_mpz_t(), s);
+        REQUIRE( a == b );
+    }
+
+    /* The top level agrees with the plain functions */
+    a = 42;
+    djcs_encrypt_s(pk, hr, b.get_mpz_t(), a.get_mpz_t(), pk->s);
+    djcs_decrypt(vk, b.get_mpz_t(), b.get_mpz_t());
+    REQUIRE( b == 42 );
+}
+
+TEST_CASE( "Subtraction and negation" ) {
+    mpz_class a, b, c, n(pk->n[0]), ns(pk->n[pk->s-1]);
+
+    /* g^-m is expanded binomially, so check values wider than n */
+    const mpz_class values[] = { 0, 7, n + 3, n * n * 5 + n - 1, ns - 1 };
+    for (const mpz_class &x : values) {
+        for (const mpz_class &y : values) {
+            a = x; b = y;
+            djcs_encrypt(pk, hr, c.get_mpz_t(), a.get_mpz_t());
+            djcs_ep_sub(pk, c.get_mpz_t(), c.get_mpz_t(), b.get_mpz_t());
+            djcs_decrypt(vk, c.get_mpz_t(), c.get_mpz_t());
+            REQUIRE( c == (a - b + ns) % ns );
+        }
+    }
+
+    a = 1000; b = 1;
+    djcs_encrypt(pk, hr, a.get_mpz_t(), a.get_mpz_t());
+    djcs_encrypt(pk, hr, b.get_mpz_t(), b.get_mpz_t());
+    REQUIRE( djcs_ee_sub(pk, c.get_mpz_t(), a.get_mpz_t(), b.get_mpz_t()) );
+    djcs_decrypt(vk, c.get_mpz_t(), c.get_mpz_t());
+    REQUIRE( c == 999 );
+    REQUIRE( djcs_e_neg(pk, c.get_mpz_t(), b.get_mpz_t()) );
+    djcs_decrypt(vk, c.get_mpz_t(), c.get_mpz_t());
+    REQUIRE( c == ns - 1 );
+
+    /* A value sharing a factor with n has no inverse, leaving rop alone */
+    c = 5;
+    REQUIRE( !djcs_e_neg(pk, c.get_mpz_t(), pk->n[0]) );
+    REQUIRE( !djcs_ee_sub(pk, c.get_mpz_t(), a.get_mpz_t(), pk->n[0]) );
+    b = -3;
+    REQUIRE( !djcs_ep_mul(pk, c.get_mpz_t(), pk->n[0], b.get_mpz_t()) );
+    REQUIRE( c == 5 );
+
+    /* A positive scalar needs no inverse */
+    b = 3;
+    REQUIRE( djcs_ep_mul(pk, c.get_mpz_t(), a.get_mpz_t(), b.get_mpz_t()) );
+    djcs_decrypt(vk, c.get_mpz_t(), c.get_mpz_t());
+    REQUIRE( c == 3000 );
+}
+
+TEST_CASE( "Key import" ) {
+    djcs_public_key *pk2 = djcs_init_public_key();
+    djcs_private_key *vk2 = djcs_init_private_key();
+    mpz_class a = 987654321, b;
+
+    char *json = djcs_export_public_key(pk);
+    REQUIRE( djcs_import_public_key(pk2, json) );
+    free(json);
+    json = djcs_export_private_key(vk);
+    REQUIRE( djcs_import_private_key(vk2, json) );
+    free(json);
+
+    /* A second import replaces the first */
+    json = djcs_export_public_key(pk);
+    REQUIRE( djcs_import_public_key(pk2, json) );
+    free(json);
+
+    REQUIRE( pk2->s == pk->s );
+    REQUIRE( mpz_cmp(pk2->n[pk->s], pk->n[pk->s]) == 0 );
+    djcs_encrypt(pk2, hr, b.get_mpz_t(), a.get_mpz_t());
+    djcs_decrypt(vk2, b.get_mpz_t(), b.get_mpz_t());
+    REQUIRE( a == b );
+
+    REQUIRE( !djcs_import_public_key(pk2, "{\"v\":2,\"s\":0,\"n\":\"f\"}") );
+    REQUIRE( !djcs_import_private_key(vk2, "{\"v\":2,\"s\":1,\"n\":\"ff\"}") );
+
+    djcs_free_public_key(pk2);
+    djcs_free_private_key(vk2);
+}
+
+static void check_pir(djcs_pir_params *pp, djcs_pir_db *db,
+                      const std::vector<unsigned char> &data)
+{
+    std::vector<mpz_class> query(pp->query_size), answer(pp->chunks);
+    std::vector<unsigned char> record(pp->record_size);
+
+    for (unsigned long index = 0; index < pp->records; index += 3) {
+        REQUIRE( djcs_pir_query(pp, hr, (mpz_t*)query.data(), index) );
+        REQUIRE( djcs_pir_respond(pp, db, (mpz_t*)answer.data(),
+                    (mpz_t*)query.data()) );
+        REQUIRE( djcs_pir_decode(pp, vk, record.data(),
+                    (mpz_t*)answer.data()) );
+        REQUIRE( memcmp(record.data(), &data[index * pp->record_size],
+                    pp->record_size) == 0 );
+    }
+
+    REQUIRE( !djcs_pir_query(pp, hr, (mpz_t*)query.data(), pp->records) );
+}
+
+TEST_CASE( "Recursive private information retrieval" ) {
+    const unsigned long records = 23;
+    const size_t record_size = 70;
+    std::vector<unsigned char> data(records * record_size);
+
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = (unsigned char)(i * 131 + 7);
+    /* Leading zero bytes must survive the round trip */
+    data[0] = data[1] = 0;
+
+    djcs_pir_db *db = djcs_pir_init_db(data.data(), data.size());
+    REQUIRE( db != NULL );
+
+    for (unsigned long d = 1; d <= pk->s; ++d) {
+        djcs_pir_params *pp = djcs_pir_init_params(pk, records, record_size,
+                                                   d);
+        REQUIRE( pp != NULL );
+        REQUIRE( pp->s + d - 1 == pk->s );
+
+        unsigned long covered = 1;
+        for (unsigned long j = 0; j < d; ++j)
+            covered *= pp->dim[j];
+        REQUIRE( covered >= records );
+
+        check_pir(pp, db, data);
+        djcs_pir_free_params(pp);
+    }
+
+    REQUIRE( djcs_pir_init_params(pk, records, record_size, pk->s + 1)
+                == NULL );
+
+    /* A database too small for the parameters is refused */
+    djcs_pir_params *pp = djcs_pir_init_params(pk, records + 1, record_size,
+                                               2);
+    mpz_class query[16], answer[16];
+    REQUIRE( !djcs_pir_respond(pp, db, (mpz_t*)answer, (mpz_t*)query) );
+    djcs_pir_free_params(pp);
+
+    djcs_pir_free_db(db);
+}
+
+TEST_CASE( "Private information retrieval from a mapped file" ) {
+    const unsigned long records = 10;
+    const size_t record_size = 40;
+    std::vector<unsigned char> data(records * record_size);
+
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = (unsigned char)(i * 17 + 1);
+
+    char path[] = "djcs_pir_test.bin";
+    FILE *f = fopen(path, "wb");
+    REQUIRE( f != NULL );
+    REQUIRE( fwrite(data.data(), 1, data.size(), f) == data.size() );
+    fclose(f);
+
+    djcs_pir_db *db = djcs_pir_open_db(path);
+    REQUIRE( db != NULL );
+    REQUIRE( db->size == data.size() );
+
+    djcs_pir_params *pp = djcs_pir_init_params(pk, records, record_size, 2);
+    REQUIRE( pp != NULL );
+    check_pir(pp, db, data);
+
+    djcs_pir_free_params(pp);
+    djcs_pir_free_db(db);
+    remove(path);
+
+    REQUIRE( djcs_pir_open_db(path) == NULL );
+}
+
+TEST_CASE( "Group-by aggregation" ) {
+    const unsigned long rows = 200, groups = 7;
+    std::vector<unsigned long> key(rows);
+    std::vector<mpz_class> cipher(rows), sum(groups);
+    mpz_class m, expect[groups];
+
+    for (unsigned long i = 0; i < rows; ++i) {
+        key[i] = i % groups;
+        m = i;
+        expect[key[i]] += m;
+        djcs_encrypt(pk, hr, cipher[i].get_mpz_t(), m.get_mpz_t());
+    }
+
+    hcs_groupby *gb = hcs_init_groupby_djcs(pk, 0);
+    REQUIRE( gb != NULL );
+    REQUIRE( hcs_groupby_add_batch(gb, key.data(), (mpz_t*)cipher.data(),
+                rows) );
+    REQUIRE( hcs_groupby_finish(gb) );
+    REQUIRE( hcs_groupby_count(gb) == groups );
+
+    /* The plaintext space of n^s fits every group in one ciphertext */
+    REQUIRE( hcs_groupby_packed_count(gb, 64) == 1 );
+    REQUIRE( hcs_groupby_pack(gb, (mpz_t*)&m, 64) );
+    djcs_decrypt(vk, m.get_mpz_t(), m.get_mpz_t());
+    REQUIRE( hcs_groupby_unpack(gb, (mpz_t*)sum.data(), (mpz_t*)&m, 64) );
+    for (unsigned long i = 0; i < groups; ++i)
+        REQUIRE( sum[i] == expect[hcs_groupby_key(gb, i)] );
+
+    hcs_free_groupby(gb);
+}
+
+TEST_CASE( "C++ wrapper" ) {
+    hcs::random r;
+    hcs::djcs::public_key pk2(r);
+    hcs::djcs::private_key vk2(r);
+    mpz_class a = 1000, b = 3, ca, cb, d;
+
+    REQUIRE( hcs::djcs::generate_key_pair(pk2, vk2, 2, 256) );
+    REQUIRE( hcs::djcs::verify_key_pair(pk2, vk2) );
+
+    const hcs::djcs::public_key &cpk = pk2;
+    const hcs::djcs::private_key &cvk = vk2;
+    cpk.encrypt(ca, a);
+    cpk.encrypt(cb, b);
+    cpk.ee_add(d, ca, cb);
+    cpk.ep_add(d, d, b);
+    cvk.decrypt(d, d);
+    REQUIRE( d == 1006 );
+
+    REQUIRE( cpk.ep_mul(d, ca, b) );
+    cvk.decrypt(d, d);
+    REQUIRE( d == 3000 );
+    REQUIRE( cpk.ee_sub(d, ca, cb) );
+    cpk.ep_sub(d, d, b);
+    cvk.decrypt(d, d);
+    REQUIRE( d == 994 );
+    REQUIRE( cpk.e_neg(d, cb) );
+    cpk.reencrypt(d, d);
+    cpk.ee_add(d, d, ca);
+    cvk.decrypt(d, d);
+    REQUIRE( d == 997 );
+
+    std::string json = cpk.export_json();
+    hcs::djcs::public_key pk3(r);
+    REQUIRE( pk3.import_json(json) );
+    json = cvk.export_json();
+    hcs::djcs::private_key vk3(r);
+    REQUIRE( vk3.import_json(json) );
+    REQUIRE( hcs::djcs::verify_key_pair(pk3, vk3) );
+}
+
+int main(int argc, char *argv[])
+{
+    hr = hcs_init_random();
+    pk = djcs_init_public_key();
+    vk = djcs_init_private_key();
+    djcs_generate_key_pair(pk, vk, hr, 3, 256);
+
+    int result = Catch::Session().run(argc, argv);
+
+    djcs_free_public_key(pk);
+    djcs_free_private_key(vk);
+    hcs_free_random(hr);
+    return result;
+}
@@ -0,0 +1,122 @@
+#define CATCH_CONFIG_RUNNER
+#include "catch.hpp"
+
+#include <vector>
+#include <gmpxx.h>
+#include "../include/libhcs/djcs_t.h"
+#include "../include/libhcs/hcs_shares.h"
+#include "../include/libhcs++/djcs_t.hpp"
+
+static hcs_random *hr;
+static djcs_t_public_key *pk;
+static djcs_t_private_key *vk;
+
+TEST_CASE( "Key generation" ) {
+    mpz_class t;
+
+    REQUIRE( pk->w == 3 );
+    REQUIRE( pk->l == 5 );
+    REQUIRE( mpz_cmp_ui(pk->delta, 120) == 0 );
+
+    for (unsigned long i = 0; i <= pk->s; ++i) {
+        mpz_pow_ui(t.get_mpz_t(), pk->n[0], i + 1);
+        REQUIRE( mpz_cmp(pk->n[i], t.get_mpz_t()) == 0 );
+        REQUIRE( mpz_cmp(vk->n[i], t.get_mpz_t()) == 0 );
+    }
+}
+
+TEST_CASE( "Share combination with only the public key" ) {
+    mpz_class m, c, si, r;
+    std::vector<mpz_class> share(pk->l);
+    std::vector<djcs_t_auth_server*> au(pk->l);
+
+    /* Exceeds n, so the higher powers of n are exercised */
+    m = mpz_class(pk->n[0]) * 7 + 12345;
+
+    mpz_t *coeff = djcs_t_init_polynomial(vk, hr);
+    djcs_t_encrypt(pk, hr, c.get_mpz_t(), m.get_mpz_t());
+    for (unsigned long i = 0; i < pk->l; ++i) {
+        au[i] = djcs_t_init_auth_server();
+        djcs_t_compute_polynomial(vk, coeff, si.get_mpz_t(), i);
+        djcs_t_set_auth_server(au[i], si.get_mpz_t(), i);
+        djcs_t_share_decrypt(pk, au[i], share[i].get_mpz_t(), c.get_mpz_t());
+    }
+    djcs_t_free_polynomial(vk, coeff);
+
+    hcs_shares *hs = hcs_init_shares(pk->l);
+    for (unsigned long i = 0; i < pk->l; ++i)
+        hcs_set_share(hs, share[i].get_mpz_t(), i);
+
+    REQUIRE( djcs_t_share_combine(pk, r.get_mpz_t(), hs) );
+    REQUIRE( r == m );
+
+    hcs_clear_flag(hs, 1);
+    hcs_clear_flag(hs, 2);
+    REQUIRE( djcs_t_share_combine(pk, r.get_mpz_t(), hs) );
+    REQUIRE( r == m );
+    hcs_clear_flag(hs, 0);
+    REQUIRE( !djcs_t_share_combine(pk, r.get_mpz_t(), hs) );
+    hcs_free_shares(hs);
+
+    const unsigned long quorum[] = { 3, 1, 4 };
+    djcs_t_combiner *cb = djcs_t_init_combiner(pk, quorum);
+    REQUIRE( cb != NULL );
+    for (unsigned long i = 0; i < pk->l; ++i)
+        djcs_t_combiner_add(cb, i, share[i].get_mpz_t());
+    REQUIRE( djcs_t_combiner_result(pk, cb, r.get_mpz_t()) );
+    REQUIRE( r == m );
+    djcs_t_free_combiner(cb);
+
+    for (djcs_t_auth_server *a : au)
+        djcs_t_free_auth_server(a);
+}
+
+TEST_CASE( "C++ wrapper" ) {
+    hcs::random r;
+    hcs::djcs_t::public_key pk2(r);
+    hcs::djcs_t::private_key vk2(r);
+    mpz_class a = 20, b = 7, c, d, si, share;
+
+    hcs::djcs_t::generate_key_pair(pk2, vk2, 1, 256, 5, 3);
+    REQUIRE( pk2.as_ptr()->l == 5 );
+    REQUIRE( pk2.as_ptr()->w == 3 );
+
+    const hcs::djcs_t::public_key &cpk = pk2;
+    cpk.encrypt(c, a);
+    cpk.encrypt(d, b);
+    cpk.ee_add(c, c, d);
+    cpk.ep_add(c, c, b);
+    cpk.ep_mul(c, c, b);
+    cpk.reencrypt(c, c);
+
+    hcs_shares *hs = hcs_init_shares(pk2.as_ptr()->l);
+    {
+        hcs::djcs_t::polynomial px(vk2);
+        REQUIRE( px.as_ptr() != NULL );
+        for (unsigned long i = 0; i < pk2.as_ptr()->l; ++i) {
+            px.compute(si, i);
+            hcs::djcs_t::auth_server au(si, i);
+            au.share_decrypt(cpk, share, c);
+            hcs_set_share(hs, share.get_mpz_t(), i);
+        }
+    }
+
+    REQUIRE( cpk.share_combine(a, hs) );
+    REQUIRE( a == (20 + 7 + 7) * 7 );
+    hcs_free_shares(hs);
+}
+
+int main(int argc, char *argv[])
+{
+    hr = hcs_init_random();
+    pk = djcs_t_init_public_key();
+    vk = djcs_t_init_private_key();
+    djcs_t_generate_key_pair(pk, vk, hr, 2, 256, 3, 5);
+
+    int result = Catch::Session().run(argc, argv);
+
+    djcs_t_free_public_key(pk);
+    djcs_t_free_private_key(vk);
+    hcs_free_random(hr);
+    return result;
+}
@@ -8,16 +8,44 @@ static hcs::random *hr;
 static hcs::egcs::public_key *pk;
 static hcs::egcs::private_key *vk;
 
+TEST_CASE( "Key generation" ) {
+    const egcs_public_key *k = pk->as_ptr();
+    mpz_class t;
+
+    REQUIRE( mpz_sizeinbase(k->r, 2) == 256 );
+    REQUIRE( mpz_probab_prime_p(k->r, 25) );
+    REQUIRE( mpz_probab_prime_p(k->q, 25) );
+
+    /* r divides q - 1 and g generates the subgroup of order r */
+    mpz_sub_ui(t.get_mpz_t(), k->q, 1);
+    REQUIRE( mpz_divisible_p(t.get_mpz_t(), k->r) );
+    REQUIRE( mpz_cmp_ui(k->g, 1) > 0 );
+    mpz_powm(t.get_mpz_t(), k->g, k->r, k->q);
+    REQUIRE( t == 1 );
+
+    /* The secret exponent is short */
+    REQUIRE( mpz_cmp(vk->as_ptr()->x, k->r) < 0 );
+}
+
+/* Map x into the subgroup of order r, where messages must lie */
+static mpz_class encode(const mpz_class &x)
+{
+    const egcs_public_key *k = pk->as_ptr();
+    mpz_class m;
+    mpz_powm(m.get_mpz_t(), k->g, x.get_mpz_t(), k->q);
+    return m;
+}
+
 TEST_CASE( "Encryption/Decryption") {
 
     hcs::egcs::cipher u, v;
-    mpz_class a, b, c;
+    mpz_class a, b, c, q(pk->as_ptr()->q);
 
     /* Key pair must match */
     //REQUIRE( hcs::egcs::verify_key_pair(*pk, *vk) );
 
 #define TEST_SIMPLE(x)\
-    a = (x); b = (a);\
+    a = encode(x); b = (a);\
     u = pk->encrypt(a);\
     a = vk->decrypt(u);\
     REQUIRE( a == b )
@@ -25,10 +53,10 @@ TEST_CASE( "Encryption/Decryption") {
     TEST_SIMPLE(5);
     TEST_SIMPLE(0);
     TEST_SIMPLE(1241012408124);
-    TEST_SIMPLE("22222222222222222222222222222222");
+    TEST_SIMPLE(mpz_class("22222222222222222222222222222222"));
 
 #define TEST_EE_MUL(x, y)\
-    a = (x); b = (y); c = (a) * (b);\
+    a = encode(x); b = encode(y); c = (a) * (b) % q;\
     u = pk->encrypt(a);\
     v = pk->encrypt(b);\
     u = pk->ee_mul(u, v);\
@@ -38,12 +66,42 @@ TEST_CASE( "Encryption/Decryption") {
     TEST_EE_MUL(0, 0);
     TEST_EE_MUL(0, 5);
     TEST_EE_MUL(4124, 1208725);
-    TEST_EE_MUL("123456678924124087124", "31209235923652352352126437357");
+    TEST_EE_MUL(mpz_class("123456678924124087124"),
+                mpz_class("31209235923652352352126437357"));
+
+    a = encode(987654321);
+    u = pk->encrypt(a);
+    v = pk->reencrypt(u);
+    REQUIRE( mpz_cmp(u.as_ptr()->c1, v.as_ptr()->c1) != 0 );
+    b = vk->decrypt(v);
+    REQUIRE( a == b );
 
 #undef TEST_SIMPLE
 #undef TEST_EE_MUL
 }
 
+TEST_CASE( "Messages outside the subgroup" ) {
+    const egcs_public_key *k = pk->as_ptr();
+    egcs_cipher *ct = egcs_init_cipher();
+    mpz_class m;
+
+    /* Small integers and -1 would be recognisable from c2^r */
+    const long values[] = { 0, 2, 5, -1 };
+    for (long x : values) {
+        m = x;
+        if (x < 0)
+            m += mpz_class(k->q);
+        REQUIRE( !egcs_encrypt(k, hr->as_ptr(), ct, m.get_mpz_t()) );
+        REQUIRE( mpz_sgn(ct->c1) == 0 );
+    }
+
+    m = 5;
+    hcs::egcs::cipher u = pk->encrypt(m);
+    REQUIRE( mpz_sgn(u.as_ptr()->c2) == 0 );
+
+    egcs_free_cipher(ct);
+}
+
 int main(int argc, char *argv[])
 {
     hr = new hcs::random();
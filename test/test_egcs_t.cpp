@@ -0,0 +1,180 @@
+#define CATCH_CONFIG_RUNNER
+#include "catch.hpp"
+
+#include <vector>
+#include <gmpxx.h>
+#include "../include/libhcs/egcs_t.h"
+#include "../include/libhcs/hcs_shares.h"
+
+static hcs_random *hr;
+static egcs_t_public_key *pk;
+static egcs_t_private_key *vk;
+static std::vector<egcs_t_auth_server*> au;
+
+TEST_CASE( "Key generation" ) {
+    mpz_class t;
+
+    REQUIRE( pk->w == 3 );
+    REQUIRE( pk->l == 5 );
+    REQUIRE( mpz_cmp_ui(pk->delta, 120) == 0 );
+    REQUIRE( mpz_sizeinbase(pk->r, 2) == EGCS_T_ORDER_BITS );
+    REQUIRE( mpz_sizeinbase(pk->q, 2) >= 512 );
+    REQUIRE( mpz_probab_prime_p(pk->r, 25) );
+    REQUIRE( mpz_probab_prime_p(pk->q, 25) );
+
+    /* g generates the subgroup of order r */
+    REQUIRE( mpz_cmp_ui(pk->g, 1) > 0 );
+    mpz_powm(t.get_mpz_t(), pk->g, pk->r, pk->q);
+    REQUIRE( t == 1 );
+
+    mpz_powm(t.get_mpz_t(), pk->g, vk->x, pk->q);
+    REQUIRE( mpz_cmp(t.get_mpz_t(), pk->h) == 0 );
+}
+
+TEST_CASE( "Share decryption" ) {
+    mpz_class m, r, s;
+    egcs_cipher *ct = egcs_init_cipher();
+    hcs_shares *hs = hcs_init_shares(pk->l);
+
+    /* Messages must lie in the subgroup generated by g */
+    m = 1241012408124;
+    mpz_powm(m.get_mpz_t(), pk->g, m.get_mpz_t(), pk->q);
+    REQUIRE( egcs_t_encrypt(pk, hr, ct, m.get_mpz_t()) );
+    for (unsigned long i = 0; i < pk->l; ++i) {
+        REQUIRE( egcs_t_share_decrypt(pk, au[i], s.get_mpz_t(), ct) );
+        hcs_set_share(hs, s.get_mpz_t(), i);
+    }
+
+    REQUIRE( egcs_t_share_combine(pk, r.get_mpz_t(), ct, hs) );
+    REQUIRE( r == m );
+
+    /* Any w servers are enough */
+    hcs_clear_flag(hs, 0);
+    hcs_clear_flag(hs, 3);
+    REQUIRE( egcs_t_share_combine(pk, r.get_mpz_t(), ct, hs) );
+    REQUIRE( r == m );
+
+    /* But fewer are refused, leaving rop alone */
+    hcs_clear_flag(hs, 1);
+    r = 0;
+    REQUIRE( !egcs_t_share_combine(pk, r.get_mpz_t(), ct, hs) );
+    REQUIRE( r == 0 );
+
+    /* A message outside the subgroup is refused, leaving ct alone */
+    mpz_class c1(ct->c1);
+    m = mpz_class(pk->q) - 1;
+    REQUIRE( !egcs_t_encrypt(pk, hr, ct, m.get_mpz_t()) );
+    m = 0;
+    REQUIRE( !egcs_t_encrypt(pk, hr, ct, m.get_mpz_t()) );
+    REQUIRE( c1 == mpz_class(ct->c1) );
+
+    /* A c1 outside the subgroup is never raised to a share */
+    mpz_class c[] = { 0, mpz_class(pk->q) - 1, mpz_class(pk->q) };
+    for (const mpz_class &x : c) {
+        mpz_set(ct->c1, x.get_mpz_t());
+        s = 5;
+        REQUIRE( !egcs_t_share_decrypt(pk, au[0], s.get_mpz_t(), ct) );
+        REQUIRE( s == 5 );
+    }
+    egcs_cipher *bad[] = { ct };
+    mpz_t share[1];
+    mpz_init(share[0]);
+    REQUIRE( !egcs_t_share_decrypt_batch(pk, au[0], share, bad, 1) );
+    mpz_clear(share[0]);
+
+    hcs_free_shares(hs);
+    egcs_free_cipher(ct);
+}
+
+TEST_CASE( "Homomorphic multiplication" ) {
+    mpz_class a, b, r, s;
+    egcs_cipher *u = egcs_init_cipher(), *v = egcs_init_cipher();
+    hcs_shares *hs = hcs_init_shares(pk->l);
+
+    a = "123456678924124087124";
+    b = "31209235923652352352126437357";
+    mpz_powm(a.get_mpz_t(), pk->g, a.get_mpz_t(), pk->q);
+    mpz_powm(b.get_mpz_t(), pk->g, b.get_mpz_t(), pk->q);
+    REQUIRE( egcs_t_encrypt(pk, hr, u, a.get_mpz_t()) );
+    REQUIRE( egcs_t_encrypt(pk, hr, v, b.get_mpz_t()) );
+    egcs_t_ee_mul(pk, u, u, v);
+    egcs_t_reencrypt(pk, hr, u, u);
+
+    for (unsigned long i = 0; i < pk->l; ++i) {
+        REQUIRE( egcs_t_share_decrypt(pk, au[i], s.get_mpz_t(), u) );
+        hcs_set_share(hs, s.get_mpz_t(), i);
+    }
+    hcs_clear_flag(hs, 2);
+
+    REQUIRE( egcs_t_share_combine(pk, r.get_mpz_t(), u, hs) );
+    mpz_class p = a * b;
+    mpz_mod(p.get_mpz_t(), p.get_mpz_t(), pk->q);
+    REQUIRE( r == p );
+
+    hcs_free_shares(hs);
+    egcs_free_cipher(u);
+    egcs_free_cipher(v);
+}
+
+TEST_CASE( "Batch share decryption" ) {
+    const unsigned long count = 9;
+    std::vector<egcs_cipher*> ct(count);
+    std::vector<mpz_class> m(count);
+    mpz_t share[count], plain[count];
+    hcs_shares *hs = hcs_init_shares_batch(pk->l, count,
+                                           mpz_sizeinbase(pk->q, 2));
+
+    for (unsigned long r = 0; r < count; ++r) {
+        m[r] = 1000 * r + 7;
+        mpz_powm(m[r].get_mpz_t(), pk->g, m[r].get_mpz_t(), pk->q);
+        ct[r] = egcs_init_cipher();
+        REQUIRE( egcs_t_encrypt(pk, hr, ct[r], m[r].get_mpz_t()) );
+        mpz_inits(share[r], plain[r], NULL);
+    }
+
+    for (unsigned long i = 0; i < pk->l; ++i) {
+        REQUIRE( egcs_t_share_decrypt_batch(pk, au[i], share, ct.data(),
+                                            count) );
+        for (unsigned long r = 0; r < count; ++r)
+            hcs_set_batch_share(hs, share[r], r, i);
+    }
+
+    hcs_clear_flag(hs, 1);
+    hcs_clear_flag(hs, 4);
+    REQUIRE( egcs_t_share_combine_batch(pk, plain, ct.data(), hs) );
+    for (unsigned long r = 0; r < count; ++r) {
+        REQUIRE( mpz_class(plain[r]) == m[r] );
+        mpz_clears(share[r], plain[r], NULL);
+        egcs_free_cipher(ct[r]);
+    }
+
+    hcs_free_shares(hs);
+}
+
+int main(int argc, char *argv[])
+{
+    mpz_class si;
+
+    hr = hcs_init_random();
+    pk = egcs_t_init_public_key();
+    vk = egcs_t_init_private_key();
+    if (!egcs_t_generate_key_pair(pk, vk, hr, 512, 3, 5))
+        return 1;
+
+    egcs_t_polynomial *px = egcs_t_init_polynomial(vk, hr);
+    for (unsigned long i = 0; i < pk->l; ++i) {
+        au.push_back(egcs_t_init_auth_server());
+        egcs_t_compute_polynomial(vk, px, si.get_mpz_t(), i);
+        egcs_t_set_auth_server(au[i], si.get_mpz_t(), i);
+    }
+    egcs_t_free_polynomial(px);
+
+    int result = Catch::Session().run(argc, argv);
+
+    for (egcs_t_auth_server *a : au)
+        egcs_t_free_auth_server(a);
+    egcs_t_free_public_key(pk);
+    egcs_t_free_private_key(vk);
+    hcs_free_random(hr);
+    return result;
+}
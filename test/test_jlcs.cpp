@@ -0,0 +1,161 @@
+#define CATCH_CONFIG_RUNNER
+#include "catch.hpp"
+
+#include <cstdlib>
+#include <string>
+#include <gmpxx.h>
+#include "../include/libhcs/jlcs.h"
+
+static hcs_random *hr;
+static jlcs_public_key *pk;
+static jlcs_private_key *vk;
+
+static mpz_class round_trip(jlcs_public_key *k, jlcs_private_key *v,
+        const mpz_class &m)
+{
+    mpz_class a(m);
+    jlcs_encrypt(k, hr, a.get_mpz_t(), a.get_mpz_t());
+    jlcs_decrypt(v, a.get_mpz_t(), a.get_mpz_t());
+    return a;
+}
+
+TEST_CASE( "Key generation" ) {
+    REQUIRE( jlcs_verify_key_pair(pk, vk) );
+    REQUIRE( pk->k == 32 );
+
+    /* p = 1 mod 2^k and q = 3 mod 4 */
+    REQUIRE( mpz_scan1(mpz_class(mpz_class(vk->p) - 1).get_mpz_t(), 0) >= 32 );
+    REQUIRE( mpz_fdiv_ui(vk->q, 4) == 3 );
+    REQUIRE( mpz_jacobi(pk->y, pk->n) == 1 );
+    REQUIRE( mpz_legendre(pk->y, vk->p) == -1 );
+
+    /* k is limited to a quarter of the modulus */
+    jlcs_public_key *pk2 = jlcs_init_public_key();
+    jlcs_private_key *vk2 = jlcs_init_private_key();
+    REQUIRE( !jlcs_generate_key_pair(pk2, vk2, hr, 512, 0) );
+    REQUIRE( !jlcs_generate_key_pair(pk2, vk2, hr, 512, 129) );
+    jlcs_free_public_key(pk2);
+    jlcs_free_private_key(vk2);
+}
+
+TEST_CASE( "Encryption/Decryption" ) {
+    mpz_class a, b, c, mod(pk->k2);
+
+    REQUIRE( round_trip(pk, vk, 0) == 0 );
+    REQUIRE( round_trip(pk, vk, 1) == 1 );
+    REQUIRE( round_trip(pk, vk, 4124124523u) == 4124124523u );
+    REQUIRE( round_trip(pk, vk, mod - 1) == mod - 1 );
+
+    /* Plaintexts are taken mod 2^k */
+    REQUIRE( round_trip(pk, vk, mod + 77) == 77 );
+    REQUIRE( round_trip(pk, vk, -1) == mod - 1 );
+
+#define TEST_OP(op, x, y)\
+    a = (x); b = (y);\
+    jlcs_encrypt(pk, hr, a.get_mpz_t(), a.get_mpz_t());\
+    jlcs_encrypt(pk, hr, b.get_mpz_t(), b.get_mpz_t());\
+    op;\
+    jlcs_decrypt(vk, c.get_mpz_t(), c.get_mpz_t())
+
+    /* Sums wrap mod 2^k */
+    TEST_OP(jlcs_ee_add(pk, c.get_mpz_t(), a.get_mpz_t(), b.get_mpz_t()),
+            mod - 5, 12);
+    REQUIRE( c == 7 );
+
+    TEST_OP(jlcs_reencrypt(pk, hr, c.get_mpz_t(), a.get_mpz_t()), 31337, 0);
+    REQUIRE( c == 31337 );
+    REQUIRE( a != c );
+
+    TEST_OP(jlcs_e_neg(pk, b.get_mpz_t(), b.get_mpz_t());
+            jlcs_ee_add(pk, c.get_mpz_t(), a.get_mpz_t(), b.get_mpz_t()),
+            1000, 1);
+    REQUIRE( c == 999 );
+
+#undef TEST_OP
+
+    a = 123456;
+    b = 789;
+    jlcs_encrypt(pk, hr, c.get_mpz_t(), a.get_mpz_t());
+    jlcs_ep_add(pk, c.get_mpz_t(), c.get_mpz_t(), b.get_mpz_t());
+    jlcs_ep_mul(pk, c.get_mpz_t(), c.get_mpz_t(), b.get_mpz_t());
+    jlcs_decrypt(vk, c.get_mpz_t(), c.get_mpz_t());
+    mpz_class r = (a + b) * b % mod;
+    REQUIRE( c == r );
+}
+
+TEST_CASE( "Plaintext widths" ) {
+    jlcs_public_key *pk2 = jlcs_init_public_key();
+    jlcs_private_key *vk2 = jlcs_init_private_key();
+    mpz_class m;
+
+    /* Goldwasser-Micali is the single bit case */
+    REQUIRE( jlcs_generate_key_pair(pk2, vk2, hr, 512, 1) );
+    REQUIRE( round_trip(pk2, vk2, 0) == 0 );
+    REQUIRE( round_trip(pk2, vk2, 1) == 1 );
+
+    /* Wider than a machine word, generated over the previous key */
+    REQUIRE( jlcs_generate_key_pair(pk2, vk2, hr, 512, 100) );
+    m = "1234567890123456789012345678901";
+    REQUIRE( round_trip(pk2, vk2, m) == m );
+
+    jlcs_free_public_key(pk2);
+    jlcs_free_private_key(vk2);
+}
+
+TEST_CASE( "Key import" ) {
+    jlcs_public_key *pk2 = jlcs_init_public_key();
+    jlcs_private_key *vk2 = jlcs_init_private_key();
+
+    char *json = jlcs_export_public_key(pk);
+    REQUIRE( json != NULL );
+    REQUIRE( jlcs_import_public_key(pk2, json) );
+    free(json);
+    REQUIRE( mpz_cmp(pk2->k2, pk->k2) == 0 );
+
+    json = jlcs_export_private_key(vk);
+    REQUIRE( json != NULL );
+    REQUIRE( jlcs_import_private_key(vk2, json) );
+    /* Importing over a held key releases its table */
+    REQUIRE( jlcs_import_private_key(vk2, json) );
+    free(json);
+    REQUIRE( jlcs_verify_key_pair(pk2, vk2) );
+    REQUIRE( round_trip(pk2, vk2, 2718281828u) == 2718281828u );
+
+    REQUIRE( !jlcs_import_public_key(pk2, "{\"v\": 2, \"k\": 4}") );
+    REQUIRE( !jlcs_import_private_key(vk2, "not json") );
+
+    /* k must leave 2^k below n */
+    std::string n = mpz_class(pk->n).get_str(16);
+    std::string y = mpz_class(pk->y).get_str(16);
+    for (const char *k : { "0", "512", "4000000000000" }) {
+        std::string key = std::string("{\"v\": 2, \"k\": ") + k +
+            ", \"n\": \"" + n + "\", \"y\": \"" + y + "\"}";
+        REQUIRE( !jlcs_import_public_key(pk2, key.c_str()) );
+    }
+
+    /* y = 4 is a residue mod p, so no message could be decrypted */
+    std::string key = "{\"v\": 2, \"k\": 32, \"p\": \"" +
+        mpz_class(vk->p).get_str(16) + "\", \"q\": \"" +
+        mpz_class(vk->q).get_str(16) + "\", \"y\": \"";
+    REQUIRE( jlcs_import_private_key(vk2, (key + y + "\"}").c_str()) );
+    REQUIRE( !jlcs_import_private_key(vk2, (key + "4\"}").c_str()) );
+
+    jlcs_free_public_key(pk2);
+    jlcs_free_private_key(vk2);
+}
+
+int main(int argc, char *argv[])
+{
+    hr = hcs_init_random();
+    pk = jlcs_init_public_key();
+    vk = jlcs_init_private_key();
+    if (!jlcs_generate_key_pair(pk, vk, hr, 512, 32))
+        return 1;
+
+    int result = Catch::Session().run(argc, argv);
+
+    jlcs_free_public_key(pk);
+    jlcs_free_private_key(vk);
+    hcs_free_random(hr);
+    return result;
+}
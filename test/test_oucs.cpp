@@ -0,0 +1,132 @@
+#define CATCH_CONFIG_RUNNER
+#include "catch.hpp"
+
+#include <cstdlib>
+#include <gmpxx.h>
+#include "../include/libhcs/oucs.h"
+
+static hcs_random *hr;
+static oucs_public_key *pk;
+static oucs_private_key *vk;
+
+TEST_CASE( "Key generation" ) {
+    mpz_class t;
+
+    REQUIRE( oucs_verify_key_pair(pk, vk) );
+
+    /* n = p^2 * q and every plaintext below 2^mbits is below p */
+    t = mpz_class(vk->p) * mpz_class(vk->p) * mpz_class(vk->q);
+    REQUIRE( mpz_cmp(t.get_mpz_t(), pk->n) == 0 );
+    REQUIRE( mpz_sizeinbase(vk->p, 2) > pk->mbits );
+    REQUIRE( pk->mbits >= 170 );
+
+    mpz_powm(t.get_mpz_t(), pk->g, pk->n, pk->n);
+    REQUIRE( mpz_cmp(t.get_mpz_t(), pk->h) == 0 );
+}
+
+TEST_CASE( "Encryption/Decryption" ) {
+    mpz_class a, b, c, d, n(pk->n);
+
+#define TEST_SIMPLE(x)\
+    a = (x); d = (a);\
+    oucs_encrypt(pk, hr, a.get_mpz_t(), a.get_mpz_t());\
+    REQUIRE( a < n );\
+    oucs_decrypt(vk, a.get_mpz_t(), a.get_mpz_t());\
+    REQUIRE( a == d )
+
+    TEST_SIMPLE(0);
+    TEST_SIMPLE(5);
+    TEST_SIMPLE(1241012408124);
+    TEST_SIMPLE("22222222222222222222222222222222");
+
+    /* The largest plaintext allowed */
+    d = 1;
+    d <<= pk->mbits;
+    TEST_SIMPLE(d - 1);
+
+#define TEST_OP(op, x, y, r)\
+    a = (x); b = (y); d = (r);\
+    oucs_encrypt(pk, hr, a.get_mpz_t(), a.get_mpz_t());\
+    oucs_encrypt(pk, hr, b.get_mpz_t(), b.get_mpz_t());\
+    op;\
+    oucs_decrypt(vk, c.get_mpz_t(), c.get_mpz_t());\
+    REQUIRE( c == d )
+
+    TEST_OP(oucs_ee_add(pk, c.get_mpz_t(), a.get_mpz_t(), b.get_mpz_t()),
+            4124, 1208725, 4124 + 1208725);
+    TEST_OP(REQUIRE( oucs_ee_sub(pk, c.get_mpz_t(), a.get_mpz_t(),
+                                 b.get_mpz_t()) ),
+            1208725, 4124, 1208725 - 4124);
+    TEST_OP(oucs_reencrypt(pk, hr, c.get_mpz_t(), a.get_mpz_t()),
+            98765, 0, 98765);
+
+#undef TEST_OP
+
+    a = 1208725;
+    b = 4124;
+    oucs_encrypt(pk, hr, c.get_mpz_t(), a.get_mpz_t());
+    oucs_ep_add(pk, c.get_mpz_t(), c.get_mpz_t(), b.get_mpz_t());
+    oucs_ep_mul(pk, c.get_mpz_t(), c.get_mpz_t(), b.get_mpz_t());
+    oucs_decrypt(vk, c.get_mpz_t(), c.get_mpz_t());
+    REQUIRE( c == (a + b) * b );
+
+    /* A negation is useful inside a non-negative sum */
+    oucs_encrypt(pk, hr, c.get_mpz_t(), b.get_mpz_t());
+    REQUIRE( oucs_e_neg(pk, c.get_mpz_t(), c.get_mpz_t()) );
+    oucs_ep_add(pk, c.get_mpz_t(), c.get_mpz_t(), a.get_mpz_t());
+    oucs_decrypt(vk, c.get_mpz_t(), c.get_mpz_t());
+    REQUIRE( c == a - b );
+
+    /* A value sharing a factor with n has no inverse, leaving rop alone */
+    c = 5;
+    REQUIRE( !oucs_e_neg(pk, c.get_mpz_t(), vk->p) );
+    REQUIRE( !oucs_ee_sub(pk, c.get_mpz_t(), a.get_mpz_t(), vk->p) );
+    REQUIRE( c == 5 );
+
+#undef TEST_SIMPLE
+}
+
+TEST_CASE( "Key import" ) {
+    mpz_class a, b;
+    oucs_public_key *pk2 = oucs_init_public_key();
+    oucs_private_key *vk2 = oucs_init_private_key();
+
+    char *json = oucs_export_public_key(pk);
+    REQUIRE( json != NULL );
+    REQUIRE( oucs_import_public_key(pk2, json) );
+    free(json);
+    REQUIRE( pk2->mbits == pk->mbits );
+    REQUIRE( mpz_cmp(pk2->h, pk->h) == 0 );
+
+    json = oucs_export_private_key(vk);
+    REQUIRE( json != NULL );
+    REQUIRE( oucs_import_private_key(vk2, json) );
+    free(json);
+    REQUIRE( oucs_verify_key_pair(pk2, vk2) );
+
+    a = 31415926535;
+    oucs_encrypt(pk2, hr, b.get_mpz_t(), a.get_mpz_t());
+    oucs_decrypt(vk2, b.get_mpz_t(), b.get_mpz_t());
+    REQUIRE( a == b );
+
+    REQUIRE( !oucs_import_public_key(pk2, "{\"v\": 2}") );
+    REQUIRE( !oucs_import_private_key(vk2, "not json") );
+
+    oucs_free_public_key(pk2);
+    oucs_free_private_key(vk2);
+}
+
+int main(int argc, char *argv[])
+{
+    hr = hcs_init_random();
+    pk = oucs_init_public_key();
+    vk = oucs_init_private_key();
+    oucs_generate_key_pair(pk, vk, hr, 512);
+
+    int result = Catch::Session().run(argc, argv);
+
+    oucs_free_public_key(pk);
+    oucs_free_private_key(vk);
+    hcs_free_random(hr);
+    return result;
+}
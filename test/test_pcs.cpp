@@ -1,15 +1,28 @@
 #define CATCH_CONFIG_RUNNER
 #include "catch.hpp"
 
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <thread>
+#include <vector>
 #include <gmpxx.h>
 #include "../include/libhcs++/pcs.hpp"
+#include "../include/libhcs/hcs_encoding.h"
+#include "../include/libhcs/hcs_groupby.h"
+#include "../include/libhcs/hcs_key_cache.h"
+#include "../include/libhcs/hcs_scrub.h"
+#include "../include/libhcs/pcs_ope.h"
+#include "../include/libhcs/pcs_stream.h"
 
 static hcs::random *hr;
 static hcs::pcs::public_key *pk;
 static hcs::pcs::private_key *vk;
 
 TEST_CASE( "Encryption/Decryption") {
-    mpz_class a, b, c, d;
+    mpz_class a, b, c, d, n(pk->as_ptr()->n);
 
     /* Key pair must match */
     REQUIRE( hcs::pcs::verify_key_pair(*pk, *vk) );
@@ -74,13 +87,604 @@ TEST_CASE( "Encryption/Decryption") {
     TEST_REENCRYPT(124101284);
     TEST_REENCRYPT("22222222222222222222222222222222");
 
+#define TEST_EE_SUB(x, y)\
+    a = (x); b = (y); d = (a) - (b);\
+    if (d < 0) d += n;\
+    a = pk->encrypt(a);\
+    b = pk->encrypt(b);\
+    a = pk->ee_sub(a, b);\
+    c = vk->decrypt(a);\
+    REQUIRE( c == d )
+
+    TEST_EE_SUB(0, 0);
+    TEST_EE_SUB(5, 0);
+    TEST_EE_SUB(1208725, 4124);
+    TEST_EE_SUB(4124, 1208725);
+
+#define TEST_EP_SUB(x, y)\
+    a = (x); b = (y); d = (a) - (b);\
+    if (d < 0) d += n;\
+    a = pk->encrypt(a);\
+    a = pk->ep_sub(a, b);\
+    c = vk->decrypt(a);\
+    REQUIRE( c == d )
+
+    TEST_EP_SUB(0, 0);
+    TEST_EP_SUB(1208725, 4124);
+    TEST_EP_SUB(4124, 1208725);
+    TEST_EP_SUB(5, -7);
+
+    /* Negative scalars and scalars just below n take the inverse path */
+    a = 4124; a = pk->encrypt(a);
+    b = -3; c = pk->ep_mul(a, b); c = vk->decrypt(c);
+    REQUIRE( c == n - 4124 * 3 );
+    b = n - 1; c = pk->ep_mul(a, b); c = vk->decrypt(c);
+    REQUIRE( c == n - 4124 );
+    c = pk->e_neg(a); c = vk->decrypt(c);
+    REQUIRE( c == n - 4124 );
+
+    /* A value sharing a factor with n has no inverse */
+    b = n;
+    REQUIRE( pk->e_neg(b) == 0 );
+    REQUIRE( pk->ee_sub(a, b) == 0 );
+    c = -3;
+    REQUIRE( pk->ep_mul(b, c) == 0 );
+    REQUIRE( !pcs_ep_mul(pk->as_ptr(), c.get_mpz_t(), b.get_mpz_t(),
+                         c.get_mpz_t()) );
+    REQUIRE( c == -3 );
+
 #undef TEST_SIMPLE
 #undef TEST_EP_ADD
 #undef TEST_EE_ADD
 #undef TEST_EP_MUL
+#undef TEST_EE_SUB
+#undef TEST_EP_SUB
 #undef TEST_REENCRYPT
 }
 
+TEST_CASE( "Private key import" ) {
+    hcs::pcs::private_key vk2(*hr);
+    std::string json = vk->export_json();
+    REQUIRE( vk2.import_json(json) );
+
+    mpz_class a = 1241241, b = a;
+    a = pk->encrypt(a);
+    a = vk2.decrypt(a);
+    REQUIRE( a == b );
+}
+
+TEST_CASE( "Shared keys across threads" ) {
+    const hcs::pcs::public_key &cpk = *pk;
+    const hcs::pcs::private_key &cvk = *vk;
+    std::vector<std::thread> threads;
+    std::vector<int> ok(4, 0);
+
+    /* One key pair serves every thread, each with its own random state */
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&, i]() {
+            hcs::random thr;
+            int good = 1;
+            for (int j = 0; j < 20; ++j) {
+                mpz_class a = i * 1000 + j, b = a;
+                a = cpk.encrypt(a, thr);
+                a = cvk.decrypt(a);
+                good &= a == b;
+            }
+            ok[i] = good;
+        });
+    }
+    for (auto &t : threads)
+        t.join();
+
+    for (int i = 0; i < 4; ++i)
+        REQUIRE( ok[i] );
+}
+
+TEST_CASE( "Batch ciphertext validation" ) {
+    const unsigned long count = 9;
+    mpz_t c[count];
+    int valid[count];
+
+    for (unsigned long i = 0; i < count; ++i) {
+        mpz_init_set_ui(c[i], i);
+        pcs_encrypt(pk->as_ptr(), hr->as_ptr(), c[i], c[i]);
+    }
+
+    REQUIRE( pcs_validate_batch(pk->as_ptr(), c, count, NULL) );
+    REQUIRE( pcs_validate_batch(pk->as_ptr(), c, count, valid) );
+    for (unsigned long i = 0; i < count; ++i)
+        REQUIRE( valid[i] );
+
+    /* Share a factor with n, zero, and out of range */
+    mpz_mul(c[2], c[2], vk->as_ptr()->p);
+    mpz_mod(c[2], c[2], pk->as_ptr()->n2);
+    mpz_set_ui(c[4], 0);
+    mpz_set(c[7], pk->as_ptr()->n2);
+    mpz_mul(c[8], vk->as_ptr()->q, vk->as_ptr()->q);
+
+    REQUIRE( !pcs_validate_batch(pk->as_ptr(), c, count, NULL) );
+    REQUIRE( !pcs_validate_batch(pk->as_ptr(), c, count, valid) );
+    for (unsigned long i = 0; i < count; ++i) {
+        const bool bad = i == 2 || i == 4 || i == 7 || i == 8;
+        REQUIRE( valid[i] == !bad );
+    }
+
+    for (unsigned long i = 0; i < count; ++i)
+        mpz_clear(c[i]);
+}
+
+TEST_CASE( "Batch subtraction and negation" ) {
+    const unsigned long count = 5;
+    mpz_t c1[count], c2[count], r[count];
+    mpz_class m, n(pk->as_ptr()->n);
+
+    for (unsigned long i = 0; i < count; ++i) {
+        mpz_init_set_ui(c1[i], 100 * i + 50);
+        mpz_init_set_ui(c2[i], i);
+        mpz_init(r[i]);
+        pcs_encrypt(pk->as_ptr(), hr->as_ptr(), c1[i], c1[i]);
+        pcs_encrypt(pk->as_ptr(), hr->as_ptr(), c2[i], c2[i]);
+    }
+
+    REQUIRE( pcs_ee_sub_batch(pk->as_ptr(), r, c1, c2, count) );
+    for (unsigned long i = 0; i < count; ++i) {
+        pcs_decrypt(vk->as_ptr(), m.get_mpz_t(), r[i]);
+        REQUIRE( m == 99 * i + 50 );
+    }
+
+    /* In place */
+    REQUIRE( pcs_e_neg_batch(pk->as_ptr(), c2, c2, count) );
+    for (unsigned long i = 0; i < count; ++i) {
+        pcs_decrypt(vk->as_ptr(), m.get_mpz_t(), c2[i]);
+        REQUIRE( m == (n - i) % n );
+    }
+
+    /* A non-invertible value fails the batch and leaves rop alone */
+    mpz_set(c2[3], vk->as_ptr()->p);
+    mpz_set_ui(r[0], 7);
+    REQUIRE( !pcs_ee_sub_batch(pk->as_ptr(), r, c1, c2, count) );
+    REQUIRE( mpz_cmp_ui(r[0], 7) == 0 );
+
+    for (unsigned long i = 0; i < count; ++i)
+        mpz_clears(c1[i], c2[i], r[i], NULL);
+}
+
+TEST_CASE( "Encoded numbers" ) {
+    hcs_encoding *enc = hcs_init_encoding_pcs(pk->as_ptr());
+    hcs_encoded_number x, y;
+    hcs_encrypted_number cx, cy, cz;
+
+    REQUIRE( enc != NULL );
+    hcs_encoded_init(&x);
+    hcs_encoded_init(&y);
+    hcs_encrypted_init(&cx);
+    hcs_encrypted_init(&cy);
+    hcs_encrypted_init(&cz);
+
+    /* Round trip, including values needing a negative exponent */
+    const double values[] = { 0.0, 1.5, -2.75, 1e-9, -123456.125 };
+    for (double v : values) {
+        REQUIRE( hcs_encode_double(enc, &x, v) );
+        hcs_encrypt_encoded(enc, hr->as_ptr(), &cx, &x);
+        REQUIRE( hcs_decrypt_encoded_pcs(enc, vk->as_ptr(), &y, &cx) );
+        REQUIRE( hcs_decode_double(&y) == v );
+    }
+
+    /* Fixed point rounds to the nearest multiple of 2^exponent */
+    REQUIRE( hcs_encode_fixed(enc, &x, -0.3, -4) );
+    REQUIRE( mpz_cmp_si(x.mantissa, -5) == 0 );
+    REQUIRE( hcs_decode_double(&x) == -0.3125 );
+
+    /* Lazy alignment: adding a plaintext with a larger exponent leaves the
+     * ciphertext exponent alone, a smaller one rescales it */
+    hcs_encode_fixed(enc, &x, 1.5, -8);
+    hcs_encrypt_encoded(enc, hr->as_ptr(), &cx, &x);
+    hcs_encode_double(enc, &y, 2.0);
+    hcs_encrypted_add_encoded(enc, &cz, &cx, &y);
+    REQUIRE( cz.exponent == -8 );
+    hcs_encode_fixed(enc, &y, 0.25, -20);
+    hcs_encrypted_sub_encoded(enc, &cz, &cz, &y);
+    REQUIRE( cz.exponent == -20 );
+    hcs_decrypt_encoded_pcs(enc, vk->as_ptr(), &x, &cz);
+    REQUIRE( hcs_decode_double(&x) == 3.25 );
+
+    /* Encrypted with differing exponents, and negative products */
+    hcs_encode_double(enc, &x, 0.75);
+    hcs_encrypt_encoded(enc, hr->as_ptr(), &cx, &x);
+    hcs_encode_double(enc, &x, -5.0);
+    hcs_encrypt_encoded(enc, hr->as_ptr(), &cy, &x);
+    REQUIRE( hcs_encrypted_sub(enc, &cz, &cx, &cy) );
+    hcs_decrypt_encoded_pcs(enc, vk->as_ptr(), &x, &cz);
+    REQUIRE( hcs_decode_double(&x) == 5.75 );
+    hcs_encode_double(enc, &y, -0.5);
+    REQUIRE( hcs_encrypted_mul_encoded(enc, &cz, &cz, &y) );
+    hcs_decrypt_encoded_pcs(enc, vk->as_ptr(), &x, &cz);
+    REQUIRE( hcs_decode_double(&x) == -2.875 );
+    REQUIRE( hcs_encrypted_neg(enc, &cz, &cz) );
+    hcs_decrypt_encoded_pcs(enc, vk->as_ptr(), &x, &cz);
+    REQUIRE( hcs_decode_double(&x) == 2.875 );
+
+    /* A ciphertext sharing a factor with n cannot be inverted, and each
+     * operation needing its inverse fails without writing rop */
+    mpz_set(cy.cipher, pk->as_ptr()->n);
+    mpz_class before(cz.cipher);
+    REQUIRE( !hcs_encrypted_sub(enc, &cz, &cx, &cy) );
+    REQUIRE( !hcs_encrypted_neg(enc, &cz, &cy) );
+    REQUIRE( !hcs_encrypted_mul_encoded(enc, &cz, &cy, &y) );
+    REQUIRE( before == mpz_class(cz.cipher) );
+
+    /* Sums and batches over mixed exponents */
+    const unsigned long count = 6;
+    hcs_encrypted_number c[count], d[count];
+    double total = 0;
+    for (unsigned long i = 0; i < count; ++i) {
+        const double v = (i % 2 ? -1.0 : 1.0) * (i + 1) / (1 << i);
+        hcs_encrypted_init(&c[i]);
+        hcs_encrypted_init(&d[i]);
+        hcs_encode_double(enc, &x, v);
+        hcs_encrypt_encoded(enc, hr->as_ptr(), &c[i], &x);
+        total += v;
+    }
+
+    REQUIRE( hcs_encrypted_sum(enc, &cz, c, count) );
+    hcs_decrypt_encoded_pcs(enc, vk->as_ptr(), &x, &cz);
+    REQUIRE( hcs_decode_double(&x) == total );
+
+    hcs_encrypted_add_batch(enc, d, c, c, count);
+    hcs_encrypted_align_batch(enc, c, count);
+    for (unsigned long i = 0; i < count; ++i) {
+        REQUIRE( c[i].exponent == c[0].exponent );
+        hcs_decrypt_encoded_pcs(enc, vk->as_ptr(), &x, &c[i]);
+        hcs_decrypt_encoded_pcs(enc, vk->as_ptr(), &y, &d[i]);
+        REQUIRE( 2 * hcs_decode_double(&x) == hcs_decode_double(&y) );
+    }
+
+    for (unsigned long i = 0; i < count; ++i) {
+        hcs_encrypted_clear(&c[i]);
+        hcs_encrypted_clear(&d[i]);
+    }
+    hcs_encrypted_clear(&cx);
+    hcs_encrypted_clear(&cy);
+    hcs_encrypted_clear(&cz);
+    hcs_encoded_clear(&x);
+    hcs_encoded_clear(&y);
+    hcs_free_encoding(enc);
+}
+
+TEST_CASE( "Streaming file encryption" ) {
+    const unsigned long rows = 300;
+    FILE *plain = tmpfile(), *cipher = tmpfile(), *out = tmpfile();
+    REQUIRE( (plain && cipher && out) );
+
+    mpz_class m;
+    for (unsigned long i = 0; i < rows; ++i) {
+        m = i * 1000003;
+        gmp_fprintf(plain, i % 2 ? "%Zd\n" : "  %Zd ", m.get_mpz_t());
+    }
+
+    /* Few chunks and more workers than chunks exercise the back pressure
+     * and ordering of the pipeline */
+    rewind(plain);
+    REQUIRE( pcs_encrypt_stream(pk->as_ptr(), hr->as_ptr(), plain, cipher,
+                3, 2) );
+    rewind(cipher);
+    REQUIRE( pcs_decrypt_stream(vk->as_ptr(), cipher, out, 2, 0) );
+
+    rewind(out);
+    for (unsigned long i = 0; i < rows; ++i) {
+        REQUIRE( mpz_inp_str(m.get_mpz_t(), out, 10) != 0 );
+        REQUIRE( m == i * 1000003 );
+    }
+    REQUIRE( mpz_inp_str(m.get_mpz_t(), out, 10) == 0 );
+
+    /* Truncated ciphertexts and plaintexts outside the space are refused */
+    fflush(cipher);
+    rewind(cipher);
+    FILE *cut = tmpfile();
+    char buf[100];
+    REQUIRE( fread(buf, 1, sizeof(buf), cipher) == sizeof(buf) );
+    fwrite(buf, 1, sizeof(buf), cut);
+    rewind(cut);
+    REQUIRE( !pcs_decrypt_stream(vk->as_ptr(), cut, out, 1, 0) );
+
+    fclose(plain);
+    plain = tmpfile();
+    gmp_fprintf(plain, "1 %Zd\n", pk->as_ptr()->n);
+    rewind(plain);
+    REQUIRE( !pcs_encrypt_stream(pk->as_ptr(), hr->as_ptr(), plain, cipher,
+                1, 0) );
+
+    fclose(cut);
+    fclose(out);
+    fclose(cipher);
+    fclose(plain);
+}
+
+TEST_CASE( "Group-by aggregation" ) {
+    const unsigned long rows = 2000;
+    std::vector<unsigned long> key(rows);
+    std::vector<mpz_class> cipher(rows);
+    std::map<unsigned long, unsigned long> expect;
+
+    for (unsigned long i = 0; i < rows; ++i) {
+        /* Enough groups to grow the tables, plus an extreme key */
+        key[i] = i % 5 == 0 ? ULONG_MAX : (i * 7919) % 151;
+        mpz_class m = i % 50;
+        expect[key[i]] += i % 50;
+        pcs_encrypt(pk->as_ptr(), hr->as_ptr(), cipher[i].get_mpz_t(),
+                m.get_mpz_t());
+    }
+
+    /* An odd number of shards leaves one unpaired in the merge */
+    hcs_groupby *gb = hcs_init_groupby_pcs(pk->as_ptr(), 3);
+    REQUIRE( gb != NULL );
+    REQUIRE( hcs_groupby_shards(gb) == 3 );
+    REQUIRE( hcs_groupby_add_batch(gb, key.data(), (mpz_t*)cipher.data(),
+                rows) );
+    REQUIRE( hcs_groupby_finish(gb) );
+    REQUIRE( hcs_groupby_count(gb) == expect.size() );
+
+    mpz_class m;
+    for (const auto &e : expect) {
+        unsigned long index;
+        REQUIRE( hcs_groupby_find(gb, e.first, &index) );
+        REQUIRE( hcs_groupby_key(gb, index) == e.first );
+        pcs_decrypt(vk->as_ptr(), m.get_mpz_t(),
+                (mpz_ptr)hcs_groupby_cipher(gb, index));
+        REQUIRE( m == e.second );
+    }
+    unsigned long unused;
+    REQUIRE( !hcs_groupby_find(gb, 151, &unused) );
+
+    /* Packed decryption recovers every group with far fewer decryptions */
+    const unsigned long nbits = mpz_sizeinbase(pk->as_ptr()->n, 2);
+    const unsigned long per = (nbits - 1) / 20;
+    const unsigned long packed = hcs_groupby_packed_count(gb, 20);
+    REQUIRE( packed == (expect.size() + per - 1) / per );
+    REQUIRE( hcs_groupby_packed_count(gb, nbits) == 0 );
+    REQUIRE( !hcs_groupby_pack(gb, NULL, nbits) );
+
+    std::vector<mpz_class> pc(packed), sum(expect.size());
+    REQUIRE( hcs_groupby_pack(gb, (mpz_t*)pc.data(), 20) );
+    for (unsigned long i = 0; i < packed; ++i)
+        pcs_decrypt(vk->as_ptr(), pc[i].get_mpz_t(), pc[i].get_mpz_t());
+    REQUIRE( hcs_groupby_unpack(gb, (mpz_t*)sum.data(), (mpz_t*)pc.data(),
+                20) );
+    for (unsigned long i = 0; i < expect.size(); ++i)
+        REQUIRE( sum[i] == expect[hcs_groupby_key(gb, i)] );
+    REQUIRE( !hcs_groupby_unpack(gb, (mpz_t*)sum.data(), (mpz_t*)pc.data(),
+                nbits) );
+
+    /* Reuse after a reset, adding to a single shard directly */
+    hcs_groupby_reset(gb);
+    for (unsigned long i = 0; i < 10; ++i)
+        REQUIRE( hcs_groupby_add(gb, 1, i % 2, cipher[i].get_mpz_t()) );
+    REQUIRE( hcs_groupby_finish(gb) );
+    REQUIRE( hcs_groupby_count(gb) == 2 );
+    for (unsigned long i = 0; i < 2; ++i) {
+        pcs_decrypt(vk->as_ptr(), m.get_mpz_t(),
+                (mpz_ptr)hcs_groupby_cipher(gb, i));
+        REQUIRE( m == (hcs_groupby_key(gb, i) ? 25 : 20) );
+    }
+
+    hcs_free_groupby(gb);
+}
+
+TEST_CASE( "Oblivious polynomial evaluation and set intersection" ) {
+    const pcs_public_key *k = pk->as_ptr();
+    const unsigned long count = 40, points = 30;
+    mpz_class n(k->n), p, x;
+    mpz_t set[count], y[points], out[points];
+
+    for (unsigned long i = 0; i < count; ++i)
+        mpz_init_set_ui(set[i], 1000 + 7 * i);
+    /* Every third point is in the set */
+    for (unsigned long j = 0; j < points; ++j) {
+        mpz_init_set_ui(y[j], j % 3 ? 50000 + j : 1000 + 7 * j);
+        mpz_init(out[j]);
+    }
+
+    pcs_ope_poly *poly = pcs_ope_init_poly();
+    REQUIRE( pcs_ope_encrypt_set(k, hr->as_ptr(), poly, set, count, 0) );
+    REQUIRE( poly->buckets == count / 4 );
+
+    /* Evaluations decrypt to the plaintext product over the bucket's roots */
+    REQUIRE( pcs_ope_evaluate(k, hr->as_ptr(), poly, out, y, points) );
+    for (unsigned long j = 0; j < points; ++j) {
+        const unsigned long b = pcs_ope_bucket(y[j], poly->buckets);
+        p = 1;
+        for (unsigned long i = 0; i < count; ++i) {
+            if (pcs_ope_bucket(set[i], poly->buckets) == b)
+                p = p * (mpz_class(y[j]) - mpz_class(set[i])) % n;
+        }
+        if (p < 0) p += n;
+
+        mpz_set(x.get_mpz_t(), out[j]);
+        x = vk->decrypt(x);
+        REQUIRE( x == p );
+    }
+
+    unsigned long found = 0;
+    REQUIRE( pcs_psi_respond(k, hr->as_ptr(), poly, out, y, points) );
+    REQUIRE( pcs_psi_intersect(vk->as_ptr(), y, &found, out, points, set,
+                count) );
+    REQUIRE( found == 10 );
+    for (unsigned long j = 0; j < found; ++j) {
+        x = mpz_class(y[j]) - 1000;
+        REQUIRE( x % 21 == 0 );
+    }
+
+    pcs_ope_free_poly(poly);
+    for (unsigned long i = 0; i < count; ++i)
+        mpz_clear(set[i]);
+    for (unsigned long j = 0; j < points; ++j)
+        mpz_clears(y[j], out[j], NULL);
+}
+
+TEST_CASE( "Prime pool key generation" ) {
+    const mp_bitcnt_t bits = hcs_prime_pool_bits_for_key(512);
+    const char *path = "test_pcs_prime_pool.tmp";
+    hcs::pcs::public_key pk2(*hr);
+    hcs::pcs::private_key vk2(*hr);
+
+    hcs_prime_pool *pool = hcs_init_prime_pool(bits, 0, 4);
+    REQUIRE( pool != NULL );
+    REQUIRE( hcs_prime_pool_bits(pool) == bits );
+    REQUIRE( !hcs_prime_pool_safe(pool) );
+
+    hcs_prime_pool_fill(pool, hr->as_ptr(), 4);
+    REQUIRE( hcs_prime_pool_count(pool) == 4 );
+
+    /* Round trip through a saved file */
+    REQUIRE( hcs_prime_pool_save(pool, path) );
+    hcs_prime_pool *loaded = hcs_init_prime_pool(bits, 0, 4);
+    REQUIRE( hcs_prime_pool_load(loaded, path) );
+    REQUIRE( hcs_prime_pool_count(loaded) == 4 );
+    hcs_free_prime_pool(loaded);
+    std::remove(path);
+
+    pcs_generate_key_pair_pool(pk2.as_ptr(), vk2.as_ptr(), hr->as_ptr(),
+                               pool, 512);
+    REQUIRE( hcs_prime_pool_count(pool) == 2 );
+
+    mpz_class a = 1241241, b = a;
+    a = pk2.encrypt(a);
+    a = vk2.decrypt(a);
+    REQUIRE( a == b );
+
+    /* The background thread refills the pool after primes are taken */
+    hcs_prime_pool_take(pool, a.get_mpz_t(), NULL);
+    REQUIRE( hcs_prime_pool_start(pool) );
+    for (int i = 0; i < 1000 && hcs_prime_pool_count(pool) < 4; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    hcs_prime_pool_stop(pool);
+    REQUIRE( hcs_prime_pool_count(pool) == 4 );
+
+    hcs_free_prime_pool(pool);
+}
+
+TEST_CASE( "Scrubbing a private key" ) {
+    const hcs_scrub_policy saved = hcs_get_scrub_policy();
+    hcs::pcs::public_key pk2(*hr);
+    hcs::pcs::private_key vk2(*hr);
+    hcs::pcs::generate_key_pair(pk2, vk2, 512);
+    pcs_private_key *k = vk2.as_ptr();
+
+    /* Under SECRET, the limbs of p are overwritten while n is only reset,
+     * and the public key is left as it was */
+    hcs_set_scrub_policy(HCS_SCRUB_SECRET);
+    const mpz_class n(pk2.as_ptr()->n), g(pk2.as_ptr()->g);
+    const mp_limb_t *p_limbs = k->p->_mp_d, *n_limbs = k->n->_mp_d;
+    const int p_size = mpz_size(k->p), n_size = mpz_size(k->n);
+    const mp_limb_t n_top = n_limbs[n_size - 1];
+
+    pcs_clear_private_key(k);
+    REQUIRE( mpz_sgn(k->p) == 0 );
+    REQUIRE( mpz_sgn(k->n) == 0 );
+    for (int i = 0; i < p_size; ++i)
+        REQUIRE( p_limbs[i] == 0 );
+    /* Resetting n to zero writes only its lowest limb */
+    REQUIRE( n_size > 1 );
+    REQUIRE( n_limbs[n_size - 1] == n_top );
+
+    REQUIRE( mpz_cmp(pk2.as_ptr()->n, n.get_mpz_t()) == 0 );
+    REQUIRE( mpz_cmp(pk2.as_ptr()->g, g.get_mpz_t()) == 0 );
+
+    hcs_set_scrub_policy(saved);
+}
+
+TEST_CASE( "JSON encodings" ) {
+    pcs_public_key *pk2 = pcs_init_public_key();
+    pcs_private_key *vk2 = pcs_init_private_key();
+
+    /* Current exports are versioned and hexadecimal */
+    char *json = pcs_export_public_key(pk->as_ptr());
+    REQUIRE( json != NULL );
+    REQUIRE( strstr(json, "\"v\":2") != NULL );
+    char *hex = mpz_get_str(NULL, 16, pk->as_ptr()->n);
+    REQUIRE( strstr(json, hex) != NULL );
+    REQUIRE( pcs_import_public_key(pk2, json) );
+    REQUIRE( mpz_cmp(pk2->n2, pk->as_ptr()->n2) == 0 );
+    free(hex);
+    free(json);
+
+    /* Unversioned base 62 objects from earlier versions are still read */
+    char *n = mpz_get_str(NULL, 62, pk->as_ptr()->n);
+    std::string legacy = std::string("{\"n\":\"") + n + "\"}";
+    mpz_set_ui(pk2->n, 0);
+    REQUIRE( pcs_import_public_key(pk2, legacy.c_str()) );
+    REQUIRE( mpz_cmp(pk2->n, pk->as_ptr()->n) == 0 );
+    free(n);
+
+    char *p = mpz_get_str(NULL, 62, vk->as_ptr()->p);
+    char *q = mpz_get_str(NULL, 62, vk->as_ptr()->q);
+    legacy = std::string("{\"p\":\"") + p + "\",\"q\":\"" + q + "\"}";
+    REQUIRE( pcs_import_private_key(vk2, legacy.c_str()) );
+    REQUIRE( mpz_cmp(vk2->n, vk->as_ptr()->n) == 0 );
+    free(p);
+    free(q);
+
+    /* Unknown versions, missing fields and bad digits are refused */
+    REQUIRE( !pcs_import_public_key(pk2, "{\"v\":3,\"n\":\"ff\"}") );
+    REQUIRE( !pcs_import_public_key(pk2, "{\"v\":2}") );
+    REQUIRE( !pcs_import_public_key(pk2, "{\"v\":2,\"n\":\"xyz\"}") );
+    REQUIRE( !pcs_import_private_key(vk2, "{\"v\":2,\"p\":\"b\"}") );
+    REQUIRE( !pcs_import_private_key(vk2, "[]") );
+
+    pcs_free_public_key(pk2);
+    pcs_free_private_key(vk2);
+}
+
+TEST_CASE( "Key cache" ) {
+    const std::string json = pk->export_json();
+    hcs_key_cache *cache = hcs_init_key_cache(1 << 20);
+
+    REQUIRE( hcs_key_cache_get(cache, HCS_KEY_PCS, "{}") == NULL );
+    REQUIRE( hcs_key_cache_get(cache, HCS_KEY_PCS, "not json") == NULL );
+
+    hcs_cached_key *k1 = hcs_key_cache_get(cache, HCS_KEY_PCS, json.c_str());
+    hcs_cached_key *k2 = hcs_key_cache_get(cache, HCS_KEY_PCS, json.c_str());
+    REQUIRE( k1 != NULL );
+    REQUIRE( k1 == k2 );
+    REQUIRE( hcs_key_cache_count(cache) == 1 );
+    REQUIRE( mpz_cmp(k1->key.pcs->n2, pk->as_ptr()->n2) == 0 );
+
+    /* Concurrent lookups share the single entry */
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&]() {
+            for (int j = 0; j < 100; ++j)
+                hcs_key_cache_release(
+                    hcs_key_cache_get(cache, HCS_KEY_PCS, json.c_str()));
+        });
+    }
+    for (auto &t : threads)
+        t.join();
+    REQUIRE( hcs_key_cache_count(cache) == 1 );
+
+    hcs_key_cache_release(k1);
+    hcs_key_cache_release(k2);
+    hcs_free_key_cache(cache);
+
+    /* With no budget each shard keeps only its newest key, but evicted keys
+     * stay usable while referenced */
+    cache = hcs_init_key_cache(0);
+    k1 = hcs_key_cache_get(cache, HCS_KEY_PCS, json.c_str());
+    for (int i = 0; i < 64; ++i) {
+        std::string variant = std::string(i, ' ') + json;
+        hcs_key_cache_release(
+            hcs_key_cache_get(cache, HCS_KEY_PCS, variant.c_str()));
+    }
+    REQUIRE( hcs_key_cache_count(cache) <= 16 );
+    hcs_free_key_cache(cache);
+
+    mpz_class a = 1241241, b = a;
+    pcs_encrypt(k1->key.pcs, hr->as_ptr(), a.get_mpz_t(), a.get_mpz_t());
+    a = vk->decrypt(a);
+    REQUIRE( a == b );
+    hcs_key_cache_release(k1);
+}
+
 int main(int argc, char *argv[])
 {
     hr = new hcs::random();
@@ -0,0 +1,571 @@
+#define CATCH_CONFIG_RUNNER
+#include "catch.hpp"
+
+#include <cstdio>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gmpxx.h>
+#include "../include/libhcs.h"
+#include "../include/libhcs++/pcs_t.hpp"
+
+static hcs_random *hr;
+static pcs_t_public_key *pk;
+static pcs_t_private_key *vk;
+
+TEST_CASE( "n^s protocol" ) {
+    mpz_class c, r, zero = 0;
+    pcs_t_proof *pf = pcs_t_init_proof();
+
+    pcs_t_r_encrypt(pk, hr, c.get_mpz_t(), r.get_mpz_t(), zero.get_mpz_t());
+    pcs_t_compute_ns_protocol(pk, hr, pf, c.get_mpz_t(), r.get_mpz_t(), 5);
+    REQUIRE( pcs_t_verify_ns_protocol(pk, pf, 5) );
+    REQUIRE( !pcs_t_verify_ns_protocol(pk, pf, 6) );
+
+    pcs_t_free_proof(pf);
+}
+
+TEST_CASE( "1of2 n^s protocol" ) {
+    mpz_class c, r, m;
+    pcs_t_proof *pf = pcs_t_init_proof();
+
+    for (unsigned long power = 0; power < 2; ++power) {
+        mpz_pow_ui(m.get_mpz_t(), pf->generator, power);
+        pcs_t_r_encrypt(pk, hr, c.get_mpz_t(), r.get_mpz_t(), m.get_mpz_t());
+        pcs_t_compute_1of2_ns_protocol(pk, hr, pf, c.get_mpz_t(),
+                r.get_mpz_t(), power, 17);
+        REQUIRE( pcs_t_verify_1of2_ns_protocol(pk, pf, c.get_mpz_t(), 17) );
+        REQUIRE( !pcs_t_verify_1of2_ns_protocol(pk, pf, c.get_mpz_t(), 18) );
+    }
+
+    pcs_t_free_proof(pf);
+}
+
+TEST_CASE( "Proof and auth server JSON" ) {
+    mpz_class c, r, m = 1;
+    pcs_t_proof *pf = pcs_t_init_proof();
+    pcs_t_proof *pf2 = pcs_t_init_proof();
+
+    pcs_t_r_encrypt(pk, hr, c.get_mpz_t(), r.get_mpz_t(), m.get_mpz_t());
+    pcs_t_compute_1of2_ns_protocol(pk, hr, pf, c.get_mpz_t(), r.get_mpz_t(),
+            0, 3);
+    REQUIRE( pcs_t_verify_1of2_ns_protocol(pk, pf, c.get_mpz_t(), 3) );
+    REQUIRE( mpz_cmp(pf->e[0], pf->e[1]) != 0 );
+
+    char *json = pcs_t_export_proof(pf);
+    REQUIRE( json != NULL );
+    REQUIRE( pcs_t_import_proof(pf2, json) == 0 );
+    free(json);
+    REQUIRE( mpz_cmp(pf2->e[0], pf->e[0]) == 0 );
+    REQUIRE( mpz_cmp(pf2->e[1], pf->e[1]) == 0 );
+    REQUIRE( mpz_cmp(pf2->z[1], pf->z[1]) == 0 );
+    REQUIRE( pcs_t_verify_1of2_ns_protocol(pk, pf2, c.get_mpz_t(), 3) );
+    REQUIRE( pcs_t_import_proof(pf2, "{\"v\":2,\"e1\":\"1\"}") != 0 );
+
+    pcs_t_public_key *pk2 = pcs_t_init_public_key();
+    json = pcs_t_export_public_key(pk);
+    REQUIRE( pcs_t_import_public_key(pk2, json) == 0 );
+    free(json);
+    REQUIRE( pk2->w == pk->w );
+    REQUIRE( pk2->l == pk->l );
+    REQUIRE( mpz_cmp(pk2->delta, pk->delta) == 0 );
+    REQUIRE( pcs_t_import_public_key(pk2,
+                "{\"n\":\"zz\",\"w\":6,\"l\":5}") != 0 );
+
+    /* Legacy objects carry no version and use base 62 */
+    char *n = mpz_get_str(NULL, 62, pk->n);
+    std::string legacy = std::string("{\"n\":\"") + n +
+                         "\",\"w\":3,\"l\":5}";
+    REQUIRE( pcs_t_import_public_key(pk2, legacy.c_str()) == 0 );
+    REQUIRE( mpz_cmp(pk2->n2, pk->n2) == 0 );
+    free(n);
+
+    pcs_t_auth_server *au = pcs_t_init_auth_server();
+    pcs_t_auth_server *au2 = pcs_t_init_auth_server();
+    mpz_set_ui(r.get_mpz_t(), 123456789);
+    pcs_t_set_auth_server(au, r.get_mpz_t(), 2);
+    json = pcs_t_export_auth_server(au);
+    REQUIRE( pcs_t_import_auth_server(au2, json) == 0 );
+    free(json);
+    REQUIRE( au2->i == au->i );
+    REQUIRE( mpz_cmp(au2->si, au->si) == 0 );
+    REQUIRE( pcs_t_import_auth_server(au2, "{\"si\":\"1\"}") != 0 );
+
+    pcs_t_free_auth_server(au);
+    pcs_t_free_auth_server(au2);
+    pcs_t_free_public_key(pk2);
+    pcs_t_free_proof(pf2);
+    pcs_t_free_proof(pf);
+}
+
+TEST_CASE( "Incremental share combination" ) {
+    mpz_class m = 123456789, c, si, r;
+    std::vector<mpz_class> share(pk->l);
+    std::vector<pcs_t_auth_server*> au(pk->l);
+
+    pcs_t_polynomial *px = pcs_t_init_polynomial(vk, hr);
+    pcs_t_encrypt(pk, hr, c.get_mpz_t(), m.get_mpz_t());
+    for (unsigned long i = 0; i < pk->l; ++i) {
+        au[i] = pcs_t_init_auth_server();
+        pcs_t_compute_polynomial(vk, px, si.get_mpz_t(), i);
+        pcs_t_set_auth_server(au[i], si.get_mpz_t(), i);
+        pcs_t_share_decrypt(pk, au[i], share[i].get_mpz_t(), c.get_mpz_t());
+    }
+    pcs_t_free_polynomial(px);
+
+    /* Batch combination over a strict subset */
+    hcs_shares *hs = hcs_init_shares(pk->l);
+    for (unsigned long i = 0; i < pk->l; ++i) {
+        hcs_set_share(hs, share[i].get_mpz_t(), i);
+        if (i == 0 || i == 2)
+            hcs_clear_flag(hs, i);
+    }
+    REQUIRE( pcs_t_share_combine(pk, r.get_mpz_t(), hs) );
+    REQUIRE( r == m );
+    hcs_free_shares(hs);
+
+    /* Fixed quorum, with shares arriving out of order */
+    const unsigned long quorum[] = { 4, 0, 2 };
+    pcs_t_combiner *cb = pcs_t_init_combiner(pk, quorum);
+    REQUIRE( cb != NULL );
+    REQUIRE( !pcs_t_combiner_result(pk, cb, r.get_mpz_t()) );
+    REQUIRE( !pcs_t_combiner_add(cb, 2, share[2].get_mpz_t()) );
+    REQUIRE( !pcs_t_combiner_add(cb, 1, share[1].get_mpz_t()) );
+    REQUIRE( !pcs_t_combiner_add(cb, 2, share[2].get_mpz_t()) );
+    REQUIRE( !pcs_t_combiner_add(cb, 4, share[4].get_mpz_t()) );
+    REQUIRE( pcs_t_combiner_add(cb, 0, share[0].get_mpz_t()) );
+    REQUIRE( pcs_t_combiner_result(pk, cb, r.get_mpz_t()) );
+    REQUIRE( r == m );
+
+    /* The quorum is kept across a reset, and shares may arrive from
+     * several threads */
+    pcs_t_combiner_reset(cb);
+    std::vector<std::thread> threads;
+    for (unsigned long i = 0; i < pk->l; ++i)
+        threads.emplace_back([&, i] {
+            pcs_t_combiner_add(cb, i, share[i].get_mpz_t());
+        });
+    for (std::thread &t : threads)
+        t.join();
+    REQUIRE( pcs_t_combiner_result(pk, cb, r.get_mpz_t()) );
+    REQUIRE( r == m );
+    pcs_t_free_combiner(cb);
+
+    /* Adaptive quorum formed by the first arrivals */
+    cb = pcs_t_init_combiner(pk, NULL);
+    REQUIRE( !pcs_t_combiner_add(cb, 3, share[3].get_mpz_t()) );
+    REQUIRE( !pcs_t_combiner_add(cb, 3, share[3].get_mpz_t()) );
+    REQUIRE( !pcs_t_combiner_add(cb, 1, share[1].get_mpz_t()) );
+    REQUIRE( pcs_t_combiner_add(cb, 4, share[4].get_mpz_t()) );
+    REQUIRE( pcs_t_combiner_add(cb, 0, share[0].get_mpz_t()) );
+    REQUIRE( pcs_t_combiner_result(pk, cb, r.get_mpz_t()) );
+    REQUIRE( r == m );
+    pcs_t_free_combiner(cb);
+
+    /* Invalid quorums */
+    const unsigned long repeated[] = { 1, 1, 2 }, range[] = { 0, 1, 5 };
+    REQUIRE( pcs_t_init_combiner(pk, repeated) == NULL );
+    REQUIRE( pcs_t_init_combiner(pk, range) == NULL );
+
+    for (pcs_t_auth_server *a : au)
+        pcs_t_free_auth_server(a);
+}
+
+TEST_CASE( "Share matrix" ) {
+    const unsigned long count = 6;
+    mpz_class c, si;
+    std::vector<pcs_t_auth_server*> au(pk->l);
+    std::vector<mpz_class> m(count), share(count * pk->l);
+
+    pcs_t_polynomial *px = pcs_t_init_polynomial(vk, hr);
+    for (unsigned long i = 0; i < pk->l; ++i) {
+        au[i] = pcs_t_init_auth_server();
+        pcs_t_compute_polynomial(vk, px, si.get_mpz_t(), i);
+        pcs_t_set_auth_server(au[i], si.get_mpz_t(), i);
+    }
+    pcs_t_free_polynomial(px);
+
+    for (unsigned long r = 0; r < count; ++r) {
+        m[r] = 1000 * r + 7;
+        pcs_t_encrypt(pk, hr, c.get_mpz_t(), m[r].get_mpz_t());
+        for (unsigned long i = 0; i < pk->l; ++i)
+            pcs_t_share_decrypt(pk, au[i],
+                    share[r * pk->l + i].get_mpz_t(), c.get_mpz_t());
+    }
+
+    /* No space is reserved, so the arena grows as shares are set */
+    hcs_shares *hs = hcs_init_shares_batch(pk->l, count, 0);
+    REQUIRE( hs != NULL );
+    REQUIRE( hcs_count_flags(hs) == 0 );
+    REQUIRE( hcs_next_flag(hs, 0) == pk->l );
+
+    for (unsigned long r = 0; r < count; ++r)
+        for (unsigned long i = 0; i < pk->l; ++i)
+            REQUIRE( hcs_set_batch_share(hs, share[r * pk->l + i].get_mpz_t(),
+                        r, i) );
+
+    mpz_t view;
+    for (unsigned long k = 0; k < count * pk->l; ++k) {
+        REQUIRE( mpz_cmp(hcs_get_share(hs, view, k / pk->l, k % pk->l),
+                    share[k].get_mpz_t()) == 0 );
+    }
+
+    REQUIRE( hcs_count_flags(hs) == pk->l );
+    hcs_clear_flag(hs, 1);
+    hcs_clear_flag(hs, 3);
+    REQUIRE( hcs_count_flags(hs) == pk->l - 2 );
+    REQUIRE( hcs_next_flag(hs, 1) == 2 );
+    REQUIRE( hcs_next_flag(hs, 3) == 4 );
+
+    std::vector<mpz_class> plain(count);
+    REQUIRE( pcs_t_share_combine_batch(pk, (mpz_t*)&plain[0], hs) );
+    for (unsigned long r = 0; r < count; ++r)
+        REQUIRE( plain[r] == m[r] );
+
+    /* Refill with another quorum without reinitialising */
+    hcs_reset_shares(hs);
+    REQUIRE( hcs_count_flags(hs) == 0 );
+    for (unsigned long r = 0; r < count; ++r)
+        for (unsigned long i = 2; i < pk->l; ++i)
+            hcs_set_batch_share(hs, share[r * pk->l + i].get_mpz_t(), r, i);
+    REQUIRE( hcs_next_flag(hs, 0) == 2 );
+
+    for (unsigned long r = 0; r < count; ++r)
+        plain[r] = 0;
+    REQUIRE( pcs_t_share_combine_batch(pk, (mpz_t*)&plain[0], hs) );
+    for (unsigned long r = 0; r < count; ++r)
+        REQUIRE( plain[r] == m[r] );
+
+    /* Fewer than w shares cannot be combined */
+    hcs_clear_flag(hs, 2);
+    REQUIRE( !pcs_t_share_combine_batch(pk, (mpz_t*)&plain[0], hs) );
+    REQUIRE( !pcs_t_share_combine(pk, plain[0].get_mpz_t(), hs) );
+    hcs_free_shares(hs);
+
+    for (pcs_t_auth_server *a : au)
+        pcs_t_free_auth_server(a);
+}
+
+struct tally_servers {
+    std::vector<pcs_t_auth_server*> au;
+    std::vector<mpz_class> result;
+    std::vector<unsigned long> count;
+};
+
+static void decrypt_race(void *arg, unsigned long race, mpz_t cipher,
+                         unsigned long count)
+{
+    tally_servers *ts = (tally_servers*)arg;
+    hcs_shares *hs = hcs_init_shares(pk->l);
+    mpz_class share;
+
+    for (unsigned long i = 0; i < pk->l; ++i) {
+        pcs_t_share_decrypt(pk, ts->au[i], share.get_mpz_t(), cipher);
+        hcs_set_share(hs, share.get_mpz_t(), i);
+    }
+
+    ts->result.resize(race + 1);
+    ts->count.resize(race + 1);
+    pcs_t_share_combine(pk, ts->result[race].get_mpz_t(), hs);
+    ts->count[race] = count;
+    hcs_free_shares(hs);
+}
+
+TEST_CASE( "Streaming tally" ) {
+    const unsigned long races = 3, ballots = 30;
+    mpz_class c, r, m, si, expect[races];
+    pcs_t_proof *pf = pcs_t_init_proof();
+    tally_servers ts;
+
+    pcs_t_polynomial *px = pcs_t_init_polynomial(vk, hr);
+    for (unsigned long i = 0; i < pk->l; ++i) {
+        ts.au.push_back(pcs_t_init_auth_server());
+        pcs_t_compute_polynomial(vk, px, si.get_mpz_t(), i);
+        pcs_t_set_auth_server(ts.au[i], si.get_mpz_t(), i);
+    }
+    pcs_t_free_polynomial(px);
+
+    FILE *f = tmpfile();
+    REQUIRE( f != NULL );
+
+    for (unsigned long i = 0; i < ballots; ++i) {
+        const unsigned long race = i % races, vote = (i / races) % 2;
+        mpz_pow_ui(m.get_mpz_t(), pf->generator, vote);
+        pcs_t_r_encrypt(pk, hr, c.get_mpz_t(), r.get_mpz_t(), m.get_mpz_t());
+        pcs_t_compute_1of2_ns_protocol(pk, hr, pf, c.get_mpz_t(),
+                r.get_mpz_t(), vote, i);
+        REQUIRE( pcs_t_tally_write_ballot(f, race, i, c.get_mpz_t(), pf) );
+        expect[race] += m;
+    }
+
+    /* A proof bound to another voter, an unknown race and a replay of the
+     * last ballot */
+    REQUIRE( pcs_t_tally_write_ballot(f, 0, ballots + 1, c.get_mpz_t(), pf) );
+    REQUIRE( pcs_t_tally_write_ballot(f, races, ballots - 1, c.get_mpz_t(),
+                pf) );
+    REQUIRE( pcs_t_tally_write_ballot(f, (ballots - 1) % races, ballots - 1,
+                c.get_mpz_t(), pf) );
+
+    /* A small depth forces the reader to wait on the later stages */
+    pcs_t_tally *tally = pcs_t_init_tally(pk, pf->generator, races, 2, 3);
+    REQUIRE( tally != NULL );
+
+    rewind(f);
+    REQUIRE( pcs_t_tally_run(tally, f, decrypt_race, &ts) );
+    REQUIRE( pcs_t_tally_rejected(tally) == 3 );
+    REQUIRE( ts.result.size() == races );
+    for (unsigned long k = 0; k < races; ++k) {
+        REQUIRE( pcs_t_tally_accepted(tally, k) == ballots / races );
+        REQUIRE( ts.count[k] == ballots / races );
+        REQUIRE( ts.result[k] == expect[k] );
+    }
+
+    /* A truncated stream is reported and produces no requests */
+    fseek(f, 0, SEEK_END);
+    fprintf(f, "0 1 zz");
+    rewind(f);
+    ts.result.clear();
+    REQUIRE( !pcs_t_tally_run(tally, f, decrypt_race, &ts) );
+    REQUIRE( ts.result.empty() );
+
+    fclose(f);
+    pcs_t_free_tally(tally);
+    for (pcs_t_auth_server *au : ts.au)
+        pcs_t_free_auth_server(au);
+    pcs_t_free_proof(pf);
+}
+
+static std::vector<pcs_t_auth_server*> init_auth_servers()
+{
+    std::vector<pcs_t_auth_server*> au(pk->l);
+    pcs_t_polynomial *px = pcs_t_init_polynomial(vk, hr);
+    mpz_class si;
+
+    for (unsigned long i = 0; i < pk->l; ++i) {
+        au[i] = pcs_t_init_auth_server();
+        pcs_t_compute_polynomial(vk, px, si.get_mpz_t(), i);
+        pcs_t_set_auth_server(au[i], si.get_mpz_t(), i);
+    }
+
+    pcs_t_free_polynomial(px);
+    return au;
+}
+
+static void check_coordinator(pcs_t_coordinator *co, unsigned long count)
+{
+    std::vector<mpz_class> m(count), c(count), r(count);
+
+    for (unsigned long j = 0; j < count; ++j) {
+        m[j] = j * 7919 + 3;
+        pcs_t_encrypt(pk, hr, c[j].get_mpz_t(), m[j].get_mpz_t());
+    }
+
+    REQUIRE( pcs_t_coordinator_decrypt(co, (mpz_t*)r.data(),
+                (mpz_t*)c.data(), count) );
+    for (unsigned long j = 0; j < count; ++j)
+        REQUIRE( r[j] == m[j] );
+}
+
+TEST_CASE( "Coordinated decryption over in-process transports" ) {
+    std::vector<pcs_t_auth_server*> au = init_auth_servers();
+    std::vector<hcs_transport*> near(pk->l), far(pk->l);
+    std::vector<std::thread> threads;
+
+    for (unsigned long i = 0; i < pk->l; ++i) {
+        REQUIRE( hcs_init_transport_pair(&near[i], &far[i]) );
+        threads.emplace_back([&, i] { pcs_t_serve(pk, au[i], far[i]); });
+    }
+
+    /* Servers drop any batch over 65536, so it is refused up front */
+    REQUIRE( pcs_t_init_coordinator(pk, near.data(), pk->l, 65537, 2)
+                == NULL );
+
+    pcs_t_coordinator *co = pcs_t_init_coordinator(pk, near.data(), pk->l,
+                                                   4, 2);
+    REQUIRE( co != NULL );
+    check_coordinator(co, 19);
+    check_coordinator(co, 1);
+
+    /* Decryption continues while w servers remain */
+    hcs_transport_shutdown(far[0]);
+    hcs_transport_shutdown(far[3]);
+    check_coordinator(co, 9);
+    REQUIRE( pcs_t_coordinator_live(co) == pk->l - 2 );
+
+    hcs_transport_shutdown(far[1]);
+    mpz_class c[1] = { 1 }, r[1];
+    REQUIRE( !pcs_t_coordinator_decrypt(co, (mpz_t*)r, (mpz_t*)c, 1) );
+
+    pcs_t_free_coordinator(co);
+    for (std::thread &t : threads)
+        t.join();
+    for (unsigned long i = 0; i < pk->l; ++i) {
+        hcs_free_transport(near[i]);
+        hcs_free_transport(far[i]);
+        pcs_t_free_auth_server(au[i]);
+    }
+}
+
+TEST_CASE( "Coordinated decryption over UNIX sockets" ) {
+    const char *path = "pcs_t_coord_test.sock";
+    std::vector<pcs_t_auth_server*> au = init_auth_servers();
+    std::vector<hcs_transport*> near(pk->l), far(pk->l);
+    std::vector<std::thread> threads;
+
+    int fd = hcs_listen_unix(path, pk->l);
+    REQUIRE( fd >= 0 );
+
+    for (unsigned long i = 0; i < pk->l; ++i) {
+        near[i] = hcs_connect_unix(path);
+        REQUIRE( near[i] != NULL );
+        far[i] = hcs_accept_unix(fd);
+        REQUIRE( far[i] != NULL );
+        threads.emplace_back([&, i] { pcs_t_serve(pk, au[i], far[i]); });
+    }
+
+    pcs_t_coordinator *co = pcs_t_init_coordinator(pk, near.data(), pk->l,
+                                                   0, 0);
+    REQUIRE( co != NULL );
+    check_coordinator(co, 600);
+
+    pcs_t_free_coordinator(co);
+    for (std::thread &t : threads)
+        t.join();
+    for (unsigned long i = 0; i < pk->l; ++i) {
+        hcs_free_transport(near[i]);
+        hcs_free_transport(far[i]);
+        pcs_t_free_auth_server(au[i]);
+    }
+    close(fd);
+    remove(path);
+}
+
+TEST_CASE( "Prime pool key generation" ) {
+    pcs_t_public_key *pk2 = pcs_t_init_public_key();
+    pcs_t_private_key *vk2 = pcs_t_init_private_key();
+    hcs_prime_pool *pool =
+        hcs_init_prime_pool(hcs_prime_pool_bits_for_key(256), 1, 2);
+
+    hcs_prime_pool_fill(pool, hr, 2);
+    REQUIRE( pcs_t_generate_key_pair_pool(pk2, vk2, hr, pool, 256, 3, 5) );
+    REQUIRE( hcs_prime_pool_count(pool) == 0 );
+    REQUIRE( pcs_t_verify_key_pair(pk2, vk2) );
+
+    /* Only a pool of safe primes is usable */
+    hcs_prime_pool *plain =
+        hcs_init_prime_pool(hcs_prime_pool_bits_for_key(256), 0, 2);
+    hcs_prime_pool_fill(plain, hr, 2);
+    pcs_t_clear_private_key(vk2);
+    REQUIRE( pcs_t_generate_key_pair_pool(pk2, vk2, hr, plain, 256, 3, 5) );
+    REQUIRE( hcs_prime_pool_count(plain) == 2 );
+
+    hcs_free_prime_pool(plain);
+    hcs_free_prime_pool(pool);
+    pcs_t_free_public_key(pk2);
+    pcs_t_free_private_key(vk2);
+}
+
+TEST_CASE( "Prime pool files" ) {
+    const mp_bitcnt_t bits = hcs_prime_pool_bits_for_key(256);
+    hcs_prime_pool *pool = hcs_init_prime_pool(bits, 0, 2);
+    hcs_prime_pool *loaded = hcs_init_prime_pool(bits, 0, 2);
+    char path[] = "/tmp/hcs_pool_XXXXXX";
+    int fd = mkstemp(path);
+    REQUIRE( fd != -1 );
+    close(fd);
+    chmod(path, 0644);
+
+    hcs_prime_pool_fill(pool, hr, 2);
+    REQUIRE( hcs_prime_pool_save(pool, path) );
+    struct stat st;
+    REQUIRE( stat(path, &st) == 0 );
+    REQUIRE( (st.st_mode & 0777) == 0600 );
+    REQUIRE( hcs_prime_pool_load(loaded, path) );
+    REQUIRE( hcs_prime_pool_count(loaded) == 2 );
+
+    /* A small prime in an edited file is refused */
+    FILE *fp = fopen(path, "w");
+    REQUIRE( fp != NULL );
+    fprintf(fp, "hcs_prime_pool %lu 0\n7\n", (unsigned long)bits);
+    fclose(fp);
+    hcs_free_prime_pool(loaded);
+    loaded = hcs_init_prime_pool(bits, 0, 2);
+    REQUIRE( !hcs_prime_pool_load(loaded, path) );
+    REQUIRE( hcs_prime_pool_count(loaded) == 0 );
+
+    remove(path);
+    hcs_free_prime_pool(loaded);
+    hcs_free_prime_pool(pool);
+}
+
+TEST_CASE( "C++ wrapper" ) {
+    hcs::random r;
+    hcs::pcs_t::public_key pk2(r);
+    hcs::pcs_t::private_key vk2(r);
+    mpz_class a = 20, b = 7, c, d;
+
+    REQUIRE( hcs::pcs_t::generate_key_pair(pk2, vk2, 256, 5, 3) );
+    REQUIRE( pk2.as_ptr()->l == 5 );
+    REQUIRE( pk2.as_ptr()->w == 3 );
+    REQUIRE( hcs::pcs_t::verify_key_pair(pk2, vk2) );
+
+    const hcs::pcs_t::public_key &cpk = pk2;
+    a = cpk.encrypt(a);
+    d = cpk.encrypt(b, r);
+    c = cpk.ee_add(a, d);
+    c = cpk.ep_add(c, b);
+    c = cpk.ep_mul(c, b);
+    c = cpk.ee_sub(c, d);
+    c = cpk.ep_sub(c, b);
+    d = cpk.e_neg(d);
+    c = cpk.ee_add(c, d);
+    c = cpk.reencrypt(c);
+
+    hcs_shares *hs = hcs_init_shares(pk2.as_ptr()->l);
+    {
+        hcs::pcs_t::polynomial px(vk2);
+        REQUIRE( px.as_ptr() != NULL );
+        for (unsigned long i = 0; i < pk2.as_ptr()->l; ++i) {
+            mpz_class si = px.compute(vk2, i);
+            hcs::pcs_t::auth_server au(si, i);
+            std::string json = au.export_json();
+            au.import_json(json);
+            d = au.share_decrypt(pk2, c);
+            hcs_set_share(hs, d.get_mpz_t(), i);
+        }
+    }
+
+    REQUIRE( cpk.share_combine(hs) == (20 + 7 + 7) * 7 - 7 - 7 - 7 );
+    hcs_clear_flag(hs, 0);
+    hcs_clear_flag(hs, 1);
+    hcs_clear_flag(hs, 2);
+    REQUIRE( cpk.share_combine(hs) == 0 );
+    hcs_free_shares(hs);
+
+    /* A value sharing a factor with n has no inverse */
+    a = mpz_class(pk2.as_ptr()->n);
+    b = -1;
+    REQUIRE( cpk.ep_mul(a, b) == 0 );
+
+    hcs::pcs_t::public_key pk3(r);
+    std::string json = cpk.export_json();
+    REQUIRE( pk3.import_json(json) );
+    REQUIRE( mpz_cmp(pk3.as_ptr()->n, pk2.as_ptr()->n) == 0 );
+}
+
+int main(int argc, char *argv[])
+{
+    hr = hcs_init_random();
+    pk = pcs_t_init_public_key();
+    vk = pcs_t_init_private_key();
+    pcs_t_generate_key_pair(pk, vk, hr, 256, 3, 5);
+
+    int result = Catch::Session().run(argc, argv);
+
+    pcs_t_free_public_key(pk);
+    pcs_t_free_private_key(vk);
+    hcs_free_random(hr);
+    return result;
+}
@@ -3,6 +3,11 @@
 
 #include <gmpxx.h>
 #include "../include/libhcs++/random.hpp"
+#include "../include/libhcs/hcs_crt.h"
+#include "../include/libhcs/hcs_scrub.h"
+#include "../src/com/cpu.h"
+#include "../src/com/sha256.h"
+#include "../src/com/transcript.h"
 #include "../src/com/util.h"
 
 TEST_CASE( "Prime Generation accuracy" ) {
@@ -17,3 +22,249 @@ TEST_CASE( "Prime Generation accuracy" ) {
     REQUIRE(mpz_sizeinbase( a.get_mpz_t(), 2 ) >= 512);
     REQUIRE(mpz_probab_prime_p( a.get_mpz_t(), 25) != 0);
 }
+
+TEST_CASE( "CRT recombination" ) {
+    mpz_class a[3], m[3], x, r;
+    hcs_crt *crt = hcs_init_crt(3);
+
+    m[0] = 1000003; m[1] = "340282366920938463463374607431768211507"; m[2] = 65537;
+    x = "12345678901234567890123456789012345678901234";
+
+    for (int i = 0; i < 3; ++i) {
+        hcs_crt_set_modulus(crt, m[i].get_mpz_t(), i);
+        a[i] = x % m[i];
+    }
+    REQUIRE( hcs_crt_precompute(crt) );
+
+    mpz_t t[3];
+    for (int i = 0; i < 3; ++i)
+        mpz_init_set(t[i], a[i].get_mpz_t());
+
+    hcs_crt_combine(crt, r.get_mpz_t(), t);
+    REQUIRE( r == x % (m[0] * m[1] * m[2]) );
+
+    for (int i = 0; i < 3; ++i)
+        mpz_clear(t[i]);
+    hcs_free_crt(crt);
+
+    /* A context needs at least one modulus */
+    REQUIRE( hcs_init_crt(0) == NULL );
+}
+
+TEST_CASE( "Batch inversion and signed exponentiation" ) {
+    mpz_class mod = 1000003, order = 1000002, r, x;
+    mpz_t a[4];
+
+    for (int i = 0; i < 4; ++i)
+        mpz_init_set_ui(a[i], 17 * i + 3);
+
+    /* In place */
+    REQUIRE( mpz_invert_batch(a, a, 4, mod.get_mpz_t()) );
+    for (int i = 0; i < 4; ++i) {
+        x = mpz_class(a[i]) * (17 * i + 3) % mod;
+        REQUIRE( x == 1 );
+    }
+
+    mpz_set_ui(a[2], 0);
+    REQUIRE( !mpz_invert_batch(a, a, 4, mod.get_mpz_t()) );
+
+    /* Exponents on either side of order / 2 and below zero agree */
+    mpz_class base = 5, e[] = { 12345, 999990, -7 };
+    for (mpz_class &k : e) {
+        x = k % order;
+        if (x < 0) x += order;
+        mpz_powm(x.get_mpz_t(), base.get_mpz_t(), x.get_mpz_t(),
+                 mod.get_mpz_t());
+        REQUIRE( mpz_powm_signed(r.get_mpz_t(), base.get_mpz_t(),
+                    k.get_mpz_t(), order.get_mpz_t(), mod.get_mpz_t()) );
+        REQUIRE( r == x );
+    }
+
+    for (int i = 0; i < 4; ++i)
+        mpz_clear(a[i]);
+}
+
+TEST_CASE( "Lagrange coefficients" ) {
+    /* f(x) = 7 + 3x + 5x^2, so sum lambda_i * f(x_i) = delta * f(0) */
+    const unsigned long x[] = { 2, 5, 3 };
+    mpz_class delta = 120, l, sum = 0;
+
+    for (unsigned long i = 0; i < 3; ++i) {
+        mpz_lagrange_coeff(l.get_mpz_t(), delta.get_mpz_t(), x, 3, i);
+        sum += l * (7 + 3 * x[i] + 5 * x[i] * x[i]);
+    }
+    REQUIRE( sum == delta * 7 );
+}
+
+TEST_CASE( "Multi-exponentiation" ) {
+    mpz_class mod = 1000003, expect = 1, r, t;
+    mpz_t base[3], exp[3];
+
+    const unsigned long b[] = { 2, 999999, 12345 };
+    const char *e[] = { "0", "123456789012345678901234567890", "65535" };
+    for (int i = 0; i < 3; ++i) {
+        mpz_init_set_ui(base[i], b[i]);
+        mpz_init_set_str(exp[i], e[i], 10);
+        mpz_powm(t.get_mpz_t(), base[i], exp[i], mod.get_mpz_t());
+        expect = expect * t % mod;
+    }
+
+    REQUIRE( mpz_multi_powm(r.get_mpz_t(), base, exp, 3, mod.get_mpz_t()) );
+    REQUIRE( r == expect );
+
+    /* All exponents zero */
+    for (int i = 0; i < 3; ++i)
+        mpz_set_ui(exp[i], 0);
+    REQUIRE( mpz_multi_powm(r.get_mpz_t(), base, exp, 3, mod.get_mpz_t()) );
+    REQUIRE( r == 1 );
+
+    for (int i = 0; i < 3; ++i)
+        mpz_clears(base[i], exp[i], NULL);
+}
+
+TEST_CASE( "Fixed-base exponentiation" ) {
+    const unsigned long bits = 70;
+    mpz_class mod("1000000000000000000000000000000000000000000000000000007"),
+              base("31415926535897932384626433832795"), e, r, expect;
+    const unsigned long size = HCS_FIXED_POWM_SIZE(bits);
+    mpz_t *table = new mpz_t[size];
+    for (unsigned long i = 0; i < size; ++i)
+        mpz_init(table[i]);
+
+    mpz_fixed_powm_table(table, base.get_mpz_t(), bits, mod.get_mpz_t());
+
+    const char *exps[] = { "0", "1", "15", "16", "1180591620717411303423",
+                           "590295810358705651712" };
+    for (const char *x : exps) {
+        e = x;
+        mpz_fixed_powm_precomp(r.get_mpz_t(), table, e.get_mpz_t(), bits,
+                mod.get_mpz_t());
+        mpz_powm(expect.get_mpz_t(), base.get_mpz_t(), e.get_mpz_t(),
+                mod.get_mpz_t());
+        REQUIRE( r == expect );
+    }
+
+    for (unsigned long i = 0; i < size; ++i)
+        mpz_clear(table[i]);
+    delete[] table;
+}
+
+TEST_CASE( "Scrub policy" ) {
+    const hcs_scrub_policy saved = hcs_get_scrub_policy();
+    mpz_class a, b;
+
+    /* Values read as zero afterwards under every policy */
+    const hcs_scrub_policy policies[] = {
+        HCS_SCRUB_NONE, HCS_SCRUB_SECRET, HCS_SCRUB_ALL
+    };
+    for (hcs_scrub_policy p : policies) {
+        hcs_set_scrub_policy(p);
+        REQUIRE( hcs_get_scrub_policy() == p );
+
+        a = 12345; b = "98765432109876543210987654321";
+        mpz_zeros_public(a.get_mpz_t(), b.get_mpz_t(), NULL);
+        REQUIRE( a == 0 );
+        REQUIRE( b == 0 );
+
+        b = "98765432109876543210987654321";
+        mpz_zeros_secret(b.get_mpz_t(), NULL);
+        REQUIRE( b == 0 );
+        REQUIRE( mpz_sgn(b.get_mpz_t()) == 0 );
+    }
+
+    /* A scrubbed secret leaves no limbs behind */
+    hcs_set_scrub_policy(HCS_SCRUB_SECRET);
+    b = "98765432109876543210987654321";
+    const int limbs = b.get_mpz_t()->_mp_alloc;
+    mpz_zeros_secret(b.get_mpz_t(), NULL);
+    for (int i = 0; i < limbs; ++i)
+        REQUIRE( b.get_mpz_t()->_mp_d[i] == 0 );
+
+    hcs_set_scrub_policy(saved);
+}
+
+TEST_CASE( "CPU feature dispatch" ) {
+    const unsigned int features = hcs_cpu_features();
+    const unsigned int shani = HCS_CPU_SHA | HCS_CPU_SSSE3 | HCS_CPU_SSE41;
+
+    /* Kernels resolve against the features left after masking */
+    hcs_cpu_disable(HCS_CPU_SHA);
+    REQUIRE( (hcs_cpu_features() & HCS_CPU_SHA) == 0 );
+    sha256_force_generic(0);
+    REQUIRE( !sha256_accelerated() );
+
+    hcs_cpu_disable(0);
+    REQUIRE( hcs_cpu_features() == features );
+    sha256_force_generic(0);
+    REQUIRE( sha256_accelerated() == ((features & shani) == shani) );
+}
+
+TEST_CASE( "SHA-256 test vectors" ) {
+    const char *abc = "abc";
+    const char *long_msg =
+        "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    const char *abc_hex =
+        "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad";
+    const char *long_hex =
+        "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1";
+
+    for (int generic = 0; generic < 2; ++generic) {
+        sha256_force_generic(generic);
+
+        unsigned char digest[SHA256_DIGEST_SIZE];
+        char hex[2 * SHA256_DIGEST_SIZE + 1];
+        sha256_state st;
+
+        sha256_init(&st);
+        sha256_update(&st, (const unsigned char*)abc, 3);
+        sha256_digest(&st, digest);
+        for (int i = 0; i < SHA256_DIGEST_SIZE; ++i)
+            sprintf(hex + 2*i, "%02x", digest[i]);
+        REQUIRE( std::string(hex) == abc_hex );
+
+        /* Feed the message in uneven pieces to exercise buffering */
+        sha256_init(&st);
+        sha256_update(&st, (const unsigned char*)long_msg, 5);
+        sha256_update(&st, (const unsigned char*)long_msg + 5, 51);
+        sha256_digest(&st, digest);
+        for (int i = 0; i < SHA256_DIGEST_SIZE; ++i)
+            sprintf(hex + 2*i, "%02x", digest[i]);
+        REQUIRE( std::string(hex) == long_hex );
+    }
+
+    sha256_force_generic(0);
+}
+
+TEST_CASE( "Transcript absorbs mpz_t canonically" ) {
+    mpz_class a("123456789abcdef0123456789abcdef0fedcba", 16), c1, c2;
+    hcs_transcript tr;
+
+    size_t count;
+    unsigned char *bytes = (unsigned char*)mpz_export(NULL, &count, 1, 1, 1,
+            0, a.get_mpz_t());
+
+    hcs_transcript_init(&tr, HCS_HASH_SHA256);
+    hcs_transcript_absorb_mpz(&tr, a.get_mpz_t());
+    hcs_transcript_challenge(&tr, c1.get_mpz_t());
+
+    hcs_transcript_init(&tr, HCS_HASH_SHA256);
+    hcs_transcript_absorb_bytes(&tr, bytes, count);
+    hcs_transcript_challenge(&tr, c2.get_mpz_t());
+
+    REQUIRE( c1 == c2 );
+    free(bytes);
+
+    /* Moving a byte from one string to the next changes the challenge */
+    const unsigned char abc[] = "abc";
+    hcs_transcript_init(&tr, HCS_HASH_SHA256);
+    hcs_transcript_absorb_bytes(&tr, abc, 2);
+    hcs_transcript_absorb_bytes(&tr, abc + 2, 1);
+    hcs_transcript_challenge(&tr, c1.get_mpz_t());
+
+    hcs_transcript_init(&tr, HCS_HASH_SHA256);
+    hcs_transcript_absorb_bytes(&tr, abc, 1);
+    hcs_transcript_absorb_bytes(&tr, abc + 1, 2);
+    hcs_transcript_challenge(&tr, c2.get_mpz_t());
+
+    REQUIRE( c1 != c2 );
+}
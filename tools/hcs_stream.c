@@ -0,0 +1,194 @@
+/**
+ * @file hcs_stream.c
+ *
+ * Command line front end to pcs_encrypt_stream and pcs_decrypt_stream.
+ *
+ *     hcs_stream keygen <bits> <public key> <private key>
+ *     hcs_stream encrypt [-j workers] <public key> [input [output]]
+ *     hcs_stream decrypt [-j workers] <private key> [input [output]]
+ *
+ * Keys are stored in the JSON format of pcs_export_public_key and
+ * pcs_export_private_key. Input and output default to the standard streams.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "../include/libhcs/hcs_random.h"
+#include "../include/libhcs/pcs.h"
+#include "../include/libhcs/pcs_stream.h"
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: hcs_stream keygen <bits> <public key> <private key>\n"
+            "       hcs_stream encrypt [-j workers] <public key> "
+            "[input [output]]\n"
+            "       hcs_stream decrypt [-j workers] <private key> "
+            "[input [output]]\n");
+    exit(2);
+}
+
+/* Read the whole of @p path into a string, or NULL on failure */
+static char* read_file(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+        return NULL;
+
+    size_t len = 0, cap = 4096;
+    char *buf = malloc(cap);
+    while (buf) {
+        len += fread(buf + len, 1, cap - len - 1, f);
+        if (len + 1 < cap)
+            break;
+
+        char *grown = realloc(buf, 2 * cap);
+        if (grown == NULL) {
+            free(buf);
+            buf = NULL;
+        }
+        else {
+            buf = grown;
+            cap *= 2;
+        }
+    }
+
+    if (buf && ferror(f)) {
+        free(buf);
+        buf = NULL;
+    }
+    if (buf)
+        buf[len] = '\0';
+
+    fclose(f);
+    return buf;
+}
+
+/* Write data to path. A secret file is created with mode 0600, and an
+ * existing one is narrowed to it, so the private key is never readable by
+ * others whatever the umask. */
+static int write_file(const char *path, const char *data, int secret)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, secret ? 0600 : 0666);
+    if (fd < 0)
+        return 0;
+
+    if (secret && fchmod(fd, 0600)) {
+        close(fd);
+        return 0;
+    }
+
+    FILE *f = fdopen(fd, "w");
+    if (f == NULL) {
+        close(fd);
+        return 0;
+    }
+
+    int ok = fputs(data, f) != EOF && fputc('\n', f) != EOF;
+    return fclose(f) == 0 && ok;
+}
+
+static int keygen(int argc, char **argv)
+{
+    if (argc != 3)
+        usage();
+
+    unsigned long bits = strtoul(argv[0], NULL, 10);
+    pcs_public_key *pk = pcs_init_public_key();
+    pcs_private_key *vk = pcs_init_private_key();
+    hcs_random *hr = hcs_init_random();
+    int ok = 0;
+
+    if (pk && vk && hr && bits >= 64) {
+        pcs_generate_key_pair(pk, vk, hr, bits);
+
+        char *pks = pcs_export_public_key(pk);
+        char *vks = pcs_export_private_key(vk);
+        ok = pks && vks && write_file(argv[1], pks, 0) &&
+             write_file(argv[2], vks, 1);
+        free(pks);
+        free(vks);
+    }
+
+    if (hr)
+        hcs_free_random(hr);
+    if (vk)
+        pcs_free_private_key(vk);
+    if (pk)
+        pcs_free_public_key(pk);
+    return ok;
+}
+
+static int run(int decrypt, int argc, char **argv)
+{
+    unsigned long workers = 0;
+    if (argc >= 2 && strcmp(argv[0], "-j") == 0) {
+        workers = strtoul(argv[1], NULL, 10);
+        argc -= 2;
+        argv += 2;
+    }
+    if (argc < 1 || argc > 3)
+        usage();
+
+    char *key = read_file(argv[0]);
+    if (key == NULL) {
+        perror(argv[0]);
+        return 0;
+    }
+
+    FILE *in = argc > 1 ? fopen(argv[1], decrypt ? "rb" : "r") : stdin;
+    FILE *out = argc > 2 ? fopen(argv[2], decrypt ? "w" : "wb") : stdout;
+    int ok = 0;
+
+    if (in == NULL || out == NULL) {
+        perror(in == NULL ? argv[1] : argv[2]);
+    }
+    else if (decrypt) {
+        pcs_private_key *vk = pcs_init_private_key();
+        if (vk && pcs_import_private_key(vk, key))
+            ok = pcs_decrypt_stream(vk, in, out, workers, 0);
+        if (vk)
+            pcs_free_private_key(vk);
+    }
+    else {
+        pcs_public_key *pk = pcs_init_public_key();
+        hcs_random *hr = hcs_init_random();
+        if (pk && hr && pcs_import_public_key(pk, key))
+            ok = pcs_encrypt_stream(pk, hr, in, out, workers, 0);
+        if (hr)
+            hcs_free_random(hr);
+        if (pk)
+            pcs_free_public_key(pk);
+    }
+
+    if (in && in != stdin)
+        fclose(in);
+    if (out && out != stdout && fclose(out))
+        ok = 0;
+    free(key);
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+        usage();
+
+    int ok = 0;
+    if (strcmp(argv[1], "keygen") == 0)
+        ok = keygen(argc - 2, argv + 2);
+    else if (strcmp(argv[1], "encrypt") == 0)
+        ok = run(0, argc - 2, argv + 2);
+    else if (strcmp(argv[1], "decrypt") == 0)
+        ok = run(1, argc - 2, argv + 2);
+    else
+        usage();
+
+    if (!ok)
+        fprintf(stderr, "hcs_stream: %s failed\n", argv[1]);
+    return ok ? 0 : 1;
+}